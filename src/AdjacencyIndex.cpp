@@ -0,0 +1,319 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "AdjacencyIndex.h"
+
+#include "sqlite3.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+void insertSortedByType(std::vector<AdjacencyIndex::Edge>& edges, const AdjacencyIndex::Edge& edge)
+{
+  // Relationships are usually added by increasing type and id, so this is most often an append.
+  const auto it = std::upper_bound(edges.begin(), edges.end(), edge.relationshipType,
+                                   [](const int64_t type, const AdjacencyIndex::Edge& e){ return type < e.relationshipType; });
+  edges.insert(it, edge);
+}
+} // NS
+
+void AdjacencyIndex::add(const int64_t relationshipID, const int64_t relationshipType, const int64_t originID, const int64_t destinationID)
+{
+  insertSortedByType(m_outgoing[originID], Edge{relationshipID, relationshipType, destinationID});
+  insertSortedByType(m_incoming[destinationID], Edge{relationshipID, relationshipType, originID});
+  ++m_countRelationships;
+}
+
+void AdjacencyIndex::clear()
+{
+  m_outgoing.clear();
+  m_incoming.clear();
+  m_countRelationships = 0;
+}
+
+std::pair<const AdjacencyIndex::Edge*, const AdjacencyIndex::Edge*>
+AdjacencyIndex::edges(const int64_t nodeID, const openCypher::TraversalDirection direction, const std::optional<int64_t> relationshipType) const
+{
+  if(direction == openCypher::TraversalDirection::Any)
+    throw std::logic_error("[Unexpected] AdjacencyIndex::edges expects a direction");
+  const auto & byNode = (direction == openCypher::TraversalDirection::Forward) ? m_outgoing : m_incoming;
+  const auto it = byNode.find(nodeID);
+  if(it == byNode.end())
+    return {nullptr, nullptr};
+  const Edge* begin = it->second.data();
+  const Edge* end = begin + it->second.size();
+  if(!relationshipType.has_value())
+    return {begin, end};
+  return std::equal_range(begin, end, Edge{0, *relationshipType, 0}, [](const Edge& a, const Edge& b){ return a.relationshipType < b.relationshipType; });
+}
+
+namespace
+{
+enum NeighborsColumn
+{
+  ColumnRelationshipID = 0,
+  ColumnRelationshipType,
+  ColumnOriginID,
+  ColumnDestinationID,
+  ColumnReversed,
+  // Hidden columns, the arguments of the table-valued function.
+  ColumnNodeID,
+  ColumnDirection,
+  ColumnRelType
+};
+
+enum NeighborsArgs
+{
+  // Bits of idxNum.
+  HasRelType = 1
+};
+
+struct NeighborsVTab : sqlite3_vtab
+{
+  const AdjacencyIndex* index{};
+};
+
+struct NeighborsCursor : sqlite3_vtab_cursor
+{
+  int64_t nodeID{};
+  int64_t direction{};
+  std::optional<int64_t> relationshipType;
+
+  // With TraversalDirection::Any, the outgoing relationships are followed by the incoming relationships.
+  std::pair<const AdjacencyIndex::Edge*, const AdjacencyIndex::Edge*> ranges[2]{};
+  int rangeIndex{};
+  const AdjacencyIndex::Edge* cur{};
+  sqlite3_int64 rowid{};
+
+  void skipEmptyRanges()
+  {
+    while(cur == ranges[rangeIndex].second && rangeIndex < 1)
+    {
+      ++rangeIndex;
+      cur = ranges[rangeIndex].first;
+    }
+  }
+  bool eof() const { return cur == ranges[rangeIndex].second; }
+};
+
+int neighborsConnect(sqlite3 *db, void *pAux, int, const char *const*, sqlite3_vtab **ppVtab, char **)
+{
+  const int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(SYS__ID, RelationshipType, OriginID, DestinationID, Reversed,"
+                                      " node_id HIDDEN, direction HIDDEN, rel_type HIDDEN)");
+  if(rc != SQLITE_OK)
+    return rc;
+  auto * vtab = new NeighborsVTab{};
+  vtab->index = static_cast<const AdjacencyIndex*>(pAux);
+  *ppVtab = vtab;
+  return SQLITE_OK;
+}
+
+int neighborsDisconnect(sqlite3_vtab *pVtab)
+{
+  delete static_cast<NeighborsVTab*>(pVtab);
+  return SQLITE_OK;
+}
+
+int neighborsOpen(sqlite3_vtab *, sqlite3_vtab_cursor **ppCursor)
+{
+  *ppCursor = new NeighborsCursor{};
+  return SQLITE_OK;
+}
+
+int neighborsClose(sqlite3_vtab_cursor *cur)
+{
+  delete static_cast<NeighborsCursor*>(cur);
+  return SQLITE_OK;
+}
+
+int neighborsFilter(sqlite3_vtab_cursor *cur, int idxNum, const char *, int argc, sqlite3_value **argv)
+{
+  auto * cursor = static_cast<NeighborsCursor*>(cur);
+  auto * vtab = cursor->pVtab;
+  const auto & index = *static_cast<const NeighborsVTab*>(vtab)->index;
+  *cursor = NeighborsCursor{};
+  cursor->pVtab = vtab;
+  if(argc < 2)
+    return SQLITE_OK;
+  cursor->nodeID = sqlite3_value_int64(argv[0]);
+  cursor->direction = sqlite3_value_int64(argv[1]);
+  if((idxNum & HasRelType) && argc > 2)
+  {
+    if(sqlite3_value_type(argv[2]) == SQLITE_NULL)
+      // No relationship has a null type.
+      return SQLITE_OK;
+    cursor->relationshipType = sqlite3_value_int64(argv[2]);
+  }
+  // A null node has no relationship.
+  if(sqlite3_value_type(argv[0]) == SQLITE_NULL)
+    return SQLITE_OK;
+
+  using openCypher::TraversalDirection;
+  switch(static_cast<TraversalDirection>(cursor->direction))
+  {
+    case TraversalDirection::Forward:
+    case TraversalDirection::Backward:
+      cursor->ranges[0] = index.edges(cursor->nodeID, static_cast<TraversalDirection>(cursor->direction), cursor->relationshipType);
+      break;
+    case TraversalDirection::Any:
+      cursor->ranges[0] = index.edges(cursor->nodeID, TraversalDirection::Forward, cursor->relationshipType);
+      cursor->ranges[1] = index.edges(cursor->nodeID, TraversalDirection::Backward, cursor->relationshipType);
+      break;
+    default:
+      cursor->pVtab->zErrMsg = sqlite3_mprintf("neighbors: invalid direction %lld", static_cast<long long>(cursor->direction));
+      return SQLITE_ERROR;
+  }
+  cursor->cur = cursor->ranges[0].first;
+  cursor->skipEmptyRanges();
+  return SQLITE_OK;
+}
+
+int neighborsNext(sqlite3_vtab_cursor *cur)
+{
+  auto * cursor = static_cast<NeighborsCursor*>(cur);
+  ++cursor->cur;
+  cursor->skipEmptyRanges();
+  ++cursor->rowid;
+  return SQLITE_OK;
+}
+
+int neighborsEof(sqlite3_vtab_cursor *cur)
+{
+  return static_cast<const NeighborsCursor*>(cur)->eof();
+}
+
+int neighborsColumn(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int i)
+{
+  const auto * cursor = static_cast<const NeighborsCursor*>(cur);
+  const auto & edge = *cursor->cur;
+  // With TraversalDirection::Any, relationships are oriented from the node.
+  const bool nodeIsDestination = cursor->direction == static_cast<int64_t>(openCypher::TraversalDirection::Backward);
+  switch(i)
+  {
+    case ColumnRelationshipID:
+      sqlite3_result_int64(ctx, edge.relationshipID);
+      break;
+    case ColumnRelationshipType:
+      sqlite3_result_int64(ctx, edge.relationshipType);
+      break;
+    case ColumnOriginID:
+      sqlite3_result_int64(ctx, nodeIsDestination ? edge.neighborID : cursor->nodeID);
+      break;
+    case ColumnDestinationID:
+      sqlite3_result_int64(ctx, nodeIsDestination ? cursor->nodeID : edge.neighborID);
+      break;
+    case ColumnReversed:
+      // The incoming relationships of TraversalDirection::Any are reversed.
+      sqlite3_result_int(ctx, cursor->rangeIndex);
+      break;
+    case ColumnNodeID:
+      sqlite3_result_int64(ctx, cursor->nodeID);
+      break;
+    case ColumnDirection:
+      sqlite3_result_int64(ctx, cursor->direction);
+      break;
+    case ColumnRelType:
+      if(cursor->relationshipType.has_value())
+        sqlite3_result_int64(ctx, *cursor->relationshipType);
+      else
+        sqlite3_result_null(ctx);
+      break;
+  }
+  return SQLITE_OK;
+}
+
+int neighborsRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid)
+{
+  *pRowid = static_cast<const NeighborsCursor*>(cur)->rowid;
+  return SQLITE_OK;
+}
+
+int neighborsBestIndex(sqlite3_vtab *, sqlite3_index_info *pIdxInfo)
+{
+  int nodeIdx = -1;
+  int directionIdx = -1;
+  int relTypeIdx = -1;
+  for(int i{}; i < pIdxInfo->nConstraint; ++i)
+  {
+    const auto & constraint = pIdxInfo->aConstraint[i];
+    if(constraint.op != SQLITE_INDEX_CONSTRAINT_EQ)
+      continue;
+    // An unusable argument forces SQLite to find another plan.
+    if(!constraint.usable && constraint.iColumn >= ColumnNodeID)
+      return SQLITE_CONSTRAINT;
+    if(!constraint.usable)
+      continue;
+    switch(constraint.iColumn)
+    {
+      case ColumnNodeID: nodeIdx = i; break;
+      case ColumnDirection: directionIdx = i; break;
+      case ColumnRelType: relTypeIdx = i; break;
+    }
+  }
+  // The node and the direction are required.
+  if(nodeIdx < 0 || directionIdx < 0)
+    return SQLITE_CONSTRAINT;
+  pIdxInfo->aConstraintUsage[nodeIdx].argvIndex = 1;
+  pIdxInfo->aConstraintUsage[nodeIdx].omit = 1;
+  pIdxInfo->aConstraintUsage[directionIdx].argvIndex = 2;
+  pIdxInfo->aConstraintUsage[directionIdx].omit = 1;
+  pIdxInfo->idxNum = 0;
+  if(relTypeIdx >= 0)
+  {
+    pIdxInfo->aConstraintUsage[relTypeIdx].argvIndex = 3;
+    pIdxInfo->aConstraintUsage[relTypeIdx].omit = 1;
+    pIdxInfo->idxNum |= HasRelType;
+  }
+  // The relationships of a node are read from memory.
+  pIdxInfo->estimatedCost = 1.;
+  pIdxInfo->estimatedRows = 10;
+  return SQLITE_OK;
+}
+
+sqlite3_module neighborsModule = {
+  0,                         /* iVersion */
+  0,                         /* xCreate */
+  neighborsConnect,          /* xConnect */
+  neighborsBestIndex,        /* xBestIndex */
+  neighborsDisconnect,       /* xDisconnect */
+  0,                         /* xDestroy */
+  neighborsOpen,             /* xOpen - open a cursor */
+  neighborsClose,            /* xClose - close a cursor */
+  neighborsFilter,           /* xFilter - configure scan constraints */
+  neighborsNext,             /* xNext - advance a cursor */
+  neighborsEof,              /* xEof - check for end of scan */
+  neighborsColumn,           /* xColumn - read data */
+  neighborsRowid,            /* xRowid - read data */
+  0,                         /* xUpdate */
+  0,                         /* xBegin */
+  0,                         /* xSync */
+  0,                         /* xCommit */
+  0,                         /* xRollback */
+  0,                         /* xFindMethod */
+  0,                         /* xRename */
+  0,                         /* xSavepoint */
+  0,                         /* xRelease */
+  0,                         /* xRollbackTo */
+  0                          /* xShadowName */
+};
+} // NS
+
+int sqlite3_neighbors_init(sqlite3* db, const AdjacencyIndex* index)
+{
+  return sqlite3_create_module(db, "neighbors", &neighborsModule, const_cast<AdjacencyIndex*>(index));
+}
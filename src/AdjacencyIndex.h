@@ -0,0 +1,67 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include "CypherAST.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct sqlite3;
+
+// An in-memory copy of the relationships system table, indexed by node, for integer ids.
+class AdjacencyIndex
+{
+public:
+  struct Edge
+  {
+    int64_t relationshipID;
+    int64_t relationshipType;
+    // The other end of the relationship.
+    int64_t neighborID;
+  };
+
+  void add(int64_t relationshipID, int64_t relationshipType, int64_t originID, int64_t destinationID);
+  void clear();
+
+  // Returns the range of the relationships of |nodeID|, leaving the node with Forward, entering the node with Backward,
+  // with |relationshipType| if it has a value.
+  // The relationships are sorted by type.
+  std::pair<const Edge*, const Edge*> edges(int64_t nodeID, openCypher::TraversalDirection, std::optional<int64_t> relationshipType) const;
+
+  size_t countRelationships() const { return m_countRelationships; }
+
+private:
+  std::unordered_map<int64_t, std::vector<Edge>> m_outgoing;
+  std::unordered_map<int64_t, std::vector<Edge>> m_incoming;
+  size_t m_countRelationships{};
+};
+
+// Registers the 'neighbors' eponymous virtual table in |db|, reading the relationships of |index|:
+//
+//   neighbors(node_id, direction [, rel_type])
+//
+// has the columns of the relationships system table (SYS__ID, RelationshipType, OriginID, DestinationID)
+// for the relationships of |node_id|, where |direction| is the integer value of a TraversalDirection:
+// - Forward: the relationships whose OriginID is node_id,
+// - Backward: the relationships whose DestinationID is node_id,
+// - Any: the relationships of both directions, oriented so that OriginID is node_id
+//   (like the undirectedRelationships view of forEachPath), and whose 'Reversed' column is 1
+//   for the relationships whose destination is node_id.
+int sqlite3_neighbors_init(sqlite3* db, const AdjacencyIndex* index);
@@ -64,6 +64,9 @@ struct ParameterName
   }
 };
 
+// The value of a query parameter: a single value, or a list of values.
+using ParameterValue = std::variant<std::shared_ptr<Value>, HomogeneousNonNullableValues>;
+
 
 
 
@@ -268,6 +271,157 @@ inline std::ostream& operator<<(std::ostream& os, const PropertyKeyName& p)
   return os;
 }
 
+
+enum class DegreeDirection
+{
+  Outgoing,
+  Incoming,
+  Both
+};
+
+// The degree of a node, as returned by the degree(), outDegree() and inDegree() functions.
+//
+// Like id(), these functions are rewritten as a reserved property of the node.
+struct DegreeFunction
+{
+  DegreeDirection direction;
+  // When set, only the relationships of this type are counted.
+  std::optional<Label> relationshipType;
+};
+
+namespace detail
+{
+inline const char* degreePropertyPrefix(const DegreeDirection d)
+{
+  switch(d)
+  {
+    case DegreeDirection::Outgoing: return "SYS__OUTDEGREE";
+    case DegreeDirection::Incoming: return "SYS__INDEGREE";
+    case DegreeDirection::Both: return "SYS__DEGREE";
+  }
+}
+}  // NS
+
+inline PropertyKeyName mkDegreeProperty(const DegreeFunction& degree)
+{
+  std::string name = detail::degreePropertyPrefix(degree.direction);
+  if(degree.relationshipType.has_value())
+    name += "__" + degree.relationshipType->symbolicName.str;
+  return mkProperty(name);
+}
+
+inline std::optional<DegreeFunction> asDegreeFunction(const PropertyKeyName& property)
+{
+  const std::string& name = property.symbolicName.str;
+  for(const auto direction : {DegreeDirection::Outgoing, DegreeDirection::Incoming, DegreeDirection::Both})
+  {
+    const std::string prefix = detail::degreePropertyPrefix(direction);
+    if(name.compare(0, prefix.size(), prefix) != 0)
+      continue;
+    if(name.size() == prefix.size())
+      return DegreeFunction{direction, std::nullopt};
+    if(name.compare(prefix.size(), 2, "__") == 0 && name.size() > prefix.size() + 2)
+      return DegreeFunction{direction, Label{SymbolicName{name.substr(prefix.size() + 2)}}};
+  }
+  return std::nullopt;
+}
+
+// A pattern predicate, like (a)-[:Blocks]->(:User) in a where clause, or EXISTS { (a)-[:Blocks]->(:User) }.
+//
+// The first node of the pattern is a node variable, the other nodes and the relationships are anonymous.
+// Like the degree functions, the predicate is rewritten as a reserved property of the node variable,
+// whose value is 1 when the pattern has a match and 0 otherwise.
+struct PatternPredicate
+{
+  struct Step
+  {
+    TraversalDirection direction;
+    Labels relationshipTypes;
+    // The labels of the node at the end of the step.
+    Labels nodeLabels;
+  };
+  std::vector<Step> steps;
+};
+
+namespace detail
+{
+inline constexpr const char* c_patternPredicatePrefix{"SYS__EXISTS"};
+
+inline const char* toStr(const TraversalDirection d)
+{
+  switch(d)
+  {
+    case TraversalDirection::Forward: return "OUT";
+    case TraversalDirection::Backward: return "IN";
+    case TraversalDirection::Any: return "ANY";
+  }
+}
+}  // NS
+
+// The steps, relationship types and labels of the pattern are encoded in the property name,
+// separated by "__". Hence, labels containing "__" are not supported.
+inline PropertyKeyName mkPatternPredicateProperty(const PatternPredicate& predicate)
+{
+  std::string name = detail::c_patternPredicatePrefix;
+  auto append = [&](const char* tag, const Labels& labels)
+  {
+    for(const auto & label : labels.labels)
+    {
+      if(label.symbolicName.str.find("__") != std::string::npos)
+        throw std::invalid_argument("Labels of pattern predicates cannot contain '__'.");
+      name += tag + label.symbolicName.str;
+    }
+  };
+  for(const auto & step : predicate.steps)
+  {
+    name += "__";
+    name += detail::toStr(step.direction);
+    append("__R_", step.relationshipTypes);
+    append("__N_", step.nodeLabels);
+  }
+  return mkProperty(name);
+}
+
+inline std::optional<PatternPredicate> asPatternPredicate(const PropertyKeyName& property)
+{
+  const std::string& name = property.symbolicName.str;
+  const std::string prefix = detail::c_patternPredicatePrefix;
+  if(name.compare(0, prefix.size(), prefix) != 0)
+    return std::nullopt;
+  PatternPredicate predicate;
+  for(size_t pos = prefix.size(); pos < name.size();)
+  {
+    if(name.compare(pos, 2, "__") != 0)
+      return std::nullopt;
+    pos += 2;
+    size_t end = name.find("__", pos);
+    if(end == std::string::npos)
+      end = name.size();
+    const std::string token = name.substr(pos, end - pos);
+    pos = end;
+    if(token == "OUT" || token == "IN" || token == "ANY")
+      predicate.steps.push_back({(token == "OUT") ? TraversalDirection::Forward : ((token == "IN") ? TraversalDirection::Backward : TraversalDirection::Any), {}, {}});
+    else if(predicate.steps.empty() || token.size() < 3 || token[1] != '_')
+      return std::nullopt;
+    else if(token[0] == 'R')
+      predicate.steps.back().relationshipTypes.labels.insert(Label{SymbolicName{token.substr(2)}});
+    else if(token[0] == 'N')
+      predicate.steps.back().nodeLabels.labels.insert(Label{SymbolicName{token.substr(2)}});
+    else
+      return std::nullopt;
+  }
+  if(predicate.steps.empty())
+    return std::nullopt;
+  return predicate;
+}
+
+// Returns true if |property| is a reserved property of nodes computed from the relationships of the node
+// (see DegreeFunction and PatternPredicate).
+inline bool isComputedNodeProperty(const PropertyKeyName& property)
+{
+  return asDegreeFunction(property).has_value() || asPatternPredicate(property).has_value();
+}
+
 } // NS
 
 
@@ -375,6 +529,15 @@ struct Expression;
 
 using ExpressionsByVarsUsages = std::map<VarsUsages, std::vector<const Expression*>>;
 
+// A predicate that could be evaluated using an index on |property|.
+struct IndexablePredicate
+{
+  Variable var;
+  PropertyKeyName property;
+  // true for '=' and 'IN' predicates, false for range predicates.
+  bool isEquality{};
+};
+
 // Definitions for terms used in comments:
 //
 // # Equi-var
@@ -391,11 +554,9 @@ using ExpressionsByVarsUsages = std::map<VarsUsages, std::vector<const Expressio
 //   (C) <term applying only to properties and label of 'r'> AND
 //   (D) <term applying to properties and label of multiple items, i.e for example 'a' and 'b'>
 //
-// Currently, we only handle where clauses containing (A), (B), (C), but not (D).
-// This is why we needed to define the notion of "equi-var" expression tree:
-//   supported where clauses are "equi-var" expressions.
-//
-// TODO: support (D) by evaluating (D) when we merge results of individual queries.
+// (A), (B), (C) are "equi-var" expressions: they are applied in the SQL queries.
+// (D) is applied in the SQL queries when it only uses id or inline properties,
+// else it is evaluated by a sql::FilterProgram when we merge results of individual queries.
 struct Expression
 {
   virtual ~Expression() = default;
@@ -442,6 +603,11 @@ struct Expression
   virtual void asMaximalANDAggregation(ExpressionsByVarsUsages& exprs) const = 0;
 
   virtual VarsUsages varsUsages() const = 0;
+
+  // Returns a value iff the expression compares a property of a variable with a literal,
+  // using '=', 'IN', '<', '<=', '>' or '>='.
+  virtual std::optional<IndexablePredicate> indexablePredicate() const { return std::nullopt; }
+
   // throws if the translation is not supported yet.
   virtual std::unique_ptr<sql::Expression>
   toSQLExpressionTree(const std::set<PropertySchema>& sqlFields,
@@ -658,6 +824,33 @@ struct Atom
 };
 
 
+// Aggregation functions of return clauses.
+// Nulls are ignored, except by count(*).
+enum class AggregationFunction
+{
+  // count(*)
+  CountRows,
+  Count,
+  Sum,
+  Min,
+  Max,
+  Avg
+};
+
+inline std::string toStr(AggregationFunction a)
+{
+  switch(a)
+  {
+    case AggregationFunction::CountRows:
+    case AggregationFunction::Count: return "count";
+    case AggregationFunction::Sum: return "sum";
+    case AggregationFunction::Min: return "min";
+    case AggregationFunction::Max: return "max";
+    case AggregationFunction::Avg: return "avg";
+  }
+}
+
+
 struct NonArithmeticOperatorExpression : public Expression
 {
   static constexpr const char * c_name {"NonArithmeticOperatorExpression"};
@@ -708,6 +901,8 @@ struct NonArithmeticOperatorExpression : public Expression
   
   VarsUsages varsUsages() const override
   {
+    if(mayAggregation.has_value())
+      throw std::logic_error("Aggregation functions can only be used in return clauses.");
     return std::visit([&](auto && arg) -> VarsUsages {
       using T = std::decay_t<decltype(arg)>;
       if constexpr (std::is_same_v<T, Variable>)
@@ -840,9 +1035,34 @@ struct NonArithmeticOperatorExpression : public Expression
     },atom.var);
   }
   
+  // Returns the variable and property iff the expression is a non-negated property of a variable.
+  std::optional<std::pair<Variable, PropertyKeyName>> asVariableProperty() const
+  {
+    if(negated || !mayPropertyName.has_value() || !labels.empty() || mayAggregation.has_value())
+      return std::nullopt;
+    if(const auto * var = std::get_if<Variable>(&atom.var))
+      return std::make_pair(*var, *mayPropertyName);
+    return std::nullopt;
+  }
+  bool isLiteral() const
+  {
+    return !negated && std::holds_alternative<Literal>(atom.var);
+  }
+  // Whether the expression is the non-negated variable |var|, without property and labels.
+  bool isVariable(const Variable& var) const
+  {
+    if(negated || mayPropertyName.has_value() || !labels.empty())
+      return false;
+    const auto * v = std::get_if<Variable>(&atom.var);
+    return v && *v == var;
+  }
+
   Atom atom;
   std::optional<PropertyKeyName> mayPropertyName;
   Labels labels;
+  // When set, the expression is an aggregation of the property (or of the variable when there is no property).
+  // For count(*), |atom| is a null literal.
+  std::optional<AggregationFunction> mayAggregation;
   
 private:
   bool negated{};
@@ -904,6 +1124,39 @@ struct ComparisonExpression : public Expression {
     return std::make_unique<sql::ComparisonExpression>(std::move(left), actualComp, std::move(right));
   }
 
+  std::optional<IndexablePredicate> indexablePredicate() const override
+  {
+    const Comparison actualComp = negated ? negateComparison(partial.comp) : partial.comp;
+    if(actualComp == Comparison::NE)
+      return std::nullopt;
+    auto varProperty = leftExp.asVariableProperty();
+    if(varProperty.has_value())
+    {
+      if(!partial.rightExp.isLiteral())
+        return std::nullopt;
+    }
+    else
+    {
+      varProperty = partial.rightExp.asVariableProperty();
+      if(!varProperty.has_value() || !leftExp.isLiteral())
+        return std::nullopt;
+    }
+    return IndexablePredicate{varProperty->first, varProperty->second, actualComp == Comparison::EQ};
+  }
+
+  // Returns the variable and property iff the expression is an equality between a property of a variable and |var|.
+  std::optional<std::pair<Variable, PropertyKeyName>> propertyEqualTo(const Variable& var) const
+  {
+    const Comparison actualComp = negated ? negateComparison(partial.comp) : partial.comp;
+    if(actualComp != Comparison::EQ)
+      return std::nullopt;
+    if(partial.rightExp.isVariable(var))
+      return leftExp.asVariableProperty();
+    if(leftExp.isVariable(var))
+      return partial.rightExp.asVariableProperty();
+    return std::nullopt;
+  }
+
   NonArithmeticOperatorExpression leftExp;
   PartialComparisonExpression partial;
 
@@ -952,6 +1205,16 @@ struct StringListNullPredicateExpression : public Expression {
     std::unique_ptr<sql::Expression> right = inList.toSQLExpressionTree();
     return std::make_unique<sql::StringListNullPredicateExpression>(std::move(left), m_negate, std::move(right));
   }
+
+  std::optional<IndexablePredicate> indexablePredicate() const override
+  {
+    if(m_negate)
+      return std::nullopt;
+    const auto varProperty = leftExp.asVariableProperty();
+    if(!varProperty.has_value())
+      return std::nullopt;
+    return IndexablePredicate{varProperty->first, varProperty->second, true};
+  }
 };
 
 
@@ -964,14 +1227,22 @@ struct WhereClause{
 struct Match{
   Pattern pattern;
   std::optional<WhereClause> where;
+  // OPTIONAL MATCH: when the pattern has no match, its variables are null.
+  bool optional{};
 };
 
 
 struct ReadingClause{
-  // todo support UNWIND
   Match match;
 };
 
+// UNWIND clauses are only supported before the MATCH clause of a query part.
+struct Unwind{
+  // The list of values.
+  Literal list;
+  Variable variable;
+};
+
 // Not used yet in valid cases.
 struct ListOperatorExpression{};
 
@@ -991,19 +1262,55 @@ struct Limit {
 };
 
 
+enum class SortOrder{
+  Ascending,
+  Descending
+};
+
+struct SortItem{
+  NonArithmeticOperatorExpression naoExp;
+  SortOrder order{SortOrder::Ascending};
+};
+
+struct Order{
+  std::vector<SortItem> sortItems;
+};
+
+
 struct ProjectionBody{
+  bool distinct{};
+  std::optional<Order> order;
   std::optional<Limit> limit;
   ProjectionItems items;
 };
 
 using Return = ProjectionBody;
 struct SinglePartQuery{
+  // The UNWIND clause preceding mayReadingClause.
+  std::optional<Unwind> mayUnwind;
   std::optional<ReadingClause> mayReadingClause;
+  // The OPTIONAL MATCH clauses following mayReadingClause.
+  std::vector<Match> optionalMatches;
   Return returnClause;
 };
 
 
+struct With{
+  ProjectionBody projectionBody;
+  std::optional<WhereClause> where;
+};
+
+// A part of a multi-part query: its reading clauses, followed by the WITH clause passing its results to the next part.
+struct QueryPart{
+  std::optional<Unwind> mayUnwind;
+  std::optional<ReadingClause> mayReadingClause;
+  std::vector<Match> optionalMatches;
+  With with;
+};
+
 struct SingleQuery{
+  // The parts preceding singlePartQuery, for a multi-part query.
+  std::vector<QueryPart> queryParts;
   SinglePartQuery singlePartQuery;
 };
 
@@ -25,8 +25,9 @@ namespace openCypher::detail
 {
 RegularQuery cypherQueryToAST(const PropertySchema& idProperty,
                               const std::string& query,
-                              const std::map<ParameterName, HomogeneousNonNullableValues>& queryParams,
-                              const bool printAST)
+                              const std::map<ParameterName, ParameterValue>& queryParams,
+                              const bool printAST,
+                              std::map<ParameterName, size_t>* countParameterUses)
 {
   auto chars = antlr4::ANTLRInputStream(query);
   auto lexer = CypherLexer(&chars);
@@ -54,6 +55,8 @@ RegularQuery cypherQueryToAST(const PropertySchema& idProperty,
   
   if(resVisit.type() != typeid(RegularQuery))
     throw std::logic_error("No RegularQuery was returned.");
+  if(countParameterUses)
+    *countParameterUses = visitor.getCountParameterUses();
   return std::any_cast<RegularQuery>(resVisit);;
 }
 
@@ -66,6 +69,8 @@ extractColumnNames(const std::vector<ProjectionItem>& items)
   {
     if(mayVar.has_value())
       res.push_back(mayVar->symbolicName.str);
+    else if(nao.mayAggregation == AggregationFunction::CountRows)
+      res.push_back("count(*)");
     else
     {
       std::string name = std::get<openCypher::Variable>(nao.atom.var).symbolicName.str;
@@ -74,10 +79,227 @@ extractColumnNames(const std::vector<ProjectionItem>& items)
         name += ".";
         name += nao.mayPropertyName->symbolicName.str;
       }
+      if(nao.mayAggregation.has_value())
+        name = toStr(*nao.mayAggregation) + "(" + name + ")";
       res.push_back(std::move(name));
     }
   }
   return res;
 }
 
+namespace
+{
+TraversalDirection reverse(const TraversalDirection d)
+{
+  switch(d)
+  {
+    case TraversalDirection::Forward:
+      return TraversalDirection::Backward;
+    case TraversalDirection::Backward:
+      return TraversalDirection::Forward;
+    case TraversalDirection::Any:
+      return TraversalDirection::Any;
+  }
+  throw std::logic_error("Unhandled TraversalDirection");
+}
+
+AnonymousPatternPart reverse(const AnonymousPatternPart& app)
+{
+  AnonymousPatternPart res;
+  const auto & chains = app.patternElementChains;
+  res.firstNodePattern = chains.empty() ? app.firstNodePattern : chains.back().nodePattern;
+  for(size_t i = chains.size(); i>0; --i)
+  {
+    auto & chain = res.patternElementChains.emplace_back(chains[i-1]);
+    chain.relPattern.traversalDirection = reverse(chain.relPattern.traversalDirection);
+    chain.nodePattern = (i > 1) ? chains[i-2].nodePattern : app.firstNodePattern;
+  }
+  return res;
+}
+
+NodePattern& lastNodePattern(AnonymousPatternPart& app)
+{
+  return app.patternElementChains.empty() ? app.firstNodePattern : app.patternElementChains.back().nodePattern;
+}
+
+bool sameVariable(const NodePattern& a, const NodePattern& b)
+{
+  return a.mayVariable.has_value() && a.mayVariable == b.mayVariable;
+}
+
+// Returns the concatenation of |a| and |b| if the last node of |a| is the first node of |b|.
+std::optional<AnonymousPatternPart> concatenate(AnonymousPatternPart a, const AnonymousPatternPart& b)
+{
+  auto & junction = lastNodePattern(a);
+  if(!sameVariable(junction, b.firstNodePattern))
+    return std::nullopt;
+  junction.labels.labels.insert(b.firstNodePattern.labels.labels.begin(), b.firstNodePattern.labels.labels.end());
+  a.patternElementChains.insert(a.patternElementChains.end(), b.patternElementChains.begin(), b.patternElementChains.end());
+  return a;
+}
+
+// Returns the pattern part where |a| and |b| are joined, if they share a variable at one of their ends.
+std::optional<AnonymousPatternPart> merge(const AnonymousPatternPart& a, const AnonymousPatternPart& b)
+{
+  if(b.patternElementChains.empty())
+  {
+    // |b| is a single node: it is merged with any node of |a| having the same variable.
+    if(!b.firstNodePattern.mayVariable.has_value())
+      return std::nullopt;
+    AnonymousPatternPart res = a;
+    std::vector<NodePattern*> nodes{&res.firstNodePattern};
+    for(auto & chain : res.patternElementChains)
+      nodes.push_back(&chain.nodePattern);
+    for(NodePattern* node : nodes)
+      if(sameVariable(*node, b.firstNodePattern))
+      {
+        node->labels.labels.insert(b.firstNodePattern.labels.labels.begin(), b.firstNodePattern.labels.labels.end());
+        return res;
+      }
+    return std::nullopt;
+  }
+  if(a.patternElementChains.empty())
+    return merge(b, a);
+  if(auto res = concatenate(a, b))
+    return res;
+  if(auto res = concatenate(b, a))
+    return res;
+  if(auto res = concatenate(a, reverse(b)))
+    return res;
+  return concatenate(reverse(a), b);
+}
+} // NS
+
+std::vector<AnonymousPatternPart> mergePatternParts(const std::vector<PatternPart>& patternParts)
+{
+  std::vector<AnonymousPatternPart> res;
+  res.reserve(patternParts.size());
+  for(const auto & patternPart : patternParts)
+  {
+    if(patternPart.mayVariable.has_value())
+      throw std::logic_error("Not Implemented (Expected no variable before match pattern)");
+    res.push_back(patternPart.anonymousPatternPart);
+  }
+
+  for(bool merged = true; merged;)
+  {
+    merged = false;
+    for(size_t i{}; i<res.size() && !merged; ++i)
+      for(size_t j{i+1}; j<res.size() && !merged; ++j)
+        if(auto m = merge(res[i], res[j]))
+        {
+          res[i] = std::move(*m);
+          res.erase(res.begin() + j);
+          merged = true;
+        }
+  }
+  return res;
+}
+
+std::optional<BatchParameter>
+mergeBatchParameters(const std::vector<std::map<ParameterName, ParameterValue>>& batchParams)
+{
+  if(batchParams.empty())
+    return std::nullopt;
+  BatchParameter batch;
+  batch.name = batchParams[0].begin()->first;
+  std::string key;
+  for(size_t i{}; i<batchParams.size(); ++i)
+  {
+    const auto & params = batchParams[i];
+    if(params.size() != 1 || !(params.begin()->first == batch.name))
+      return std::nullopt;
+    const auto * list = std::get_if<HomogeneousNonNullableValues>(&params.begin()->second);
+    if(!list)
+      return std::nullopt;
+    forEachValue(*list, [&](Value && value)
+    {
+      key.clear();
+      appendEncoded(value, key);
+      auto & indices = batch.batchIndices[key];
+      if(indices.empty())
+        append(std::move(value), batch.values);
+      if(indices.empty() || indices.back() != i)
+        indices.push_back(i);
+    });
+  }
+  return batch;
+}
+
+std::optional<NonArithmeticOperatorExpression> batchKey(const RegularQuery& q, const HomogeneousNonNullableValues& values)
+{
+  if(q.unionAllSingleQueries.size() != 1)
+    return std::nullopt;
+  const auto & singleQuery = q.unionAllSingleQueries[0];
+  if(!singleQuery.queryParts.empty())
+    return std::nullopt;
+  const auto & spq = singleQuery.singlePartQuery;
+  if(spq.mayUnwind.has_value() || !spq.mayReadingClause.has_value() || !spq.mayReadingClause->match.where.has_value())
+    return std::nullopt;
+  // The groups of an aggregation would mix the rows of several parameter sets.
+  const auto & items = spq.returnClause.items.items;
+  if(std::any_of(items.begin(), items.end(), [](const ProjectionItem& item){ return item.naoExp.mayAggregation.has_value(); }))
+    return std::nullopt;
+
+  std::vector<std::shared_ptr<Expression>> terms;
+  appendANDTerms(spq.mayReadingClause->match.where->exp, terms);
+  std::optional<NonArithmeticOperatorExpression> key;
+  for(const auto & term : terms)
+  {
+    const auto * inList = dynamic_cast<const StringListNullPredicateExpression*>(term.get());
+    if(!inList || inList->m_negate)
+      continue;
+    const auto * list = std::get_if<HomogeneousNonNullableValues>(&inList->inList.variant);
+    // The parameter is shared by the literals using it.
+    if(!list || !(*list == values))
+      continue;
+    // A list literal equal to the parameter would be ambiguous.
+    if(key.has_value() || !inList->leftExp.asVariableProperty().has_value())
+      return std::nullopt;
+    key = inList->leftExp;
+  }
+  return key;
+}
+
+std::string encodeContinuationToken(const std::vector<Value>& pageKey)
+{
+  std::string key;
+  for(const auto & value : pageKey)
+    appendEncoded(value, key);
+
+  // The token is hex-encoded so that it can be passed around as text.
+  static constexpr const char* c_hexDigits{"0123456789abcdef"};
+  std::string token;
+  token.reserve(2 * key.size());
+  for(const unsigned char c : key)
+  {
+    token.push_back(c_hexDigits[c >> 4]);
+    token.push_back(c_hexDigits[c & 0xF]);
+  }
+  return token;
+}
+
+std::vector<Value> decodeContinuationToken(const std::string& token)
+{
+  auto hexDigitValue = [](const char c) -> unsigned
+  {
+    if(c >= '0' && c <= '9')
+      return c - '0';
+    if(c >= 'a' && c <= 'f')
+      return 10 + (c - 'a');
+    throw std::invalid_argument("Invalid continuation token");
+  };
+  if(token.size() % 2)
+    throw std::invalid_argument("Invalid continuation token");
+  std::string key;
+  key.reserve(token.size() / 2);
+  for(size_t i=0; i<token.size(); i += 2)
+    key.push_back(static_cast<char>((hexDigitValue(token[i]) << 4) | hexDigitValue(token[i+1])));
+
+  std::vector<Value> pageKey;
+  for(size_t pos{}; pos < key.size();)
+    pageKey.push_back(decodeValue(key, pos));
+  return pageKey;
+}
+
 } // NS
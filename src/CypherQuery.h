@@ -17,39 +17,102 @@
 #pragma once
 
 #include "CypherAST.h"
+#include "FilterProgram.h"
 #include "GraphDBSqlite.h"
+#include "RowsAggregator.h"
+#include "RowsHashJoin.h"
+#include "RowsSorter.h"
 
+#include <numeric>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace openCypher
 {
 namespace detail
 {
+// When |countParameterUses| is not null, it receives the count of uses of each parameter in the query.
 RegularQuery cypherQueryToAST(const PropertySchema& idProperty,
                               const std::string& query,
-                              const std::map<ParameterName, HomogeneousNonNullableValues>& queryParams,
-                              bool printCypherAST);
+                              const std::map<ParameterName, ParameterValue>& queryParams,
+                              bool printCypherAST,
+                              std::map<ParameterName, size_t>* countParameterUses = nullptr);
 
 using FOnColumns = std::function<void(const std::vector<std::string>&)>;
 
+// Pattern parts sharing a node variable at one of their ends are concatenated into a single path pattern
+// (one of them being reversed if needed), so that they are joined in SQL by the system relationships query.
+// A pattern part made of a single node whose variable is used by another pattern part is removed,
+// and its labels are added to the other pattern part.
+// In the returned pattern parts, a variable is never at one end of two pattern parts.
+std::vector<AnonymousPatternPart> mergePatternParts(const std::vector<PatternPart>& patternParts);
+
+// The ids of a variable projected several times by a WITH clause, with their count of projected rows.
+struct RowsCounts
+{
+  Variable var;
+  // Keyed by the ids encoded with appendEncoded. The ids projected once are not in the map.
+  std::unordered_map<std::string, size_t> counts;
+};
+
 //fOnOrderAndColumnNames is guaranteed to be called before fOnRow;
+// When |page| is not null, the query must be a single query with a LIMIT and without ORDER BY, DISTINCT or aggregations:
+// the rows returned are the page of rows starting after |page->after| (see PageKeys).
+// When |rowsCounts| is not null, the query must be a single part query, whose rows are repeated
+// by the count of the id of |rowsCounts->var| (before aggregations, DISTINCT and LIMIT).
 template<typename ID>
 void runSingleQuery(const RegularQuery& q,
                     GraphDB<ID>& db,
                     const FOnColumns& fOnColumns,
-                    const FuncResults& fOnRow);
-}
+                    const FuncResults& fOnRow,
+                    PageKeys* page = nullptr,
+                    const RowsCounts* rowsCounts = nullptr);
+
+// The parameter sets of a batch (see runCypherBatch), merged in a single list parameter.
+struct BatchParameter
+{
+  ParameterName name;
+
+  // The distinct values of the parameter in all parameter sets.
+  HomogeneousNonNullableValues values;
 
+  // The indices of the parameter sets having a value (encoded with appendEncoded).
+  std::unordered_map<std::string, std::vector<size_t>> batchIndices;
+};
+
+// Returns std::nullopt unless all parameter sets have a single list parameter, with the same name.
+std::optional<BatchParameter>
+mergeBatchParameters(const std::vector<std::map<ParameterName, ParameterValue>>& batchParams);
+
+// Returns the property filtered by the IN filter using |values| in the WHERE clause of the MATCH clause of |q|,
+// if |q| can be run as a batch query (see runCypherBatch).
+// The caller verifies that the parameter whose values are |values| is used only once in |q|.
+std::optional<NonArithmeticOperatorExpression> batchKey(const RegularQuery& q, const HomogeneousNonNullableValues& values);
+
+// Runs |q| once, and returns the rows of each parameter set of |batch|, whose values of |key| are in its list.
+template<typename ID>
+void runBatchQuery(const RegularQuery& q,
+                   GraphDB<ID>& db,
+                   const BatchParameter& batch,
+                   const NonArithmeticOperatorExpression& key,
+                   size_t countBatches,
+                   const FOnColumns& fOnColumns,
+                   const std::function<void(size_t)>& fOnBatch,
+                   const FuncResults& fOnRow);
+
+// The continuation token of a page is an opaque string representation of the key of the last row of the page.
+std::string encodeContinuationToken(const std::vector<Value>& pageKey);
+// Throws std::invalid_argument if |token| was not returned by encodeContinuationToken.
+std::vector<Value> decodeContinuationToken(const std::string& token);
 
 template<typename ID, typename ResultsHander>
 void runCypher(const std::string& cypherQuery,
-               const std::map<ParameterName, HomogeneousNonNullableValues>& queryParams,
+               const std::map<ParameterName, ParameterValue>& queryParams,
                GraphDB<ID>&db,
-               ResultsHander& resultsHandler)
+               ResultsHander& resultsHandler,
+               PageKeys* page)
 {
-  using detail::cypherQueryToAST;
-  using detail::runSingleQuery;
-
   const auto ast = cypherQueryToAST(db.idProperty(), cypherQuery, queryParams, resultsHandler.printCypherAST());
   
   resultsHandler.onCypherQueryStarts(cypherQuery);
@@ -65,8 +128,149 @@ void runCypher(const std::string& cypherQuery,
                  [&](const std::vector<std::string>& colNames)
                  { resultsHandler.onColumns(colNames); },
                  [&](const ResultOrder& ro, const VecValues& values)
-                 { resultsHandler.onRow(ro, values); });
+                 { resultsHandler.onRow(ro, values); },
+                 page);
+}
+}
+
+
+template<typename ID, typename ResultsHander>
+void runCypher(const std::string& cypherQuery,
+               const std::map<ParameterName, ParameterValue>& queryParams,
+               GraphDB<ID>&db,
+               ResultsHander& resultsHandler)
+{
+  detail::runCypher(cypherQuery, queryParams, db, resultsHandler, nullptr);
+}
+
+// Runs the query |cypherQuery| for each parameter set of |batchParams|.
+//
+// When the parameter sets have a single list parameter, used only in an IN filter of the WHERE clause of the MATCH clause
+// (like 'MATCH (a)-[]->(b) WHERE id(a) IN $ids RETURN id(b)'), and the query has no aggregation,
+// the query is parsed and run once with the union of the lists of all parameter sets,
+// and each row is returned for the parameter sets whose list has the filtered property of the row.
+// Otherwise, the query is run for each parameter set.
+//
+// The columns are passed once to |resultsHandler|, before the rows.
+// Then the rows of each parameter set are passed in the order of |batchParams|,
+// preceded by a call to |resultsHandler.onBatch| with the index of the parameter set.
+template<typename ID, typename ResultsHander>
+void runCypherBatch(const std::string& cypherQuery,
+                    const std::vector<std::map<ParameterName, ParameterValue>>& batchParams,
+                    GraphDB<ID>&db,
+                    ResultsHander& resultsHandler)
+{
+  std::optional<RegularQuery> batchQuery;
+  std::optional<NonArithmeticOperatorExpression> key;
+  const auto batch = detail::mergeBatchParameters(batchParams);
+  if(batch.has_value())
+  {
+    std::map<ParameterName, size_t> countParameterUses;
+    batchQuery = detail::cypherQueryToAST(db.idProperty(), cypherQuery, {{batch->name, batch->values}}, resultsHandler.printCypherAST(),
+                                          &countParameterUses);
+    // Other uses of the parameter would use the union of the lists.
+    if(countParameterUses[batch->name] == 1)
+      key = detail::batchKey(*batchQuery, batch->values);
+  }
+
+  resultsHandler.onCypherQueryStarts(cypherQuery);
+  struct Scope
+  {
+    ~Scope(){
+      m_resultsHandler.onCypherQueryEnds();
+    }
+    ResultsHander& m_resultsHandler;
+  } scope{resultsHandler};
+
+  const detail::FOnColumns fOnColumns = [&](const std::vector<std::string>& colNames)
+  {
+    resultsHandler.onColumns(colNames);
+  };
+  const detail::FOnColumns fIgnoreColumns = [](const std::vector<std::string>&){};
+  const FuncResults fOnRow = [&](const ResultOrder& ro, const VecValues& values)
+  {
+    resultsHandler.onRow(ro, values);
+  };
+  if(key.has_value())
+  {
+    detail::runBatchQuery(*batchQuery, db, *batch, *key, batchParams.size(), fOnColumns,
+                          [&](size_t batchIndex) { resultsHandler.onBatch(batchIndex); },
+                          fOnRow);
+    return;
+  }
+  for(size_t i{}; i<batchParams.size(); ++i)
+  {
+    const auto ast = detail::cypherQueryToAST(db.idProperty(), cypherQuery, batchParams[i], resultsHandler.printCypherAST());
+    if(i)
+    {
+      resultsHandler.onBatch(i);
+      detail::runSingleQuery(ast, db, fIgnoreColumns, fOnRow);
+      continue;
+    }
+    // The columns are passed before the first parameter set.
+    bool batchStarted{};
+    detail::runSingleQuery(ast, db, [&](const std::vector<std::string>& colNames)
+    {
+      fOnColumns(colNames);
+      resultsHandler.onBatch(0);
+      batchStarted = true;
+    }, fOnRow);
+    if(!batchStarted)
+      resultsHandler.onBatch(0);
+  }
 }
+
+// Runs a query returning its rows by pages, as an alternative to SKIP whose cost grows with the count of skipped rows:
+// the query must have a LIMIT (the size of the page), and no ORDER BY, DISTINCT or aggregation.
+// Pass an empty |continuationToken| to get the first page, and the returned token to get the next page.
+// The returned token is empty when there is no next page.
+//
+// Rows are returned in the order of their key (see PageKeys), so a page starts where the previous one ended
+// with a range predicate on the key, without counting the rows of the previous pages.
+template<typename ID, typename ResultsHander>
+std::string runCypherPage(const std::string& cypherQuery,
+                          const std::map<ParameterName, ParameterValue>& queryParams,
+                          GraphDB<ID>&db,
+                          ResultsHander& resultsHandler,
+                          const std::string& continuationToken)
+{
+  PageKeys page;
+  if(!continuationToken.empty())
+    page.after = detail::decodeContinuationToken(continuationToken);
+  detail::runCypher(cypherQuery, queryParams, db, resultsHandler, &page);
+  if(page.last.empty())
+    return {};
+  return detail::encodeContinuationToken(page.last);
+}
+
+// A results handler inserting the integers of the first returned column in an IDSet,
+// so that the ids returned by a query (like the next frontier of a traversal: 'MATCH (a)-[]->(b) WHERE id(a) IN $frontier RETURN id(b)')
+// are deduplicated as they are returned, and can be passed as a parameter of the next query.
+// Null values are ignored.
+struct IDSetResultsHandler
+{
+  explicit IDSetResultsHandler(IDSet& ids)
+  : m_ids(ids)
+  {}
+
+  bool printCypherAST() const { return false; }
+  void onCypherQueryStarts(const std::string&) {}
+  void onCypherQueryEnds() {}
+  void onColumns(const std::vector<std::string>&) {}
+  void onBatch(size_t) {}
+  void onRow(const ResultOrder& resultOrder, const VecValues& values)
+  {
+    const auto & [i, j] = resultOrder[0];
+    const Value & value = (*values[i])[j];
+    if(const auto * id = std::get_if<int64_t>(&value))
+      m_ids.insert(*id);
+    else if(!std::holds_alternative<Nothing>(value))
+      throw std::invalid_argument("IDSetResultsHandler expects integers");
+  }
+
+private:
+  IDSet& m_ids;
+};
 } // NS
 
 #include "CypherQuery.inl"
@@ -17,16 +17,26 @@
 namespace openCypher::detail
 {
 
+// The positions of count(*) terms are returned in |countRowsPositions|:
+// they will be associated to a variable of the match pattern by the caller.
 inline
 std::map<Variable, std::vector<ReturnClauseTerm>>
-extractProperties(const std::vector<ProjectionItem>& items)
+extractProperties(const std::vector<ProjectionItem>& items,
+                  const PropertyKeyName& idProperty,
+                  std::vector<size_t>& countRowsPositions)
 {
   std::map<Variable, std::vector<ReturnClauseTerm>> props;
   size_t i{};
   for(const auto & [nao, _] : items)
   {
+    if(nao.mayAggregation == AggregationFunction::CountRows)
+    {
+      countRowsPositions.push_back(i);
+      ++i;
+      continue;
+    }
     const auto& mayPropertyName = nao.mayPropertyName;
-    if(!mayPropertyName.has_value())
+    if(!mayPropertyName.has_value() && nao.mayAggregation != AggregationFunction::Count)
       throw std::logic_error("Not Implemented (todo return 'entire node'?)");
     if(!nao.labels.empty())
       throw std::logic_error("Cannot have labels in a return clause (?)");
@@ -34,22 +44,913 @@ extractProperties(const std::vector<ProjectionItem>& items)
     const auto & var = std::get<Variable>(nao.atom.var);
     auto & elem = props[var].emplace_back();
     elem.returnClausePosition = i;
-    elem.propertyName = *mayPropertyName;
+    // count(n) counts the ids of n.
+    elem.propertyName = mayPropertyName.has_value() ? *mayPropertyName : idProperty;
+    elem.aggregation = nao.mayAggregation;
     ++i;
   }
   return props;
 }
 
+struct SortKey
+{
+  // The sorted property, or nullopt when the key is an aggregation.
+  std::optional<std::pair<Variable, PropertyKeyName>> property;
+  SortOrder order;
+  // The position of the key in the rows.
+  size_t position;
+};
+
+// Returns true if |a| and |b| are the same aggregation.
+inline bool isSameAggregation(const NonArithmeticOperatorExpression& a,
+                              const NonArithmeticOperatorExpression& b)
+{
+  if(!a.mayAggregation.has_value() || a.mayAggregation != b.mayAggregation)
+    return false;
+  if(*a.mayAggregation == AggregationFunction::CountRows)
+    return true;
+  return std::get<Variable>(a.atom.var) == std::get<Variable>(b.atom.var) &&
+  a.mayPropertyName == b.mayPropertyName;
+}
+
+// The sort items of |order| must be properties of variables, aggregations of the return clause,
+// or aliases of the return clause.
+// The sort keys that are not in the return clause are added to |props|, after the terms of the return clause.
+inline
+std::vector<SortKey>
+extractSortKeys(const Order& order,
+                const std::vector<ProjectionItem>& items,
+                std::map<Variable, std::vector<ReturnClauseTerm>>& props)
+{
+  std::vector<SortKey> sortKeys;
+  size_t countPositions = items.size();
+  for(const auto & [nao, sortOrder] : order.sortItems)
+  {
+    if(!nao.labels.empty())
+      throw std::logic_error("Cannot have labels in an order clause (?)");
+    auto & sortKey = sortKeys.emplace_back();
+    sortKey.order = sortOrder;
+
+    // The position of the returned item that is sorted, when the sort item is an alias or an aggregation.
+    std::optional<size_t> itemPosition;
+    if(nao.mayAggregation.has_value())
+    {
+      for(size_t i=0, sz=items.size(); i<sz && !itemPosition.has_value(); ++i)
+        if(isSameAggregation(nao, items[i].naoExp))
+          itemPosition = i;
+      if(!itemPosition.has_value())
+        throw std::logic_error("Not Implemented (ORDER BY expects aggregations to be in the return clause)");
+    }
+    else
+    {
+      if(!std::holds_alternative<Variable>(nao.atom.var))
+        throw std::logic_error("Not Implemented (ORDER BY expects a property or an alias of the return clause)");
+      if(!nao.mayPropertyName.has_value())
+      {
+        const auto & var = std::get<Variable>(nao.atom.var);
+        for(size_t i=0, sz=items.size(); i<sz && !itemPosition.has_value(); ++i)
+          if(items[i].asVariable.has_value() && *items[i].asVariable == var)
+            itemPosition = i;
+        if(!itemPosition.has_value())
+          throw std::logic_error("Not Implemented (ORDER BY expects a property or an alias of the return clause)");
+      }
+    }
+
+    if(itemPosition.has_value())
+    {
+      sortKey.position = *itemPosition;
+      const auto & itemNao = items[*itemPosition].naoExp;
+      if(!itemNao.mayAggregation.has_value())
+        sortKey.property = std::make_pair(std::get<Variable>(itemNao.atom.var), *itemNao.mayPropertyName);
+      continue;
+    }
+
+    const auto & [var, propertyName] = sortKey.property.emplace(std::get<Variable>(nao.atom.var), *nao.mayPropertyName);
+    auto & terms = props[var];
+    const auto it = std::find_if(terms.begin(), terms.end(), [&](const ReturnClauseTerm& term)
+    {
+      return !term.aggregation.has_value() && term.propertyName == propertyName;
+    });
+    if(it != terms.end())
+      sortKey.position = it->returnClausePosition;
+    else
+    {
+      sortKey.position = countPositions++;
+      terms.push_back(ReturnClauseTerm{sortKey.position, propertyName});
+    }
+  }
+  return sortKeys;
+}
+
+// Converts |app| to the arguments of GraphDB::forEachPath.
+inline void toPathPattern(const AnonymousPatternPart& app,
+                          std::vector<TraversalDirection>& traversalDirections,
+                          std::vector<PathPatternElement>& pathPatternElements)
+{
+  pathPatternElements.emplace_back(app.firstNodePattern.mayVariable,
+                                   app.firstNodePattern.labels);
+  for(const auto & pec : app.patternElementChains)
+  {
+    traversalDirections.push_back(pec.relPattern.traversalDirection);
+    pathPatternElements.emplace_back(pec.relPattern.mayVariable,
+                                     pec.relPattern.labels);
+    pathPatternElements.emplace_back(pec.nodePattern.mayVariable,
+                                     pec.nodePattern.labels);
+  }
+}
+
+// A MATCH clause whose pattern parts can't be merged in a single path pattern (see mergePatternParts),
+// or an OPTIONAL MATCH clause.
+struct MatchClause
+{
+  std::vector<AnonymousPatternPart> patternParts;
+  ExpressionsByVarsUsages filters;
+  bool optional{};
+};
+
+// Rows of MATCH clauses.
+struct MatchRows
+{
+  Rows rows;
+  // The column of the values of a property of a variable.
+  std::map<std::pair<Variable, PropertyKeyName>, size_t> columns;
+  // The count of values in a row (a property of a variable can have several columns).
+  size_t countColumns{};
+};
+
+// Removes the rows of |matchRows| that don't satisfy |filters|.
+// The filters are evaluated natively, the properties they use must be columns of |matchRows|.
+template<typename ID>
+void filterRows(const GraphDB<ID>& db,
+                const std::map<Variable, Element>& variables,
+                const std::vector<const Expression*>& filters,
+                MatchRows& matchRows)
+{
+  if(filters.empty())
+    return;
+  std::map<Variable, VarQueryInfo> varQueryInfo;
+  std::set<PropertySchema> sqlFields;
+  std::map<std::string, size_t> valueColumnsSources;
+  for(const Expression* filter : filters)
+    for(const auto & [var, usage] : filter->varsUsages())
+    {
+      if(usage.usedInLabelConstraints)
+        throw std::logic_error("Not Implemented (Label constraints in a filter using variables of several pattern parts)");
+      auto & info = varQueryInfo.try_emplace(var, db.indexedTypes(variables.at(var))).first->second;
+      for(const auto & property : usage.properties)
+      {
+        const sql::QueryColumnName column{var.symbolicName.str + "." + property.symbolicName.str};
+        info.cypherPropertyToSQLQueryColumnName[property] = column;
+        valueColumnsSources[column.name] = matchRows.columns.at({var, property});
+        // The ValueType is ignored when comparing keys so we can use any ValueType here.
+        sqlFields.insert(PropertySchema{property, ValueType::String});
+      }
+    }
+  std::vector<std::unique_ptr<sql::Expression>> sqlExprs;
+  sqlExprs.reserve(filters.size());
+  for(const Expression* filter : filters)
+    sqlExprs.push_back(filter->toSQLExpressionTree(sqlFields, varQueryInfo));
+  const sql::AggregateExpression sqlExpr(sql::Aggregator::AND, std::move(sqlExprs));
+  if(auto eval = sqlExpr.tryEvaluate(GraphDB<ID>::c_labelsPerElement))
+  {
+    if(*eval != sql::Evaluation::True)
+      // The filters are never satisfied.
+      matchRows.rows.clear();
+    return;
+  }
+  const sql::FilterProgram filterProgram(sqlExpr);
+  sql::FilterProgram::Batch filterBatch;
+  filterBatch.countRows = matchRows.rows.size();
+  for(const auto & column : filterProgram.valueColumns())
+  {
+    const size_t source = valueColumnsSources.at(column.name);
+    auto & values = filterBatch.values.emplace_back();
+    values.reserve(matchRows.rows.size());
+    for(const auto & row : matchRows.rows)
+      values.push_back(&row[source]);
+  }
+  std::vector<size_t> selection;
+  filterProgram.run(filterBatch, selection);
+  Rows selectedRows;
+  selectedRows.reserve(selection.size());
+  for(const size_t r : selection)
+    selectedRows.push_back(std::move(matchRows.rows[r]));
+  matchRows.rows = std::move(selectedRows);
+}
+
+// Returns the rows of the join of |patternParts| satisfying |filters|, with the columns of |properties|.
+//
+// Each pattern part is queried with the filters using only its variables, the rows of the pattern parts
+// are then joined on their shared variables (see hashJoin), and the other filters are evaluated natively on the joined rows.
+// Like in a single path pattern, a relationship is traversed at most once in a row.
+// The relationships of |patternParts| must have a variable.
+template<typename ID>
+MatchRows queryMatch(GraphDB<ID>& db,
+                     const std::vector<AnonymousPatternPart>& patternParts,
+                     const std::map<Variable, Element>& variables,
+                     const ExpressionsByVarsUsages& filters,
+                     const std::map<Variable, std::set<PropertyKeyName>>& properties)
+{
+  const PropertyKeyName& idProperty = db.idProperty().name;
+  const size_t countParts = patternParts.size();
+
+  std::vector<std::set<Variable>> partsVariables(countParts);
+  // The count of pattern parts using each variable.
+  std::map<Variable, size_t> countVariableParts;
+  size_t countPartsWithRelationships{};
+  for(size_t k{}; k<countParts; ++k)
+  {
+    auto addVariable = [&](const std::optional<Variable>& var)
+    {
+      if(var.has_value() && partsVariables[k].insert(*var).second)
+        ++countVariableParts[*var];
+    };
+    const auto & app = patternParts[k];
+    addVariable(app.firstNodePattern.mayVariable);
+    for(const auto & pec : app.patternElementChains)
+    {
+      addVariable(pec.relPattern.mayVariable);
+      addVariable(pec.nodePattern.mayVariable);
+    }
+    if(!app.patternElementChains.empty())
+      ++countPartsWithRelationships;
+  }
+
+  // The filters using only variables of a pattern part are applied when querying this pattern part,
+  // the other filters are evaluated on the joined rows.
+  std::vector<ExpressionsByVarsUsages> partsFilters(countParts);
+  std::vector<const Expression*> joinedRowsFilters;
+  // The properties of the joined rows.
+  std::map<Variable, std::set<PropertyKeyName>> joinedRowsProperties = properties;
+  for(const auto & [varsUsages, exprs] : filters)
+  {
+    bool applied{};
+    for(size_t k{}; k<countParts; ++k)
+      if(std::all_of(varsUsages.begin(), varsUsages.end(), [&](const auto & varUsage) { return partsVariables[k].count(varUsage.first); }))
+      {
+        auto & partFilters = partsFilters[k][varsUsages];
+        partFilters.insert(partFilters.end(), exprs.begin(), exprs.end());
+        applied = true;
+      }
+    if(applied)
+      continue;
+    for(const auto & [var, usage] : varsUsages)
+      joinedRowsProperties[var].insert(usage.properties.begin(), usage.properties.end());
+    joinedRowsFilters.insert(joinedRowsFilters.end(), exprs.begin(), exprs.end());
+  }
+
+  // The columns of the rows of each pattern part, and the corresponding terms.
+  std::vector<std::map<std::pair<Variable, PropertyKeyName>, size_t>> partsColumns(countParts);
+  std::vector<std::map<Variable, std::vector<ReturnClauseTerm>>> partsTerms(countParts);
+  auto addColumn = [&](const size_t k, const Variable& var, const PropertyKeyName& property)
+  {
+    auto & columns = partsColumns[k];
+    const auto [it, inserted] = columns.try_emplace(std::pair{var, property}, columns.size());
+    if(inserted)
+      partsTerms[k][var].push_back(ReturnClauseTerm{it->second, property, std::nullopt});
+    return it->second;
+  };
+  // The pattern part and the column of the relationship ids.
+  std::vector<std::pair<size_t, size_t>> relationshipIDsSources;
+  for(size_t k{}; k<countParts; ++k)
+  {
+    for(const auto & var : partsVariables[k])
+    {
+      partsTerms[k][var];
+      if(countVariableParts[var] > 1)
+        // The pattern parts are joined on the id of this variable.
+        addColumn(k, var, idProperty);
+      if(variables.at(var) == Element::Relationship && countPartsWithRelationships > 1)
+        relationshipIDsSources.emplace_back(k, addColumn(k, var, idProperty));
+      // The properties of a variable are gathered by the first pattern part using it.
+      if(const auto it = joinedRowsProperties.find(var); it != joinedRowsProperties.end())
+      {
+        for(const auto & property : it->second)
+          addColumn(k, var, property);
+        joinedRowsProperties.erase(it);
+      }
+    }
+  }
+
+  // Query the pattern parts.
+  std::vector<Rows> partsRows(countParts);
+  for(size_t k{}; k<countParts; ++k)
+  {
+    const auto & app = patternParts[k];
+    auto & rows = partsRows[k];
+    const FuncResults fOnRow = [&](const ResultOrder& resultOrder, const VecValues& values)
+    {
+      auto & row = rows.emplace_back();
+      row.reserve(resultOrder.size());
+      for(const auto & [i, j] : resultOrder)
+        row.push_back(copy((*values[i])[j]));
+    };
+    auto isUsed = [&](const NodePattern& np)
+    {
+      if(!np.labels.empty())
+        return true;
+      if(!np.mayVariable.has_value())
+        return false;
+      if(!partsTerms[k][*np.mayVariable].empty())
+        return true;
+      for(const auto & [varsUsages, _] : partsFilters[k])
+        if(varsUsages.count(*np.mayVariable))
+          return true;
+      return false;
+    };
+    std::vector<const Expression*> filter;
+    for(const auto & [_, exprs] : partsFilters[k])
+      filter.insert(filter.end(), exprs.begin(), exprs.end());
+
+    if(app.patternElementChains.empty())
+    {
+      if(!app.firstNodePattern.mayVariable.has_value())
+        throw std::logic_error("Not Implemented (Expected a variable in a pattern part made of a single node)");
+      const auto & var = *app.firstNodePattern.mayVariable;
+      if(partsColumns[k].empty())
+        // The rows of this pattern part are counted in the join.
+        addColumn(k, var, idProperty);
+      db.forEachElementPropertyWithLabelsIn(var, Element::Node, partsTerms[k][var], app.firstNodePattern.labels,
+                                            &filter, Distinct::No, {}, std::nullopt, fOnRow, nullptr);
+    }
+    else if(app.patternElementChains.size() == 1 && !isUsed(app.firstNodePattern) && !isUsed(app.patternElementChains[0].nodePattern))
+    {
+      const auto & relPattern = app.patternElementChains[0].relPattern;
+      const auto & var = *relPattern.mayVariable;
+      if(partsColumns[k].empty())
+        addColumn(k, var, idProperty);
+      db.forEachElementPropertyWithLabelsIn(var, Element::Relationship, partsTerms[k][var], relPattern.labels,
+                                            &filter, Distinct::No, {}, std::nullopt, fOnRow, nullptr);
+    }
+    else
+    {
+      std::vector<TraversalDirection> traversalDirections;
+      std::vector<PathPatternElement> pathPatternElements;
+      toPathPattern(app, traversalDirections, pathPatternElements);
+      if(partsColumns[k].empty())
+        addColumn(k, *app.patternElementChains[0].relPattern.mayVariable, idProperty);
+      db.forEachPath(traversalDirections, partsTerms[k], pathPatternElements, partsFilters[k],
+                     Distinct::No, std::nullopt, fOnRow, nullptr);
+    }
+    if(rows.empty())
+    {
+      // There is no row, the columns are those of the pattern parts in their order.
+      MatchRows res;
+      for(size_t j{}; j<countParts; ++j)
+      {
+        for(const auto & [varAndProperty, column] : partsColumns[j])
+          res.columns.try_emplace(varAndProperty, res.countColumns + column);
+        res.countColumns += partsColumns[j].size();
+      }
+      return res;
+    }
+  }
+
+  // Join the pattern parts, one at a time, starting with the pattern part having the fewest rows.
+  // The next pattern part shares a variable with the joined pattern parts when possible, to avoid cartesian products.
+  // indexed by pattern part: the position of the columns of the pattern part in the joined rows.
+  std::vector<std::optional<size_t>> offsets(countParts);
+  MatchRows res;
+  for(size_t n{}; n<countParts; ++n)
+  {
+    std::optional<size_t> next;
+    bool nextIsConnected{};
+    for(size_t k{}; k<countParts; ++k)
+    {
+      if(offsets[k].has_value())
+        continue;
+      const bool isConnected = std::any_of(partsVariables[k].begin(), partsVariables[k].end(), [&](const Variable& var)
+      {
+        for(size_t j{}; j<countParts; ++j)
+          if(offsets[j].has_value() && partsVariables[j].count(var))
+            return true;
+        return false;
+      });
+      if(!next.has_value() ||
+         (isConnected && !nextIsConnected) ||
+         (isConnected == nextIsConnected && partsRows[k].size() < partsRows[*next].size()))
+      {
+        next = k;
+        nextIsConnected = isConnected;
+      }
+    }
+    const size_t k = *next;
+    if(n == 0)
+      res.rows = std::move(partsRows[k]);
+    else
+    {
+      std::vector<size_t> joinedKeys, partKeys;
+      for(const auto & var : partsVariables[k])
+        if(const auto it = res.columns.find({var, idProperty}); it != res.columns.end() && countVariableParts[var] > 1)
+        {
+          joinedKeys.push_back(it->second);
+          partKeys.push_back(partsColumns[k].at({var, idProperty}));
+        }
+      res.rows = hashJoin(res.rows, joinedKeys, partsRows[k], partKeys);
+    }
+    offsets[k] = res.countColumns;
+    for(const auto & [varAndProperty, column] : partsColumns[k])
+      res.columns.try_emplace(varAndProperty, res.countColumns + column);
+    res.countColumns += partsColumns[k].size();
+  }
+
+  // A relationship is traversed at most once: the ids of relationships of different pattern parts must be different.
+  std::vector<std::pair<size_t, size_t>> distinctRelationshipIDsColumns;
+  for(size_t a{}, sz = relationshipIDsSources.size(); a<sz; ++a)
+    for(size_t b{a+1}; b<sz; ++b)
+      if(relationshipIDsSources[a].first != relationshipIDsSources[b].first)
+        distinctRelationshipIDsColumns.emplace_back(*offsets[relationshipIDsSources[a].first] + relationshipIDsSources[a].second,
+                                                    *offsets[relationshipIDsSources[b].first] + relationshipIDsSources[b].second);
+  if(!distinctRelationshipIDsColumns.empty())
+    res.rows.erase(std::remove_if(res.rows.begin(), res.rows.end(), [&](const std::vector<Value>& row)
+    {
+      return std::any_of(distinctRelationshipIDsColumns.begin(), distinctRelationshipIDsColumns.end(), [&](const auto & columns)
+      {
+        return 0 == threeWayCompare(row[columns.first], row[columns.second]);
+      });
+    }), res.rows.end());
+
+  filterRows(db, variables, joinedRowsFilters, res);
+  return res;
+}
+
+// Calls |f| with the rows of |matchClauses|: the values of a row are the terms of |terms|, at their returnClausePosition.
+//
+// The first clause is a MATCH clause, the next clauses are OPTIONAL MATCH clauses.
+// The rows of an OPTIONAL MATCH clause are left outer joined (see hashJoin) with the rows of the previous clauses,
+// using the filters of the clause that use variables of the previous clauses as join condition:
+// when a row of the previous clauses has no match, the variables of the clause are null in this row.
+// An OPTIONAL MATCH clause is queried only for the ids of its variables in the rows of the previous clauses.
+template<typename ID>
+void forEachMatchRow(GraphDB<ID>& db,
+                     std::vector<MatchClause> matchClauses,
+                     const std::map<Variable, std::vector<ReturnClauseTerm>>& terms,
+                     const FuncResults& f)
+{
+  const PropertyKeyName& idProperty = db.idProperty().name;
+  const size_t countClauses = matchClauses.size();
+
+  // Anonymous relationships are given a variable, to verify that a relationship is not traversed by two pattern parts.
+  std::vector<std::set<Variable>> clausesVariables(countClauses);
+  std::map<Variable, Element> variables;
+  // The first clause using each variable.
+  std::map<Variable, size_t> variablesClause;
+  {
+    size_t countAnonymousRelationships{};
+    for(size_t c{}; c<countClauses; ++c)
+    {
+      auto addVariable = [&](const Variable& var, const Element elem)
+      {
+        if(const auto [it, inserted] = variables.try_emplace(var, elem); !inserted && it->second != elem)
+          throw std::invalid_argument("A variable cannot be both a node and a relationship.");
+        clausesVariables[c].insert(var);
+        variablesClause.try_emplace(var, c);
+      };
+      for(auto & app : matchClauses[c].patternParts)
+      {
+        if(app.firstNodePattern.mayVariable.has_value())
+          addVariable(*app.firstNodePattern.mayVariable, Element::Node);
+        for(auto & pec : app.patternElementChains)
+        {
+          if(!pec.relPattern.mayVariable.has_value())
+            pec.relPattern.mayVariable = Variable{SymbolicName{"SYS__RELATIONSHIP" + std::to_string(countAnonymousRelationships++)}};
+          addVariable(*pec.relPattern.mayVariable, Element::Relationship);
+          if(pec.nodePattern.mayVariable.has_value())
+            addVariable(*pec.nodePattern.mayVariable, Element::Node);
+        }
+      }
+    }
+  }
+
+  for(const auto & [var, _] : terms)
+    if(0 == variables.count(var))
+      throw std::logic_error("A variable used in the return clause was not defined.");
+
+  // The properties of each clause needed by the next clauses and by the return clause.
+  std::vector<std::map<Variable, std::set<PropertyKeyName>>> clausesProperties(countClauses);
+  for(const auto & [var, c] : variablesClause)
+    for(size_t d{c+1}; d<countClauses; ++d)
+      if(clausesVariables[d].count(var))
+      {
+        // The clauses are joined on the id of this variable.
+        clausesProperties[c][var].insert(idProperty);
+        clausesProperties[d][var].insert(idProperty);
+      }
+  for(const auto & [var, varTerms] : terms)
+    for(const auto & term : varTerms)
+      clausesProperties[variablesClause.at(var)][var].insert(term.propertyName);
+
+  // The filters of a clause using variables of previous clauses are evaluated when joining the clause.
+  std::vector<ExpressionsByVarsUsages> clausesFilters(countClauses);
+  std::vector<std::vector<const Expression*>> joinFilters(countClauses);
+  for(size_t c{}; c<countClauses; ++c)
+    for(const auto & [varsUsages, exprs] : matchClauses[c].filters)
+    {
+      bool local = true;
+      for(const auto & [var, _] : varsUsages)
+      {
+        const auto it = variablesClause.find(var);
+        if(it == variablesClause.end() || it->second > c)
+          throw std::logic_error("A variable used in the where clause was not defined.");
+        local = local && clausesVariables[c].count(var);
+      }
+      if(local)
+      {
+        auto & clauseFilters = clausesFilters[c][varsUsages];
+        clauseFilters.insert(clauseFilters.end(), exprs.begin(), exprs.end());
+        continue;
+      }
+      joinFilters[c].insert(joinFilters[c].end(), exprs.begin(), exprs.end());
+      for(const auto & [var, usage] : varsUsages)
+      {
+        auto & props = clausesProperties[clausesVariables[c].count(var) ? c : variablesClause.at(var)][var];
+        props.insert(usage.properties.begin(), usage.properties.end());
+      }
+    }
+
+  // The filters binding the variables of the previous clauses to their ids (see below).
+  std::vector<std::shared_ptr<Expression>> boundIDsFilters;
+  MatchRows matchRows = queryMatch(db, matchClauses[0].patternParts, variables, clausesFilters[0], clausesProperties[0]);
+  for(size_t c{1}; c<countClauses && !matchRows.rows.empty(); ++c)
+  {
+    if(!matchClauses[c].optional)
+      throw std::logic_error("Not Implemented (Expected an OPTIONAL MATCH clause)");
+    // Like a variable projected by a WITH clause (see runQueryParts), a variable of the previous clauses
+    // is bound to its ids in the rows of the previous clauses by an 'id(var) IN [...]' filter,
+    // so that the clause is queried only for these ids.
+    for(const auto & var : clausesVariables[c])
+      if(variablesClause.at(var) < c)
+      {
+        const size_t column = matchRows.columns.at({var, idProperty});
+        HomogeneousNonNullableValues ids;
+        std::unordered_set<std::string> distinctIDs;
+        std::string idKey;
+        for(const auto & row : matchRows.rows)
+        {
+          const Value & id = row[column];
+          // A null variable (of a previous OPTIONAL MATCH clause) matches nothing.
+          if(std::holds_alternative<Nothing>(id))
+            continue;
+          idKey.clear();
+          appendEncoded(id, idKey);
+          if(distinctIDs.insert(idKey).second)
+            append(copy(id), ids);
+        }
+        StringListNullPredicateExpression inIDs;
+        inIDs.leftExp.atom.var = var;
+        inIDs.leftExp.mayPropertyName = idProperty;
+        inIDs.inList.variant = std::move(ids);
+        boundIDsFilters.push_back(inIDs.StealAsPtr());
+        boundIDsFilters.back()->asMaximalANDAggregation(clausesFilters[c]);
+      }
+    const MatchRows clauseRows = queryMatch(db, matchClauses[c].patternParts, variables, clausesFilters[c], clausesProperties[c]);
+
+    std::vector<size_t> keys, clauseKeys;
+    for(const auto & var : clausesVariables[c])
+      if(variablesClause.at(var) < c)
+      {
+        keys.push_back(matchRows.columns.at({var, idProperty}));
+        clauseKeys.push_back(clauseRows.columns.at({var, idProperty}));
+      }
+
+    // The last column of the rows is the index of the row, to find the rows that have no match.
+    const size_t countColumns = matchRows.countColumns;
+    for(size_t r{}, sz = matchRows.rows.size(); r<sz; ++r)
+      matchRows.rows[r].push_back(static_cast<int64_t>(r));
+    MatchRows joinedRows{hashJoin(matchRows.rows, keys, clauseRows.rows, clauseKeys), matchRows.columns, countColumns + 1 + clauseRows.countColumns};
+    for(const auto & [varAndProperty, column] : clauseRows.columns)
+      joinedRows.columns.try_emplace(varAndProperty, countColumns + 1 + column);
+    filterRows(db, variables, joinFilters[c], joinedRows);
+
+    std::vector<bool> matched(matchRows.rows.size());
+    for(auto & row : joinedRows.rows)
+    {
+      matched[std::get<int64_t>(row[countColumns])] = true;
+      row.erase(row.begin() + countColumns);
+    }
+    for(size_t r{}, sz = matchRows.rows.size(); r<sz; ++r)
+    {
+      if(matched[r])
+        continue;
+      auto & row = joinedRows.rows.emplace_back(std::move(matchRows.rows[r]));
+      // The variables of the clause are null.
+      row.resize(countColumns);
+      row.resize(countColumns + clauseRows.countColumns);
+    }
+    matchRows.rows = std::move(joinedRows.rows);
+    matchRows.countColumns = countColumns + clauseRows.countColumns;
+    for(const auto & [varAndProperty, column] : clauseRows.columns)
+      matchRows.columns.try_emplace(varAndProperty, countColumns + column);
+  }
+
+  if(matchRows.rows.empty())
+    return;
+  size_t countPositions{};
+  for(const auto & [_, varTerms] : terms)
+    for(const auto & term : varTerms)
+      countPositions = std::max(countPositions, term.returnClausePosition + 1);
+  // The column of the value of each position.
+  std::vector<size_t> sources(countPositions);
+  for(const auto & [var, varTerms] : terms)
+    for(const auto & term : varTerms)
+      sources[term.returnClausePosition] = matchRows.columns.at({var, term.propertyName});
+  std::vector<Value> values(countPositions);
+  const VecValues vecValues{&values};
+  ResultOrder resultOrder;
+  for(size_t p{}; p<countPositions; ++p)
+    resultOrder.emplace_back(0, static_cast<unsigned>(p));
+  for(const auto & row : matchRows.rows)
+  {
+    for(size_t p{}; p<countPositions; ++p)
+      values[p] = copy(row[sources[p]]);
+    f(resultOrder, vecValues);
+  }
+}
+
 std::vector<std::string>
 extractColumnNames(const std::vector<ProjectionItem>& items);
 
+inline bool isPatternVariable(const std::vector<AnonymousPatternPart>& patternParts, const Variable& var)
+{
+  return std::any_of(patternParts.begin(), patternParts.end(), [&](const AnonymousPatternPart& part)
+  {
+    if(part.firstNodePattern.mayVariable == var)
+      return true;
+    return std::any_of(part.patternElementChains.begin(), part.patternElementChains.end(), [&](const PatternElementChain& pec)
+    {
+      return pec.relPattern.mayVariable == var || pec.nodePattern.mayVariable == var;
+    });
+  });
+}
+
+// The variable projected by a WITH clause.
+inline const Variable& projectedVariable(const With& with)
+{
+  const auto & items = with.projectionBody.items.items;
+  if(items.size() == 1)
+  {
+    const auto & item = items[0];
+    const auto & naoExp = item.naoExp;
+    const auto * var = std::get_if<Variable>(&naoExp.atom.var);
+    if(var &&
+       !naoExp.mayPropertyName.has_value() &&
+       naoExp.labels.empty() &&
+       !naoExp.mayAggregation.has_value() &&
+       (!item.asVariable.has_value() || *item.asVariable == *var))
+      return *var;
+  }
+  throw std::logic_error("Not Implemented (WITH expects a single projected variable, without alias)");
+}
+
+// Flattens the nested AND aggregations of |exp| into |terms|.
+inline void appendANDTerms(const std::shared_ptr<Expression>& exp, std::vector<std::shared_ptr<Expression>>& terms)
+{
+  // Applies the lazy negation of |exp|, so that its aggregator is up to date.
+  exp->varsUsages();
+  const auto * aggr = dynamic_cast<const AggregateExpression*>(exp.get());
+  if(aggr && aggr->aggregator() == Aggregator::AND)
+    for(const auto & subExpr : aggr->subExpressions())
+      appendANDTerms(subExpr, terms);
+  else
+    terms.push_back(exp);
+}
+
+// |terms| is expected to have 1 or more elements.
+inline std::shared_ptr<Expression> mkANDExpression(std::vector<std::shared_ptr<Expression>>&& terms)
+{
+  if(terms.size() == 1)
+    return std::move(terms[0]);
+  auto res = std::make_shared<AggregateExpression>(Aggregator::AND);
+  for(auto & term : terms)
+    res->add(std::move(term));
+  return res;
+}
+
+// Evaluates an UNWIND clause in the queries of its MATCH clause, so that the whole list is matched by a single query.
+//
+// The WHERE clause of the MATCH clause is expected to have an equality between the unwound variable and a property
+// of a variable of the pattern, like 'UNWIND $ids AS x MATCH (a)-[]->(b) WHERE id(a) = x'.
+// This equality is replaced by an 'id(a) IN $ids' filter, where the list is bound as a single parameter of the SQL queries,
+// and the unwound variable is replaced by 'id(a)' in the other comparisons, and in the return and order clauses.
+// The list must not have duplicate values, because the rows of a match would then have to be repeated.
+inline SinglePartQuery bindUnwoundVariable(const SinglePartQuery& q)
+{
+  const auto & [list, var] = *q.mayUnwind;
+  const auto * values = std::get_if<HomogeneousNonNullableValues>(&list.variant);
+  if(!values)
+    throw std::logic_error("Not Implemented (UNWIND expects a list)");
+  if(hasDuplicates(*values))
+    throw std::logic_error("Not Implemented (UNWIND of a list with duplicate values)");
+  if(!q.mayReadingClause.has_value())
+    throw std::logic_error("Not Implemented (UNWIND expects a MATCH clause)");
+
+  SinglePartQuery spq = q;
+  spq.mayUnwind.reset();
+  auto & match = spq.mayReadingClause->match;
+
+  std::vector<std::shared_ptr<Expression>> terms;
+  if(match.where.has_value())
+    appendANDTerms(match.where->exp, terms);
+  NonArithmeticOperatorExpression key;
+  {
+    std::optional<std::pair<Variable, PropertyKeyName>> property;
+    const auto it = std::find_if(terms.begin(), terms.end(), [&](const std::shared_ptr<Expression>& term)
+    {
+      const auto * comparison = dynamic_cast<const ComparisonExpression*>(term.get());
+      return comparison && (property = comparison->propertyEqualTo(var)).has_value();
+    });
+    if(it == terms.end())
+      throw std::logic_error("Not Implemented (UNWIND expects an equality between the unwound variable and a property in the WHERE clause of the MATCH clause)");
+    terms.erase(it);
+    key.atom.var = property->first;
+    key.mayPropertyName = property->second;
+  }
+
+  auto bindNAO = [&](NonArithmeticOperatorExpression& nao)
+  {
+    const auto * v = std::get_if<Variable>(&nao.atom.var);
+    if(!v || !(*v == var))
+      return;
+    if(nao.mayPropertyName.has_value() || !nao.labels.empty())
+      throw std::logic_error("Not Implemented (The unwound variable is expected to be a value)");
+    nao.atom.var = key.atom.var;
+    nao.mayPropertyName = key.mayPropertyName;
+  };
+  auto bindTerms = [&](std::vector<std::shared_ptr<Expression>>& terms)
+  {
+    for(auto & term : terms)
+    {
+      if(!term->varsUsages().count(var))
+        continue;
+      const auto * comparison = dynamic_cast<const ComparisonExpression*>(term.get());
+      if(!comparison ||
+         !(comparison->leftExp.isVariable(var) || comparison->partial.rightExp.isVariable(var)))
+        throw std::logic_error("Not Implemented (The unwound variable is only supported in comparisons)");
+      auto boundComparison = std::make_shared<ComparisonExpression>(*comparison);
+      bindNAO(boundComparison->leftExp);
+      bindNAO(boundComparison->partial.rightExp);
+      term = std::move(boundComparison);
+    }
+  };
+
+  bindTerms(terms);
+  StringListNullPredicateExpression inList;
+  inList.leftExp = key;
+  inList.inList = list;
+  terms.insert(terms.begin(), inList.StealAsPtr());
+  match.where = WhereClause{mkANDExpression(std::move(terms))};
+
+  for(auto & optionalMatch : spq.optionalMatches)
+    if(optionalMatch.where.has_value())
+    {
+      std::vector<std::shared_ptr<Expression>> optionalTerms;
+      appendANDTerms(optionalMatch.where->exp, optionalTerms);
+      bindTerms(optionalTerms);
+      optionalMatch.where = WhereClause{mkANDExpression(std::move(optionalTerms))};
+    }
+  for(auto & item : spq.returnClause.items.items)
+    bindNAO(item.naoExp);
+  if(spq.returnClause.order.has_value())
+    for(auto & sortItem : spq.returnClause.order->sortItems)
+      bindNAO(sortItem.naoExp);
+  return spq;
+}
+
+// Runs the parts of a multi-part query preceding its last part, and returns its last part.
+//
+// Each part is run as a single part query returning the ids of the variable projected by its WITH clause,
+// with the order and limit of the WITH clause. The variable is then bound to these ids in the next part
+// by an 'id(var) IN [...]' filter added to its MATCH clause (with the WHERE of the WITH clause):
+// the ids are not returned to the caller, and are bound as a single list parameter of the SQL queries of the next part.
+// When an id is projected several times, the rows of the next part matching this id are repeated as many times,
+// so |rowsCounts| receives the counts of the ids projected several times by the WITH clause of the last part.
+template<typename ID>
+SinglePartQuery runQueryParts(const SingleQuery& q, GraphDB<ID>& db, std::optional<RowsCounts>& rowsCounts)
+{
+  std::optional<Variable> boundVariable;
+  HomogeneousNonNullableValues boundIDs;
+  std::optional<WhereClause> boundWhere;
+
+  auto bind = [&](std::optional<ReadingClause>& mayReadingClause)
+  {
+    if(!boundVariable.has_value())
+      return;
+    if(!mayReadingClause.has_value() ||
+       !isPatternVariable(mergePatternParts(mayReadingClause->match.pattern.patternParts), *boundVariable))
+      throw std::logic_error("Not Implemented (The variable projected by WITH is expected in the pattern of the next MATCH clause)");
+    auto & match = mayReadingClause->match;
+
+    StringListNullPredicateExpression inIDs;
+    inIDs.leftExp.atom.var = *boundVariable;
+    inIDs.leftExp.mayPropertyName = db.idProperty().name;
+    inIDs.inList.variant = std::move(boundIDs);
+
+    std::vector<std::shared_ptr<Expression>> filters;
+    filters.push_back(inIDs.StealAsPtr());
+    if(boundWhere.has_value())
+      filters.push_back(boundWhere->exp);
+    if(match.where.has_value())
+      filters.push_back(match.where->exp);
+    match.where = WhereClause{mkANDExpression(std::move(filters))};
+
+    boundVariable.reset();
+    boundIDs = {};
+    boundWhere.reset();
+  };
+
+  for(const auto & part : q.queryParts)
+  {
+    const Variable& var = projectedVariable(part.with);
+    const auto & projectionBody = part.with.projectionBody;
+
+    RegularQuery partQuery;
+    auto & spq = partQuery.unionAllSingleQueries.emplace_back().singlePartQuery;
+    spq.mayUnwind = part.mayUnwind;
+    spq.mayReadingClause = part.mayReadingClause;
+    spq.optionalMatches = part.optionalMatches;
+    bind(spq.mayReadingClause);
+    spq.returnClause.distinct = projectionBody.distinct;
+    spq.returnClause.order = projectionBody.order;
+    spq.returnClause.limit = projectionBody.limit;
+    auto & item = spq.returnClause.items.items.emplace_back();
+    item.naoExp.atom.var = var;
+    item.naoExp.mayPropertyName = db.idProperty().name;
+
+    // The rows of this part are repeated by the counts of the ids projected by the previous part.
+    const std::optional<RowsCounts> partRowsCounts = std::move(rowsCounts);
+    rowsCounts.reset();
+    HomogeneousNonNullableValues ids;
+    std::unordered_map<std::string, size_t> countsByID;
+    std::string idKey;
+    runSingleQuery(partQuery, db, [](const std::vector<std::string>&){}, [&](const ResultOrder& resultOrder, const VecValues& values)
+    {
+      const auto & [i, j] = resultOrder[0];
+      const Value & id = (*values[i])[j];
+      // A null variable (of an OPTIONAL MATCH) matches nothing in the next part.
+      if(std::holds_alternative<Nothing>(id))
+        return;
+      idKey.clear();
+      appendEncoded(id, idKey);
+      if(++countsByID[idKey] == 1)
+        append(copy(id), ids);
+    }, nullptr, partRowsCounts.has_value() ? &*partRowsCounts : nullptr);
+    for(auto & [key, count] : countsByID)
+      if(count > 1)
+      {
+        if(!rowsCounts.has_value())
+          rowsCounts.emplace(RowsCounts{var, {}});
+        rowsCounts->counts.emplace(key, count);
+      }
+
+    boundVariable = var;
+    boundIDs = std::move(ids);
+    boundWhere = part.with.where;
+  }
+
+  SinglePartQuery spq = q.singlePartQuery;
+  bind(spq.mayReadingClause);
+  return spq;
+}
+
+// Returns a function calling |f| with each row repeated by the count of the id of |rowsCounts.var|
+// at |position| in the row, and ignoring the rows after the first |limit| rows.
+inline FuncResults repeatRows(const RowsCounts& rowsCounts,
+                              const size_t position,
+                              const std::optional<Limit>& limit,
+                              const FuncResults& f)
+{
+  return [&rowsCounts, position, limit, f, idKey = std::string{}, countRows = size_t{}]
+  (const ResultOrder& resultOrder, const VecValues& values) mutable
+  {
+    const auto & [i, j] = resultOrder[position];
+    idKey.clear();
+    appendEncoded((*values[i])[j], idKey);
+    const auto it = rowsCounts.counts.find(idKey);
+    const size_t count = (it == rowsCounts.counts.end()) ? 1 : it->second;
+    for(size_t k{}; k<count; ++k)
+    {
+      if(limit.has_value() && countRows >= limit->maxCountRows)
+        return;
+      ++countRows;
+      f(resultOrder, values);
+    }
+  };
+}
+
 //fOnOrderAndColumnNames is guaranteed to be called before fOnRow;
 template<typename ID>
 void runSingleQuery(const RegularQuery& regularQuery,
                     GraphDB<ID>& db,
                     const FOnColumns& fOnColumns,
-                    const FuncResults& fOnRow)
+                    const FuncResults& fOnRow,
+                    PageKeys* page,
+                    const RowsCounts* rowsCounts)
 {
+  if(rowsCounts && (regularQuery.unionAllSingleQueries.size() != 1 || !regularQuery.unionAllSingleQueries[0].queryParts.empty()))
+    throw std::invalid_argument("Repeated rows expect a single part query.");
+  if(page && regularQuery.unionAllSingleQueries.size() != 1)
+    throw std::invalid_argument("A page of results expects a single query.");
+
   std::optional<std::vector<std::string>> columnNames;
   for(const auto & q : regularQuery.unionAllSingleQueries)
   {
@@ -69,15 +970,27 @@ void runSingleQuery(const RegularQuery& regularQuery,
 
   for(const auto & q : regularQuery.unionAllSingleQueries)
   {
-    const auto & spq = q.singlePartQuery;
+    std::optional<SinglePartQuery> rewrittenQuery;
+    std::optional<RowsCounts> partsRowsCounts;
+    if(!q.queryParts.empty())
+    {
+      if(page)
+        throw std::logic_error("Not Implemented (A page of results expects a single part query)");
+      rewrittenQuery = runQueryParts(q, db, partsRowsCounts);
+    }
+    if(const auto & unwindQuery = rewrittenQuery.has_value() ? *rewrittenQuery : q.singlePartQuery;
+       unwindQuery.mayUnwind.has_value())
+      rewrittenQuery = bindUnwoundVariable(unwindQuery);
+    const auto & spq = rewrittenQuery.has_value() ? *rewrittenQuery : q.singlePartQuery;
     if(!spq.mayReadingClause.has_value())
       throw std::logic_error("Not Implemented (Expected a reading clause)");
     const auto & matchPatternParts = spq.mayReadingClause->match.pattern.patternParts;
-    if(matchPatternParts.size() != 1)
-      throw std::logic_error("Not Implemented (Expected a single pattern part)");
-    const auto & mpp = matchPatternParts[0];
-    if(mpp.mayVariable.has_value())
-      throw std::logic_error("Not Implemented (Expected no variable before match pattern)");
+    if(matchPatternParts.empty())
+      throw std::logic_error("Not Implemented (Expected a pattern part)");
+    // The pattern parts that can't be merged in a single path pattern are joined by forEachMatchRow.
+    const std::vector<AnonymousPatternPart> patternParts = mergePatternParts(matchPatternParts);
+    if(page && (patternParts.size() > 1 || !spq.optionalMatches.empty()))
+      throw std::logic_error("Not Implemented (A page of results expects a single path pattern)");
     
     ExpressionsByVarsUsages whereExprsByVarsAndproperties;
     
@@ -85,13 +998,115 @@ void runSingleQuery(const RegularQuery& regularQuery,
       // If the tree is not Equi-var, an exception is thrown.
       spq.mayReadingClause->match.where->exp->asMaximalANDAggregation(whereExprsByVarsAndproperties);
     
-    const auto & app = mpp.anonymousPatternPart;
+    std::vector<MatchClause> optionalMatchClauses;
+    for(const auto & optionalMatch : spq.optionalMatches)
+    {
+      auto & clause = optionalMatchClauses.emplace_back();
+      clause.patternParts = mergePatternParts(optionalMatch.pattern.patternParts);
+      if(optionalMatch.where.has_value())
+        optionalMatch.where->exp->asMaximalANDAggregation(clause.filters);
+      clause.optional = true;
+    }
+    
+    const auto & app = patternParts[0];
     
-    const std::map<Variable, std::vector<ReturnClauseTerm>> props =
-    extractProperties(spq.returnClause.items.items);
+    const auto & returnedItems = spq.returnClause.items.items;
+    std::vector<size_t> countRowsPositions;
+    std::map<Variable, std::vector<ReturnClauseTerm>> props = extractProperties(returnedItems, db.idProperty().name, countRowsPositions);
+    if(!countRowsPositions.empty())
+    {
+      // count(*) counts the ids of a variable of the pattern.
+      // A variable that is already returned is preferred, so that count(*) doesn't change the query plan.
+      // Variables of OPTIONAL MATCH clauses can be null so they are not used.
+      std::optional<Variable> countRowsVariable;
+      for(const auto & [var, _] : props)
+        if(isPatternVariable(patternParts, var))
+        {
+          countRowsVariable = var;
+          break;
+        }
+      if(!countRowsVariable.has_value())
+      {
+        if(app.firstNodePattern.mayVariable.has_value())
+          countRowsVariable = app.firstNodePattern.mayVariable;
+        else
+          for(const auto & pec : app.patternElementChains)
+          {
+            if(pec.relPattern.mayVariable.has_value())
+              countRowsVariable = pec.relPattern.mayVariable;
+            else if(pec.nodePattern.mayVariable.has_value())
+              countRowsVariable = pec.nodePattern.mayVariable;
+            if(countRowsVariable.has_value())
+              break;
+          }
+      }
+      if(!countRowsVariable.has_value())
+        throw std::logic_error("Not Implemented (count(*) expects a variable in the match pattern)");
+      auto & terms = props[*countRowsVariable];
+      for(const size_t position : countRowsPositions)
+        terms.push_back(ReturnClauseTerm{position, db.idProperty().name, AggregationFunction::CountRows});
+    }
+    
+    const bool aggregate = std::any_of(returnedItems.begin(), returnedItems.end(), [](const ProjectionItem& item)
+    {
+      return item.naoExp.mayAggregation.has_value();
+    });
+    
+    // Aggregated rows are distinct.
+    const Distinct distinct = (spq.returnClause.distinct && !aggregate) ? Distinct::Yes : Distinct::No;
+    
+    std::vector<SortKey> sortKeys;
+    if(spq.returnClause.order.has_value())
+      sortKeys = extractSortKeys(*spq.returnClause.order, returnedItems, props);
+    for(const auto & sortKey : sortKeys)
+      if(sortKey.position >= returnedItems.size())
+      {
+        if(distinct == Distinct::Yes)
+          throw std::logic_error("In a RETURN DISTINCT, ORDER BY can only use returned terms.");
+        if(aggregate)
+          throw std::logic_error("With aggregations, ORDER BY can only use returned terms.");
+      }
+    
+    // Repeating rows doesn't change the distinct rows.
+    const RowsCounts* repeatedRows = (distinct == Distinct::Yes) ? nullptr :
+    (partsRowsCounts.has_value() ? &*partsRowsCounts : rowsCounts);
+    // The id of the variable whose rows are repeated is returned after the other terms.
+    std::optional<size_t> repeatedRowsPosition;
+    if(repeatedRows)
+    {
+      size_t position = returnedItems.size();
+      for(const auto & [_, terms] : props)
+        for(const auto & term : terms)
+          position = std::max(position, term.returnClausePosition + 1);
+      props[repeatedRows->var].push_back(ReturnClauseTerm{position, db.idProperty().name});
+      repeatedRowsPosition = position;
+    }
     
     const auto limit = spq.returnClause.limit;
     
+    if(page)
+    {
+      if(!limit.has_value())
+        throw std::invalid_argument("A page of results expects a LIMIT.");
+      if(!sortKeys.empty() || aggregate || spq.returnClause.distinct)
+        throw std::logic_error("Not Implemented (A page of results expects no ORDER BY, no DISTINCT and no aggregation)");
+    }
+    
+    // When the rows are not sorted in SQL, they are sorted by |rowsSorter|,
+    // and the limit is applied by |rowsSorter| too.
+    std::optional<RowsSorter> rowsSorter;
+    auto sortRows = [&]()
+    {
+      std::vector<RowSortKey> rowSortKeys;
+      for(const auto & sortKey : sortKeys)
+        rowSortKeys.push_back(RowSortKey{sortKey.position, sortKey.order});
+      rowsSorter.emplace(returnedItems.size(), std::move(rowSortKeys), limit);
+    };
+    const FuncResults fOnUnsortedRow = [&](const ResultOrder& resultOrder, const VecValues& values)
+    {
+      rowsSorter->onRow(resultOrder, values);
+    };
+    
     auto mkReturnedProperties = [&](const Variable& var) -> std::vector<ReturnClauseTerm>
     {
       if(auto it = props.find(var); it != props.end())
@@ -121,35 +1136,42 @@ void runSingleQuery(const RegularQuery& regularQuery,
     for(const auto & pec : app.patternElementChains)
       countActiveNodePaterns += nodePatternIsActive(pec.nodePattern);
     
-    if(((app.patternElementChains.size() == 1) && (countActiveNodePaterns > 0)) ||
+    // The aggregations that are not computed in SQL are computed by |rowsAggregator|, before the rows are sorted.
+    std::vector<std::optional<AggregationFunction>> aggregations(returnedItems.size());
+    auto moveAggregations = [&](std::vector<ReturnClauseTerm>& terms)
+    {
+      for(auto & term : terms)
+        if(term.aggregation.has_value())
+        {
+          aggregations[term.returnClausePosition] = term.aggregation;
+          term.aggregation.reset();
+        }
+    };
+    std::optional<RowsAggregator> rowsAggregator;
+    const FuncResults fOnUnaggregatedRow = [&](const ResultOrder& resultOrder, const VecValues& values)
+    {
+      rowsAggregator->onRow(resultOrder, values);
+    };
+    
+    const bool joinPatternParts = patternParts.size() > 1 || !optionalMatchClauses.empty();
+    if(joinPatternParts ||
+       ((app.patternElementChains.size() == 1) && (countActiveNodePaterns > 0)) ||
        app.patternElementChains.size() > 1)
     {
       std::map<Variable, std::vector<ReturnClauseTerm>> variables;
       std::vector<PathPatternElement> pathPatternElements;
-      
-      if(app.firstNodePattern.mayVariable.has_value())
-        variables[*app.firstNodePattern.mayVariable] = mkReturnedProperties(*app.firstNodePattern.mayVariable);
-      pathPatternElements.emplace_back(app.firstNodePattern.mayVariable,
-                                       app.firstNodePattern.labels);
-      
       std::vector<TraversalDirection> traversalDirections;
       
-      for(const auto & pec : app.patternElementChains)
+      if(joinPatternParts)
+        // forEachMatchRow verifies that these variables are defined.
+        variables = props;
+      else
       {
-        traversalDirections.push_back(pec.relPattern.traversalDirection);
-        
-        if(pec.relPattern.mayVariable.has_value())
-          variables[*pec.relPattern.mayVariable] = mkReturnedProperties(*pec.relPattern.mayVariable);
-        pathPatternElements.emplace_back(pec.relPattern.mayVariable,
-                                         pec.relPattern.labels);
+        toPathPattern(app, traversalDirections, pathPatternElements);
+        for(const auto & pathPatternElement : pathPatternElements)
+          if(pathPatternElement.var.has_value())
+            variables[*pathPatternElement.var] = mkReturnedProperties(*pathPatternElement.var);
         
-        if(pec.nodePattern.mayVariable.has_value())
-          variables[*pec.nodePattern.mayVariable] = mkReturnedProperties(*pec.nodePattern.mayVariable);
-        pathPatternElements.emplace_back(pec.nodePattern.mayVariable,
-                                         pec.nodePattern.labels);
-      }
-      
-      {
         // Sanity check.
         
         for(const auto & [varName, _] : props)
@@ -162,12 +1184,63 @@ void runSingleQuery(const RegularQuery& regularQuery,
               throw std::logic_error("A variable used in the where clause was not defined.");
       }
       
-      db.forEachPath(traversalDirections,
-                     variables,
-                     pathPatternElements,
-                     whereExprsByVarsAndproperties,
-                     limit,
-                     fOnRow);
+      if(!sortKeys.empty())
+        sortRows();
+      
+      // The aggregations of paths are computed by |rowsAggregator|.
+      if(aggregate)
+      {
+        for(auto & [_, terms] : variables)
+          moveAggregations(terms);
+        rowsAggregator.emplace(std::move(aggregations));
+      }
+      const FuncResults& fOnAggregatedRow = rowsSorter.has_value() ? fOnUnsortedRow : fOnRow;
+      
+      std::optional<Limit> pathsLimit = (rowsSorter.has_value() || rowsAggregator.has_value()) ? std::nullopt : limit;
+      FuncResults fOnPath = rowsAggregator.has_value() ? fOnUnaggregatedRow : fOnAggregatedRow;
+      // The limit applies to the repeated rows.
+      if(repeatedRows)
+      {
+        fOnPath = repeatRows(*repeatedRows, *repeatedRowsPosition, pathsLimit, fOnPath);
+        pathsLimit.reset();
+      }
+      if(joinPatternParts)
+      {
+        // Duplicate rows are removed with a hash set of the encoded rows.
+        std::unordered_set<std::string> distinctRows;
+        std::string rowKey;
+        size_t countRows{};
+        std::vector<MatchClause> matchClauses;
+        matchClauses.push_back(MatchClause{patternParts, whereExprsByVarsAndproperties, false});
+        std::move(optionalMatchClauses.begin(), optionalMatchClauses.end(), std::back_inserter(matchClauses));
+        forEachMatchRow(db, std::move(matchClauses), variables, [&](const ResultOrder& resultOrder, const VecValues& values)
+        {
+          if(pathsLimit.has_value() && countRows >= pathsLimit->maxCountRows)
+            return;
+          if(distinct == Distinct::Yes)
+          {
+            rowKey.clear();
+            for(const auto & [i, j] : resultOrder)
+              appendEncoded((*values[i])[j], rowKey);
+            if(!distinctRows.insert(rowKey).second)
+              return;
+          }
+          ++countRows;
+          fOnPath(resultOrder, values);
+        });
+      }
+      else
+        db.forEachPath(traversalDirections,
+                       variables,
+                       pathPatternElements,
+                       whereExprsByVarsAndproperties,
+                       distinct,
+                       pathsLimit,
+                       fOnPath,
+                       page);
+      
+      if(rowsAggregator.has_value())
+        rowsAggregator->emit(rowsSorter.has_value() ? std::nullopt : limit, fOnAggregatedRow);
     }
     else
     {
@@ -214,13 +1287,139 @@ void runSingleQuery(const RegularQuery& regularQuery,
         filter.insert(filter.end(), exprs.begin(), exprs.end());
       }
       
+      // When there are aggregations, they are computed in SQL and the aggregated rows are sorted by |rowsSorter|.
+      // When rows are repeated, the aggregations are computed by |rowsAggregator|.
+      if(aggregate && repeatedRows)
+      {
+        moveAggregations(properties);
+        rowsAggregator.emplace(std::move(aggregations));
+      }
+      std::vector<PropertySortKey> sqlSortKeys;
+      if(!aggregate)
+        for(const auto & sortKey : sortKeys)
+          sqlSortKeys.push_back(PropertySortKey{sortKey.property->second, sortKey.order});
+      if(!aggregate && db.canSortInSQL(elem, labels, sqlSortKeys))
+      {
+        // The sort keys don't need to be returned by the SQL query.
+        properties.erase(std::remove_if(properties.begin(), properties.end(), [&](const ReturnClauseTerm& term)
+        {
+          return term.returnClausePosition >= returnedItems.size() && term.returnClausePosition != repeatedRowsPosition;
+        }), properties.end());
+      }
+      else
+      {
+        sqlSortKeys.clear();
+        if(!sortKeys.empty())
+          sortRows();
+      }
+      
+      const FuncResults& fOnAggregatedRow = rowsSorter.has_value() ? fOnUnsortedRow : fOnRow;
+      std::optional<Limit> elementsLimit = (rowsSorter.has_value() || rowsAggregator.has_value()) ? std::nullopt : limit;
+      FuncResults fOnElement = rowsAggregator.has_value() ? fOnUnaggregatedRow : fOnAggregatedRow;
+      // The limit applies to the repeated rows.
+      if(repeatedRows)
+      {
+        fOnElement = repeatRows(*repeatedRows, *repeatedRowsPosition, elementsLimit, fOnElement);
+        elementsLimit.reset();
+      }
       db.forEachElementPropertyWithLabelsIn(variable,
                                             elem,
                                             properties,
                                             labels,
                                             &filter,
-                                            limit,
-                                            fOnRow);
+                                            distinct,
+                                            sqlSortKeys,
+                                            elementsLimit,
+                                            fOnElement,
+                                            page);
+      
+      if(rowsAggregator.has_value())
+        rowsAggregator->emit(rowsSorter.has_value() ? std::nullopt : limit, fOnAggregatedRow);
+    }
+    
+    if(rowsSorter.has_value())
+      rowsSorter->emit(fOnRow);
+  }
+}
+
+template<typename ID>
+void runBatchQuery(const RegularQuery& q,
+                   GraphDB<ID>& db,
+                   const BatchParameter& batch,
+                   const NonArithmeticOperatorExpression& key,
+                   size_t countBatches,
+                   const FOnColumns& fOnColumns,
+                   const std::function<void(size_t)>& fOnBatch,
+                   const FuncResults& fOnRow)
+{
+  // The key is returned after the returned items, and the LIMIT and DISTINCT apply to the rows of each parameter set.
+  RegularQuery keyedQuery = q;
+  auto & returnClause = keyedQuery.unionAllSingleQueries[0].singlePartQuery.returnClause;
+  const size_t countColumns = returnClause.items.items.size();
+  const std::optional<Limit> limit = returnClause.limit;
+  returnClause.limit.reset();
+  const bool distinct = returnClause.distinct;
+  returnClause.items.items.push_back(ProjectionItem{key, std::nullopt});
+
+  std::vector<std::vector<std::vector<Value>>> batchesRows(countBatches);
+  std::vector<std::unordered_set<std::string>> batchesDistinctRows(distinct ? countBatches : 0);
+  std::string keyStr;
+  std::string rowKey;
+  runSingleQuery(keyedQuery, db, [&](const std::vector<std::string>& columns)
+  {
+    fOnColumns(std::vector<std::string>(columns.begin(), columns.begin() + countColumns));
+  }, [&](const ResultOrder& resultOrder, const VecValues& values)
+  {
+    const auto & [keyI, keyJ] = resultOrder[countColumns];
+    const Value & keyValue = (*values[keyI])[keyJ];
+    auto findBatchIndices = [&](const Value& value)
+    {
+      keyStr.clear();
+      appendEncoded(value, keyStr);
+      return batch.batchIndices.find(keyStr);
+    };
+    auto it = findBatchIndices(keyValue);
+    // SQLite returns an integral double property value as an integer when it is compared with an integer, and vice versa.
+    if(it == batch.batchIndices.end())
+    {
+      if(const auto * i = std::get_if<int64_t>(&keyValue))
+        it = findBatchIndices(Value{static_cast<double>(*i)});
+      else if(const auto * d = std::get_if<double>(&keyValue); d && *d == static_cast<double>(static_cast<int64_t>(*d)))
+        it = findBatchIndices(Value{static_cast<int64_t>(*d)});
+      if(it == batch.batchIndices.end())
+        return;
+    }
+    if(distinct)
+    {
+      rowKey.clear();
+      for(size_t c{}; c<countColumns; ++c)
+        appendEncoded((*values[resultOrder[c].first])[resultOrder[c].second], rowKey);
+    }
+    for(const size_t batchIndex : it->second)
+    {
+      auto & rows = batchesRows[batchIndex];
+      if(limit.has_value() && rows.size() >= limit->maxCountRows)
+        continue;
+      if(distinct && !batchesDistinctRows[batchIndex].insert(rowKey).second)
+        continue;
+      auto & row = rows.emplace_back();
+      row.reserve(countColumns);
+      for(size_t c{}; c<countColumns; ++c)
+        row.push_back(copy((*values[resultOrder[c].first])[resultOrder[c].second]));
+    }
+  });
+
+  ResultOrder resultOrder;
+  for(size_t c{}; c<countColumns; ++c)
+    resultOrder.emplace_back(0, c);
+  VecValues rowValues(1);
+  for(size_t batchIndex{}; batchIndex<countBatches; ++batchIndex)
+  {
+    fOnBatch(batchIndex);
+    for(const auto & row : batchesRows[batchIndex])
+    {
+      rowValues[0] = &row;
+      fOnRow(resultOrder, rowValues);
     }
   }
 }
@@ -0,0 +1,472 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "FilterKernels.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+// The x86 kernels are compiled with function-level target attributes, so that the library
+// doesn't need to be compiled with -mavx2 and still runs on processors without AVX2.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GRAPHDBLITE_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define GRAPHDBLITE_X86_KERNELS 0
+#endif
+
+namespace sql::kernels
+{
+
+namespace
+{
+
+InstructionSet supportedInstructionSet()
+{
+  static const InstructionSet s_supported = []()
+  {
+#if GRAPHDBLITE_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+      return InstructionSet::AVX2;
+    if(__builtin_cpu_supports("sse4.2"))
+      return InstructionSet::SSE4_2;
+#endif
+    return InstructionSet::Scalar;
+  }();
+  return s_supported;
+}
+
+std::atomic<InstructionSet> g_maxInstructionSet{InstructionSet::AVX2};
+
+// Above this size, IN sets are evaluated with a binary search rather than with one SIMD comparison per element.
+constexpr size_t c_maxSIMDSetSize{16};
+
+template<Comparison comp>
+using ComparisonConstant = std::integral_constant<Comparison, comp>;
+
+// Calls |f| with ComparisonConstant<comp>, so that the comparison is known at compile time in the kernels.
+template<typename F>
+void withComparison(Comparison comp, F&& f)
+{
+  switch(comp)
+  {
+    case Comparison::EQ: f(ComparisonConstant<Comparison::EQ>{}); break;
+    case Comparison::NE: f(ComparisonConstant<Comparison::NE>{}); break;
+    case Comparison::LT: f(ComparisonConstant<Comparison::LT>{}); break;
+    case Comparison::LE: f(ComparisonConstant<Comparison::LE>{}); break;
+    case Comparison::GT: f(ComparisonConstant<Comparison::GT>{}); break;
+    case Comparison::GE: f(ComparisonConstant<Comparison::GE>{}); break;
+  }
+}
+
+// Calls |f| with the ComparisonConstant of the lower bound and the ComparisonConstant of the upper bound of a range.
+template<typename F>
+void withRangeComparisons(bool lowInclusive, bool highInclusive, F&& f)
+{
+  if(lowInclusive)
+  {
+    if(highInclusive)
+      f(ComparisonConstant<Comparison::GE>{}, ComparisonConstant<Comparison::LE>{});
+    else
+      f(ComparisonConstant<Comparison::GE>{}, ComparisonConstant<Comparison::LT>{});
+  }
+  else
+  {
+    if(highInclusive)
+      f(ComparisonConstant<Comparison::GT>{}, ComparisonConstant<Comparison::LE>{});
+    else
+      f(ComparisonConstant<Comparison::GT>{}, ComparisonConstant<Comparison::LT>{});
+  }
+}
+
+template<Comparison comp, typename T>
+bool satisfies(T a, T b)
+{
+  if constexpr (comp == Comparison::EQ) return a == b;
+  else if constexpr (comp == Comparison::NE) return a != b;
+  else if constexpr (comp == Comparison::LT) return a < b;
+  else if constexpr (comp == Comparison::LE) return a <= b;
+  else if constexpr (comp == Comparison::GT) return a > b;
+  else return a >= b;
+}
+
+#if GRAPHDBLITE_X86_KERNELS
+
+// c_bitsToBytes[bits] contains, in its k-th byte (in memory order), the k-th bit of |bits|.
+constexpr std::array<uint32_t, 16> c_bitsToBytes = []()
+{
+  std::array<uint32_t, 16> res{};
+  for(uint32_t bits{}; bits<16; ++bits)
+    for(uint32_t k{}; k<4; ++k)
+      res[bits] |= ((bits >> k) & 1u) << (8 * k);
+  return res;
+}();
+
+// Writes the |width| lowest bits of |bits| to |dst|, one byte per bit.
+inline void storeBits(unsigned bits, size_t width, uint8_t* dst)
+{
+  std::memcpy(dst, &c_bitsToBytes[bits], width);
+}
+
+// The SIMD kernels process the values by blocks of Lanes::c_width values,
+// and return the count of processed values.
+//
+// The Lanes classes provide the operations used by the kernels, for a given instruction set and a given type of value:
+//   'mask<comp>(a, b)' returns a bitmask whose k-th bit is set iff (the k-th lane of a) <comp> (the k-th lane of b).
+
+template<typename T>
+struct AVX2Lanes;
+
+template<>
+struct AVX2Lanes<int64_t>
+{
+  using Register = __m256i;
+  static constexpr size_t c_width{4};
+
+  __attribute__((target("avx2"))) static Register load(const int64_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+  __attribute__((target("avx2"))) static Register broadcast(int64_t v) { return _mm256_set1_epi64x(v); }
+  __attribute__((target("avx2"))) static unsigned bits(Register r) { return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(r))); }
+  template<Comparison comp>
+  __attribute__((target("avx2"))) static unsigned mask(Register a, Register b)
+  {
+    constexpr unsigned all{(1u << c_width) - 1};
+    if constexpr (comp == Comparison::EQ) return bits(_mm256_cmpeq_epi64(a, b));
+    else if constexpr (comp == Comparison::NE) return bits(_mm256_cmpeq_epi64(a, b)) ^ all;
+    else if constexpr (comp == Comparison::GT) return bits(_mm256_cmpgt_epi64(a, b));
+    else if constexpr (comp == Comparison::LE) return bits(_mm256_cmpgt_epi64(a, b)) ^ all;
+    else if constexpr (comp == Comparison::LT) return bits(_mm256_cmpgt_epi64(b, a));
+    else return bits(_mm256_cmpgt_epi64(b, a)) ^ all;
+  }
+};
+
+template<>
+struct AVX2Lanes<double>
+{
+  using Register = __m256d;
+  static constexpr size_t c_width{4};
+
+  __attribute__((target("avx2"))) static Register load(const double* p) { return _mm256_loadu_pd(p); }
+  __attribute__((target("avx2"))) static Register broadcast(double v) { return _mm256_set1_pd(v); }
+  template<Comparison comp>
+  __attribute__((target("avx2"))) static unsigned mask(Register a, Register b)
+  {
+    if constexpr (comp == Comparison::EQ) return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)));
+    else if constexpr (comp == Comparison::NE) return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_NEQ_UQ)));
+    else if constexpr (comp == Comparison::GT) return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ)));
+    else if constexpr (comp == Comparison::LE) return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ)));
+    else if constexpr (comp == Comparison::LT) return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ)));
+    else return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ)));
+  }
+};
+
+template<typename T>
+struct SSELanes;
+
+template<>
+struct SSELanes<int64_t>
+{
+  using Register = __m128i;
+  static constexpr size_t c_width{2};
+
+  __attribute__((target("sse4.2"))) static Register load(const int64_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+  __attribute__((target("sse4.2"))) static Register broadcast(int64_t v) { return _mm_set1_epi64x(v); }
+  __attribute__((target("sse4.2"))) static unsigned bits(Register r) { return static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(r))); }
+  template<Comparison comp>
+  __attribute__((target("sse4.2"))) static unsigned mask(Register a, Register b)
+  {
+    constexpr unsigned all{(1u << c_width) - 1};
+    if constexpr (comp == Comparison::EQ) return bits(_mm_cmpeq_epi64(a, b));
+    else if constexpr (comp == Comparison::NE) return bits(_mm_cmpeq_epi64(a, b)) ^ all;
+    else if constexpr (comp == Comparison::GT) return bits(_mm_cmpgt_epi64(a, b));
+    else if constexpr (comp == Comparison::LE) return bits(_mm_cmpgt_epi64(a, b)) ^ all;
+    else if constexpr (comp == Comparison::LT) return bits(_mm_cmpgt_epi64(b, a));
+    else return bits(_mm_cmpgt_epi64(b, a)) ^ all;
+  }
+};
+
+template<>
+struct SSELanes<double>
+{
+  using Register = __m128d;
+  static constexpr size_t c_width{2};
+
+  __attribute__((target("sse4.2"))) static Register load(const double* p) { return _mm_loadu_pd(p); }
+  __attribute__((target("sse4.2"))) static Register broadcast(double v) { return _mm_set1_pd(v); }
+  template<Comparison comp>
+  __attribute__((target("sse4.2"))) static unsigned mask(Register a, Register b)
+  {
+    if constexpr (comp == Comparison::EQ) return static_cast<unsigned>(_mm_movemask_pd(_mm_cmpeq_pd(a, b)));
+    else if constexpr (comp == Comparison::NE) return static_cast<unsigned>(_mm_movemask_pd(_mm_cmpneq_pd(a, b)));
+    else if constexpr (comp == Comparison::GT) return static_cast<unsigned>(_mm_movemask_pd(_mm_cmpgt_pd(a, b)));
+    else if constexpr (comp == Comparison::LE) return static_cast<unsigned>(_mm_movemask_pd(_mm_cmple_pd(a, b)));
+    else if constexpr (comp == Comparison::LT) return static_cast<unsigned>(_mm_movemask_pd(_mm_cmplt_pd(a, b)));
+    else return static_cast<unsigned>(_mm_movemask_pd(_mm_cmpge_pd(a, b)));
+  }
+};
+
+// The AVX2 and SSE4.2 kernels have the same implementation, but they need distinct target attributes
+// for the intrinsics of the Lanes classes to be inlined.
+
+template<Comparison comp, typename T>
+__attribute__((target("avx2")))
+size_t compareAVX2(const T* values, size_t count, T constant, uint8_t* dst)
+{
+  using Lanes = AVX2Lanes<T>;
+  const auto c = Lanes::broadcast(constant);
+  size_t i{};
+  for(; i + Lanes::c_width <= count; i += Lanes::c_width)
+    storeBits(Lanes::template mask<comp>(Lanes::load(values + i), c), Lanes::c_width, dst + i);
+  return i;
+}
+
+template<Comparison lowComp, Comparison highComp, typename T>
+__attribute__((target("avx2")))
+size_t inRangeAVX2(const T* values, size_t count, T low, T high, uint8_t* dst)
+{
+  using Lanes = AVX2Lanes<T>;
+  const auto l = Lanes::broadcast(low);
+  const auto h = Lanes::broadcast(high);
+  size_t i{};
+  for(; i + Lanes::c_width <= count; i += Lanes::c_width)
+  {
+    const auto v = Lanes::load(values + i);
+    storeBits(Lanes::template mask<lowComp>(v, l) & Lanes::template mask<highComp>(v, h), Lanes::c_width, dst + i);
+  }
+  return i;
+}
+
+template<typename T>
+__attribute__((target("avx2")))
+size_t inSetAVX2(const T* values, size_t count, const std::vector<T>& set, uint8_t* dst)
+{
+  using Lanes = AVX2Lanes<T>;
+  const size_t setSize = set.size();
+  typename Lanes::Register elements[c_maxSIMDSetSize];
+  for(size_t k{}; k<setSize; ++k)
+    elements[k] = Lanes::broadcast(set[k]);
+  size_t i{};
+  for(; i + Lanes::c_width <= count; i += Lanes::c_width)
+  {
+    const auto v = Lanes::load(values + i);
+    unsigned bits{};
+    for(size_t k{}; k<setSize; ++k)
+      bits |= Lanes::template mask<Comparison::EQ>(v, elements[k]);
+    storeBits(bits, Lanes::c_width, dst + i);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+size_t appendSelectionAVX2(const uint8_t* bytes, size_t count, uint8_t value, std::vector<size_t>& selection)
+{
+  const __m256i v = _mm256_set1_epi8(static_cast<char>(value));
+  size_t i{};
+  for(; i + 32 <= count; i += 32)
+  {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+    for(auto bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, v))); bits; bits &= bits - 1)
+      selection.push_back(i + static_cast<size_t>(__builtin_ctz(bits)));
+  }
+  return i;
+}
+
+template<Comparison comp, typename T>
+__attribute__((target("sse4.2")))
+size_t compareSSE(const T* values, size_t count, T constant, uint8_t* dst)
+{
+  using Lanes = SSELanes<T>;
+  const auto c = Lanes::broadcast(constant);
+  size_t i{};
+  for(; i + Lanes::c_width <= count; i += Lanes::c_width)
+    storeBits(Lanes::template mask<comp>(Lanes::load(values + i), c), Lanes::c_width, dst + i);
+  return i;
+}
+
+template<Comparison lowComp, Comparison highComp, typename T>
+__attribute__((target("sse4.2")))
+size_t inRangeSSE(const T* values, size_t count, T low, T high, uint8_t* dst)
+{
+  using Lanes = SSELanes<T>;
+  const auto l = Lanes::broadcast(low);
+  const auto h = Lanes::broadcast(high);
+  size_t i{};
+  for(; i + Lanes::c_width <= count; i += Lanes::c_width)
+  {
+    const auto v = Lanes::load(values + i);
+    storeBits(Lanes::template mask<lowComp>(v, l) & Lanes::template mask<highComp>(v, h), Lanes::c_width, dst + i);
+  }
+  return i;
+}
+
+template<typename T>
+__attribute__((target("sse4.2")))
+size_t inSetSSE(const T* values, size_t count, const std::vector<T>& set, uint8_t* dst)
+{
+  using Lanes = SSELanes<T>;
+  const size_t setSize = set.size();
+  typename Lanes::Register elements[c_maxSIMDSetSize];
+  for(size_t k{}; k<setSize; ++k)
+    elements[k] = Lanes::broadcast(set[k]);
+  size_t i{};
+  for(; i + Lanes::c_width <= count; i += Lanes::c_width)
+  {
+    const auto v = Lanes::load(values + i);
+    unsigned bits{};
+    for(size_t k{}; k<setSize; ++k)
+      bits |= Lanes::template mask<Comparison::EQ>(v, elements[k]);
+    storeBits(bits, Lanes::c_width, dst + i);
+  }
+  return i;
+}
+
+__attribute__((target("sse4.2")))
+size_t appendSelectionSSE(const uint8_t* bytes, size_t count, uint8_t value, std::vector<size_t>& selection)
+{
+  const __m128i v = _mm_set1_epi8(static_cast<char>(value));
+  size_t i{};
+  for(; i + 16 <= count; i += 16)
+  {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+    for(auto bits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, v))); bits; bits &= bits - 1)
+      selection.push_back(i + static_cast<size_t>(__builtin_ctz(bits)));
+  }
+  return i;
+}
+
+#endif // GRAPHDBLITE_X86_KERNELS
+
+// The values that are not processed by the SIMD kernels are processed by the scalar loops below.
+
+template<typename T>
+void compareImpl(const T* values, size_t count, Comparison comparison, T constant, uint8_t* dst)
+{
+  withComparison(comparison, [&](auto comp)
+  {
+    size_t i{};
+#if GRAPHDBLITE_X86_KERNELS
+    switch(instructionSet())
+    {
+      case InstructionSet::AVX2: i = compareAVX2<comp.value>(values, count, constant, dst); break;
+      case InstructionSet::SSE4_2: i = compareSSE<comp.value>(values, count, constant, dst); break;
+      case InstructionSet::Scalar: break;
+    }
+#endif
+    for(; i<count; ++i)
+      dst[i] = satisfies<comp.value>(values[i], constant);
+  });
+}
+
+template<typename T>
+void inRangeImpl(const T* values, size_t count, T low, bool lowInclusive, T high, bool highInclusive, uint8_t* dst)
+{
+  withRangeComparisons(lowInclusive, highInclusive, [&](auto lowComp, auto highComp)
+  {
+    size_t i{};
+#if GRAPHDBLITE_X86_KERNELS
+    switch(instructionSet())
+    {
+      case InstructionSet::AVX2: i = inRangeAVX2<lowComp.value, highComp.value>(values, count, low, high, dst); break;
+      case InstructionSet::SSE4_2: i = inRangeSSE<lowComp.value, highComp.value>(values, count, low, high, dst); break;
+      case InstructionSet::Scalar: break;
+    }
+#endif
+    for(; i<count; ++i)
+      dst[i] = satisfies<lowComp.value>(values[i], low) & satisfies<highComp.value>(values[i], high);
+  });
+}
+
+template<typename T>
+void inSetImpl(const T* values, size_t count, const std::vector<T>& set, uint8_t* dst)
+{
+  size_t i{};
+#if GRAPHDBLITE_X86_KERNELS
+  if(set.size() <= c_maxSIMDSetSize)
+  {
+    switch(instructionSet())
+    {
+      case InstructionSet::AVX2: i = inSetAVX2(values, count, set, dst); break;
+      case InstructionSet::SSE4_2: i = inSetSSE(values, count, set, dst); break;
+      case InstructionSet::Scalar: break;
+    }
+  }
+#endif
+  for(; i<count; ++i)
+    dst[i] = std::binary_search(set.begin(), set.end(), values[i]);
+}
+
+} // NS
+
+InstructionSet instructionSet()
+{
+  return std::min(supportedInstructionSet(), g_maxInstructionSet.load(std::memory_order_relaxed));
+}
+
+void setMaxInstructionSet(InstructionSet set)
+{
+  g_maxInstructionSet.store(set, std::memory_order_relaxed);
+}
+
+void compare(const int64_t* values, size_t count, Comparison comp, int64_t constant, uint8_t* dst)
+{
+  compareImpl(values, count, comp, constant, dst);
+}
+
+void compare(const double* values, size_t count, Comparison comp, double constant, uint8_t* dst)
+{
+  compareImpl(values, count, comp, constant, dst);
+}
+
+void inRange(const int64_t* values, size_t count, int64_t low, bool lowInclusive, int64_t high, bool highInclusive, uint8_t* dst)
+{
+  inRangeImpl(values, count, low, lowInclusive, high, highInclusive, dst);
+}
+
+void inRange(const double* values, size_t count, double low, bool lowInclusive, double high, bool highInclusive, uint8_t* dst)
+{
+  inRangeImpl(values, count, low, lowInclusive, high, highInclusive, dst);
+}
+
+void inSet(const int64_t* values, size_t count, const std::vector<int64_t>& set, uint8_t* dst)
+{
+  inSetImpl(values, count, set, dst);
+}
+
+void inSet(const double* values, size_t count, const std::vector<double>& set, uint8_t* dst)
+{
+  inSetImpl(values, count, set, dst);
+}
+
+void appendSelection(const uint8_t* bytes, size_t count, uint8_t value, std::vector<size_t>& selection)
+{
+  size_t i{};
+#if GRAPHDBLITE_X86_KERNELS
+  switch(instructionSet())
+  {
+    case InstructionSet::AVX2: i = appendSelectionAVX2(bytes, count, value, selection); break;
+    case InstructionSet::SSE4_2: i = appendSelectionSSE(bytes, count, value, selection); break;
+    case InstructionSet::Scalar: break;
+  }
+#endif
+  for(; i<count; ++i)
+    if(bytes[i] == value)
+      selection.push_back(i);
+}
+
+}
@@ -0,0 +1,63 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include "SqlAST.h"
+
+#include <cstdint>
+#include <vector>
+
+// Kernels evaluating predicates on contiguous arrays of numeric values, used by sql::FilterProgram.
+//
+// On x86 processors, the kernels use AVX2 or SSE4.2 instructions when the processor supports them
+// (this is detected at runtime), and a scalar implementation otherwise.
+//
+// The predicate kernels write to |dst| 1 for the values satisfying the predicate, and 0 for the other values.
+namespace sql::kernels
+{
+
+enum class InstructionSet
+{
+  Scalar,
+  SSE4_2,
+  AVX2
+};
+
+// The instruction set used by the kernels.
+InstructionSet instructionSet();
+
+// Limits the instruction set used by the kernels, to compare the implementations in tests and benchmarks.
+// The kernels never use an instruction set that is not supported by the processor.
+void setMaxInstructionSet(InstructionSet);
+
+// values[i] <comp> constant
+void compare(const int64_t* values, size_t count, Comparison comp, int64_t constant, uint8_t* dst);
+void compare(const double* values, size_t count, Comparison comp, double constant, uint8_t* dst);
+
+// low <(=) values[i] <(=) high
+void inRange(const int64_t* values, size_t count, int64_t low, bool lowInclusive, int64_t high, bool highInclusive, uint8_t* dst);
+void inRange(const double* values, size_t count, double low, bool lowInclusive, double high, bool highInclusive, uint8_t* dst);
+
+// values[i] IN set
+// |set| is sorted.
+void inSet(const int64_t* values, size_t count, const std::vector<int64_t>& set, uint8_t* dst);
+void inSet(const double* values, size_t count, const std::vector<double>& set, uint8_t* dst);
+
+// Appends to |selection| the indices i in [0, count) such that bytes[i] == value, in increasing order.
+void appendSelection(const uint8_t* bytes, size_t count, uint8_t value, std::vector<size_t>& selection);
+
+}
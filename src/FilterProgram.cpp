@@ -0,0 +1,610 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "FilterProgram.h"
+#include "FilterKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace sql
+{
+
+namespace
+{
+
+// Evaluations are stored in registers as bytes, so that the logical operators are simple min / max operations:
+//   AND is min, OR is max, NOT is 2 - x.
+constexpr uint8_t toByte(Evaluation e)
+{
+  switch(e)
+  {
+    case Evaluation::False: return 0;
+    case Evaluation::Unknown: return 1;
+    case Evaluation::True: return 2;
+  }
+  return 1;
+}
+
+constexpr uint8_t c_byteFalse = toByte(Evaluation::False);
+constexpr uint8_t c_byteUnknown = toByte(Evaluation::Unknown);
+constexpr uint8_t c_byteTrue = toByte(Evaluation::True);
+
+bool isNumeric(const Value& v)
+{
+  return std::holds_alternative<int64_t>(v) || std::holds_alternative<double>(v);
+}
+
+uint8_t compare(const Value& a, const Value& b, const Comparison comp)
+{
+  if(std::holds_alternative<Nothing>(a) || std::holds_alternative<Nothing>(b))
+    return c_byteUnknown;
+  const int c = threeWayCompare(a, b);
+  bool res{};
+  switch(comp)
+  {
+    case Comparison::EQ: res = c == 0; break;
+    case Comparison::NE: res = c != 0; break;
+    case Comparison::LT: res = c < 0; break;
+    case Comparison::LE: res = c <= 0; break;
+    case Comparison::GT: res = c > 0; break;
+    case Comparison::GE: res = c >= 0; break;
+  }
+  return res ? c_byteTrue : c_byteFalse;
+}
+
+// The comparison such that (a <comp> b) is equivalent to (b <mirror(comp)> a).
+Comparison mirror(const Comparison comp)
+{
+  switch(comp)
+  {
+    case Comparison::EQ: return Comparison::EQ;
+    case Comparison::NE: return Comparison::NE;
+    case Comparison::LT: return Comparison::GT;
+    case Comparison::LE: return Comparison::GE;
+    case Comparison::GT: return Comparison::LT;
+    case Comparison::GE: return Comparison::LE;
+  }
+  return comp;
+}
+
+// |v| is non-null.
+bool contains(const HomogeneousNonNullableValues& list, const Value& v)
+{
+  return std::visit([&](auto && arg) -> bool {
+    using T = std::decay_t<decltype(arg)>;
+    if constexpr (std::is_same_v<T, std::monostate>)
+      return false;
+    else if constexpr (std::is_same_v<T, std::shared_ptr<std::vector<int64_t>>> ||
+                       std::is_same_v<T, std::shared_ptr<std::vector<double>>>)
+    {
+      if(storageClass(v) != 0)
+        return false;
+      for(const auto elem : *arg)
+        if(0 == threeWayCompare(v, Value{elem}))
+          return true;
+      return false;
+    }
+    else if constexpr (std::is_same_v<T, std::shared_ptr<Strings>>)
+    {
+      const auto * str = std::get_if<StringPtr>(&v);
+      if(!str)
+        return false;
+      for(const char * elem : arg->stringsArray)
+        if(0 == std::strcmp(str->string.get(), elem))
+          return true;
+      return false;
+    }
+    else if constexpr (std::is_same_v<T, std::shared_ptr<ByteArrays>>)
+    {
+      const auto * bytes = std::get_if<ByteArrayPtr>(&v);
+      if(!bytes)
+        return false;
+      for(const iovec & elem : arg->iovecs)
+        if(0 == compareBytes(bytes->bytes.get(), bytes->m_bufSz, static_cast<const unsigned char*>(elem.iov_base), elem.iov_len))
+          return true;
+      return false;
+    }
+    else if constexpr (std::is_same_v<T, std::shared_ptr<IDSet>>)
+    {
+      if(const auto * i = std::get_if<int64_t>(&v))
+        return arg->contains(*i);
+      // A real is in the set when it has an exact integer value.
+      if(const auto * d = std::get_if<double>(&v))
+        return *d >= -0x1p63 && *d < 0x1p63 && *d == std::trunc(*d) && arg->contains(static_cast<int64_t>(*d));
+      return false;
+    }
+    else
+      static_assert(c_false<T>, "non-exhaustive visitor!");
+  }, list);
+}
+
+} // NS
+
+
+FilterProgram::FilterProgram(const Expression& expr)
+{
+  m_resultRegister = expr.compile(*this);
+}
+
+FilterOperand FilterProgram::addValueColumn(const QueryColumnName& column)
+{
+  for(size_t i{}, sz = m_valueColumns.size(); i < sz; ++i)
+    if(m_valueColumns[i].name == column.name)
+      return FilterOperand{FilterOperand::Kind::Column, static_cast<unsigned>(i)};
+  m_valueColumns.push_back(column);
+  return FilterOperand{FilterOperand::Kind::Column, static_cast<unsigned>(m_valueColumns.size() - 1)};
+}
+
+FilterOperand FilterProgram::addConstant(Value&& value)
+{
+  m_constants.push_back(std::move(value));
+  return FilterOperand{FilterOperand::Kind::Constant, static_cast<unsigned>(m_constants.size() - 1)};
+}
+
+unsigned FilterProgram::addConstant(Evaluation e)
+{
+  Instruction instruction{OpCode::Constant};
+  instruction.evaluation = e;
+  return add(std::move(instruction));
+}
+
+unsigned FilterProgram::addComparison(Comparison comp, const FilterOperand& left, const FilterOperand& right)
+{
+  const auto isNumericConstant = [&](const FilterOperand& operand)
+  {
+    return operand.kind == FilterOperand::Kind::Constant && isNumeric(m_constants[operand.index]);
+  };
+
+  Instruction instruction{OpCode::Compare};
+  instruction.comparison = comp;
+  instruction.left = left;
+  instruction.right = right;
+  if(left.kind == FilterOperand::Kind::Column && isNumericConstant(right))
+    instruction.opCode = OpCode::CompareNumeric;
+  else if(right.kind == FilterOperand::Kind::Column && isNumericConstant(left))
+  {
+    instruction.opCode = OpCode::CompareNumeric;
+    instruction.comparison = mirror(comp);
+    std::swap(instruction.left, instruction.right);
+  }
+  return add(std::move(instruction));
+}
+
+unsigned FilterProgram::addInList(const FilterOperand& operand, const HomogeneousNonNullableValues& list, bool negate)
+{
+  Instruction instruction{OpCode::InList};
+  instruction.left = operand;
+  instruction.negate = negate;
+
+  if(operand.kind == FilterOperand::Kind::Column)
+  {
+    std::optional<NumericSet> set;
+    if(const auto * integers = std::get_if<std::shared_ptr<std::vector<int64_t>>>(&list))
+    {
+      set.emplace();
+      set->integers = **integers;
+      std::sort(set->integers.begin(), set->integers.end());
+      set->reals.assign(set->integers.begin(), set->integers.end());
+    }
+    else if(const auto * reals = std::get_if<std::shared_ptr<std::vector<double>>>(&list))
+    {
+      set.emplace();
+      set->reals = **reals;
+      std::sort(set->reals.begin(), set->reals.end());
+    }
+    if(set.has_value())
+    {
+      m_numericSets.push_back(std::move(*set));
+      instruction.opCode = OpCode::InNumericSet;
+      instruction.index = static_cast<unsigned>(m_numericSets.size() - 1);
+      return add(std::move(instruction));
+    }
+  }
+
+  m_lists.push_back(list);
+  instruction.index = static_cast<unsigned>(m_lists.size() - 1);
+  return add(std::move(instruction));
+}
+
+unsigned FilterProgram::addLabelsConstraint(const QueryColumnName& typeColumn, const std::set<ElementTypeIndex>& types)
+{
+  Instruction instruction{OpCode::LabelsConstraint};
+  instruction.index = [&]()
+  {
+    for(size_t i{}, sz = m_typeColumns.size(); i < sz; ++i)
+      if(m_typeColumns[i].name == typeColumn.name)
+        return static_cast<unsigned>(i);
+    m_typeColumns.push_back(typeColumn);
+    return static_cast<unsigned>(m_typeColumns.size() - 1);
+  }();
+  for(const auto & type : types)
+  {
+    if(instruction.types.size() <= type.unsafeGet())
+      instruction.types.resize(type.unsafeGet() + 1);
+    instruction.types[type.unsafeGet()] = true;
+  }
+  return add(std::move(instruction));
+}
+
+unsigned FilterProgram::addNot(unsigned reg)
+{
+  Instruction instruction{OpCode::Not};
+  instruction.reg1 = reg;
+  return add(std::move(instruction));
+}
+
+unsigned FilterProgram::addAggregation(Aggregator a, unsigned reg1, unsigned reg2)
+{
+  // A lower bound and an upper bound of the same column, with numeric constants, that are ANDed
+  // are fused in a single instruction evaluating the range.
+  // Each register is used by a single instruction, so when the two comparisons are the last instructions
+  // the second one can be removed.
+  if(a == Aggregator::AND && reg1 + 1 == reg2 && reg2 + 1 == m_instructions.size())
+  {
+    const auto isLowerBound = [](const Instruction& i) { return i.comparison == Comparison::GT || i.comparison == Comparison::GE; };
+    const auto isUpperBound = [](const Instruction& i) { return i.comparison == Comparison::LT || i.comparison == Comparison::LE; };
+
+    Instruction& first = m_instructions[reg1];
+    Instruction& second = m_instructions[reg2];
+    if(first.opCode == OpCode::CompareNumeric && second.opCode == OpCode::CompareNumeric &&
+       !first.secondComparison.has_value() && !second.secondComparison.has_value() &&
+       first.left.index == second.left.index)
+    {
+      if(isUpperBound(first) && isLowerBound(second))
+        std::swap(first, second);
+      if(isLowerBound(first) && isUpperBound(second))
+      {
+        first.secondComparison.emplace(second.comparison, second.right);
+        m_instructions.pop_back();
+        return reg1;
+      }
+    }
+  }
+
+  Instruction instruction{(a == Aggregator::AND) ? OpCode::And : OpCode::Or};
+  instruction.reg1 = reg1;
+  instruction.reg2 = reg2;
+  return add(std::move(instruction));
+}
+
+unsigned FilterProgram::add(Instruction&& instruction)
+{
+  m_instructions.push_back(std::move(instruction));
+  return static_cast<unsigned>(m_instructions.size() - 1);
+}
+
+const Value& FilterProgram::operandValue(const Batch& batch, const FilterOperand& operand, size_t row) const
+{
+  if(operand.kind == FilterOperand::Kind::Constant)
+    return m_constants[operand.index];
+  return *batch.values[operand.index][row];
+}
+
+const FilterProgram::NumericColumn& FilterProgram::numericColumn(const Batch& batch, unsigned column) const
+{
+  NumericColumn& res = m_numericColumns[column];
+  if(res.decoded)
+    return res;
+  const size_t countRows = batch.countRows;
+  res.kinds.resize(countRows);
+  res.integers.resize(countRows);
+  res.reals.resize(countRows);
+  res.countReals = 0;
+  res.countNulls = 0;
+  res.countOthers = 0;
+  const auto & values = batch.values[column];
+  for(size_t row{}; row < countRows; ++row)
+  {
+    const Value & v = *values[row];
+    if(const auto * i = std::get_if<int64_t>(&v))
+    {
+      res.kinds[row] = NumericColumn::Kind::Integer;
+      res.integers[row] = *i;
+      res.reals[row] = static_cast<double>(*i);
+    }
+    else if(const auto * d = std::get_if<double>(&v))
+    {
+      res.kinds[row] = NumericColumn::Kind::Real;
+      res.integers[row] = 0;
+      res.reals[row] = *d;
+      ++res.countReals;
+    }
+    else
+    {
+      const bool isNull = std::holds_alternative<Nothing>(v);
+      res.kinds[row] = isNull ? NumericColumn::Kind::Null : NumericColumn::Kind::Other;
+      res.integers[row] = 0;
+      res.reals[row] = 0.;
+      ++(isNull ? res.countNulls : res.countOthers);
+    }
+  }
+  res.decoded = true;
+  return res;
+}
+
+void FilterProgram::runCompareNumeric(const Batch& batch, const Instruction& instruction, uint8_t* dst) const
+{
+  const size_t countRows = batch.countRows;
+  const NumericColumn& column = numericColumn(batch, instruction.left.index);
+  const Value& constant = m_constants[instruction.right.index];
+  const Value* secondConstant = instruction.secondComparison.has_value() ?
+    &m_constants[instruction.secondComparison->second.index] : nullptr;
+
+  // Values are compared as integers when the column and the constants only contain integers, and as doubles otherwise.
+  // Note that when a column contains both integers and doubles, its integers are compared as doubles
+  // even with an integer constant, which is only different from SQLite for integers beyond 2^53.
+  const bool compareIntegers = column.countReals == 0 &&
+    std::holds_alternative<int64_t>(constant) &&
+    (!secondConstant || std::holds_alternative<int64_t>(*secondConstant));
+  if(compareIntegers)
+  {
+    if(secondConstant)
+      kernels::inRange(column.integers.data(), countRows,
+                       std::get<int64_t>(constant), instruction.comparison == Comparison::GE,
+                       std::get<int64_t>(*secondConstant), instruction.secondComparison->first == Comparison::LE,
+                       dst);
+    else
+      kernels::compare(column.integers.data(), countRows, instruction.comparison, std::get<int64_t>(constant), dst);
+  }
+  else
+  {
+    if(secondConstant)
+      kernels::inRange(column.reals.data(), countRows,
+                       asDouble(constant), instruction.comparison == Comparison::GE,
+                       asDouble(*secondConstant), instruction.secondComparison->first == Comparison::LE,
+                       dst);
+    else
+      kernels::compare(column.reals.data(), countRows, instruction.comparison, asDouble(constant), dst);
+  }
+  for(size_t row{}; row < countRows; ++row)
+    dst[row] = dst[row] ? c_byteTrue : c_byteFalse;
+
+  // Non-numeric values are not handled by the kernels.
+  if(column.countNulls || column.countOthers)
+  {
+    const auto & values = batch.values[instruction.left.index];
+    for(size_t row{}; row < countRows; ++row)
+    {
+      switch(column.kinds[row])
+      {
+        case NumericColumn::Kind::Null:
+          dst[row] = c_byteUnknown;
+          break;
+        case NumericColumn::Kind::Other:
+          dst[row] = compare(*values[row], constant, instruction.comparison);
+          if(secondConstant)
+            dst[row] = std::min(dst[row], compare(*values[row], *secondConstant, instruction.secondComparison->first));
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
+
+void FilterProgram::runInNumericSet(const Batch& batch, const Instruction& instruction, uint8_t* dst) const
+{
+  const size_t countRows = batch.countRows;
+  const NumericColumn& column = numericColumn(batch, instruction.left.index);
+  const NumericSet& set = m_numericSets[instruction.index];
+
+  if(column.countReals == 0 && !set.integers.empty())
+    kernels::inSet(column.integers.data(), countRows, set.integers, dst);
+  else
+    kernels::inSet(column.reals.data(), countRows, set.reals, dst);
+
+  const uint8_t inSet = instruction.negate ? c_byteFalse : c_byteTrue;
+  const uint8_t notInSet = instruction.negate ? c_byteTrue : c_byteFalse;
+  for(size_t row{}; row < countRows; ++row)
+    dst[row] = dst[row] ? inSet : notInSet;
+
+  // Non-numeric values are not handled by the kernels.
+  if(column.countNulls || column.countOthers)
+  {
+    for(size_t row{}; row < countRows; ++row)
+    {
+      switch(column.kinds[row])
+      {
+        case NumericColumn::Kind::Null:
+          dst[row] = c_byteUnknown;
+          break;
+        case NumericColumn::Kind::Other:
+          dst[row] = notInSet;
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
+
+void FilterProgram::run(const Batch& batch, std::vector<size_t>& selection) const
+{
+  const size_t countRows = batch.countRows;
+  m_registers.resize(m_instructions.size());
+  // Value columns are decoded lazily, at most once per batch.
+  m_numericColumns.resize(m_valueColumns.size());
+  for(auto & column : m_numericColumns)
+    column.decoded = false;
+
+  for(size_t i{}, sz = m_instructions.size(); i < sz; ++i)
+  {
+    const Instruction& instruction = m_instructions[i];
+    std::vector<uint8_t>& reg = m_registers[i];
+    reg.resize(countRows);
+    uint8_t * const dst = reg.data();
+
+    switch(instruction.opCode)
+    {
+      case OpCode::Constant:
+        std::fill(dst, dst + countRows, toByte(instruction.evaluation));
+        break;
+
+      case OpCode::Compare:
+        for(size_t row{}; row < countRows; ++row)
+          dst[row] = compare(operandValue(batch, instruction.left, row),
+                             operandValue(batch, instruction.right, row),
+                             instruction.comparison);
+        break;
+
+      case OpCode::CompareNumeric:
+        runCompareNumeric(batch, instruction, dst);
+        break;
+
+      case OpCode::InNumericSet:
+        runInNumericSet(batch, instruction, dst);
+        break;
+
+      case OpCode::InList:
+      {
+        const auto & list = m_lists[instruction.index];
+        for(size_t row{}; row < countRows; ++row)
+        {
+          const Value & v = operandValue(batch, instruction.left, row);
+          if(std::holds_alternative<Nothing>(v))
+            dst[row] = c_byteUnknown;
+          else
+            dst[row] = (contains(list, v) != instruction.negate) ? c_byteTrue : c_byteFalse;
+        }
+        break;
+      }
+
+      case OpCode::LabelsConstraint:
+      {
+        const auto & types = batch.types[instruction.index];
+        const size_t countTypes = instruction.types.size();
+        for(size_t row{}; row < countRows; ++row)
+        {
+          const size_t type = types[row];
+          dst[row] = (type < countTypes && instruction.types[type]) ? c_byteTrue : c_byteFalse;
+        }
+        break;
+      }
+
+      case OpCode::Not:
+      {
+        const uint8_t * const src = m_registers[instruction.reg1].data();
+        for(size_t row{}; row < countRows; ++row)
+          dst[row] = c_byteTrue - src[row];
+        break;
+      }
+
+      case OpCode::And:
+      {
+        const uint8_t * const src1 = m_registers[instruction.reg1].data();
+        const uint8_t * const src2 = m_registers[instruction.reg2].data();
+        for(size_t row{}; row < countRows; ++row)
+          dst[row] = std::min(src1[row], src2[row]);
+        break;
+      }
+
+      case OpCode::Or:
+      {
+        const uint8_t * const src1 = m_registers[instruction.reg1].data();
+        const uint8_t * const src2 = m_registers[instruction.reg2].data();
+        for(size_t row{}; row < countRows; ++row)
+          dst[row] = std::max(src1[row], src2[row]);
+        break;
+      }
+    }
+  }
+
+  // In a WHERE clause, rows for which the filter evaluates to NULL are discarded.
+  selection.clear();
+  kernels::appendSelection(m_registers[m_resultRegister].data(), countRows, c_byteTrue, selection);
+}
+
+
+unsigned Expression::compile(FilterProgram& program) const
+{
+  throw std::logic_error("[Not supported] The expression cannot be evaluated as a predicate.");
+}
+
+FilterOperand Expression::compileOperand(FilterProgram& program) const
+{
+  throw std::logic_error("[Not supported] The expression cannot be evaluated as a value.");
+}
+
+FilterOperand Literal::compileOperand(FilterProgram& program) const
+{
+  if(const auto * value = std::get_if<std::shared_ptr<Value>>(&m_variant))
+    return program.addConstant(copy(**value));
+  throw std::logic_error("[Not supported] A list literal cannot be evaluated as a value.");
+}
+
+FilterOperand QueryColumn::compileOperand(FilterProgram& program) const
+{
+  return program.addValueColumn(m_name);
+}
+
+unsigned Null::compile(FilterProgram& program) const
+{
+  return program.addConstant(Evaluation::Unknown);
+}
+
+FilterOperand Null::compileOperand(FilterProgram& program) const
+{
+  return program.addConstant(Value{Nothing{}});
+}
+
+unsigned True::compile(FilterProgram& program) const
+{
+  return program.addConstant(Evaluation::True);
+}
+
+unsigned False::compile(FilterProgram& program) const
+{
+  return program.addConstant(Evaluation::False);
+}
+
+unsigned Not::compile(FilterProgram& program) const
+{
+  return program.addNot(m_expr->compile(program));
+}
+
+unsigned ElementLabelsConstraints::compile(FilterProgram& program) const
+{
+  return program.addLabelsConstraint(m_typeIndexQueryColumn, m_typeConstraintsANDed);
+}
+
+unsigned ComparisonExpression::compile(FilterProgram& program) const
+{
+  const FilterOperand left = m_left->compileOperand(program);
+  const FilterOperand right = m_right->compileOperand(program);
+  return program.addComparison(m_comp, left, right);
+}
+
+unsigned StringListNullPredicateExpression::compile(FilterProgram& program) const
+{
+  const FilterOperand left = m_left->compileOperand(program);
+  // The constructor verified that the right expression is a list literal.
+  const auto & list = std::get<HomogeneousNonNullableValues>(static_cast<const Literal&>(*m_right).getVariant());
+  return program.addInList(left, list, m_negate);
+}
+
+unsigned AggregateExpression::compile(FilterProgram& program) const
+{
+  if(m_subExprs.empty())
+    throw std::logic_error("[Unexpected] An aggregate expression has no sub-expression.");
+  unsigned reg = m_subExprs[0]->compile(program);
+  for(size_t i{1}, sz = m_subExprs.size(); i < sz; ++i)
+    reg = program.addAggregation(m_aggregator, reg, m_subExprs[i]->compile(program));
+  return reg;
+}
+
+} // NS
@@ -0,0 +1,184 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include "SqlAST.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace sql
+{
+
+// An operand of a comparison in a FilterProgram.
+struct FilterOperand
+{
+  enum class Kind
+  {
+    Column,
+    Constant
+  };
+  Kind kind;
+  // The index of the value column or of the constant.
+  unsigned index;
+};
+
+// A filter expression compiled into a flat sequence of instructions,
+// that is evaluated natively (i.e without SQLite) on batches of rows.
+//
+// Each instruction is applied to all rows of the batch before the next instruction is executed,
+// and writes its evaluations (using SQL three-valued logic) to its own register.
+//
+// Comparisons of a value column with a numeric constant, and numeric IN lists, are evaluated by the
+// SIMD kernels of FilterKernels.h, on the values of the column decoded into contiguous arrays.
+//
+// The columns used by the program are the QueryColumn and the ElementLabelsConstraints type columns
+// of the compiled expression tree:
+// - value columns contain property values,
+// - type columns contain element type indices.
+class FilterProgram
+{
+public:
+  explicit FilterProgram(const Expression& expr);
+
+  // indexed by value column index.
+  const std::vector<QueryColumnName>& valueColumns() const { return m_valueColumns; }
+  // indexed by type column index.
+  const std::vector<QueryColumnName>& typeColumns() const { return m_typeColumns; }
+
+  struct Batch
+  {
+    size_t countRows{};
+    // indexed by value column index, then by row.
+    std::vector<std::vector<const Value*>> values;
+    // indexed by type column index, then by row.
+    std::vector<std::vector<size_t>> types;
+  };
+
+  // |selection| contains the rows of the batch for which the filter evaluates to TRUE, in increasing order.
+  void run(const Batch& batch, std::vector<size_t>& selection) const;
+
+  // The functions below are used by sql::Expression::compile and sql::Expression::compileOperand.
+  // The functions returning an 'unsigned' return the register containing the evaluations of the added instruction.
+
+  FilterOperand addValueColumn(const QueryColumnName& column);
+  FilterOperand addConstant(Value&& value);
+  unsigned addConstant(Evaluation e);
+  unsigned addComparison(Comparison comp, const FilterOperand& left, const FilterOperand& right);
+  unsigned addInList(const FilterOperand& operand, const HomogeneousNonNullableValues& list, bool negate);
+  unsigned addLabelsConstraint(const QueryColumnName& typeColumn, const std::set<ElementTypeIndex>& types);
+  unsigned addNot(unsigned reg);
+  unsigned addAggregation(Aggregator a, unsigned reg1, unsigned reg2);
+
+private:
+  enum class OpCode
+  {
+    Constant,
+    Compare,
+    CompareNumeric,
+    InList,
+    InNumericSet,
+    LabelsConstraint,
+    Not,
+    And,
+    Or
+  };
+
+  struct Instruction
+  {
+    OpCode opCode;
+    // Constant
+    Evaluation evaluation{};
+    // Compare, CompareNumeric
+    Comparison comparison{};
+    // Compare, CompareNumeric, InList, InNumericSet
+    // (CompareNumeric, InNumericSet: 'left' is a column operand and 'right' is a numeric constant operand)
+    FilterOperand left{};
+    FilterOperand right{};
+    // CompareNumeric: when the instruction evaluates a range, 'comparison' is the lower bound (GT or GE)
+    // and this is the upper bound (LT or LE) of the range.
+    std::optional<std::pair<Comparison, FilterOperand>> secondComparison;
+    // InList: the index of the list. InNumericSet: the index of the numeric set. LabelsConstraint: the index of the type column.
+    unsigned index{};
+    // InList, InNumericSet
+    bool negate{};
+    // LabelsConstraint: indexed by type index.
+    std::vector<bool> types;
+    // Not, And, Or
+    unsigned reg1{};
+    unsigned reg2{};
+  };
+
+  // The elements of a numeric IN list, sorted.
+  struct NumericSet
+  {
+    // Empty if the list contains doubles.
+    std::vector<int64_t> integers;
+    // The elements of the list, converted to doubles if they are integers.
+    std::vector<double> reals;
+  };
+
+  // The values of a value column of the batch, decoded for the numeric kernels.
+  struct NumericColumn
+  {
+    enum class Kind : uint8_t
+    {
+      Integer,
+      Real,
+      Null,
+      // A text or a blob.
+      Other
+    };
+    bool decoded{};
+    // indexed by row.
+    std::vector<Kind> kinds;
+    // indexed by row. Contains 0 for non-integer values.
+    std::vector<int64_t> integers;
+    // indexed by row. Contains the numeric values, converted to doubles if they are integers, and 0 for non-numeric values.
+    std::vector<double> reals;
+    size_t countReals{};
+    size_t countNulls{};
+    size_t countOthers{};
+  };
+
+  unsigned add(Instruction&& instruction);
+
+  const Value& operandValue(const Batch& batch, const FilterOperand& operand, size_t row) const;
+
+  const NumericColumn& numericColumn(const Batch& batch, unsigned column) const;
+
+  void runCompareNumeric(const Batch& batch, const Instruction& instruction, uint8_t* dst) const;
+  void runInNumericSet(const Batch& batch, const Instruction& instruction, uint8_t* dst) const;
+
+  std::vector<QueryColumnName> m_valueColumns;
+  std::vector<QueryColumnName> m_typeColumns;
+  std::vector<Value> m_constants;
+  std::vector<HomogeneousNonNullableValues> m_lists;
+  std::vector<NumericSet> m_numericSets;
+
+  // The register of instruction i is i.
+  std::vector<Instruction> m_instructions;
+  unsigned m_resultRegister{};
+
+  // indexed by register, then by row. Reused across runs to minimize allocations.
+  mutable std::vector<std::vector<uint8_t>> m_registers;
+  // indexed by value column index. Reused across runs to minimize allocations.
+  mutable std::vector<NumericColumn> m_numericColumns;
+};
+
+}
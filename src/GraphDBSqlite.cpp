@@ -17,6 +17,7 @@
 #include "GraphDBSqlite.h"
 #include "Logs.h"
 #include "SqlAST.h"
+#include "FilterProgram.h"
 
 
 #include <iostream>
@@ -72,6 +73,75 @@ T cloneIfNeeded(T const & a){
   return a.clone();
 }
 
+// A node visited by one side of a bidirectional breadth-first search.
+template<typename ID>
+struct VisitedNode
+{
+  // The count of relationships from the origin of the search.
+  size_t depth{};
+  // The relationships and nodes of the previous depth this node is reached from. Empty for the origin of the search.
+  std::vector<std::pair<ID, ID>> previous;
+};
+
+// Calls |f| with each path from |node| to the origin of the search that visited |visited|,
+// as the ids of its nodes and relationships (starting with |node|).
+template<typename ID, typename F>
+void forEachPathToOrigin(const std::unordered_map<ID, VisitedNode<ID>>& visited,
+                         const ID& node,
+                         std::vector<ID>& path,
+                         const F& f)
+{
+  path.push_back(cloneIfNeeded(node));
+  const auto & previous = visited.at(node).previous;
+  if(previous.empty())
+    f(path);
+  for(const auto & [relationship, previousNode] : previous)
+  {
+    path.push_back(cloneIfNeeded(relationship));
+    forEachPathToOrigin(visited, previousNode, path, f);
+    path.pop_back();
+  }
+  path.pop_back();
+}
+
+// Returns false when the relationships at indices |i| and |j| of a path pattern cannot be the same relationship:
+// when their types are disjoint, or when the types of the nodes they would have in common are disjoint.
+//
+// |typeFilters| is parallel to the path pattern, |traversalDirections| is parallel to its relationships.
+bool maybeSameRelationship(const std::vector<openCypher::TraversalDirection>& traversalDirections,
+                           const std::vector<std::optional<std::set<sql::ElementTypeIndex>>>& typeFilters,
+                           const size_t i,
+                           const size_t j)
+{
+  const auto disjointTypes = [&](const size_t a, const size_t b)
+  {
+    const auto & typesA = typeFilters[a];
+    const auto & typesB = typeFilters[b];
+    if(!typesA.has_value() || !typesB.has_value())
+      return false;
+    return std::none_of(typesA->begin(), typesA->end(), [&](const sql::ElementTypeIndex type) { return typesB->count(type) > 0; });
+  };
+  if(disjointTypes(i, j))
+    return false;
+  // The pattern indices of the origin and destination nodes of the relationship at |r|,
+  // for both orientations with TraversalDirection::Any.
+  const auto endpoints = [&](const size_t r)
+  {
+    std::vector<std::pair<size_t, size_t>> res;
+    const auto direction = traversalDirections[(r - 1) / 2];
+    if(direction != openCypher::TraversalDirection::Backward)
+      res.emplace_back(r - 1, r + 1);
+    if(direction != openCypher::TraversalDirection::Forward)
+      res.emplace_back(r + 1, r - 1);
+    return res;
+  };
+  for(const auto & [originI, destinationI] : endpoints(i))
+    for(const auto & [originJ, destinationJ] : endpoints(j))
+      if(!disjointTypes(originI, originJ) && !disjointTypes(destinationI, destinationJ))
+        return true;
+  return false;
+}
+
 const char * valueTypeToSQLliteTypeAffinity(ValueType t)
 {
   switch(t)
@@ -243,6 +313,20 @@ void toSQLQueryStringValue(const Value & value, std::ostream& os)
   }, value);
 }
 
+// Returns a SQL expression evaluating to |value|, which is bound as a query variable.
+std::string mkBoundValue(const Value& value, sql::QueryVars& vars)
+{
+  return vars.addVar(value);
+}
+
+// Encodes the returned values of a row, to remove duplicate rows using a hash set of the encoded rows.
+void encodeRow(const ResultOrder& resultOrder, const VecValues& vecValues, std::string& key)
+{
+  key.clear();
+  for(const auto & [i, j] : resultOrder)
+    appendEncoded((*vecValues[i])[j], key);
+}
+
 }  // NS
 
 template<typename ID>
@@ -250,7 +334,8 @@ GraphDB<ID>::GraphDB(const FuncOnSQLQuery& fOnSQLQuery,
                      const FuncOnSQLQueryDuration& fOnSQLQueryDuration,
                      const FuncOnDBDiagnosticContent& fOnDiagnostic,
                      const std::optional<std::filesystem::path>& dbPath,
-                     const std::optional<Overwrite> overwrite)
+                     const std::optional<Overwrite> overwrite,
+                     const std::optional<IDAllocation> idAllocation)
 : m_fOnSQLQuery(fOnSQLQuery)
 , m_fOnSQLQueryDuration(fOnSQLQueryDuration)
 , m_fOnDiagnostic(fOnDiagnostic)
@@ -297,8 +382,22 @@ GraphDB<ID>::GraphDB(const FuncOnSQLQuery& fOnSQLQuery,
 
 #endif  // GRAPHDBSQLITE_STATICALLY_LINK_CARRAY_EXTENSION
 
+  // Lists of integers passed as IDSet are read via the idset virtual table.
+  if(auto res = sqlite3_idset_init(m_db))
+    throw std::logic_error(sqlite3_errstr(res));
+  if(auto res = sqlite3_neighbors_init(m_db, &m_adjacencyIndex))
+    throw std::logic_error(sqlite3_errstr(res));
+
+  if constexpr (!std::is_same_v<ID, int64_t>)
+  {
+    if(idAllocation == IDAllocation::TypePartitioned)
+      throw std::invalid_argument("IDAllocation::TypePartitioned is only supported for int64_t ids.");
+  }
+
   if(reinitDB)
   {
+    m_idAllocation = idAllocation.value_or(IDAllocation::Sequential);
+    const bool typePartitionedIDs = m_idAllocation == IDAllocation::TypePartitioned;
     {
       LogIndentScope _ = logScope(std::cout, "Creating Nodes System table...");
       // This table avoids having to lookup into all nodes tables when looking for an entity
@@ -316,6 +415,8 @@ GraphDB<ID>::GraphDB(const FuncOnSQLQuery& fOnSQLQuery,
           s << m_idProperty.name << " ";
           s << valueTypeToSQLliteTypeAffinity(m_idProperty.type) << " NOT NULL PRIMARY KEY, ";
           s << "NodeType INTEGER";
+          if(typePartitionedIDs)
+            s << ", " << mkTypePartitionedIDCheck("NodeType");
         }
         s << ");";
         if(auto res = sqlite3_exec(s.str(), 0, 0, 0))
@@ -348,6 +449,8 @@ GraphDB<ID>::GraphDB(const FuncOnSQLQuery& fOnSQLQuery,
           s << valueTypeToSQLliteTypeAffinity(m_idProperty.type) << " NOT NULL, ";
           s << "DestinationID ";
           s << valueTypeToSQLliteTypeAffinity(m_idProperty.type) << " NOT NULL";
+          if(typePartitionedIDs)
+            s << ", " << mkTypePartitionedIDCheck("RelationshipType");
         }
         s << ");";
         if(auto res = sqlite3_exec(s.str(), 0, 0, 0))
@@ -385,12 +488,23 @@ GraphDB<ID>::GraphDB(const FuncOnSQLQuery& fOnSQLQuery,
       {
         s << "TypeIdx INTEGER NOT NULL PRIMARY KEY, ";
         s << "Kind INTEGER NOT NULL, ";
-        s << "NamedType TEXT NOT NULL";
+        s << "NamedType TEXT NOT NULL, ";
+        s << "CountElements INTEGER NOT NULL DEFAULT 0";
       }
       s << ");";
       if(auto res = sqlite3_exec(s.str(), 0, 0, 0))
         throw std::logic_error(sqlite3_errstr(res));
     }
+    createCountElementsTriggers();
+    {
+      LogIndentScope _ = logScope(std::cout, "Creating Node Degrees System table...");
+      {
+        const std::string req = "DROP TABLE nodeDegrees;";
+        // ignore error
+        auto res = sqlite3_exec(req, 0, 0, 0);
+      }
+      createNodeDegreesTable();
+    }
   }
   else
   {
@@ -428,6 +542,101 @@ GraphDB<ID>::GraphDB(const FuncOnSQLQuery& fOnSQLQuery,
         throw std::invalid_argument("ID type mismatch, expected " + toStr(m_idProperty.type) + " but have " + toStr(data.inferredIDPropertySchema->type));
     }
 
+    // Infer the id allocation scheme from the CHECK constraint of the nodes table.
+    {
+      std::optional<std::string> nodesTableSQL;
+      if(auto res = sqlite3_exec("SELECT sql FROM sqlite_master WHERE type='table' AND name='nodes'", [](void *p_nodesTableSQL, int argc, Value *argv, char **column) {
+        auto & nodesTableSQL = *static_cast<std::optional<std::string>*>(p_nodesTableSQL);
+        nodesTableSQL = std::get<StringPtr>(argv[0]).string.get();
+        return 0;
+      }, &nodesTableSQL, 0))
+        throw std::logic_error(sqlite3_errstr(res));
+      if(!nodesTableSQL.has_value())
+        throw std::invalid_argument("Could not find the nodes table.");
+      const bool typePartitionedIDs = nodesTableSQL->find(mkTypePartitionedIDCheck("NodeType")) != std::string::npos;
+      m_idAllocation = typePartitionedIDs ? IDAllocation::TypePartitioned : IDAllocation::Sequential;
+      if(idAllocation.has_value() && (*idAllocation != m_idAllocation))
+        throw std::invalid_argument("ID allocation mismatch, the DB was created with a different id allocation scheme.");
+    }
+
+    // Infer the inline properties from the extra columns of the system tables.
+    for(const auto elem : {Element::Node, Element::Relationship})
+    {
+      struct Data
+      {
+        std::set<std::string> systemColumns;
+        std::set<PropertySchema>& inlineProperties;
+      } data{
+        (elem == Element::Node) ?
+        std::set<std::string>{m_idProperty.name.symbolicName.str, "NodeType"} :
+        std::set<std::string>{m_idProperty.name.symbolicName.str, "RelationshipType", "OriginID", "DestinationID"},
+        (elem == Element::Node) ? m_inlineNodeProperties : m_inlineRelationshipProperties
+      };
+      std::ostringstream s;
+      s << "PRAGMA table_info('" << systemTableName(elem) << "')";
+      if(auto res = sqlite3_exec(s.str(), [](void *p_Data, int argc, Value *argv, char **column) {
+        auto & data = *static_cast<Data*>(p_Data);
+        const std::string columnName = std::get<StringPtr>(argv[1]).string.get();
+        if(data.systemColumns.count(columnName))
+          return 0;
+        const char * sqliteType = std::get<StringPtr>(argv[2]).string.get();
+        data.inlineProperties.insert(PropertySchema{
+          openCypher::mkProperty(columnName),
+          SQLiteTypeToValueType(sqliteType)
+        });
+        return 0;
+      }, &data, 0))
+        throw std::logic_error(sqlite3_errstr(res));
+    }
+
+    // DBs created before the counts of elements were maintained don't have the CountElements column.
+    {
+      bool hasCountElements{};
+      if(auto res = sqlite3_exec("PRAGMA table_info('namedTypes')", [](void *p_hasCountElements, int argc, Value *argv, char **column) {
+        auto & hasCountElements = *static_cast<bool*>(p_hasCountElements);
+        if(std::string{"CountElements"} == std::get<StringPtr>(argv[1]).string.get())
+          hasCountElements = true;
+        return 0;
+      }, &hasCountElements, 0))
+        throw std::logic_error(sqlite3_errstr(res));
+      if(!hasCountElements)
+      {
+        LogIndentScope _ = logScope(std::cout, "Counting elements by type...");
+        for(const auto & req : {
+          std::string{"ALTER TABLE namedTypes ADD COLUMN CountElements INTEGER NOT NULL DEFAULT 0"},
+          std::string{"UPDATE namedTypes SET CountElements = (SELECT COUNT(*) FROM nodes WHERE NodeType = TypeIdx) WHERE Kind = 'E'"},
+          std::string{"UPDATE namedTypes SET CountElements = (SELECT COUNT(*) FROM relationships WHERE RelationshipType = TypeIdx) WHERE Kind = 'R'"}
+        })
+          if(auto res = sqlite3_exec(req, 0, 0, 0))
+            throw std::logic_error(sqlite3_errstr(res));
+        createCountElementsTriggers();
+      }
+    }
+
+    // DBs created before the degrees of nodes were maintained don't have the nodeDegrees table.
+    {
+      bool hasNodeDegrees{};
+      if(auto res = sqlite3_exec("SELECT name FROM sqlite_master WHERE type='table' AND name='nodeDegrees'", [](void *p_hasNodeDegrees, int argc, Value *argv, char **column) {
+        *static_cast<bool*>(p_hasNodeDegrees) = true;
+        return 0;
+      }, &hasNodeDegrees, 0))
+        throw std::logic_error(sqlite3_errstr(res));
+      if(!hasNodeDegrees)
+      {
+        LogIndentScope _ = logScope(std::cout, "Counting degrees of nodes...");
+        createNodeDegreesTable();
+        const std::string req =
+        "INSERT INTO nodeDegrees (NodeID, RelationshipType, OutDegree, InDegree)"
+        " SELECT NodeID, RelationshipType, SUM(OutDegree), SUM(InDegree) FROM ("
+        "SELECT OriginID AS NodeID, RelationshipType, 1 AS OutDegree, 0 AS InDegree FROM relationships"
+        " UNION ALL "
+        "SELECT DestinationID AS NodeID, RelationshipType, 0 AS OutDegree, 1 AS InDegree FROM relationships"
+        ") GROUP BY NodeID, RelationshipType";
+        if(auto res = sqlite3_exec(req, 0, 0, 0))
+          throw std::logic_error(sqlite3_errstr(res));
+      }
+    }
+
     const char* msg{};
     if(auto res = sqlite3_exec("SELECT NamedType, Kind, TypeIdx FROM namedTypes;", [](void *p_This, int argc, Value *argv, char **column) {
       auto & This = *static_cast<GraphDB*>(p_This);
@@ -523,6 +732,64 @@ GraphDB<ID>::GraphDB(const FuncOnSQLQuery& fOnSQLQuery,
         return 0;
       }, &set, 0))
         throw std::logic_error(sqlite3_errstr(res));
+
+      // Infer the secondary indices.
+      struct IndexListItem{
+        std::string name;
+        bool unique;
+        bool partial;
+      };
+      std::vector<IndexListItem> indexList;
+      std::ostringstream sIndexList;
+      sIndexList << "PRAGMA index_list('" << typeName << "')";
+      if(auto res = sqlite3_exec(sIndexList.str(), [](void *p_IndexList, int argc, Value *argv, char **column) {
+        auto & indexList = *static_cast<std::vector<IndexListItem>*>(p_IndexList);
+        const std::string origin = std::get<StringPtr>(argv[3]).string.get();
+        // Skip indices that were not created by a CREATE INDEX statement.
+        if(origin != "c")
+          return 0;
+        indexList.push_back(IndexListItem{
+          std::get<StringPtr>(argv[1]).string.get(),
+          std::get<int64_t>(argv[2]) != 0,
+          std::get<int64_t>(argv[4]) != 0
+        });
+        return 0;
+      }, &indexList, 0))
+        throw std::logic_error(sqlite3_errstr(res));
+
+      auto & indices = m_indices[typeName];
+      for(const auto & item : indexList)
+      {
+        auto & namedIndex = indices.emplace_back(NamedPropertyIndex{
+          item.name,
+          PropertyIndex{{}, item.unique ? IndexKind::Unique : IndexKind::BTree, std::nullopt}
+        });
+        std::ostringstream sIndexInfo;
+        sIndexInfo << "PRAGMA index_info('" << item.name << "')";
+        if(auto res = sqlite3_exec(sIndexInfo.str(), [](void *p_Properties, int argc, Value *argv, char **column) {
+          auto & properties = *static_cast<std::vector<openCypher::PropertyKeyName>*>(p_Properties);
+          properties.push_back(openCypher::mkProperty(std::get<StringPtr>(argv[2]).string.get()));
+          return 0;
+        }, &namedIndex.index.properties, 0))
+          throw std::logic_error(sqlite3_errstr(res));
+        if(item.partial)
+        {
+          std::optional<std::string> indexSQL;
+          std::ostringstream sIndexSQL;
+          sIndexSQL << "SELECT sql FROM sqlite_master WHERE type='index' AND name='" << item.name << "'";
+          if(auto res = sqlite3_exec(sIndexSQL.str(), [](void *p_indexSQL, int argc, Value *argv, char **column) {
+            auto & indexSQL = *static_cast<std::optional<std::string>*>(p_indexSQL);
+            indexSQL = std::get<StringPtr>(argv[0]).string.get();
+            return 0;
+          }, &indexSQL, 0))
+            throw std::logic_error(sqlite3_errstr(res));
+          const std::string whereKeyword{") WHERE "};
+          const auto pos = indexSQL.has_value() ? indexSQL->find(whereKeyword) : std::string::npos;
+          if(pos == std::string::npos)
+            throw std::logic_error("[Unexpected] Could not find the condition of the partial index " + item.name);
+          namedIndex.index.where = indexSQL->substr(pos + whereKeyword.size());
+        }
+      }
     }
   }
 }
@@ -530,17 +797,104 @@ GraphDB<ID>::GraphDB(const FuncOnSQLQuery& fOnSQLQuery,
 template<typename ID>
 GraphDB<ID>::~GraphDB()
 {
+  m_cachedQueryStatements.clear();
   sqlite3_close(m_db);
 }
 
 template<typename ID>
-void GraphDB<ID>::addType(const std::string &typeName, bool isNode, const std::vector<PropertySchema> &properties)
+void GraphDB<ID>::createCountElementsTriggers()
+{
+  // The counts are updated by the statement inserting the element in the system table,
+  // so they are always consistent with the system tables, even when a transaction is rolled back.
+  for(const auto elem : {Element::Node, Element::Relationship})
+  {
+    const bool isNode = elem == Element::Node;
+    std::ostringstream s;
+    s << "CREATE TRIGGER " << (isNode ? "CountNodesTrigger" : "CountRelationshipsTrigger")
+    << " AFTER INSERT ON " << systemTableName(elem)
+    << " BEGIN UPDATE namedTypes SET CountElements = CountElements + 1 WHERE TypeIdx = NEW." << (isNode ? "NodeType" : "RelationshipType") << "; END;";
+    if(auto res = sqlite3_exec(s.str(), 0, 0, 0))
+      throw std::logic_error(sqlite3_errstr(res));
+  }
+}
+
+template<typename ID>
+void GraphDB<ID>::createNodeDegreesTable()
+{
+  // The degrees are stored by node and relationship type in a table without rowid
+  // so that the degrees of a node are read with a single lookup in the primary key.
+  {
+    std::ostringstream s;
+    s << "CREATE TABLE nodeDegrees (";
+    s << "NodeID " << valueTypeToSQLliteTypeAffinity(m_idProperty.type) << " NOT NULL, ";
+    s << "RelationshipType INTEGER NOT NULL, ";
+    s << "OutDegree INTEGER NOT NULL DEFAULT 0, ";
+    s << "InDegree INTEGER NOT NULL DEFAULT 0, ";
+    s << "PRIMARY KEY (NodeID, RelationshipType)";
+    s << ") WITHOUT ROWID;";
+    if(auto res = sqlite3_exec(s.str(), 0, 0, 0))
+      throw std::logic_error(sqlite3_errstr(res));
+  }
+  {
+    // Like the counts of elements, the degrees are updated by the statement inserting the relationship.
+    const std::string req =
+    "CREATE TRIGGER CountDegreesTrigger AFTER INSERT ON relationships BEGIN"
+    " INSERT INTO nodeDegrees (NodeID, RelationshipType, OutDegree) VALUES (NEW.OriginID, NEW.RelationshipType, 1)"
+    " ON CONFLICT (NodeID, RelationshipType) DO UPDATE SET OutDegree = OutDegree + 1;"
+    " INSERT INTO nodeDegrees (NodeID, RelationshipType, InDegree) VALUES (NEW.DestinationID, NEW.RelationshipType, 1)"
+    " ON CONFLICT (NodeID, RelationshipType) DO UPDATE SET InDegree = InDegree + 1;"
+    " END;";
+    if(auto res = sqlite3_exec(req, 0, 0, 0))
+      throw std::logic_error(sqlite3_errstr(res));
+  }
+}
+
+template<typename ID>
+int64_t GraphDB<ID>::countElements(const Element elem, const openCypher::Labels& labels) const
+{
+  const auto & indexedTypes = (elem == Element::Node) ? m_indexedNodeTypes : m_indexedRelationshipTypes;
+  std::ostringstream s;
+  bool first = true;
+  for(const auto & label : computeAllowedLabels(elem, labels))
+  {
+    const auto typeIdx = indexedTypes.getIfExists(label);
+    if(!typeIdx.has_value())
+      continue;
+    s << (first ? "SELECT SUM(CountElements) FROM namedTypes WHERE TypeIdx IN (" : ", ") << typeIdx->unsafeGet();
+    first = false;
+  }
+  if(first)
+    // No label exists.
+    return 0;
+  s << ")";
+  int64_t count{};
+  if(auto res = sqlite3_exec(s.str(), [](void *p_count, int argc, Value *argv, char **column) {
+    auto & count = *static_cast<int64_t*>(p_count);
+    count = std::get<int64_t>(argv[0]);
+    return 0;
+  }, &count, 0))
+    throw std::logic_error(sqlite3_errstr(res));
+  return count;
+}
+
+template<typename ID>
+void GraphDB<ID>::addType(const std::string &typeName,
+                          bool isNode,
+                          const std::vector<PropertySchema> &properties,
+                          const std::vector<PropertyIndex> &indices)
 {
   const auto label = openCypher::Label{typeName};
 
   if(auto it = m_properties.find(label); it != m_properties.end())
     throw std::logic_error("CREATE TABLE, type already exists.");
 
+  for(const auto & property : properties)
+  {
+    const auto & inlineProps = inlineProperties(isNode ? Element::Node : Element::Relationship);
+    if(const auto it = inlineProps.find(property); (it != inlineProps.end()) && (it->type != property.type))
+      throw std::logic_error("CREATE TABLE, the type of the property '" + property.name.symbolicName.str + "' doesn't match the type of the inline property.");
+  }
+
   {
     // It is not necessary to cache the prepared statement: types are added very infrequently
     // so we don't need to optimize the query compilation time.
@@ -585,6 +939,8 @@ void GraphDB<ID>::addType(const std::string &typeName, bool isNode, const std::v
       throw std::logic_error(std::string{msg});
     if(typeIdx == std::numeric_limits<size_t>::max())
       throw std::logic_error("no result for typeIdx.");
+    if(m_idAllocation == IDAllocation::TypePartitioned && typeIdx > c_maxPartitionedTypeIndex)
+      throw std::logic_error("Too many types for IDAllocation::TypePartitioned.");
     if(isNode)
       m_indexedNodeTypes.add(typeIdx, label);
     else
@@ -594,9 +950,274 @@ void GraphDB<ID>::addType(const std::string &typeName, bool isNode, const std::v
       set.insert(propertyName);
     set.insert(m_idProperty);
   }
+  for(const auto & index : indices)
+    addIndex(typeName, index);
   // todo use a transaction, rollback if there is an error.
 }
 
+template<typename ID>
+void GraphDB<ID>::addInlineProperty(const Element elem, const PropertySchema& property)
+{
+  const bool isNode = elem == Element::Node;
+  const char* tableName = systemTableName(elem);
+  const std::string& name = property.name.symbolicName.str;
+
+  if(isSystemProperty(elem, property.name) ||
+     (name == (isNode ? "NodeType" : "RelationshipType")) ||
+     (!isNode && ((name == "OriginID") || (name == "DestinationID"))))
+    throw std::logic_error("ALTER TABLE, '" + name + "' is already a column of the " + tableName + " system table.");
+
+  // The types having this property
+  std::vector<std::pair<openCypher::Label, size_t>> types;
+  for(const auto & [label, typeIdx] : (isNode ? m_indexedNodeTypes : m_indexedRelationshipTypes).getTypeToIndex())
+  {
+    const auto & properties = m_properties[label];
+    const auto it = properties.find(property);
+    if(it == properties.end())
+      continue;
+    if(it->type != property.type)
+      throw std::logic_error("ALTER TABLE, the property '" + name + "' of the type '" + label.symbolicName.str + "' has a different value type.");
+    types.emplace_back(label, typeIdx.unsafeGet());
+  }
+
+  {
+    std::ostringstream s;
+    s << "ALTER TABLE " << tableName << " ADD COLUMN " << property.name << " " << valueTypeToSQLliteTypeAffinity(property.type);
+    if(auto res = sqlite3_exec(s.str(), 0, 0, 0))
+      throw std::logic_error(sqlite3_errstr(res));
+  }
+  // Copy the values of existing elements.
+  for(const auto & [label, typeIdx] : types)
+  {
+    std::ostringstream s;
+    s << "UPDATE " << tableName << " SET " << property.name << " = "
+    << "(SELECT " << property.name << " FROM " << label << " WHERE " << label << "." << m_idProperty.name << " = " << tableName << "." << m_idProperty.name << ")"
+    << " WHERE " << (isNode ? "NodeType" : "RelationshipType") << " = " << typeIdx;
+    if(auto res = sqlite3_exec(s.str(), 0, 0, 0))
+      throw std::logic_error(sqlite3_errstr(res));
+  }
+
+  (isNode ? m_inlineNodeProperties : m_inlineRelationshipProperties).insert(PropertySchema{property.name, property.type});
+  // The statements setting the inline properties of elements need to be recompiled.
+  m_setInlinePropertiesPreparedStatements.clear();
+}
+
+template<typename ID>
+const char* GraphDB<ID>::systemTableName(const Element elem)
+{
+  return (elem == Element::Node) ? "nodes" : "relationships";
+}
+
+template<typename ID>
+bool GraphDB<ID>::isSystemProperty(const Element elem, const PropertyKeyName& property) const
+{
+  return (property == m_idProperty.name) ||
+  inlineProperties(elem).count(PropertySchema{property}) ||
+  ((elem == Element::Node) && openCypher::isComputedNodeProperty(property));
+}
+
+template<typename ID>
+std::optional<std::string> GraphDB<ID>::computedPropertySQLExpression(const PropertyKeyName& property, const std::string& nodeIDColumn) const
+{
+  if(const auto predicate = openCypher::asPatternPredicate(property))
+    return patternPredicateSQLExpression(*predicate, nodeIDColumn);
+  const auto degree = openCypher::asDegreeFunction(property);
+  if(!degree.has_value())
+    return std::nullopt;
+  std::optional<sql::ElementTypeIndex> typeIdx;
+  if(degree->relationshipType.has_value())
+  {
+    typeIdx = m_indexedRelationshipTypes.getIfExists(*degree->relationshipType);
+    if(!typeIdx.has_value())
+      // No relationship has this type.
+      return "0";
+  }
+  std::ostringstream s;
+  s << "(SELECT COALESCE(SUM(";
+  switch(degree->direction)
+  {
+    case openCypher::DegreeDirection::Outgoing: s << "OutDegree"; break;
+    case openCypher::DegreeDirection::Incoming: s << "InDegree"; break;
+    case openCypher::DegreeDirection::Both: s << "OutDegree + InDegree"; break;
+  }
+  s << "), 0) FROM nodeDegrees WHERE NodeID = " << nodeIDColumn;
+  if(typeIdx.has_value())
+    s << " AND RelationshipType = " << typeIdx->unsafeGet();
+  s << ")";
+  return s.str();
+}
+
+template<typename ID>
+std::string GraphDB<ID>::patternPredicateSQLExpression(const openCypher::PatternPredicate& predicate, const std::string& nodeIDColumn) const
+{
+  const size_t countSteps = predicate.steps.size();
+  std::vector<std::optional<std::set<sql::ElementTypeIndex>>> relationshipTypes, nodeTypes;
+  for(const auto & step : predicate.steps)
+  {
+    relationshipTypes.push_back(computeTypeFilter(Element::Relationship, step.relationshipTypes));
+    nodeTypes.push_back(computeTypeFilter(Element::Node, step.nodeLabels));
+    if((relationshipTypes.back().has_value() && relationshipTypes.back()->empty()) ||
+       (nodeTypes.back().has_value() && nodeTypes.back()->empty()))
+      // No element has these types.
+      return "0";
+  }
+
+  // A step in any direction is the disjunction of a forward step and a backward step,
+  // so that the relationships are always looked up with the index on their origin or on their destination.
+  std::vector<std::vector<TraversalDirection>> directionsAlternatives{{}};
+  for(const auto & step : predicate.steps)
+  {
+    std::vector<std::vector<TraversalDirection>> next;
+    for(const auto & directions : directionsAlternatives)
+      for(const auto direction : {TraversalDirection::Forward, TraversalDirection::Backward})
+        if(step.direction == TraversalDirection::Any || step.direction == direction)
+        {
+          next.push_back(directions);
+          next.back().push_back(direction);
+        }
+    directionsAlternatives = std::move(next);
+  }
+
+  const bool typePartitionedIDs = m_idAllocation == IDAllocation::TypePartitioned;
+  auto relationshipsAlias = [](const size_t k) { return "SYS__EXISTS_R" + std::to_string(k); };
+  auto nodesAlias = [](const size_t k) { return "SYS__EXISTS_N" + std::to_string(k); };
+
+  // The correlated subqueries stop at the first match, so the relationships of the node are not all read.
+  std::ostringstream s;
+  s << "(";
+  bool firstAlternative = true;
+  for(const auto & directions : directionsAlternatives)
+  {
+    if(firstAlternative)
+      firstAlternative = false;
+    else
+      s << " OR ";
+    s << "EXISTS (SELECT 1 FROM ";
+    for(size_t k{}; k<countSteps; ++k)
+    {
+      if(k)
+        s << ", ";
+      s << "relationships AS " << relationshipsAlias(k);
+      if(nodeTypes[k].has_value() && !typePartitionedIDs)
+        s << ", nodes AS " << nodesAlias(k);
+    }
+    std::vector<std::string> constraints;
+    std::string previousNodeIDColumn = nodeIDColumn;
+    for(size_t k{}; k<countSteps; ++k)
+    {
+      const std::string rel = relationshipsAlias(k);
+      const bool forward = directions[k] == TraversalDirection::Forward;
+      constraints.push_back(rel + (forward ? ".OriginID = " : ".DestinationID = ") + previousNodeIDColumn);
+      const std::string nodeIDColumn = rel + (forward ? ".DestinationID" : ".OriginID");
+      if(relationshipTypes[k].has_value())
+        constraints.push_back(mkFilterTypesConstraint(*relationshipTypes[k], sql::QueryColumnName{rel + ".RelationshipType"}));
+      // Like in path patterns, a relationship is traversed at most once.
+      for(size_t j{}; j<k; ++j)
+        constraints.push_back(rel + ".SYS__ID <> " + relationshipsAlias(j) + ".SYS__ID");
+      if(nodeTypes[k].has_value())
+      {
+        if(typePartitionedIDs)
+          constraints.push_back(mkFilterTypesRangeConstraint(*nodeTypes[k], sql::QueryColumnName{nodeIDColumn}));
+        else
+        {
+          constraints.push_back(nodesAlias(k) + ".SYS__ID = " + nodeIDColumn);
+          constraints.push_back(mkFilterTypesConstraint(*nodeTypes[k], sql::QueryColumnName{nodesAlias(k) + ".NodeType"}));
+        }
+      }
+      previousNodeIDColumn = nodeIDColumn;
+    }
+    s << " WHERE";
+    bool firstConstraint = true;
+    for(const auto & constraint : constraints)
+    {
+      if(firstConstraint)
+        firstConstraint = false;
+      else
+        s << " AND";
+      s << " " << constraint;
+    }
+    s << ")";
+  }
+  s << ")";
+  return s.str();
+}
+
+template<typename ID>
+std::set<PropertySchema> GraphDB<ID>::mapComputedProperties(const std::vector<const Expression*>& filters,
+                                                            const Variable& var,
+                                                            const std::string& nodeIDColumn,
+                                                            VarQueryInfo& info) const
+{
+  std::set<PropertySchema> computedProperties;
+  for(const Expression* filter : filters)
+  {
+    const auto usages = filter->varsUsages();
+    const auto it = usages.find(var);
+    if(it == usages.end())
+      continue;
+    for(const auto & property : it->second.properties)
+      if(auto expr = computedPropertySQLExpression(property, nodeIDColumn))
+      {
+        info.cypherPropertyToSQLQueryColumnName[property] = sql::QueryColumnName{std::move(*expr)};
+        computedProperties.insert(PropertySchema{property});
+      }
+  }
+  return computedProperties;
+}
+
+template<typename ID>
+void GraphDB<ID>::addIndex(const std::string &typeName, const PropertyIndex& index)
+{
+  const auto label = openCypher::Label{typeName};
+
+  const auto it = m_properties.find(label);
+  if(it == m_properties.end())
+    throw std::logic_error("CREATE INDEX, the type doesn't exist.");
+  if(index.properties.empty())
+    throw std::logic_error("CREATE INDEX, an index needs at least one property.");
+  for(const auto & property : index.properties)
+    if(!it->second.count(PropertySchema{property}))
+      throw std::logic_error(std::string{"CREATE INDEX, the property '"} + property.symbolicName.str + "' doesn't exist for the type '" + typeName + "'");
+
+  auto & indices = m_indices[label];
+
+  std::string name = typeName;
+  for(const auto & property : index.properties)
+    name += "__" + property.symbolicName.str;
+  name += "__idx";
+  {
+    // There may be several indices on the same properties, with different partial index conditions.
+    const std::string baseName = name;
+    for(size_t i{2}; std::any_of(indices.begin(), indices.end(), [&](const auto & namedIndex){ return namedIndex.name == name; }); ++i)
+      name = baseName + std::to_string(i);
+  }
+
+  std::ostringstream s;
+  s << "CREATE ";
+  if(index.kind == IndexKind::Unique)
+    s << "UNIQUE ";
+  s << "INDEX " << name << " ON " << typeName << " (";
+  {
+    bool first = true;
+    for(const auto & property : index.properties)
+    {
+      if(first)
+        first = false;
+      else
+        s << ", ";
+      s << property;
+    }
+  }
+  s << ")";
+  if(index.where.has_value())
+    s << " WHERE " << *index.where;
+  const char* msg{};
+  if(auto res = sqlite3_exec(s.str(), 0, 0, &msg))
+    throw std::logic_error(msg ? std::string{msg} : std::string{sqlite3_errstr(res)});
+
+  indices.push_back(NamedPropertyIndex{name, index});
+}
+
 template<typename ID>
 void GraphDB<ID>::validatePropertyValues(const openCypher::Label& label,
                                      const std::vector<std::pair<PropertyKeyName, Value>>& propValues) const
@@ -625,9 +1246,11 @@ bool GraphDB<ID>::findValidProperties(const openCypher::Label& typeName,
   auto it = m_properties.find(typeName);
   if(it == m_properties.end())
     return false;
+  // The degrees and pattern predicates are valid properties of all nodes.
+  const bool isNodeType = m_indexedNodeTypes.getIfExists(typeName).has_value();
   valid.reserve(propNames.size());
   for(const auto& name : propNames)
-    valid.push_back(it->second.count(name) > 0);
+    valid.push_back((it->second.count(name) > 0) || (isNodeType && openCypher::isComputedNodeProperty(name)));
   return true;
 }
 
@@ -655,33 +1278,47 @@ ID GraphDB<ID>::addNode(const std::string& typeName,
     throw std::logic_error("unknown node type: " + typeName);
 
   std::optional<ID> nodeId;
-  
+
+  auto addNodeWithID = [&](const Value& value)
+  {
+    runCachedStatement(m_addNodeWithIDPreparedStatement,
+                       [&](SQLBoundVarIndex & var, std::ostringstream& s) {
+      s << "INSERT INTO nodes (" << m_idProperty.name << ", NodeType) Values("
+      << var.nextAsStr() << ", "
+      << var.nextAsStr()
+      <<") RETURNING " << m_idProperty.name;
+    },
+                       [&, valuePtr=&value](SQLBoundVarIndex& var, SQLPreparedStatement& ps) {
+      ps.bindVariable(var.next(), *valuePtr);
+      ps.bindVariable(var.next(), static_cast<int64_t>(typeIdx->unsafeGet()));
+    },
+                       [](void *p_nodeId, int argc, Value *argv, char **column) {
+      auto & nodeId = *static_cast<std::optional<ID>*>(p_nodeId);
+      nodeId = std::move(std::get<ID>(argv[0]));
+      return 0;
+    },
+                       &nodeId);
+  };
+
   for(const auto & [name, value] : propValues)
   {
     if(name == m_idProperty.name)
     {
       // an ID was specified
-      runCachedStatement(m_addNodeWithIDPreparedStatement,
-                         [&](SQLBoundVarIndex & var, std::ostringstream& s) {
-        s << "INSERT INTO nodes (" << m_idProperty.name << ", NodeType) Values("
-        << var.nextAsStr() << ", "
-        << var.nextAsStr()
-        <<") RETURNING " << m_idProperty.name;
-      },
-                         [&, valuePtr=&value](SQLBoundVarIndex& var, SQLPreparedStatement& ps) {
-        ps.bindVariable(var.next(), *valuePtr);
-        ps.bindVariable(var.next(), static_cast<int64_t>(typeIdx->unsafeGet()));
-      },
-                         [](void *p_nodeId, int argc, Value *argv, char **column) {
-        auto & nodeId = *static_cast<std::optional<ID>*>(p_nodeId);
-        nodeId = std::move(std::get<ID>(argv[0]));
-        return 0;
-      },
-                         &nodeId);
+      if(m_idAllocation == IDAllocation::TypePartitioned)
+        onExplicitPartitionedID(value, *typeIdx);
+      addNodeWithID(value);
       goto idDone;
     }
   }
 
+  if(m_idAllocation == IDAllocation::TypePartitioned)
+  {
+    // no ID was specified, the ID is allocated in the range of the node type.
+    addNodeWithID(Value{allocatePartitionedID(Element::Node, *typeIdx)});
+    goto idDone;
+  }
+
   // no ID was specified. It will be generated by the DB if the ID type is integer, if not an error will be returned.
   runCachedStatement(m_addNodePreparedStatement,
                      [&](SQLBoundVarIndex & var, std::ostringstream& s) {
@@ -703,7 +1340,7 @@ idDone:;
   if(!nodeId.has_value())
     throw std::logic_error("no result for nodeId.");
   
-  addElement(label, *nodeId, propValues);
+  addElement(Element::Node, label, *nodeId, propValues);
   return std::move(*nodeId);
 }
 
@@ -750,35 +1387,49 @@ ID GraphDB<ID>::addRelationship(const std::string& typeName,
 
   std::optional<ID> relId;
 
+  auto addRelationshipWithID = [&](const Value& value)
+  {
+    runCachedStatement(m_addRelationshipWithIDPreparedStatement,
+                       [&](SQLBoundVarIndex & var, std::ostringstream& s) {
+      s << "INSERT INTO relationships (" << m_idProperty.name << ", RelationshipType, OriginID, DestinationID) Values("
+      << var.nextAsStr()
+      << ", " << var.nextAsStr()
+      << ", " << var.nextAsStr()
+      << ", " << var.nextAsStr()
+      <<") RETURNING " << m_idProperty.name;
+    },
+                       [&, valuePtr=&value](SQLBoundVarIndex& var, SQLPreparedStatement& ps) {
+      ps.bindVariable(var.next(), *valuePtr);
+      ps.bindVariable(var.next(), static_cast<int64_t>(typeIdx->unsafeGet()));
+      ps.bindVariable(var.next(), originEntity);
+      ps.bindVariable(var.next(), destinationEntity);
+    },
+                       [](void *p_relId, int argc, Value *argv, char **column) {
+      auto & relId = *static_cast<std::optional<ID>*>(p_relId);
+      relId = std::move(std::get<ID>(argv[0]));
+      return 0;
+    },
+                       &relId);
+  };
+
   for(const auto & [name, value] : propValues)
   {
     if(name == m_idProperty.name)
     {
       // an ID was specified
-      runCachedStatement(m_addRelationshipWithIDPreparedStatement,
-                         [&](SQLBoundVarIndex & var, std::ostringstream& s) {
-        s << "INSERT INTO relationships (" << m_idProperty.name << ", RelationshipType, OriginID, DestinationID) Values("
-        << var.nextAsStr()
-        << ", " << var.nextAsStr()
-        << ", " << var.nextAsStr()
-        << ", " << var.nextAsStr()
-        <<") RETURNING " << m_idProperty.name;
-      },
-                         [&, valuePtr=&value](SQLBoundVarIndex& var, SQLPreparedStatement& ps) {
-        ps.bindVariable(var.next(), *valuePtr);
-        ps.bindVariable(var.next(), static_cast<int64_t>(typeIdx->unsafeGet()));
-        ps.bindVariable(var.next(), originEntity);
-        ps.bindVariable(var.next(), destinationEntity);
-      },
-                         [](void *p_relId, int argc, Value *argv, char **column) {
-        auto & relId = *static_cast<std::optional<ID>*>(p_relId);
-        relId = std::move(std::get<ID>(argv[0]));
-        return 0;
-      },
-                         &relId);
+      if(m_idAllocation == IDAllocation::TypePartitioned)
+        onExplicitPartitionedID(value, *typeIdx);
+      addRelationshipWithID(value);
       goto idDone;
     }
   }
+
+  if(m_idAllocation == IDAllocation::TypePartitioned)
+  {
+    // no ID was specified, the ID is allocated in the range of the relationship type.
+    addRelationshipWithID(Value{allocatePartitionedID(Element::Relationship, *typeIdx)});
+    goto idDone;
+  }
   
   // no ID was specified. It will be generated by the DB if the ID type is integer, if not an error will be returned.
   runCachedStatement(m_addRelationshipPreparedStatement,
@@ -804,23 +1455,55 @@ ID GraphDB<ID>::addRelationship(const std::string& typeName,
 idDone:;
   if(!relId.has_value())
     throw std::logic_error("no result for relId.");
-  addElement(label, *relId, propValues);
+  if constexpr (std::is_same_v<ID, int64_t>)
+    if(m_inMemoryAdjacency)
+      m_adjacencyIndex.add(*relId, static_cast<int64_t>(typeIdx->unsafeGet()), originEntity, destinationEntity);
+  addElement(Element::Relationship, label, *relId, propValues);
   return std::move(*relId);
 }
 
 template<typename ID>
-void GraphDB<ID>::addElement(const openCypher::Label& typeName,
-                         const ID& id,
-                         const std::vector<std::pair<PropertyKeyName, Value>>& propValues)
+void GraphDB<ID>::setInMemoryAdjacency(const bool enabled)
 {
-  validatePropertyValues(typeName, propValues);
-  
-  std::vector<PropertyKeyName> allPropertyNames;
-  allPropertyNames.reserve(propValues.size());
-  for(const auto & [propertyName, _] : propValues)
-    allPropertyNames.push_back(propertyName);
-
-  runCachedStatement(m_addElementPreparedStatements,
+  if(enabled == m_inMemoryAdjacency)
+    return;
+  m_adjacencyIndex.clear();
+  m_inMemoryAdjacency = false;
+  if(!enabled)
+    return;
+  if constexpr (!std::is_same_v<ID, int64_t>)
+    throw std::invalid_argument("The in-memory adjacency is only supported for int64_t ids.");
+  else
+  {
+    std::ostringstream s;
+    s << "SELECT " << m_idProperty.name << ", RelationshipType, OriginID, DestinationID FROM relationships";
+    if(auto res = sqlite3_exec(s.str(), [](void *p_index, int argc, Value *argv, char **column) {
+      auto & index = *static_cast<AdjacencyIndex*>(p_index);
+      index.add(std::get<int64_t>(argv[0]), std::get<int64_t>(argv[1]), std::get<int64_t>(argv[2]), std::get<int64_t>(argv[3]));
+      return 0;
+    }, &m_adjacencyIndex, 0))
+    {
+      m_adjacencyIndex.clear();
+      throw std::logic_error(sqlite3_errstr(res));
+    }
+    m_inMemoryAdjacency = true;
+  }
+}
+
+template<typename ID>
+void GraphDB<ID>::addElement(const Element elem,
+                             const openCypher::Label& typeName,
+                             const ID& id,
+                             const std::vector<std::pair<PropertyKeyName, Value>>& propValues)
+{
+  validatePropertyValues(typeName, propValues);
+  
+  std::vector<PropertyKeyName> allPropertyNames;
+  allPropertyNames.reserve(propValues.size());
+  for(const auto & [propertyName, _] : propValues)
+    allPropertyNames.push_back(propertyName);
+
+  runCachedStatement(m_addElementPreparedStatements,
                      AddElementPreparedStatementKey{typeName, allPropertyNames},
                      [&](SQLBoundVarIndex & var, std::ostringstream& s) {
     s << "INSERT INTO " << typeName << " (" << m_idProperty.name;
@@ -851,6 +1534,48 @@ void GraphDB<ID>::addElement(const openCypher::Label& typeName,
       ps.bindVariable(var.next(), value);
     }
   });
+
+  // Copy the inline properties in the system table.
+  const auto & inlineProps = inlineProperties(elem);
+  if(inlineProps.empty())
+    return;
+  const auto & typeProperties = m_properties[typeName];
+  std::vector<const PropertySchema*> inlineTypeProperties;
+  for(const auto & property : typeProperties)
+    if(inlineProps.count(property))
+      inlineTypeProperties.push_back(&property);
+  if(inlineTypeProperties.empty())
+    return;
+  runCachedStatement(m_setInlinePropertiesPreparedStatements,
+                     openCypher::Label{typeName},
+                     [&](SQLBoundVarIndex & var, std::ostringstream& s) {
+    s << "UPDATE " << systemTableName(elem) << " SET ";
+    bool first = true;
+    for(const auto * property : inlineTypeProperties)
+    {
+      if(first)
+        first = false;
+      else
+        s << ", ";
+      s << property->name << " = " << var.nextAsStr();
+    }
+    s << " WHERE " << m_idProperty.name << " = " << var.nextAsStr();
+  },
+                     [&](SQLBoundVarIndex& var, SQLPreparedStatement& ps) {
+    for(const auto * property : inlineTypeProperties)
+    {
+      const auto it = std::find_if(propValues.begin(), propValues.end(), [&](const auto & propValue) {
+        return propValue.first == property->name;
+      });
+      if(it != propValues.end())
+        ps.bindVariable(var.next(), it->second);
+      else if(property->defaultValue)
+        ps.bindVariable(var.next(), *property->defaultValue);
+      else
+        ps.bindVariable(var.next(), Nothing{});
+    }
+    ps.bindVariable(var.next(), id);
+  });
 }
 
 template<typename ID>
@@ -977,12 +1702,18 @@ GraphDB<ID>::toEquivalentSQLFilter(const std::vector<const openCypher::Expressio
 }
 
 
-size_t countPropertiesNotEqual(const openCypher::PropertyKeyName& property,
-                               const openCypher::VarsUsages& varsUsages)
+template<typename ID>
+size_t GraphDB<ID>::countNonSystemProperties(const openCypher::VarsUsages& varsUsages,
+                                             const std::map<Variable, Element>& varToElement) const
 {
   size_t count{};
-  for(const auto & [_, usage]: varsUsages)
-    count += usage.properties.size() - usage.properties.count(property);
+  for(const auto & [var, usage]: varsUsages)
+  {
+    const auto it = varToElement.find(var);
+    for(const auto & property : usage.properties)
+      if((it == varToElement.end()) ? (property != m_idProperty.name) : !isSystemProperty(it->second, property))
+        ++count;
+  }
   return count;
 }
 
@@ -993,7 +1724,7 @@ size_t countPropertiesNotEqual(const openCypher::PropertyKeyName& property,
 template<typename ID>
 std::optional<std::set<sql::ElementTypeIndex>>
 GraphDB<ID>::computeTypeFilter(const Element e,
-                               const openCypher::Labels& labels)
+                               const openCypher::Labels& labels) const
 {
   if(labels.empty())
     return std::nullopt;
@@ -1025,9 +1756,390 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
                               const std::map<Variable, std::vector<ReturnClauseTerm>>& variablesInfo,
                               const std::vector<PathPatternElement>& pathPattern,
                               const ExpressionsByVarsUsages& allFilters,
+                              const Distinct distinct,
                               const std::optional<Limit>& limit,
-                              const FuncResults& f)
+                              const FuncResults& f,
+                              PageKeys* page)
+{
+  if(!page && m_frontierExpansion &&
+     forEachPathByFrontiers(traversalDirections, variablesInfo, pathPattern, allFilters, distinct, limit, f))
+    return;
+  forEachPathBySelfJoins(traversalDirections, variablesInfo, pathPattern, allFilters, distinct, limit, f, page, {});
+}
+
+template<typename ID>
+bool GraphDB<ID>::forEachPathByFrontiers(const std::vector<TraversalDirection>& traversalDirections,
+                                         const std::map<Variable, std::vector<ReturnClauseTerm>>& variablesInfo,
+                                         const std::vector<PathPatternElement>& pathPattern,
+                                         const ExpressionsByVarsUsages& allFilters,
+                                         const Distinct distinct,
+                                         const std::optional<Limit>& limit,
+                                         const FuncResults& f)
+{
+  const size_t countHops = traversalDirections.size();
+  if(countHops < 2 || pathPattern.size() != 2 * countHops + 1)
+    return false;
+
+  const auto & firstVar = pathPattern.front().var;
+  const auto & lastVar = pathPattern.back().var;
+  if(!lastVar.has_value())
+    return false;
+  const auto itLastVarTerms = variablesInfo.find(*lastVar);
+  if(itLastVarTerms == variablesInfo.end() || itLastVarTerms->second.empty())
+    return false;
+  const auto & lastVarTerms = itLastVarTerms->second;
+
+  // Only the last node is returned, and variables are not repeated.
+  std::set<Variable> patternVariables;
+  for(const auto & element : pathPattern)
+  {
+    if(!element.var.has_value())
+      continue;
+    if(!patternVariables.insert(*element.var).second)
+      return false;
+    if(*element.var == *lastVar)
+      continue;
+    if(const auto it = variablesInfo.find(*element.var); it != variablesInfo.end() && !it->second.empty())
+      return false;
+  }
+
+  // The filters use either the first node or the last node.
+  ExpressionsByVarsUsages firstVarFilters, lastVarFilters;
+  for(const auto & [varsUsages, expressions] : allFilters)
+  {
+    if(varsUsages.size() != 1)
+      return false;
+    const auto & var = varsUsages.begin()->first;
+    if(var == *lastVar)
+      lastVarFilters.emplace(varsUsages, expressions);
+    else if(firstVar.has_value() && var == *firstVar)
+      firstVarFilters.emplace(varsUsages, expressions);
+    else
+      return false;
+  }
+
+  // A path cannot traverse a relationship twice when the relationships of the hops cannot be the same.
+  std::vector<std::optional<std::set<sql::ElementTypeIndex>>> typeFilters;
+  typeFilters.reserve(pathPattern.size());
+  for(size_t i{}; i < pathPattern.size(); ++i)
+    typeFilters.push_back(computeTypeFilter((i % 2) ? Element::Relationship : Element::Node, pathPattern[i].labels));
+  for(size_t i{1}; i < pathPattern.size(); i += 2)
+    for(size_t j{i + 2}; j < pathPattern.size(); j += 2)
+      if(!m_uniquenessConstraintsElimination || maybeSameRelationship(traversalDirections, typeFilters, i, j))
+        return false;
+
+  // Without duplicate removal, a row is returned for each path.
+  const bool countPaths = (distinct == Distinct::No);
+
+  // The frontier variables are not symbolic names of the query.
+  const Variable fromVar{openCypher::SymbolicName{" from"}};
+  const Variable toVar{openCypher::SymbolicName{" to"}};
+  const auto idTerm = [&](const size_t position)
+  {
+    return ReturnClauseTerm{position, m_idProperty.name, std::nullopt};
+  };
+
+  // The distinct nodes reached by the previous hops, with the count of paths reaching them.
+  std::unordered_map<ID, size_t> frontier, nextFrontier;
+  const auto frontierIDs = [&]()
+  {
+    AnchorIDs ids{frontier.size(), std::make_shared<typename CorrespondingVectorType<ID>::type>()};
+    ids.ids->reserve(frontier.size());
+    for(const auto & [id, _] : frontier)
+      ids.ids->push_back(cloneIfNeeded(id));
+    return ids;
+  };
+  const auto pathsReaching = [&](const Value& id)
+  {
+    return frontier.at(std::get<ID>(id));
+  };
+
+  for(size_t hop{}; hop < countHops; ++hop)
+  {
+    const bool isFirstHop = (hop == 0);
+    const bool isLastHop = (hop + 1 == countHops);
+
+    std::vector<PathPatternElement> hopPattern;
+    hopPattern.reserve(3);
+    std::map<Variable, std::vector<ReturnClauseTerm>> hopVariables;
+    std::map<Variable, AnchorIDs> boundIDs;
+    if(isFirstHop)
+    {
+      hopPattern.push_back(pathPattern.front());
+      if(firstVar.has_value())
+        hopVariables[*firstVar];
+    }
+    else
+    {
+      hopPattern.emplace_back(fromVar, pathPattern[2 * hop].labels);
+      boundIDs.emplace(fromVar, frontierIDs());
+    }
+    hopPattern.emplace_back(std::nullopt, pathPattern[2 * hop + 1].labels);
+    hopPattern.emplace_back(isLastHop ? *lastVar : toVar, pathPattern[2 * hop + 2].labels);
+    const std::vector<TraversalDirection> hopDirection{traversalDirections[hop]};
+
+    if(!isLastHop)
+    {
+      // Returns the id of the reached node, and the id of the node it is reached from when paths are counted.
+      if(!isFirstHop)
+        hopVariables[fromVar] = countPaths ? std::vector<ReturnClauseTerm>{idTerm(1)} : std::vector<ReturnClauseTerm>{};
+      hopVariables[toVar] = {idTerm(0)};
+      nextFrontier.clear();
+      forEachPathBySelfJoins(hopDirection, hopVariables, hopPattern, isFirstHop ? firstVarFilters : ExpressionsByVarsUsages{},
+                             countPaths ? Distinct::No : Distinct::Yes, std::nullopt,
+                             [&](const ResultOrder& resultOrder, const VecValues& values)
+      {
+        const auto & [i, j] = resultOrder[0];
+        const ID& id = std::get<ID>((*values[i])[j]);
+        size_t countReachingPaths{1};
+        if(countPaths && !isFirstHop)
+        {
+          const auto & [k, l] = resultOrder[1];
+          countReachingPaths = pathsReaching((*values[k])[l]);
+        }
+        if(auto it = nextFrontier.find(id); it != nextFrontier.end())
+          it->second += countReachingPaths;
+        else
+          nextFrontier.emplace(cloneIfNeeded(id), countReachingPaths);
+      }, nullptr, std::move(boundIDs));
+      std::swap(frontier, nextFrontier);
+      if(frontier.empty())
+        return true;
+      continue;
+    }
+
+    // The last hop returns the rows.
+    hopVariables[*lastVar] = lastVarTerms;
+    if(!countPaths)
+    {
+      hopVariables[fromVar];
+      forEachPathBySelfJoins(hopDirection, hopVariables, hopPattern, lastVarFilters, distinct, limit, f, nullptr, std::move(boundIDs));
+      break;
+    }
+    // The id of the node the row is reached from is returned after the returned terms,
+    // and the row is returned once per path reaching this node.
+    const size_t countReturnedTerms = lastVarTerms.size();
+    hopVariables[fromVar] = {idTerm(countReturnedTerms)};
+    std::optional<ResultOrder> returnedOrder;
+    size_t countRows{};
+    forEachPathBySelfJoins(hopDirection, hopVariables, hopPattern, lastVarFilters, Distinct::No, std::nullopt,
+                           [&](const ResultOrder& resultOrder, const VecValues& values)
+    {
+      if(!returnedOrder.has_value())
+        returnedOrder.emplace(resultOrder.begin(), resultOrder.begin() + countReturnedTerms);
+      const auto & [i, j] = resultOrder[countReturnedTerms];
+      for(size_t count = pathsReaching((*values[i])[j]); count; --count)
+      {
+        if(limit.has_value() && countRows >= limit->maxCountRows)
+          return;
+        f(*returnedOrder, values);
+        ++countRows;
+      }
+    }, nullptr, std::move(boundIDs));
+  }
+  return true;
+}
+
+template<typename ID>
+std::vector<std::vector<ID>> GraphDB<ID>::shortestPaths(const ID& from,
+                                                        const ID& to,
+                                                        const TraversalDirection direction,
+                                                        const std::set<openCypher::Label>& relationshipTypes,
+                                                        const std::optional<size_t> maxDepth,
+                                                        const ShortestPaths which) const
+{
+  std::vector<std::vector<ID>> paths;
+  if(from == to)
+  {
+    paths.emplace_back();
+    paths.back().push_back(cloneIfNeeded(from));
+    return paths;
+  }
+
+  std::optional<std::set<sql::ElementTypeIndex>> typeFilter;
+  if(!relationshipTypes.empty())
+  {
+    typeFilter.emplace();
+    for(const auto & label : relationshipTypes)
+      if(const auto typeIdx = m_indexedRelationshipTypes.getIfExists(label))
+        typeFilter->insert(*typeIdx);
+    if(typeFilter->empty())
+      return paths;
+  }
+
+  struct Search
+  {
+    TraversalDirection direction;
+    std::unordered_map<ID, VisitedNode<ID>> visited;
+    // The nodes visited at the current depth.
+    std::vector<ID> frontier;
+    size_t depth{};
+  };
+  const auto startSearch = [](const ID& origin, const TraversalDirection dir)
+  {
+    Search search{dir, {}, {}, 0};
+    search.visited.emplace(cloneIfNeeded(origin), VisitedNode<ID>{});
+    search.frontier.push_back(cloneIfNeeded(origin));
+    return search;
+  };
+  Search forward = startSearch(from, direction);
+  Search backward = startSearch(to, (direction == TraversalDirection::Forward) ? TraversalDirection::Backward :
+                                    ((direction == TraversalDirection::Backward) ? TraversalDirection::Forward : TraversalDirection::Any));
+
+  while(!maxDepth.has_value() || forward.depth + backward.depth < *maxDepth)
+  {
+    // The frontier having fewer nodes is expanded.
+    auto & search = (backward.frontier.size() < forward.frontier.size()) ? backward : forward;
+    const auto & other = (&search == &forward) ? backward : forward;
+    const size_t depth = search.depth + 1;
+
+    std::vector<ID> nextFrontier;
+    // The nodes of the next frontier visited by the other search. All shortest paths go through these nodes.
+    std::vector<ID> meetingNodes;
+    forEachRelationshipOf(search.frontier, search.direction, typeFilter, [&](const ID& node, const ID& relationship, const ID& neighbor)
+    {
+      auto it = search.visited.find(neighbor);
+      if(it == search.visited.end())
+      {
+        it = search.visited.emplace(cloneIfNeeded(neighbor), VisitedNode<ID>{depth, {}}).first;
+        nextFrontier.push_back(cloneIfNeeded(neighbor));
+        if(other.visited.count(neighbor))
+          meetingNodes.push_back(cloneIfNeeded(neighbor));
+      }
+      else if(it->second.depth != depth || which == ShortestPaths::One)
+        return;
+      it->second.previous.emplace_back(cloneIfNeeded(relationship), cloneIfNeeded(node));
+    });
+    search.frontier = std::move(nextFrontier);
+    search.depth = depth;
+
+    if(!meetingNodes.empty())
+    {
+      std::vector<ID> toFrom, toTo;
+      for(const auto & node : meetingNodes)
+      {
+        forEachPathToOrigin(forward.visited, node, toFrom, [&](const std::vector<ID>& pathToFrom)
+        {
+          forEachPathToOrigin(backward.visited, node, toTo, [&](const std::vector<ID>& pathToTo)
+          {
+            if(which == ShortestPaths::One && !paths.empty())
+              return;
+            auto & path = paths.emplace_back();
+            path.reserve(pathToFrom.size() + pathToTo.size() - 1);
+            for(auto it = pathToFrom.rbegin(); it != pathToFrom.rend(); ++it)
+              path.push_back(cloneIfNeeded(*it));
+            for(auto it = pathToTo.begin() + 1; it != pathToTo.end(); ++it)
+              path.push_back(cloneIfNeeded(*it));
+          });
+        });
+        if(which == ShortestPaths::One)
+          break;
+      }
+      return paths;
+    }
+    if(search.frontier.empty())
+      break;
+  }
+  return paths;
+}
+
+template<typename ID>
+void GraphDB<ID>::forEachRelationshipOf(const std::vector<ID>& nodes,
+                                        const TraversalDirection direction,
+                                        const std::optional<std::set<sql::ElementTypeIndex>>& typeFilter,
+                                        const std::function<void(const ID& node, const ID& relationship, const ID& neighbor)>& f) const
+{
+  if(nodes.empty() || (typeFilter.has_value() && typeFilter->empty()))
+    return;
+  std::vector<TraversalDirection> directions;
+  if(direction != TraversalDirection::Backward)
+    directions.push_back(TraversalDirection::Forward);
+  if(direction != TraversalDirection::Forward)
+    directions.push_back(TraversalDirection::Backward);
+
+  if constexpr (std::is_same_v<ID, int64_t>)
+  {
+    if(m_inMemoryAdjacency)
+    {
+      const auto forEachEdge = [&](const int64_t node, const TraversalDirection dir, const std::optional<int64_t> type)
+      {
+        const auto [begin, end] = m_adjacencyIndex.edges(node, dir, type);
+        for(auto edge = begin; edge != end; ++edge)
+          f(node, edge->relationshipID, edge->neighborID);
+      };
+      for(const auto node : nodes)
+        for(const auto dir : directions)
+        {
+          if(!typeFilter.has_value())
+            forEachEdge(node, dir, std::nullopt);
+          else
+            for(const auto typeIdx : *typeFilter)
+              forEachEdge(node, dir, static_cast<int64_t>(typeIdx.unsafeGet()));
+        }
+      return;
+    }
+  }
+
+  // The relationships are oriented from the nodes.
+  sql::QueryVars sqlVars = mkQueryVars();
+  auto ids = std::make_shared<typename CorrespondingVectorType<ID>::type>();
+  ids->reserve(nodes.size());
+  for(const auto & node : nodes)
+    ids->push_back(cloneIfNeeded(node));
+  const std::string nodesList = sqlVars.addVar(std::move(ids));
+
+  std::ostringstream s;
+  for(const auto dir : directions)
+  {
+    const std::string nodeColumn = (dir == TraversalDirection::Forward) ? "OriginID" : "DestinationID";
+    const std::string neighborColumn = (dir == TraversalDirection::Forward) ? "DestinationID" : "OriginID";
+    if(dir != directions.front())
+      s << " UNION ALL ";
+    s << "SELECT " << nodeColumn << ", " << m_idProperty.name << ", " << neighborColumn << " FROM relationships WHERE "
+      << nodeColumn << " IN " << nodesList;
+    if(typeFilter.has_value())
+    {
+      // The relationships are looked up from the nodes with the indices on OriginID / DestinationID:
+      // the unary '+' prevents SQLite from scanning all the relationships of the types instead.
+      s << " AND";
+      if(m_idAllocation == IDAllocation::TypePartitioned)
+        s << mkFilterTypesRangeConstraint(*typeFilter, sql::QueryColumnName{"+" + m_idProperty.name.symbolicName.str});
+      else
+        s << mkFilterTypesConstraint(*typeFilter, sql::QueryColumnName{"+RelationshipType"});
+    }
+  }
+
+  if(auto res = sqlite3_exec(s.str(), [](void *p_f, int argc, Value *argv, char **column) {
+    const auto & f = *static_cast<const std::function<void(const ID&, const ID&, const ID&)>*>(p_f);
+    f(std::get<ID>(argv[0]), std::get<ID>(argv[1]), std::get<ID>(argv[2]));
+    return 0;
+  }, const_cast<void*>(static_cast<const void*>(&f)), 0, sqlVars))
+    throw std::logic_error(sqlite3_errstr(res));
+}
+
+template<typename ID>
+void GraphDB<ID>::forEachPathBySelfJoins(const std::vector<TraversalDirection>& traversalDirections,
+                                         const std::map<Variable, std::vector<ReturnClauseTerm>>& variablesInfo,
+                                         const std::vector<PathPatternElement>& pathPattern,
+                                         const ExpressionsByVarsUsages& allFilters,
+                                         const Distinct distinct,
+                                         const std::optional<Limit>& limit,
+                                         const FuncResults& f,
+                                         PageKeys* page,
+                                         std::map<Variable, AnchorIDs> boundIDs,
+                                         const size_t countPageCandidates)
 {
+  for(const auto & [_, terms] : variablesInfo)
+    for(const auto & term : terms)
+      if(term.aggregation.has_value())
+        throw std::logic_error("Aggregations of paths must be computed by the caller.");
+  if(page)
+  {
+    if((distinct == Distinct::Yes) || !limit.has_value())
+      throw std::logic_error("A page of paths must have a limit, and no duplicate removal.");
+    page->last.clear();
+  }
+
   const bool hasTraversalDirectionAny =
   std::find(traversalDirections.begin(),
             traversalDirections.end(),
@@ -1041,14 +2153,11 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
   // These constraints contain non-id properties so we apply them while querying the non-system relationship/entity tables.
   std::map<Variable, VariablePostFilters> postFilters;
 
-  std::map<Variable, VariableInfo> varInfo;
-
-  analyzeFilters(allFilters, variablesInfo, idFilters, postFilters, varInfo);
+  // These constraints use non-id properties of several variables (or of a single variable, with SingleVariableFiltersEvaluation::Native)
+  // so we evaluate them once the property values have been gathered.
+  std::vector<const Expression*> evaluatedFilters;
 
-  // We apply the LIMIT clause in the system relationships table query when
-  // we know that all candidate rows found in this query will be returned.
-  const bool applyHardLimitInSystemRelationshipsQuery = postFilters.empty();
-  
+  std::map<Variable, VariableInfo> varInfo;
 
   auto pathPatternIndexToElement = [](size_t i)
   {
@@ -1056,6 +2165,45 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
   };
 
   std::map<Variable, Element> varToElement;
+  for(size_t i{}; i<pathPatternSize; ++i)
+    if(pathPattern[i].var.has_value())
+      varToElement[*pathPattern[i].var] = pathPatternIndexToElement(i);
+
+  analyzeFilters(allFilters, variablesInfo, varToElement, idFilters, postFilters, evaluatedFilters, varInfo);
+
+  // We apply the LIMIT clause in the system relationships table query when
+  // we know that all candidate rows found in this query will be returned.
+  const bool applyHardLimitInSystemRelationshipsQuery = postFilters.empty() && evaluatedFilters.empty();
+
+  // Otherwise, the candidate rows of a page are queried by batches whose size doubles,
+  // so that a page doesn't query all the remaining paths.
+  std::optional<size_t> pageCandidatesLimit;
+  if(page && !applyHardLimitInSystemRelationshipsQuery)
+    pageCandidatesLimit = countPageCandidates ? countPageCandidates : std::max(limit->maxCountRows, c_filterBatchSize);
+
+  // We remove duplicate rows in the system relationships table query when
+  // the columns of this query are exactly the returned values.
+  const bool distinctInSystemRelationshipsQuery = (distinct == Distinct::Yes) &&
+  applyHardLimitInSystemRelationshipsQuery &&
+  std::none_of(varInfo.begin(), varInfo.end(), [](const auto & varAndInfo) { return varAndInfo.second.needsTypeInfo; });
+
+  // The inline properties used in the system relationships query, by variable.
+  std::map<Variable, std::set<PropertyKeyName>> inlinePropertiesByVar;
+  for(const Expression* idFilter : idFilters)
+    for(const auto & [var, usage] : idFilter->varsUsages())
+      for(const auto & property : usage.properties)
+        if(property != m_idProperty.name)
+          inlinePropertiesByVar[var].insert(property);
+  for(const auto & [var, returnedProperties] : variablesInfo)
+  {
+    const auto & info = varInfo[var];
+    if(info.needsTypeInfo || !info.lookupProperties)
+      continue;
+    // The returned properties of this variable are only id or inline properties.
+    for(const auto & p : returnedProperties)
+      if(p.propertyName != m_idProperty.name)
+        inlinePropertiesByVar[var].insert(p.propertyName);
+  }
 
   // parallel to pathPattern
   std::vector<std::optional<std::set<sql::ElementTypeIndex>>> nodesRelsTypesFilters;
@@ -1065,8 +2213,6 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
     for(const auto & pattern : pathPattern)
     {
       const Element element = pathPatternIndexToElement(i);
-      if(pattern.var.has_value())
-        varToElement[*pattern.var] = element;
       const auto filter = computeTypeFilter(element, pattern.labels);
       if(filter.has_value() && filter->empty())
         // No label is allowed for this variable, so the query has no result.
@@ -1086,42 +2232,168 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
   for(const auto & [var, i] : varToVarIdx)
     varIdxToVar[i] = var;
 
+  // The properties gathered in the property tables for |var|:
+  // the returned properties, followed by the other properties used in evaluated filters.
+  const auto gatheredProperties = [&](const Variable& var)
+  {
+    std::vector<PropertyKeyName> props;
+    const auto & returnedProperties = variablesInfo.at(var);
+    const auto & evaluatedProperties = varInfo[var].evaluatedProperties;
+    props.reserve(returnedProperties.size() + evaluatedProperties.size());
+    for(const auto & p : returnedProperties)
+      props.push_back(p.propertyName);
+    for(const auto & p : evaluatedProperties)
+      if(std::find(props.begin(), props.end(), p) == props.end())
+        props.push_back(p);
+    return props;
+  };
+
+  // The evaluated filters are compiled to a program whose value columns are the gathered property values
+  // and whose type columns are the types of the candidate rows.
+  std::optional<sql::FilterProgram> filterProgram;
+  // parallel to filterProgram->valueColumns(): the variable index and the index of the property in the gathered property values.
+  std::vector<std::pair<size_t, size_t>> filterValueColumnsSources;
+  // parallel to filterProgram->typeColumns(): the variable index.
+  std::vector<size_t> filterTypeColumnsSources;
+  if(!evaluatedFilters.empty())
+  {
+    std::map<Variable, VarQueryInfo> varQueryInfo;
+    std::set<PropertySchema> sqlFields;
+    std::map<std::string, std::pair<size_t, size_t>> valueColumnsSources;
+    std::map<std::string, size_t> typeColumnsSources;
+    for(const Expression* filter : evaluatedFilters)
+    {
+      for(const auto & [var, usage] : filter->varsUsages())
+      {
+        const size_t i = varToVarIdx.at(var);
+        auto & info = insert(varToElement[var], var, varQueryInfo);
+        if(usage.usedInLabelConstraints)
+        {
+          info.typeIndexSQLQueryColumn = sql::QueryColumnName{var.symbolicName.str + ".<type>"};
+          typeColumnsSources[info.typeIndexSQLQueryColumn->name] = i;
+        }
+        const auto props = gatheredProperties(var);
+        for(const auto & property : usage.properties)
+        {
+          const auto itProperty = std::find(props.begin(), props.end(), property);
+          if(itProperty == props.end())
+            throw std::logic_error("[Unexpected] A property used in an evaluated filter is not gathered.");
+          const sql::QueryColumnName column{var.symbolicName.str + "." + property.symbolicName.str};
+          info.cypherPropertyToSQLQueryColumnName[property] = column;
+          valueColumnsSources[column.name] = {i, static_cast<size_t>(std::distance(props.begin(), itProperty))};
+          // The ValueType is ignored when comparing keys so we can use any ValueType here.
+          sqlFields.insert(PropertySchema{property, ValueType::String});
+        }
+      }
+    }
+    std::vector<std::unique_ptr<sql::Expression>> sqlExprs;
+    sqlExprs.reserve(evaluatedFilters.size());
+    for(const Expression* filter : evaluatedFilters)
+      sqlExprs.push_back(filter->toSQLExpressionTree(sqlFields, varQueryInfo));
+    const sql::AggregateExpression sqlExpr(sql::Aggregator::AND, std::move(sqlExprs));
+    if(auto eval = sqlExpr.tryEvaluate(c_labelsPerElement))
+    {
+      if(*eval != sql::Evaluation::True)
+        // The filters are never satisfied.
+        return;
+    }
+    else
+    {
+      filterProgram.emplace(sqlExpr);
+      for(const auto & column : filterProgram->valueColumns())
+        filterValueColumnsSources.push_back(valueColumnsSources.at(column.name));
+      for(const auto & column : filterProgram->typeColumns())
+        filterTypeColumnsSources.push_back(typeColumnsSources.at(column.name));
+    }
+  }
+
   // To minimize allocations, we use a "struct of arrays" approach here.
   using CandidateRows = std::vector<std::vector<IDAndType<ID>>>;
   // indexed by varToVarIdx[var]
   CandidateRows candidateRows(countDistinctVariables);
+  // The values of the returned inline properties, for variables whose returned properties are all id or inline properties.
+  // indexed by varToVarIdx[var]
+  std::vector<std::vector<Value>> inlineValues(countDistinctVariables);
+  // With a page, the keys of the candidate rows (see PageKeys).
+  std::vector<Value> pageKeys;
+  size_t countPageKeyColumns{};
   
+  // 0. Anchor variables having selective predicates on indexed properties:
+  //    we look up the ids of the matching elements in the property tables first, so that the
+  //    system relationships query starts from these elements instead of enumerating all relationships.
+  //    The post filters of these variables are still applied when gathering property values.
+
+  std::map<Variable, AnchorIDs> anchorIDs = std::move(boundIDs);
+  // The variables anchored by computeAnchorIDs.
+  std::set<Variable> indexAnchoredVariables;
+  for(const auto & pattern : pathPattern)
+  {
+    if(!pattern.var.has_value() || anchorIDs.count(*pattern.var))
+      continue;
+    const auto itPostFilters = postFilters.find(*pattern.var);
+    if(itPostFilters == postFilters.end())
+      continue;
+    auto anchor = computeAnchorIDs(*pattern.var, varToElement[*pattern.var], pattern.labels, itPostFilters->second.filters);
+    if(!anchor.has_value())
+      continue;
+    if(anchor->count == 0)
+      // No element matches the filters of the variable.
+      return;
+    anchorIDs.emplace(*pattern.var, std::move(*anchor));
+    indexAnchoredVariables.insert(*pattern.var);
+  }
+
   // 1. Query relationships system table (with self joins and joins on nodes system table)
 
   {
     struct RelationshipQueryInfo{
       std::chrono::steady_clock::duration& totalSystemRelationshipCbDuration;
       CandidateRows & candidateRows;
+      std::vector<std::vector<Value>> & inlineValues;
+      std::vector<Value> & pageKeys;
       size_t countDistinctVariables;
 
       // parallel to 'varIdxToVar'
       std::vector<std::optional<unsigned>> indexIDs;
       // parallel to 'varIdxToVar'
       std::vector<std::optional<unsigned>> indexTypes;
-    } queryInfo{m_totalSystemRelationshipCbDuration, candidateRows, countDistinctVariables};
+      // parallel to 'varIdxToVar'
+      std::vector<std::vector<unsigned>> indexInlineValues;
+      std::vector<unsigned> indexPageKeys;
+    } queryInfo{m_totalSystemRelationshipCbDuration, candidateRows, inlineValues, pageKeys, countDistinctVariables};
     queryInfo.indexIDs.resize(countDistinctVariables);
     queryInfo.indexTypes.resize(countDistinctVariables);
+    queryInfo.indexInlineValues.resize(countDistinctVariables);
 
     std::ostringstream s;
-    sql::QueryVars sqlVars;
+    sql::QueryVars sqlVars = mkQueryVars();
 
     {
       if(hasTraversalDirectionAny)
       {
         // TODO replace undirectedRelationships by a VIEW,
         // verify that performance is the same on large graph.
-        s <<R"V0G0N(WITH undirectedRelationships(SYS__ID, RelationshipType, OriginID, DestinationID) as NOT MATERIALIZED(
-  SELECT A.SYS__ID, A.RelationshipType, A.OriginID, A.DestinationID FROM relationships A
-  UNION ALL
-  SELECT B.SYS__ID, B.RelationshipType, B.DestinationID, B.OriginID FROM relationships B)
-)V0G0N";
+        std::string inlineColumns, inlineColumnsA, inlineColumnsB;
+        for(const auto & property : m_inlineRelationshipProperties)
+        {
+          const auto & name = property.name.symbolicName.str;
+          inlineColumns += ", " + name;
+          inlineColumnsA += ", A." + name;
+          inlineColumnsB += ", B." + name;
+        }
+        if(page)
+        {
+          // Distinguishes the 2 orientations of a relationship in the key of a path, even for a loop.
+          inlineColumns += ", Reversed";
+          inlineColumnsA += ", 0";
+          inlineColumnsB += ", 1";
+        }
+        s << "WITH undirectedRelationships(SYS__ID, RelationshipType, OriginID, DestinationID" << inlineColumns << ") as NOT MATERIALIZED(\n"
+        << "  SELECT A.SYS__ID, A.RelationshipType, A.OriginID, A.DestinationID" << inlineColumnsA << " FROM relationships A\n"
+        << "  UNION ALL\n"
+        << "  SELECT B.SYS__ID, B.RelationshipType, B.DestinationID, B.OriginID" << inlineColumnsB << " FROM relationships B)\n";
       }
-      s << "SELECT ";
+      s << (distinctInSystemRelationshipsQuery ? "SELECT DISTINCT " : "SELECT ");
       unsigned selectIndex{};
       auto pushSelect = [&](const sql::QueryColumnName& columnName)
       {
@@ -1137,9 +2409,23 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
 
       std::map<Variable, sql::QueryColumnName> variableToIDQueryColumn;
       std::map<Variable, sql::QueryColumnName> variableToTypeQueryColumn;
+      // The alias of the system table containing the inline properties of the variable.
+      std::map<Variable, std::string> variableToSystemTableAlias;
 
       std::optional<std::string> prevToField;
-      std::set<std::string> prevRelationshipIDFields;
+      // The pattern index and the id column of the previous relationships.
+      std::vector<std::pair<size_t, std::string>> prevRelationshipIDFields;
+      // The neighbors virtual table doesn't have the inline properties of relationships.
+      const bool useNeighbors = std::is_same_v<ID, int64_t> && m_inMemoryAdjacency && m_inlineRelationshipProperties.empty();
+      // The columns of the key of a path (see PageKeys).
+      std::vector<std::string> pageKeyColumns;
+
+      // Whether some variables are bound to ids (by anchors, or by equality or IN predicates on ids).
+      const bool hasIDsConstraint = !anchorIDs.empty() ||
+      std::any_of(idFilters.begin(), idFilters.end(), [&](const Expression* filter) {
+        const auto predicate = filter->indexablePredicate();
+        return predicate.has_value() && predicate->isEquality && predicate->property == m_idProperty.name;
+      });
 
       unsigned patternIndex{};
       for(const auto & pathPattern : pathPattern)
@@ -1168,9 +2454,25 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
         const auto elem = pathPatternIndexToElement(patternIndex);
         const std::string relationshipTableJoinAlias{"R" + std::to_string(relJoinIndex)};
 
+        // With the in-memory adjacency, the relationships following the first relationship are the neighbors
+        // of the previous node, read from memory by the neighbors virtual table.
+        const bool readNeighbors = useNeighbors && relJoinIndex > 0;
+        // The neighbors virtual table filters the relationships by type when there is a single type.
+        const bool readNeighborsOfType = readNeighbors && elem == Element::Relationship &&
+        nodesRelsTypesFilters[patternIndex].has_value() && nodesRelsTypesFilters[patternIndex]->size() == 1;
+
         if(relationshipSelfJoins.size() == relJoinIndex)
         {
-          if(traversalDirection == TraversalDirection::Any)
+          if(readNeighbors)
+          {
+            if(!prevToField.has_value())
+              throw std::logic_error("[Unexpected]");
+            std::string args = *prevToField + ", " + std::to_string(static_cast<int>(traversalDirection));
+            if(readNeighborsOfType)
+              args += ", " + std::to_string(nodesRelsTypesFilters[patternIndex]->begin()->unsafeGet());
+            relationshipSelfJoins.push_back("neighbors(" + args + ") " + relationshipTableJoinAlias);
+          }
+          else if(traversalDirection == TraversalDirection::Any)
             relationshipSelfJoins.push_back("undirectedRelationships " + relationshipTableJoinAlias);
           else
             relationshipSelfJoins.push_back("relationships " + relationshipTableJoinAlias);
@@ -1178,6 +2480,7 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
 
         std::string columnNameForID(relationshipTableJoinAlias);
         std::optional<sql::QueryColumnName> columnNameForType;
+        std::optional<std::string> systemTableAlias;
         if(elem == Element::Node)
         {
           // For the TraversalDirection::Any case, we use a view on relationships table that duplicates
@@ -1195,23 +2498,42 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
           // The query returns the type
           (pathPattern.var.has_value() && varInfo[*pathPattern.var].needsTypeInfo);
 
-          if(needsTypeField)
+          auto joinNodesTable = [&]()
+          {
+            if(!systemTableAlias.has_value())
+            {
+              systemTableAlias = "N" + std::to_string(nodeJoinIndex);
+              nodeJoins.push_back(" INNER JOIN nodes " + *systemTableAlias + " ON " + *systemTableAlias + ".SYS__ID = " + columnNameForID);
+            }
+            return *systemTableAlias;
+          };
+
+          if(m_idAllocation == IDAllocation::TypePartitioned)
+          {
+            // The type is derived from the id, no join is needed.
+            if(pathPattern.var.has_value() && varInfo[*pathPattern.var].needsTypeInfo)
+              columnNameForType = mkTypeFromPartitionedID(sql::QueryColumnName{columnNameForID});
+          }
+          else if(needsTypeField)
           {
             if(pathPattern.var.has_value())
               if(auto it = variableToTypeQueryColumn.find(*pathPattern.var); it != variableToTypeQueryColumn.end())
                 columnNameForType = it->second;
             if(!columnNameForType.has_value())
-            {
-              const std::string nodeTableJoinAlias{"N" + std::to_string(nodeJoinIndex)};
-              nodeJoins.push_back(" INNER JOIN nodes " + nodeTableJoinAlias + " ON " + nodeTableJoinAlias + ".SYS__ID = " + columnNameForID);
-              columnNameForType = sql::QueryColumnName{nodeTableJoinAlias + ".NodeType"};
-            }
+              columnNameForType = sql::QueryColumnName{joinNodesTable() + ".NodeType"};
           }
+
+          if(pathPattern.var.has_value() && !varAlreadySeen)
+            if(const auto it = inlinePropertiesByVar.find(*pathPattern.var); it != inlinePropertiesByVar.end())
+              // The inline properties are in the nodes system table, whereas the computed properties are looked up by node id.
+              if(std::any_of(it->second.begin(), it->second.end(), [](const PropertyKeyName& p) { return !openCypher::isComputedNodeProperty(p); }))
+                joinNodesTable();
         }
         else
         {
           columnNameForID += ".SYS__ID";
           columnNameForType = sql::QueryColumnName{relationshipTableJoinAlias + ".RelationshipType"};
+          systemTableAlias = relationshipTableJoinAlias;
           if(varAlreadySeen)
             // Because openCypher only allows paths to traverse a relationship once (see comment on relationship uniqueness above),
             // repeating a variable-length relationship in the same graph pattern will yield no results.
@@ -1219,23 +2541,26 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
           if(!prevToField.has_value())
             throw std::logic_error("[Unexpected]");
           const std::string curFromField = relationshipTableJoinAlias + ((traversalDirection == TraversalDirection::Backward) ? ".DestinationID" : ".OriginID");
-          if(*prevToField != curFromField)
+          if(*prevToField != curFromField && !readNeighbors)
             constraints.push_back("(" + *prevToField + " = " + curFromField + ")");
-          if(!prevRelationshipIDFields.empty())
+          // The previous relationships that cannot be this relationship are omitted.
+          std::string allPrevRelIds;
+          for(const auto & [prevPatternIndex, id] : prevRelationshipIDFields)
           {
-            std::string allPrevRelIds;
-            bool first = true;
-            for(const auto & id : prevRelationshipIDFields)
-            {
-              if(first)
-                first = false;
-              else
-                allPrevRelIds += ", ";
-              allPrevRelIds += id;
-            }
-            constraints.push_back("(" + columnNameForID + " NOT IN (" + allPrevRelIds + ") )");
+            if(m_uniquenessConstraintsElimination &&
+               !maybeSameRelationship(traversalDirections, nodesRelsTypesFilters, prevPatternIndex, patternIndex))
+              continue;
+            if(!allPrevRelIds.empty())
+              allPrevRelIds += ", ";
+            allPrevRelIds += id;
           }
-          prevRelationshipIDFields.insert(columnNameForID);
+          if(!allPrevRelIds.empty())
+            constraints.push_back("(" + columnNameForID + " NOT IN (" + allPrevRelIds + ") )");
+          prevRelationshipIDFields.emplace_back(patternIndex, columnNameForID);
+          pageKeyColumns.push_back(columnNameForID);
+          if(traversalDirection == TraversalDirection::Any)
+            // Both orientations of the relationship are in undirectedRelationships.
+            pageKeyColumns.push_back(relationshipTableJoinAlias + ".Reversed");
         }
         if(pathPattern.var.has_value() && !varAlreadySeen)
         {
@@ -1249,25 +2574,77 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
               throw std::logic_error("[Unexpected]");
             queryInfo.indexTypes[i] = pushSelect(*columnNameForType);
           }
+          else if(info.lookupProperties)
+          {
+            // The returned properties are id or inline properties.
+            for(const auto & p : variablesInfo.at(*pathPattern.var))
+            {
+              if(p.propertyName == m_idProperty.name)
+                continue;
+              if(const auto expr = computedPropertySQLExpression(p.propertyName, columnNameForID))
+              {
+                queryInfo.indexInlineValues[i].push_back(pushSelect(sql::QueryColumnName{*expr}));
+                continue;
+              }
+              if(!systemTableAlias.has_value())
+                throw std::logic_error("[Unexpected] No system table for inline properties.");
+              queryInfo.indexInlineValues[i].push_back(pushSelect(sql::QueryColumnName{*systemTableAlias + "." + p.propertyName.symbolicName.str}));
+            }
+          }
+          if(systemTableAlias.has_value())
+            variableToSystemTableAlias.emplace(*pathPattern.var, *systemTableAlias);
 
           variableToIDQueryColumn.emplace(*pathPattern.var, sql::QueryColumnName{columnNameForID});
           if(columnNameForType.has_value())
             variableToTypeQueryColumn[*pathPattern.var] = *columnNameForType;
         }
 
-        if(const auto & typeFilter = nodesRelsTypesFilters[patternIndex])
+        if(const auto & typeFilter = nodesRelsTypesFilters[patternIndex]; typeFilter.has_value() && !readNeighborsOfType)
         {
-          if(!columnNameForType.has_value())
-            throw std::logic_error("[Unexpected]");
           // Note: for MATCH (a:Type1)-[]->(a:Type2) since 'a' is used in both node patterns,
           //   it means 'a' must be Type1 AND Type2.
           // In our case (single label per entity) no row will be ever returned.
-          constraints.push_back(mkFilterTypesConstraint(*typeFilter, *columnNameForType));
+          //
+          // When some variables are bound to ids, the relationships are looked up from these elements with the indices
+          // on OriginID / DestinationID: the unary '+' prevents SQLite from scanning all the relationships of the type instead.
+          const std::string noIndex = (elem == Element::Relationship && hasIDsConstraint) ? "+" : "";
+          if(m_idAllocation == IDAllocation::TypePartitioned)
+            constraints.push_back(mkFilterTypesRangeConstraint(*typeFilter, sql::QueryColumnName{noIndex + columnNameForID}));
+          else
+          {
+            if(!columnNameForType.has_value())
+              throw std::logic_error("[Unexpected]");
+            constraints.push_back(mkFilterTypesConstraint(*typeFilter, sql::QueryColumnName{noIndex + columnNameForType->name}));
+          }
         }
           
         ++patternIndex;
       }
 
+      for(const auto & [var, anchor] : anchorIDs)
+        constraints.push_back("( " + variableToIDQueryColumn[var].name + " IN " + sqlVars.addVar(anchor.ids) + " )");
+
+      std::string pageKeyColumnsList;
+      if(page)
+      {
+        for(const auto & column : pageKeyColumns)
+        {
+          queryInfo.indexPageKeys.push_back(pushSelect(sql::QueryColumnName{column}));
+          pageKeyColumnsList += (pageKeyColumnsList.empty() ? "" : ", ") + column;
+        }
+        countPageKeyColumns = pageKeyColumns.size();
+        if(!page->after.empty())
+        {
+          if(page->after.size() != countPageKeyColumns)
+            throw std::invalid_argument("The page key doesn't match the query.");
+          // The paths are resumed after the key of the last path of the previous page.
+          std::string boundKey;
+          for(const auto & value : page->after)
+            boundKey += (boundKey.empty() ? "" : ", ") + mkBoundValue(value, sqlVars);
+          constraints.push_back("( (" + pageKeyColumnsList + ") > (" + boundKey + ") )");
+        }
+      }
+
       if(!idFilters.empty())
       {
         std::map<Variable, VarQueryInfo> varQueryInfo;
@@ -1275,10 +2652,32 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
           insert(varToElement[var], var, varQueryInfo).cypherPropertyToSQLQueryColumnName[m_idProperty.name] = qc;
         for(const auto & [var, qc] : variableToTypeQueryColumn)
           insert(varToElement[var], var, varQueryInfo).typeIndexSQLQueryColumn = qc;
+        std::set<PropertySchema> sqlFields{m_idProperty};
+        for(const auto & [var, properties] : inlinePropertiesByVar)
+        {
+          const auto it = variableToSystemTableAlias.find(var);
+          auto & info = insert(varToElement[var], var, varQueryInfo);
+          for(const auto & property : properties)
+          {
+            if(auto expr = computedPropertySQLExpression(property, variableToIDQueryColumn[var].name))
+            {
+              // Predicates on degrees and pattern predicates are evaluated while expanding the path,
+              // so that hub nodes are skipped early.
+              info.cypherPropertyToSQLQueryColumnName[property] = sql::QueryColumnName{std::move(*expr)};
+              sqlFields.insert(PropertySchema{property});
+              continue;
+            }
+            if(it == variableToSystemTableAlias.end())
+              throw std::logic_error("[Unexpected] No system table for inline properties.");
+            info.cypherPropertyToSQLQueryColumnName[property] = sql::QueryColumnName{it->second + "." + property.symbolicName.str};
+          }
+        }
+        sqlFields.insert(m_inlineNodeProperties.begin(), m_inlineNodeProperties.end());
+        sqlFields.insert(m_inlineRelationshipProperties.begin(), m_inlineRelationshipProperties.end());
         // we don't assume any particular element label.
         std::string sqlFilter;
         if(!toEquivalentSQLFilter(idFilters,
-                                  {m_idProperty},
+                                  sqlFields,
                                   varQueryInfo,
                                   sqlFilter,
                                   sqlVars))
@@ -1323,7 +2722,13 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
         s << constraint;
       }
       
-      if(applyHardLimitInSystemRelationshipsQuery && limit.has_value())
+      if(page)
+        s << " ORDER BY " << pageKeyColumnsList;
+      if(pageCandidatesLimit.has_value())
+        s << " LIMIT " << *pageCandidatesLimit;
+
+      // When duplicate rows are removed after this query, some rows of this query may not be returned.
+      if(applyHardLimitInSystemRelationshipsQuery && limit.has_value() && (distinct == Distinct::No || distinctInSystemRelationshipsQuery))
         s << " LIMIT " << limit->maxCountRows;
     }
 
@@ -1344,7 +2749,11 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
             indexType.has_value() ? std::get<int64_t>(argv[*indexType]) : c_noType
           });
         }
+        for(const auto index : queryInfo.indexInlineValues[i])
+          queryInfo.inlineValues[i].push_back(std::move(argv[index]));
       }
+      for(const auto index : queryInfo.indexPageKeys)
+        queryInfo.pageKeys.push_back(std::move(argv[index]));
       
       const auto duration = std::chrono::system_clock::now() - t1;
       queryInfo.totalSystemRelationshipCbDuration += duration;
@@ -1382,15 +2791,13 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
           else
             elementsByType[idAndType.type].insert(idAndType.id.clone());
         }
-        std::vector<PropertyKeyName> props;
-        props.reserve(returnedProperties.size());
-        for(const auto & p : returnedProperties)
-          props.push_back(p.propertyName);
+        const std::vector<PropertyKeyName> props = gatheredProperties(var);
 
         // TODO: when we query the same labeled entity/relationship property tables for several variables,
         // instead of doing several queries we should do a single UNION ALL query
         // with an extra column containing the index of the variable.
-        gatherPropertyValues(var, std::move(elementsByType), varToElement[var], props, postFilters, propertiesByVar[i]);
+        gatherPropertyValues(var, std::move(elementsByType), varToElement[var], props, postFilters, indexAnchoredVariables.count(var) > 0,
+                             propertiesByVar[i]);
       }
     }
   }
@@ -1401,7 +2808,8 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
   VecValues vecValues(countDistinctVariables);
   std::vector<const std::vector<ReturnClauseTerm>*> vecReturnClauses(countDistinctVariables);
   std::vector<std::vector<Value>> propertyValues(countDistinctVariables);
-  std::vector<bool> varOnlyReturnsId(countDistinctVariables);
+  std::vector<bool> varOnlyReturnsSystemProperties(countDistinctVariables);
+  std::vector<size_t> countInlineValues(countDistinctVariables);
   std::vector<bool> lookupProperties(countDistinctVariables);
 
   for(const auto & [var, returnedProperties] : variablesInfo)
@@ -1413,16 +2821,20 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
 
     const auto & info = varInfo[var];
     lookupProperties[i] = info.lookupProperties;
-    const bool onlyReturnsID = !info.needsTypeInfo && info.lookupProperties;
-    varOnlyReturnsId[i] = onlyReturnsID;
-    if(onlyReturnsID)
+    const bool onlyReturnsSystemProperties = !info.needsTypeInfo && info.lookupProperties;
+    varOnlyReturnsSystemProperties[i] = onlyReturnsSystemProperties;
+    if(onlyReturnsSystemProperties)
     {
-      // means we return only the id (sanity check this) and no post filtering occurs.
+      // means we return only the id or inline properties (sanity check this) and no post filtering occurs.
       if(returnedProperties.empty())
-        throw std::logic_error("[Unexpected] !nodeNeedsTypeInfo && lookupNodesProperties but has no id property returned.");
+        throw std::logic_error("[Unexpected] !nodeNeedsTypeInfo && lookupNodesProperties but has no property returned.");
       for(const auto & p : returnedProperties)
+      {
+        if(!isSystemProperty(varToElement[var], p.propertyName))
+          throw std::logic_error("[Unexpected] !nodeNeedsTypeInfo but has some non-id, non-inline property returned.");
         if(p.propertyName != m_idProperty.name)
-          throw std::logic_error("[Unexpected] !nodeNeedsTypeInfo but has some non-id property returned.");
+          ++countInlineValues[i];
+      }
     }
   }
   
@@ -1437,46 +2849,136 @@ void GraphDB<ID>::forEachPath(const std::vector<TraversalDirection>& traversalDi
   for(size_t i{}; i<countDistinctVariables; ++i)
     orderedVariables.push_back(varIdxToVar[i]);
 
-  size_t countReturnedRows{};
-  for(size_t row{}; row<countRows; ++row)
+  // Candidate rows are processed in batches so that the evaluated filters are applied to all rows of a batch at once.
+
+  // The candidate rows of the batch that have not been discarded by the queries on labeled node/entity property tables.
+  std::vector<size_t> batchRows;
+  batchRows.reserve(c_filterBatchSize);
+  // indexed by varToVarIdx[var], then by index in batchRows.
+  std::vector<std::vector<const std::vector<Value>*>> batchProperties(countDistinctVariables);
+  for(size_t i{}; i<countDistinctVariables; ++i)
+    if(lookupProperties[i] && !varOnlyReturnsSystemProperties[i])
+      batchProperties[i].resize(c_filterBatchSize);
+
+  sql::FilterProgram::Batch filterBatch;
+  filterBatch.values.resize(filterValueColumnsSources.size());
+  filterBatch.types.resize(filterTypeColumnsSources.size());
+  // The indices in batchRows of the rows satisfying the evaluated filters.
+  std::vector<size_t> selection;
+
+  // The encoded rows that have been returned, when duplicate rows are removed in this function.
+  std::unordered_set<std::string> distinctRows;
+  std::string rowKey;
+  const bool removeDuplicateRows = (distinct == Distinct::Yes) && !distinctInSystemRelationshipsQuery;
+
+  size_t countReturnedRows{};
+  std::optional<size_t> lastReturnedRow;
+  for(size_t batchBegin{}; batchBegin<countRows; batchBegin += c_filterBatchSize)
   {
     if(limit.has_value() && countReturnedRows >= limit->maxCountRows)
       break;
-    for(size_t i{}; i<countDistinctVariables; ++i)
+
+    batchRows.clear();
+    for(size_t row{batchBegin}, batchEnd = std::min(countRows, batchBegin + c_filterBatchSize); row<batchEnd; ++row)
     {
-      if(lookupProperties[i])
+      for(size_t i{}; i<countDistinctVariables; ++i)
       {
-        if(varOnlyReturnsId[i])
+        if(lookupProperties[i] && !varOnlyReturnsSystemProperties[i])
+        {
+          const auto & properties = propertiesByVar[i];
+          const auto itNodeProperties = properties.find(candidateRows[i][row].id);
+          if(itNodeProperties == properties.end())
+            // The candidate has been discarded by one of the queries on labeled node/entity property tables.
+            goto nextRow;
+          batchProperties[i][batchRows.size()] = &itNodeProperties->second;
+        }
+      }
+      batchRows.push_back(row);
+    nextRow:;
+    }
+
+    const size_t countBatchRows = batchRows.size();
+    if(filterProgram.has_value())
+    {
+      filterBatch.countRows = countBatchRows;
+      for(size_t c{}, sz = filterValueColumnsSources.size(); c<sz; ++c)
+      {
+        const auto [i, j] = filterValueColumnsSources[c];
+        auto & column = filterBatch.values[c];
+        column.resize(countBatchRows);
+        for(size_t k{}; k<countBatchRows; ++k)
+          column[k] = &(*batchProperties[i][k])[j];
+      }
+      for(size_t c{}, sz = filterTypeColumnsSources.size(); c<sz; ++c)
+      {
+        const auto & rows = candidateRows[filterTypeColumnsSources[c]];
+        auto & column = filterBatch.types[c];
+        column.resize(countBatchRows);
+        for(size_t k{}; k<countBatchRows; ++k)
+          column[k] = rows[batchRows[k]].type;
+      }
+      filterProgram->run(filterBatch, selection);
+    }
+
+    const size_t countSelected = filterProgram.has_value() ? selection.size() : countBatchRows;
+    for(size_t s{}; s<countSelected; ++s)
+    {
+      if(limit.has_value() && countReturnedRows >= limit->maxCountRows)
+        break;
+      const size_t k = filterProgram.has_value() ? selection[s] : s;
+      const size_t row = batchRows[k];
+      for(size_t i{}; i<countDistinctVariables; ++i)
+      {
+        if(!lookupProperties[i])
+          continue;
+        if(varOnlyReturnsSystemProperties[i])
         {
           auto & propValues = propertyValues[i];
+          const auto & returnedProperties = *vecReturnClauses[i];
 
           auto & id = candidateRows[i][row].id;
-          if constexpr (std::copyable<ID>)
-            std::fill(propValues.begin(), propValues.end(), id);
-          else
+          auto itInlineValue = inlineValues[i].begin() + row * countInlineValues[i];
+          for(size_t j{}, sz = propValues.size(); j<sz; ++j)
           {
-            for(auto & propValue : propValues)
-            {
+            if(returnedProperties[j].propertyName != m_idProperty.name)
+              propValues[j] = std::move(*itInlineValue++);
+            else if constexpr (std::copyable<ID>)
+              propValues[j] = id;
+            else
               // Potential optimization: we could move the last value instead of copying it.
               // candidateRows[i][row].id will not be used in this function anymore
-              propValue = id.clone();
-            }
+              propValues[j] = id.clone();
           }
         }
         else
-        {
-          const auto & properties = propertiesByVar[i];
-          const auto itNodeProperties = properties.find(candidateRows[i][row].id);
-          if(itNodeProperties == properties.end())
-            // The candidate has been discarded by one of the queries on labeled node/entity property tables.
-            goto nextRow;
-          vecValues[i] = &itNodeProperties->second;
-        }
+          vecValues[i] = batchProperties[i][k];
       }
+      if(removeDuplicateRows)
+      {
+        encodeRow(resultOrder, vecValues, rowKey);
+        if(distinctRows.count(rowKey))
+          continue;
+        distinctRows.insert(rowKey);
+      }
+      f(resultOrder, vecValues);
+      ++countReturnedRows;
+      lastReturnedRow = row;
     }
-    f(resultOrder, vecValues);
-    ++countReturnedRows;
-  nextRow:;
+  }
+
+  if(page && (countReturnedRows == limit->maxCountRows) && lastReturnedRow.has_value())
+    for(size_t c{}; c<countPageKeyColumns; ++c)
+      page->last.push_back(std::move(pageKeys[*lastReturnedRow * countPageKeyColumns + c]));
+  else if(pageCandidatesLimit.has_value() && (pageKeys.size() == *pageCandidatesLimit * countPageKeyColumns))
+  {
+    // The page is not full, and there may be more candidate rows: the next batch starts after the last candidate row.
+    PageKeys nextCandidates;
+    nextCandidates.after.assign(std::make_move_iterator(pageKeys.end() - countPageKeyColumns),
+                                std::make_move_iterator(pageKeys.end()));
+    forEachPathBySelfJoins(traversalDirections, variablesInfo, pathPattern, allFilters, distinct,
+                           Limit{limit->maxCountRows - countReturnedRows}, f, &nextCandidates, std::move(anchorIDs),
+                           2 * *pageCandidatesLimit);
+    page->last = std::move(nextCandidates.last);
   }
 }
 
@@ -1486,22 +2988,81 @@ VarQueryInfo& GraphDB<ID>::insert(const Element elem, const Variable & var, std:
   return varQueryInfo.try_emplace(var, elem == Element::Node ? m_indexedNodeTypes : m_indexedRelationshipTypes).first->second;
 }
 
+template<typename ID>
+bool GraphDB<ID>::canSortInSQL(const Element elem,
+                               const openCypher::Labels& labels,
+                               const std::vector<PropertySortKey>& sortKeys) const
+{
+  if(sortKeys.empty())
+    return false;
+  const auto allowedLabels = computeAllowedLabels(elem, labels);
+  if(allowedLabels.size() != 1)
+    return false;
+  const auto & label = *allowedLabels.begin();
+  const auto itProperties = m_properties.find(label);
+  if(itProperties == m_properties.end())
+    return false;
+  for(const auto & sortKey : sortKeys)
+    if(0 == itProperties->second.count(sortKey.propertyName))
+      return false;
+
+  const auto & leadingProperty = sortKeys[0].propertyName;
+  if(leadingProperty == m_idProperty.name)
+    return true;
+  if(const auto itIndices = m_indices.find(label); itIndices != m_indices.end())
+    for(const auto & [_, index] : itIndices->second)
+      if(!index.where.has_value() && index.properties[0] == leadingProperty)
+        return true;
+  return false;
+}
+
 template<typename ID>
 void GraphDB<ID>::forEachElementPropertyWithLabelsIn(const Variable & var,
                                                      const Element elem,
                                                      const std::vector<ReturnClauseTerm>& returnClauseTerms,
                                                      const openCypher::Labels& labels,
                                                      const std::vector<const Expression*>* filter,
+                                                     const Distinct distinct,
+                                                     const std::vector<PropertySortKey>& sortKeys,
                                                      const std::optional<Limit>& limit,
-                                                     const FuncResults& f)
+                                                     const FuncResults& f,
+                                                     PageKeys* page)
 {
-  sql::QueryVars sqlVars;
+  sql::QueryVars sqlVars = mkQueryVars();
+
+  const bool aggregate = std::any_of(returnClauseTerms.begin(), returnClauseTerms.end(), [](const ReturnClauseTerm& rct)
+  {
+    return rct.aggregation.has_value();
+  });
+  if(aggregate && !sortKeys.empty())
+    throw std::logic_error("Aggregated elements cannot be sorted in SQL.");
+  if(page && (aggregate || !sortKeys.empty() || (distinct == Distinct::Yes) || !limit.has_value()))
+    throw std::logic_error("A page of elements must have a limit, and no aggregation, sort key or duplicate removal.");
+
+  // The label of the last element of the previous page: the elements of the labels before this one are skipped,
+  // and the elements of this label are resumed after the id of the last element.
+  std::optional<openCypher::Label> pageAfterLabel;
+  if(page)
+  {
+    page->last.clear();
+    if(!page->after.empty())
+    {
+      if(page->after.size() != 2 || !std::holds_alternative<StringPtr>(page->after[0]))
+        throw std::invalid_argument("The page key doesn't match the query.");
+      pageAfterLabel = openCypher::Label{openCypher::SymbolicName{std::get<StringPtr>(page->after[0]).string.get()}};
+    }
+  }
+  // The labels of the queried property tables, by rank.
+  std::vector<openCypher::Label> pageLabels;
 
   // extract property names
+  // With aggregations, the labels queries select each property once,
+  // and the aggregations are computed by an outer query.
   std::vector<PropertyKeyName> propertyNames;
   propertyNames.reserve(returnClauseTerms.size());
   for(const auto & rct : returnClauseTerms)
-    propertyNames.push_back(rct.propertyName);
+    if(!aggregate || std::find(propertyNames.begin(), propertyNames.end(), rct.propertyName) == propertyNames.end())
+      propertyNames.push_back(rct.propertyName);
   
   struct Results{
     Results(ResultOrder&&ro, const FuncResults& func)
@@ -1516,25 +3077,39 @@ void GraphDB<ID>::forEachElementPropertyWithLabelsIn(const Variable & var,
     std::vector<Value> m_values;
     const FuncResults& m_f;
     const std::vector<const std::vector<Value>*> m_vecValues;
+
+    // With a page, the rank of the label and the id of the last element are the last 2 columns.
+    bool m_page{};
+    size_t m_countRows{};
+    int64_t m_lastRank{};
+    Value m_lastID;
   } results {
     computeResultOrder({&returnClauseTerms}),
     f
   };
+  results.m_page = page != nullptr;
   
   std::vector<bool> validProperty;
   std::ostringstream s;
   bool firstOutter = true;
   for(const auto & label : computeAllowedLabels(elem, labels))
   {
+    if(pageAfterLabel.has_value() && (label < *pageAfterLabel))
+      // These elements were returned in the previous pages.
+      continue;
     if(!findValidProperties(label, propertyNames, validProperty))
       // label does not exist.
       continue;
+    const std::string idColumn = label.symbolicName.str + "." + m_idProperty.name.symbolicName.str;
     std::string sqlFilter{};
     if(filter && !filter->empty())
     {
       std::map<Variable, VarQueryInfo> varQueryInfo;
-      insert(elem, var, varQueryInfo).variableLabels = {label};
-      if(!toEquivalentSQLFilter(*filter, m_properties[label], varQueryInfo, sqlFilter, sqlVars))
+      auto & info = insert(elem, var, varQueryInfo);
+      info.variableLabels = {label};
+      auto sqlFields = (elem == Element::Node) ? mapComputedProperties(*filter, var, idColumn, info) : std::set<PropertySchema>{};
+      sqlFields.insert(m_properties[label].begin(), m_properties[label].end());
+      if(!toEquivalentSQLFilter(*filter, sqlFields, varQueryInfo, sqlFilter, sqlVars))
         // These items are excluded by the filter.
         continue;
     }
@@ -1542,11 +3117,16 @@ void GraphDB<ID>::forEachElementPropertyWithLabelsIn(const Variable & var,
     // if all properties are invalid and we don't filter,
     // then we don't query and return results directly.
     // But here we don't know the ids so we have to query anyway.
+    // Aggregated rows are distinct, so duplicate rows are removed only when there is no aggregation.
+    const bool removeDuplicates = (distinct == Distinct::Yes) && !aggregate;
     if(firstOutter)
       firstOutter = false;
     else
-      s << " UNION ALL ";
-    s << "SELECT ";
+      // UNION removes duplicate rows.
+      s << (removeDuplicates ? " UNION " : " UNION ALL ");
+    if(page)
+      s << "SELECT * FROM (";
+    s << (removeDuplicates ? "SELECT DISTINCT " : "SELECT ");
     bool first = true;
     for(size_t i=0, sz=validProperty.size(); i<sz; ++i)
     {
@@ -1557,27 +3137,170 @@ void GraphDB<ID>::forEachElementPropertyWithLabelsIn(const Variable & var,
         s << ", ";
       if(!validProperty[i])
         s << "NULL as ";
+      else if(const auto expr = computedPropertySQLExpression(propertyName, idColumn))
+        s << *expr << " as ";
       s << propertyName;
     }
+    if(page)
+    {
+      s << (first ? "" : ", ") << pageLabels.size() << " as SYS__PAGE_RANK, " << idColumn << " as SYS__PAGE_ID";
+      pageLabels.push_back(label);
+    }
     s << " FROM " << label;
+    const bool pageStartsAfter = page && pageAfterLabel.has_value() && (label == *pageAfterLabel);
     if(!sqlFilter.empty())
-      s << " WHERE " << sqlFilter;
+    {
+      // The filter is parenthesized, so that the page predicate applies to all its terms (the filter can be a disjunction).
+      if(pageStartsAfter)
+        s << " WHERE (" << sqlFilter << ")";
+      else
+        s << " WHERE " << sqlFilter;
+    }
+    if(page)
+    {
+      if(pageStartsAfter)
+        s << (sqlFilter.empty() ? " WHERE " : " AND ") << idColumn << " > " << mkBoundValue(page->after[1], sqlVars);
+      // Each branch returns at most a page, in the order of the primary key.
+      s << " ORDER BY " << idColumn << " LIMIT " << limit->maxCountRows << ")";
+    }
   }
 
   std::string req = s.str();
+  if(aggregate)
+  {
+    std::vector<PropertyKeyName> groupingKeys;
+    for(const auto & rct : returnClauseTerms)
+      if(!rct.aggregation.has_value() &&
+         std::find(groupingKeys.begin(), groupingKeys.end(), rct.propertyName) == groupingKeys.end())
+        groupingKeys.push_back(rct.propertyName);
+
+    const bool onlyCounts = std::all_of(returnClauseTerms.begin(), returnClauseTerms.end(), [&](const ReturnClauseTerm& rct)
+    {
+      return (rct.aggregation == openCypher::AggregationFunction::CountRows ||
+              rct.aggregation == openCypher::AggregationFunction::Count) &&
+      rct.propertyName == m_idProperty.name;
+    });
+    if(onlyCounts && (!filter || filter->empty()))
+    {
+      // The counts of elements by type are maintained in the namedTypes table,
+      // so we don't need to scan the elements.
+      if(!limit.has_value() || limit->maxCountRows > 0)
+      {
+        const int64_t count = countElements(elem, labels);
+        for(auto & value : results.m_values)
+          value = count;
+        f(results.m_resultsOrder, results.m_vecValues);
+      }
+      return;
+    }
+    if(req.empty())
+    {
+      // No label exists: there are no groups, and without grouping keys
+      // the aggregations of an empty set are returned.
+      if(groupingKeys.empty() && (!limit.has_value() || limit->maxCountRows > 0))
+      {
+        for(size_t i=0, sz=returnClauseTerms.size(); i<sz; ++i)
+        {
+          const auto aggregation = *returnClauseTerms[i].aggregation;
+          const bool isZero = (aggregation == openCypher::AggregationFunction::CountRows) ||
+                              (aggregation == openCypher::AggregationFunction::Count) ||
+                              (aggregation == openCypher::AggregationFunction::Sum);
+          results.m_values[i] = isZero ? Value{int64_t{0}} : Value{Nothing{}};
+        }
+        f(results.m_resultsOrder, results.m_vecValues);
+      }
+      return;
+    }
+
+    std::ostringstream aggregationReq;
+    aggregationReq << "SELECT ";
+    bool first = true;
+    for(const auto & [_, propertyName, aggregation] : returnClauseTerms)
+    {
+      if(first)
+        first = false;
+      else
+        aggregationReq << ", ";
+      if(!aggregation.has_value())
+      {
+        aggregationReq << propertyName;
+        continue;
+      }
+      switch(*aggregation)
+      {
+        case openCypher::AggregationFunction::CountRows:
+        case openCypher::AggregationFunction::Count:
+          aggregationReq << "COUNT(" << propertyName << ")";
+          break;
+        case openCypher::AggregationFunction::Sum:
+          // Like in openCypher, the sum of no value is 0.
+          aggregationReq << "COALESCE(SUM(" << propertyName << "), 0)";
+          break;
+        case openCypher::AggregationFunction::Min:
+          aggregationReq << "MIN(" << propertyName << ")";
+          break;
+        case openCypher::AggregationFunction::Max:
+          aggregationReq << "MAX(" << propertyName << ")";
+          break;
+        case openCypher::AggregationFunction::Avg:
+          aggregationReq << "AVG(" << propertyName << ")";
+          break;
+      }
+    }
+    aggregationReq << " FROM (" << req << ")";
+    first = true;
+    for(const auto & groupingKey : groupingKeys)
+    {
+      aggregationReq << (first ? " GROUP BY " : ", ") << groupingKey;
+      first = false;
+    }
+    req = aggregationReq.str();
+  }
   if(!req.empty())
   {
+    if(!sortKeys.empty())
+    {
+      if(!canSortInSQL(elem, labels, sortKeys))
+        throw std::logic_error("The elements cannot be sorted in SQL.");
+      // Like in openCypher, nulls are sorted after the other values in ascending order.
+      // SQLite can still use an index for these orders.
+      req += " ORDER BY ";
+      bool first = true;
+      for(const auto & [propertyName, order] : sortKeys)
+      {
+        if(first)
+          first = false;
+        else
+          req += ", ";
+        req += propertyName.symbolicName.str;
+        req += (order == openCypher::SortOrder::Ascending) ? " ASC NULLS LAST" : " DESC NULLS FIRST";
+      }
+    }
+    if(page)
+      req += " ORDER BY SYS__PAGE_RANK, SYS__PAGE_ID";
     if(limit.has_value())
       req += " LIMIT " + std::to_string(limit->maxCountRows);
     const char*msg{};
     if(auto res = sqlite3_exec(req, [](void *p_results, int argc, Value *argv, char **column) {
       auto & results = *static_cast<Results*>(p_results);
+      if(results.m_page)
+      {
+        argc -= 2;
+        ++results.m_countRows;
+        results.m_lastRank = std::get<int64_t>(argv[argc]);
+        results.m_lastID = std::move(argv[argc + 1]);
+      }
       for(int i=0; i<argc; ++i)
         results.m_values[i] = std::move(argv[i]);
       results.m_f(results.m_resultsOrder, results.m_vecValues);
       return 0;
     }, &results, &msg, sqlVars))
       throw std::logic_error(msg);
+    if(page && (results.m_countRows == limit->maxCountRows) && (results.m_countRows > 0))
+    {
+      page->last.emplace_back(StringPtr::fromCStr(pageLabels[results.m_lastRank].symbolicName.str.c_str()));
+      page->last.push_back(std::move(results.m_lastID));
+    }
   }
 }
 
@@ -1619,8 +3342,10 @@ auto GraphDB<ID>::computeResultOrder(const std::vector<const std::vector<ReturnC
 template<typename ID>
 void GraphDB<ID>::analyzeFilters(const ExpressionsByVarsUsages& allFilters,
                                  const std::map<Variable, std::vector<ReturnClauseTerm>>& variablesInfo,
+                                 const std::map<Variable, Element>& varToElement,
                                  std::vector<const Expression*>& idAndLabelFilters,
                                  std::map<Variable, VariablePostFilters>& postFilters,
+                                 std::vector<const Expression*>& evaluatedFilters,
                                  std::map<Variable, VariableInfo>& varInfo) const
 {
   // There are several categories of type constraints:
@@ -1636,11 +3361,28 @@ void GraphDB<ID>::analyzeFilters(const ExpressionsByVarsUsages& allFilters,
   //     - (single- and multi-)variable type constraints that are mixed with single-variable property constraints:
   //       "a:Label1 OR a.weight = 0"
   //       "a:Label1 OR a:Label2 OR a.weight = 0"
-  //   # Type constraints that cannot be applied yet (in the future they could be applied in the system relationships query
-  //                                                  if the corresponding properties are inline json properties):
+  //   # Type constraints that are evaluated once the property values have been gathered (they are applied in the
+  //                                    system relationships query if the corresponding properties are inline properties):
   //     - (single- and multi-)variable type constraints that are mixed with multi-variable property constraints:
   //       "a:Label1 OR (a.weight = 0 AND c.weight = 3)"
   //       "a:Label1 OR a:Label2 OR (a.weight = 0 AND c.weight = 3)"
+  //     - multi-variable type constraints that are mixed with single-variable property constraints:
+  //       "a:Label1 OR c.weight = 3"
+
+  // Evaluated filters need the type of the variables used in label constraints (this is done at the end of the loop below),
+  // and the values of the properties of the variables using properties.
+  const auto addEvaluatedFilters = [&](const openCypher::VarsUsages& varsUsages, const std::vector<const Expression*>& expressions)
+  {
+    for(const auto & [var, usage] : varsUsages)
+    {
+      if(usage.properties.empty())
+        continue;
+      VariableInfo& info = varInfo[var];
+      info.needsTypeInfo = true;
+      info.evaluatedProperties.insert(usage.properties.begin(), usage.properties.end());
+    }
+    evaluatedFilters.insert(evaluatedFilters.end(), expressions.begin(), expressions.end());
+  };
 
   for(const auto & [varsUsages, expressions] : allFilters)
   {
@@ -1669,51 +3411,43 @@ void GraphDB<ID>::analyzeFilters(const ExpressionsByVarsUsages& allFilters,
     {
       // 'expressions' has 2 or more variables that use properties (and potentially other variables that don't use properties).
       
-      if(countPropertiesNotEqual(m_idProperty.name, varsUsages) > 0)
-        // At least one non-id property is used.
-        // We could support this in the future by evaluating these expressions manually before returning the results.
-        throw std::logic_error("[Not supported] A non-equi-var expression is using non-id properties.");
-      
-      // only id properties are used so we will use these expressions to filter the system relationships table.
-      idAndLabelFilters.insert(idAndLabelFilters.end(), expressions.begin(), expressions.end());
+      if(countNonSystemProperties(varsUsages, varToElement) > 0)
+        // At least one non-id, non-inline property is used.
+        addEvaluatedFilters(varsUsages, expressions);
+      else
+        // only id or inline properties are used so we will use these expressions to filter the system relationships table.
+        idAndLabelFilters.insert(idAndLabelFilters.end(), expressions.begin(), expressions.end());
     }
     else if(countDistinctVariablesUsingSomeProperties == 1)
     {
       // 'expressions' has a single variable that uses properties (and potentially other variables that don't use properties).
-      if(countPropertiesNotEqual(m_idProperty.name, varsUsages) > 0)
+      if(countNonSystemProperties(varsUsages, varToElement) > 0)
       {
-        // At least one non-id property is used.
-        size_t countFound{};
-        for(const auto & [var, usage] : varsUsages)
+        // At least one non-id, non-inline property is used.
+        if(varsUsages.size() > 1)
         {
-          if(!usage.properties.empty())
-          {
-            ++countFound;
-            
-            VariablePostFilters & postFiltersForVar = postFilters[var];
-            for(const PropertyKeyName & property : usage.properties)
-              postFiltersForVar.properties.insert(property);
-            postFiltersForVar.filters.insert(postFiltersForVar.filters.end(), expressions.begin(), expressions.end());
-          }
-          else
-          {
-            if(!usage.usedInLabelConstraints)
+          // Some other variables are used in label constraints.
+          for(const auto & [var, usage] : varsUsages)
+            if(usage.properties.empty() && !usage.usedInLabelConstraints)
               throw std::logic_error("[Unexpected] usage contains no property and no label constraint.");
-            
-            // We could support this in the future by evaluating these expressions manually before returning the results.
-            throw std::logic_error("[Not supported] A non-equi-var expression (with label constraints) is using non-id properties.");
-          }
+          addEvaluatedFilters(varsUsages, expressions);
+        }
+        else if(m_singleVariableFiltersEvaluation == SingleVariableFiltersEvaluation::Native)
+          addEvaluatedFilters(varsUsages, expressions);
+        else
+        {
+          const auto & [var, usage] = *varsUsages.begin();
+          VariablePostFilters & postFiltersForVar = postFilters[var];
+          for(const PropertyKeyName & property : usage.properties)
+            postFiltersForVar.properties.insert(property);
+          postFiltersForVar.filters.insert(postFiltersForVar.filters.end(), expressions.begin(), expressions.end());
         }
-        if(countFound != 1)
-          throw std::logic_error("[Unexpected] countDistinctVariablesUsingSomeProperties == 1 so countFound should be 1 but it is " + std::to_string(countFound));
       }
-      else if(varsUsages.begin()->second.properties.count(m_idProperty.name))
+      else
       {
-        // only id properties are used
+        // only id or inline properties are used
         idAndLabelFilters.insert(idAndLabelFilters.end(), expressions.begin(), expressions.end());
       }
-      else
-        throw std::logic_error("[Unexpected] A filter expression has no property.");
     }
     else
     {
@@ -1734,23 +3468,29 @@ void GraphDB<ID>::analyzeFilters(const ExpressionsByVarsUsages& allFilters,
   {
     VariableInfo& info = varInfo[var];
     if(!info.needsTypeInfo)
-      info.needsTypeInfo = varRequiresTypeInfo(var, returnedProperties, postFilters);
-    info.lookupProperties = postFilters.count(var) || !returnedProperties.empty();
+    {
+      const auto it = varToElement.find(var);
+      if(it == varToElement.end())
+        throw std::logic_error("[Unexpected] Variable not found in the path pattern.");
+      info.needsTypeInfo = varRequiresTypeInfo(var, it->second, returnedProperties, postFilters);
+    }
+    info.lookupProperties = postFilters.count(var) || !returnedProperties.empty() || !info.evaluatedProperties.empty();
   }
 }
 
 template<typename ID>
 bool GraphDB<ID>::varRequiresTypeInfo(const Variable& var,
-                                  const std::vector<ReturnClauseTerm>& returnedProperties,
-                                  const std::map<Variable, VariablePostFilters>& postFilters) const
+                                      const Element elem,
+                                      const std::vector<ReturnClauseTerm>& returnedProperties,
+                                      const std::map<Variable, VariablePostFilters>& postFilters) const
 {
-  // If the return clause contains some non-id properties,
+  // If the return clause contains some non-id, non-inline properties,
   // we need to know the type of the element because
   // we may need to query property tables to find the value of these properties
   // (unless these properties are not valid for the property table but this will be checked later,
   //  once we know the type of the element)
   for(const auto & p : returnedProperties)
-    if(p.propertyName != m_idProperty.name)
+    if(!isSystemProperty(elem, p.propertyName))
       return true;
   
   // If there are some constraints on non-id properties,
@@ -1794,6 +3534,259 @@ std::string GraphDB<ID>::mkFilterTypesConstraint(const std::set<sql::ElementType
   return s.str();
 }
 
+template<typename ID>
+std::string GraphDB<ID>::mkTypePartitionedIDCheck(const std::string& typeColumn)
+{
+  std::ostringstream s;
+  s << "CHECK ((SYS__ID >> " << c_typeIndexShift << ") = " << typeColumn << ")";
+  return s.str();
+}
+
+template<typename ID>
+std::pair<int64_t, int64_t> GraphDB<ID>::partitionedIDRange(sql::ElementTypeIndex typeIdx)
+{
+  const auto idx = static_cast<int64_t>(typeIdx.unsafeGet());
+  return {idx << c_typeIndexShift, (idx + 1) << c_typeIndexShift};
+}
+
+template<typename ID>
+std::string GraphDB<ID>::mkFilterTypesRangeConstraint(const std::set<sql::ElementTypeIndex>& typesFilter, sql::QueryColumnName const& idColumn)
+{
+  // Consecutive type indices are merged in a single range.
+  std::vector<std::pair<int64_t, int64_t>> ranges;
+  for(const auto typeIdx : typesFilter)
+  {
+    const auto range = partitionedIDRange(typeIdx);
+    if(!ranges.empty() && ranges.back().second == range.first)
+      ranges.back().second = range.second;
+    else
+      ranges.push_back(range);
+  }
+  std::ostringstream s;
+  s << " (";
+  bool first = true;
+  for(const auto & [begin, end] : ranges)
+  {
+    if(first)
+      first = false;
+    else
+      s << " OR";
+    s << " (" << idColumn.name << " >= " << begin << " AND " << idColumn.name << " < " << end << ")";
+  }
+  s << " )";
+  return s.str();
+}
+
+template<typename ID>
+sql::QueryColumnName GraphDB<ID>::mkTypeFromPartitionedID(sql::QueryColumnName const& idColumn)
+{
+  return sql::QueryColumnName{"(" + idColumn.name + " >> " + std::to_string(c_typeIndexShift) + ")"};
+}
+
+template<typename ID>
+int64_t GraphDB<ID>::allocatePartitionedID(const Element elem, sql::ElementTypeIndex typeIdx)
+{
+  auto it = m_nextPartitionedIDs.find(typeIdx.unsafeGet());
+  if(it == m_nextPartitionedIDs.end())
+  {
+    // This is the first allocation for this type since the DB was opened,
+    // we lookup the largest id of the type (this is a primary key lookup).
+    const auto [begin, end] = partitionedIDRange(typeIdx);
+    std::ostringstream s;
+    s << "SELECT MAX(" << m_idProperty.name << ") FROM " << ((elem == Element::Node) ? "nodes" : "relationships")
+    << " WHERE " << m_idProperty.name << " >= " << begin << " AND " << m_idProperty.name << " < " << end;
+    int64_t next{begin};
+    if(auto res = sqlite3_exec(s.str(), [](void *p_next, int argc, Value *argv, char **column) {
+      if(std::holds_alternative<int64_t>(argv[0]))
+        *static_cast<int64_t*>(p_next) = std::get<int64_t>(argv[0]) + 1;
+      return 0;
+    }, &next, 0))
+      throw std::logic_error(sqlite3_errstr(res));
+    it = m_nextPartitionedIDs.emplace(typeIdx.unsafeGet(), next).first;
+  }
+  const auto id = it->second;
+  if(id >= partitionedIDRange(typeIdx).second)
+    throw std::logic_error("No more ids available for the type.");
+  ++it->second;
+  return id;
+}
+
+template<typename ID>
+void GraphDB<ID>::onExplicitPartitionedID(const Value& value, sql::ElementTypeIndex typeIdx)
+{
+  const auto * id = std::get_if<int64_t>(&value);
+  if(!id)
+    throw std::logic_error("Expected an integer id.");
+  const auto [begin, end] = partitionedIDRange(typeIdx);
+  if(*id < begin || *id >= end)
+    throw std::logic_error("The id is not in the id range of the type.");
+  if(auto it = m_nextPartitionedIDs.find(typeIdx.unsafeGet()); it != m_nextPartitionedIDs.end())
+    it->second = std::max(it->second, *id + 1);
+}
+
+template<typename ID>
+bool GraphDB<ID>::preferIndexedLookup(const openCypher::Label& label,
+                                      const Element elem,
+                                      const std::vector<const Expression*>& filters,
+                                      const size_t countCandidates) const
+{
+  if(countCandidates < c_minCandidatesForIndexedLookup)
+    return false;
+  const auto itIndices = m_indices.find(label);
+  if(itIndices == m_indices.end())
+    return false;
+  const auto itProperties = m_properties.find(label);
+  if(itProperties == m_properties.end())
+    throw std::logic_error("[Unexpected] Label not found in properties.");
+
+  for(const Expression* filter : filters)
+  {
+    const auto predicate = filter->indexablePredicate();
+    if(!predicate.has_value())
+      continue;
+    for(const auto & [name, index] : itIndices->second)
+    {
+      // SQLite uses a partial index only if the query implies the partial index condition,
+      // so we don't try to force using partial indices.
+      if(index.where.has_value() || !(index.properties.front() == predicate->property))
+        continue;
+      if(predicate->isEquality && (index.kind == IndexKind::Unique) && (index.properties.size() == 1))
+        // At most one element per value.
+        return true;
+
+      // Estimate the selectivity of the predicate: this query uses the index
+      // and stops as soon as enough elements match.
+      const size_t maxCount = countCandidates / c_indexedLookupSelectivity;
+      std::map<Variable, VarQueryInfo> varQueryInfo;
+      insert(elem, predicate->var, varQueryInfo).variableLabels = {label};
+      std::string sqlFilter;
+      sql::QueryVars sqlVars = mkQueryVars();
+      if(!toEquivalentSQLFilter({filter}, itProperties->second, varQueryInfo, sqlFilter, sqlVars))
+        continue;
+      std::ostringstream s;
+      s << "SELECT COUNT(*) FROM (SELECT 1 FROM " << label;
+      if(!sqlFilter.empty())
+        s << " WHERE " << sqlFilter;
+      s << " LIMIT " << maxCount << ")";
+      size_t count{};
+      const char* msg{};
+      if(auto res = sqlite3_exec(s.str(), [](void *p_count, int argc, Value *argv, char **column) {
+        auto & count = *static_cast<size_t*>(p_count);
+        count = std::get<int64_t>(argv[0]);
+        return 0;
+      }, &count, &msg, sqlVars))
+        throw std::logic_error(msg);
+      if(count < maxCount)
+        return true;
+    }
+  }
+  return false;
+}
+
+template<typename ID>
+bool GraphDB<ID>::isIndexedProperty(const openCypher::Label& label, const PropertyKeyName& property) const
+{
+  const auto itIndices = m_indices.find(label);
+  if(itIndices == m_indices.end())
+    return false;
+  return std::any_of(itIndices->second.begin(), itIndices->second.end(), [&](const NamedPropertyIndex& namedIndex) {
+    return !namedIndex.index.where.has_value() && (namedIndex.index.properties.front() == property);
+  });
+}
+
+template<typename ID>
+auto GraphDB<ID>::computeAnchorIDs(const Variable& var,
+                                   const Element elem,
+                                   const openCypher::Labels& labels,
+                                   const std::vector<const Expression*>& filters) const -> std::optional<AnchorIDs>
+{
+  // Only the filters using no other variable can be evaluated on the property tables of |var|.
+  std::vector<const Expression*> varFilters;
+  for(const Expression* filter : filters)
+    if(filter->varsUsages().size() == 1)
+      varFilters.push_back(filter);
+  if(varFilters.empty())
+    return std::nullopt;
+
+  std::ostringstream s;
+  // The elements of the labels, to verify that the filters are selective.
+  std::ostringstream allLabels;
+  sql::QueryVars sqlVars = mkQueryVars();
+  bool firstOutter = true;
+  for(const auto & label : computeAllowedLabels(elem, labels))
+  {
+    const auto itProperties = m_properties.find(label);
+    if(itProperties == m_properties.end())
+      continue;
+    std::map<Variable, VarQueryInfo> varQueryInfo;
+    auto & info = insert(elem, var, varQueryInfo);
+    info.variableLabels = {label};
+    auto sqlFields = (elem == Element::Node) ? mapComputedProperties(varFilters, var, label.symbolicName.str + ".SYS__ID", info) : std::set<PropertySchema>{};
+    sqlFields.insert(itProperties->second.begin(), itProperties->second.end());
+    std::string sqlFilter;
+    if(!toEquivalentSQLFilter(varFilters, sqlFields, varQueryInfo, sqlFilter, sqlVars))
+      // These elements are excluded by the filter.
+      continue;
+    const bool usesIndex = std::any_of(varFilters.begin(), varFilters.end(), [&](const Expression* filter) {
+      const auto predicate = filter->indexablePredicate();
+      return predicate.has_value() && isIndexedProperty(label, predicate->property);
+    });
+    if(!usesIndex)
+      // Looking up the matching elements of this type would scan the whole table.
+      return std::nullopt;
+    if(firstOutter)
+      firstOutter = false;
+    else
+    {
+      s << " UNION ALL ";
+      allLabels << " UNION ALL ";
+    }
+    s << "SELECT SYS__ID FROM " << label;
+    if(!sqlFilter.empty())
+      s << " WHERE " << sqlFilter;
+    allLabels << "SELECT 1 FROM " << label;
+  }
+
+  AnchorIDs anchor{0, std::make_shared<typename CorrespondingVectorType<ID>::type>()};
+  if(firstOutter)
+    // No element can match the filters.
+    return anchor;
+  const std::string allLabelsQuery = allLabels.str();
+
+  // The count of matching elements is our estimate of the selectivity of the filters:
+  // we query one more element than the maximum to know if there are too many matching elements.
+  s << " LIMIT " << (c_maxAnchorIDs + 1);
+
+  const char* msg{};
+  if(auto res = sqlite3_exec(s.str(), [](void *p_anchor, int argc, Value *argv, char **column) {
+    auto & anchor = *static_cast<AnchorIDs*>(p_anchor);
+    if(++anchor.count <= c_maxAnchorIDs)
+      anchor.ids->push_back(std::move(std::get<ID>(argv[0])));
+    return 0;
+  }, &anchor, &msg, sqlVars))
+    throw std::logic_error(msg);
+  if(anchor.count > c_maxAnchorIDs)
+    return std::nullopt;
+  if(anchor.count == 0)
+    return anchor;
+
+  // The filters must match less than one element out of c_indexedLookupSelectivity elements of the labels,
+  // otherwise the system relationships query would not be much faster when starting from the matching elements.
+  // Like in preferIndexedLookup, the elements are counted up to the needed count.
+  const size_t minCountElements = anchor.count * c_indexedLookupSelectivity;
+  size_t countElements{};
+  if(auto res = sqlite3_exec("SELECT COUNT(*) FROM (" + allLabelsQuery + " LIMIT " + std::to_string(minCountElements) + ")",
+                             [](void *p_count, int argc, Value *argv, char **column) {
+    auto & count = *static_cast<size_t*>(p_count);
+    count = std::get<int64_t>(argv[0]);
+    return 0;
+  }, &countElements, &msg))
+    throw std::logic_error(msg);
+  if(countElements < minCountElements)
+    return std::nullopt;
+  return anchor;
+}
+
 // TODO: The UNION ALL on different types only works because all properties have the same type (int),
 // but in the future this will likely break.
 // For example with entity types
@@ -1809,11 +3802,12 @@ void GraphDB<ID>::gatherPropertyValues(const Variable& var,
                                        const Element elem,
                                        const std::vector<PropertyKeyName>& propertyNames,
                                        const std::map<Variable, VariablePostFilters>& postFilters,
+                                       const bool anchored,
                                        std::unordered_map<ID, std::vector<Value>>& properties) const
 {
   bool firstOutter = true;
   std::ostringstream s;
-  sql::QueryVars sqlVars;
+  sql::QueryVars sqlVars = mkQueryVars();
 
   const VariablePostFilters * postFilterForVar{};
   
@@ -1841,8 +3835,11 @@ void GraphDB<ID>::gatherPropertyValues(const Variable& var,
       if(it == m_properties.end())
         throw std::logic_error("[Unexpected] Label not found in properties.");
       std::map<Variable, VarQueryInfo> varQueryInfo;
-      insert(elem, var, varQueryInfo).variableLabels = {label};
-      if(!toEquivalentSQLFilter(postFilterForVar->filters, it->second, varQueryInfo, sqlFilter, sqlVars))
+      auto & info = insert(elem, var, varQueryInfo);
+      info.variableLabels = {label};
+      auto sqlFields = (elem == Element::Node) ? mapComputedProperties(postFilterForVar->filters, var, label.symbolicName.str + ".SYS__ID", info) : std::set<PropertySchema>{};
+      sqlFields.insert(it->second.begin(), it->second.end());
+      if(!toEquivalentSQLFilter(postFilterForVar->filters, sqlFields, varQueryInfo, sqlFilter, sqlVars))
         // These items are excluded by the filter.
         continue;
     }
@@ -1902,15 +3899,24 @@ void GraphDB<ID>::gatherPropertyValues(const Variable& var,
       s << ", ";
       if(!validProperty[i])
         s << "NULL as ";
+      else if(const auto expr = computedPropertySQLExpression(propertyName, label.symbolicName.str + ".SYS__ID"))
+        s << *expr << " as ";
       s << propertyName;
     }
     s << " FROM " << label;
 
+    // When the filter has a selective predicate on an indexed property, the unary '+' operator
+    // prevents SQLite from looking up the candidate ids using the primary key
+    // so that it uses the index on the property instead.
+    // The filters of an anchored variable have such a predicate (see computeAnchorIDs).
+    const bool indexedLookup = !sqlFilter.empty() &&
+      (anchored || preferIndexedLookup(label, elem, postFilterForVar->filters, ids.size()));
+
     auto vecIds = std::make_shared<typename CorrespondingVectorType<ID>::type>();
     vecIds->reserve(ids.size());
     for(auto & id : ids)
       vecIds->push_back(std::move(const_cast<ID&>(id)));  // Not sure why the const_cast is needed here...
-    s << " WHERE SYS__ID IN " << sqlVars.addVar(std::move(vecIds));
+    s << " WHERE " << (indexedLookup ? "+" : "") << "SYS__ID IN " << sqlVars.addVar(std::move(vecIds));
     if(!sqlFilter.empty())
       s << " AND " << sqlFilter;
   }
@@ -1984,15 +3990,103 @@ int GraphDB<ID>::sqlite3_exec_notime(const std::string& queryStr,
                                  void * cbParam,
                                  const char **errmsg) const
 {
-  SQLPreparedStatement stmt{};
-  if(auto res = stmt.prepare(m_db, queryStr))
+  // The lists bound in temporary tables are inserted before preparing the statement, which uses their tables,
+  // and removed once the statement has run.
+  std::vector<const sql::QueryVars::TempTableList*> tempTableLists;
+  for(const auto & [i, var] : sqlVars.vars())
+    if(const auto * list = std::get_if<sql::QueryVars::TempTableList>(&var))
+      tempTableLists.push_back(list);
+  if(tempTableLists.empty())
+    return runStatement(queryStr, sqlVars, callback, cbParam, errmsg);
+
+  struct Scope
   {
-    if(errmsg)
-      *errmsg = sqlite3_errmsg(m_db);
-    return res;
+    ~Scope(){
+      for(const auto * list : m_lists)
+        m_db.clearTempTableList(*list);
+      --m_db.m_countRunningQueries;
+    }
+    const GraphDB<ID>& m_db;
+    const std::vector<const sql::QueryVars::TempTableList*>& m_lists;
+  };
+  for(const auto * list : tempTableLists)
+    insertTempTableList(*list);
+  ++m_countRunningQueries;
+  int res;
+  {
+    Scope scope{*this, tempTableLists};
+    res = runStatement(queryStr, sqlVars, callback, cbParam, errmsg);
+    if(res && errmsg && *errmsg)
+    {
+      // The message would be overwritten by the statements clearing the temporary tables.
+      m_lastErrorMessage = *errmsg;
+      *errmsg = m_lastErrorMessage.c_str();
+    }
+  }
+  return res;
+}
+
+template<typename ID>
+int GraphDB<ID>::runStatement(const std::string& queryStr,
+                              const sql::QueryVars& sqlVars,
+                              int (*callback)(void*, int, Value*, char**),
+                              void * cbParam,
+                              const char **errmsg) const
+{
+  // The statement is taken out of the cache while it runs, in case a callback runs the same query.
+  std::unique_ptr<SQLPreparedStatement> stmt;
+  if(auto node = m_cachedQueryStatements.extract(queryStr))
+    stmt = std::move(node.mapped());
+  else
+  {
+    stmt = std::make_unique<SQLPreparedStatement>();
+    if(auto res = stmt->prepare(m_db, queryStr))
+    {
+      if(errmsg)
+        *errmsg = sqlite3_errmsg(m_db);
+      return res;
+    }
+  }
+  stmt->bindVariables(sqlVars);
+  const auto res = stmt->run(callback, cbParam, errmsg);
+  if(!res && stmt->isReadOnly())
+  {
+    stmt->reset();
+    if(m_cachedQueryStatements.size() >= c_maxCachedQueryStatements)
+      m_cachedQueryStatements.clear();
+    m_cachedQueryStatements.emplace(queryStr, std::move(stmt));
   }
-  stmt.bindVariables(sqlVars);
-  return stmt.run(callback, cbParam, errmsg);
+  return res;
+}
+
+template<typename ID>
+sql::QueryVars GraphDB<ID>::mkQueryVars() const
+{
+  // The temporary tables of a query are not used by the queries run by its callbacks.
+  return sql::QueryVars{m_listBinding, "SYS__IN_LIST_" + std::to_string(m_countRunningQueries) + "_"};
+}
+
+template<typename ID>
+void GraphDB<ID>::insertTempTableList(const sql::QueryVars::TempTableList& list) const
+{
+  const char* msg{};
+  if(!m_tempTableLists.count(list.tableName))
+  {
+    if(auto res = runStatement("CREATE TEMP TABLE IF NOT EXISTS " + list.tableName + " (value PRIMARY KEY) WITHOUT ROWID;", {}, 0, 0, &msg))
+      throw std::logic_error(msg);
+    m_tempTableLists.insert(list.tableName);
+  }
+  sql::QueryVars vars;
+  const std::string req = "INSERT OR IGNORE INTO temp." + list.tableName + " SELECT value FROM " + vars.addVar(list.values) + ";";
+  if(auto res = runStatement(req, vars, 0, 0, &msg))
+    throw std::logic_error(msg);
+}
+
+template<typename ID>
+void GraphDB<ID>::clearTempTableList(const sql::QueryVars::TempTableList& list) const
+{
+  // Errors are ignored: this is called when a query ends, possibly by an exception.
+  runStatement("DELETE FROM temp." + list.tableName + ";", {}, 0, 0, nullptr);
 }
 
 template class GraphDB<int64_t>;
@@ -18,6 +18,7 @@
 
 #include "sqlite3.h"
 
+#include "AdjacencyIndex.h"
 #include "CypherAST.h"
 #include "SQLPreparedStatement.h"
 
@@ -58,18 +59,40 @@ struct GraphDB
   //   when |overwrite| is std::nullopt, the DB file is overwritten iff |dbPath| is std::nullopt
   //   when |overwrite| is NOT std::nullopt, the DB file is overwritten iff *overwrite == Overwrite::Yes
   //   Note: If the DB file is not overwritten, we infer the graph schema from it.
+  // @param idAllocation :
+  //   when |idAllocation| is std::nullopt, a new DB uses IDAllocation::Sequential and an existing DB uses
+  //   the id allocation scheme it was created with.
+  //   when |idAllocation| is NOT std::nullopt and the DB file is not overwritten, the function throws if
+  //   the DB was created with a different id allocation scheme.
+  //   IDAllocation::TypePartitioned is only supported for int64_t ids.
   GraphDB(const FuncOnSQLQuery& fOnSQLQuery,
           const FuncOnSQLQueryDuration& fOnSQLQueryDuration,
           const FuncOnDBDiagnosticContent& fOnDiagnostic,
           const std::optional<std::filesystem::path>& dbPath = std::nullopt,
-          const std::optional<Overwrite> overwrite = std::nullopt);
+          const std::optional<Overwrite> overwrite = std::nullopt,
+          const std::optional<IDAllocation> idAllocation = std::nullopt);
   ~GraphDB();
   
   // Creates a sql table.
   // todo support typed properties.
+  // @param indices : secondary indices to create on the properties of the type.
   void addType(std::string const& typeName,
                bool isNode,
-               std::vector<PropertySchema> const& properties);
+               std::vector<PropertySchema> const& properties,
+               std::vector<PropertyIndex> const& indices = {});
+
+  // Stores a copy of |property| of the node (or relationship) types in the nodes (or relationships) system table,
+  // so that filters and projections using this property are evaluated by the system relationships query in forEachPath,
+  // without querying the property tables.
+  // The property doesn't need to exist in any type yet, but all types having this property must use the same value type.
+  void addInlineProperty(const Element elem,
+                         PropertySchema const& property);
+
+  // Creates a secondary index on properties of an existing type.
+  // Throws if the type or one of the properties doesn't exist, or if a unique index
+  // cannot be created because some elements have the same values for the indexed properties.
+  void addIndex(std::string const& typeName,
+                PropertyIndex const& index);
   
   // When doing several inserts, it is best to have a transaction for many inserts.
   // TODO redesign API to remove this.
@@ -87,26 +110,98 @@ struct GraphDB
   // The property of entities and relationships that represents their ID.
   // It is a "system" property.
   PropertySchema const & idProperty() const { return m_idProperty; }
+
+  IDAllocation idAllocation() const { return m_idAllocation; }
+
+  SingleVariableFiltersEvaluation singleVariableFiltersEvaluation() const { return m_singleVariableFiltersEvaluation; }
+  void setSingleVariableFiltersEvaluation(const SingleVariableFiltersEvaluation e) { m_singleVariableFiltersEvaluation = e; }
+
+  // How the lists of the SQL queries (like the ids of IN filters) are bound.
+  sql::ListBinding listBinding() const { return m_listBinding; }
+  void setListBinding(const sql::ListBinding b) { m_listBinding = b; }
+
+  // When enabled (only for int64_t ids), the relationships are also kept in memory, indexed by node (see AdjacencyIndex),
+  // and forEachPath expands the relationships following the first relationship of a path with the 'neighbors'
+  // virtual table rather than with self joins of the relationships system table.
+  // The relationships are then expanded in the order of the path pattern, from its first node.
+  // Enabling it loads all the relationships in memory.
+  bool inMemoryAdjacency() const { return m_inMemoryAdjacency; }
+  void setInMemoryAdjacency(bool enabled);
+
+  // When enabled (the default), forEachPath expands the paths returning only properties of their last node
+  // hop by hop (see forEachPathByFrontiers), when the relationships of the hops cannot be the same relationship.
+  bool frontierExpansion() const { return m_frontierExpansion; }
+  void setFrontierExpansion(const bool enabled) { m_frontierExpansion = enabled; }
+
+  // When enabled (the default), the relationships of a path pattern that cannot be the same relationship
+  // (see maybeSameRelationship) are not compared to verify relationship uniqueness.
+  bool uniquenessConstraintsElimination() const { return m_uniquenessConstraintsElimination; }
+  void setUniquenessConstraintsElimination(const bool enabled) { m_uniquenessConstraintsElimination = enabled; }
   
+  // Returns true if the elements with |labels| can be sorted by |sortKeys| in SQL, using an index:
+  // the elements must all be in the same property table, and the first sort key must be the id property
+  // or the leading property of a (non-partial) index of this table.
+  // SQLite then walks the index in order, and stops as soon as the LIMIT is reached.
+  bool canSortInSQL(const Element,
+                    const openCypher::Labels& labels,
+                    const std::vector<PropertySortKey>& sortKeys) const;
+
+  // Returns the count of elements having one of the allowed |labels|.
+  // The counts of elements by type are maintained in the namedTypes system table, so no element is scanned.
+  int64_t countElements(const Element, const openCypher::Labels& labels) const;
+
   // |labels| is the list of possible labels. When empty, all labels are allowed.
+  // With Distinct::Yes, duplicate rows are removed in SQL.
+  // When some |propertyNames| are aggregations, they are computed in SQL, grouped by the other |propertyNames|.
+  // When |sortKeys| is not empty, the results are sorted by these keys in SQL, this requires canSortInSQL to be true.
+  // When |page| is not null, the results are a page of |limit| rows ordered by label and id (see PageKeys),
+  // there must be no aggregation, no sort key and no duplicate removal.
   void forEachElementPropertyWithLabelsIn(const Variable& var,
                                           const Element,
                                           const std::vector<ReturnClauseTerm>& propertyNames,
                                           const openCypher::Labels& labels,
                                           const std::vector<const Expression*>* filter,
+                                          const Distinct distinct,
+                                          const std::vector<PropertySortKey>& sortKeys,
                                           const std::optional<Limit>& limit,
-                                          const FuncResults& f);
+                                          const FuncResults& f,
+                                          PageKeys* page);
 
   struct VariableInfo {
     bool needsTypeInfo{};
     bool lookupProperties{};
+    // The properties used in evaluated filters (see analyzeFilters), gathered after the returned properties.
+    std::set<PropertyKeyName> evaluatedProperties;
   };
+  // With Distinct::Yes, duplicate rows are removed in SQL when the system relationships query returns
+  // exactly the returned values (i.e when only id or inline properties are returned and all filters are applied in this query),
+  // else with a hash set of the encoded returned values.
+  // |variablesI| must not contain aggregations: the caller aggregates the paths (see RowsAggregator).
+  // When |page| is not null, the results are a page of |limit| paths ordered by the ids of their relationships (see PageKeys),
+  // duplicate rows must not be removed.
   void forEachPath(const std::vector<TraversalDirection>& traversalDirections,
                    const std::map<Variable, std::vector<ReturnClauseTerm>>& variablesI,
                    const std::vector<PathPatternElement>& pathPattern,
                    const ExpressionsByVarsUsages& allFilters,
+                   const Distinct distinct,
                    const std::optional<Limit>& limit,
-                   const FuncResults& f);
+                   const FuncResults& f,
+                   PageKeys* page);
+
+  // Returns the shortest paths from the node |from| to the node |to| whose relationships are traversed in |direction|,
+  // have one of |relationshipTypes| (any type when empty), and are at most |maxDepth| (when it has a value).
+  // Each path is the ids of its nodes and relationships, in order: from, relationship, node, ..., relationship, to.
+  // With ShortestPaths::One a single shortest path is returned, else all shortest paths are returned, in no particular order.
+  //
+  // The paths are found by a bidirectional breadth-first search expanding the smaller frontier first,
+  // from |from| in |direction| and from |to| in the opposite direction. The relationships of a frontier are read
+  // from the in-memory adjacency when it is enabled, else with a single query on the relationships system table.
+  std::vector<std::vector<ID>> shortestPaths(const ID& from,
+                                             const ID& to,
+                                             const TraversalDirection direction,
+                                             const std::set<openCypher::Label>& relationshipTypes,
+                                             const std::optional<size_t> maxDepth,
+                                             const ShortestPaths which) const;
   
   // Time to run the SQL queries.
   mutable std::chrono::steady_clock::duration m_totalSQLQueryExecutionDuration{};
@@ -119,6 +214,18 @@ struct GraphDB
   
   const auto& typesAndProperties() const { return m_properties; }
 
+  const auto& typesAndIndices() const { return m_indices; }
+
+  const std::set<PropertySchema>& inlineProperties(const Element elem) const
+  {
+    return (elem == Element::Node) ? m_inlineNodeProperties : m_inlineRelationshipProperties;
+  }
+
+  const openCypher::IndexedLabels& indexedTypes(const Element elem) const
+  {
+    return (elem == Element::Node) ? m_indexedNodeTypes : m_indexedRelationshipTypes;
+  }
+
 private:
   PropertySchema m_idProperty{
     openCypher::mkProperty("SYS__ID"),
@@ -127,6 +234,14 @@ private:
   };
   
   sqlite3* m_db{};
+  IDAllocation m_idAllocation{IDAllocation::Sequential};
+  SingleVariableFiltersEvaluation m_singleVariableFiltersEvaluation{SingleVariableFiltersEvaluation::SQL};
+  sql::ListBinding m_listBinding{sql::ListBinding::Adaptive};
+  bool m_inMemoryAdjacency{};
+  bool m_frontierExpansion{true};
+  bool m_uniquenessConstraintsElimination{true};
+  // Read by the 'neighbors' virtual table, empty unless m_inMemoryAdjacency.
+  AdjacencyIndex m_adjacencyIndex;
   openCypher::IndexedLabels m_indexedNodeTypes;
   openCypher::IndexedLabels m_indexedRelationshipTypes;
   // auto-increment integer table columns start at 1 in sqlite.
@@ -134,6 +249,26 @@ private:
 
   // key : namedType.
   std::unordered_map<openCypher::Label, std::set<PropertySchema>> m_properties;
+
+  struct NamedPropertyIndex
+  {
+    // The name of the index in the DB.
+    std::string name;
+    PropertyIndex index;
+  };
+  // key : namedType.
+  std::unordered_map<openCypher::Label, std::vector<NamedPropertyIndex>> m_indices;
+
+  // The properties that have a copy in the system tables.
+  std::set<PropertySchema> m_inlineNodeProperties;
+  std::set<PropertySchema> m_inlineRelationshipProperties;
+
+  // The minimum count of candidate ids for which we consider using an index on a property
+  // instead of the primary key, in gatherPropertyValues.
+  static constexpr size_t c_minCandidatesForIndexedLookup{64};
+  // For a non-unique index, we use the index only if the predicate matches
+  // less than one element out of c_indexedLookupSelectivity candidates.
+  static constexpr size_t c_indexedLookupSelectivity{4};
   
   const FuncOnSQLQuery m_fOnSQLQuery;
   const FuncOnSQLQueryDuration m_fOnSQLQueryDuration;
@@ -146,6 +281,7 @@ private:
 
   using AddElementPreparedStatementKey = std::pair<openCypher::Label, std::vector<PropertyKeyName>>;
   std::map<AddElementPreparedStatementKey, std::unique_ptr<SQLPreparedStatement>> m_addElementPreparedStatements;
+  std::map<openCypher::Label, std::unique_ptr<SQLPreparedStatement>> m_setInlinePropertiesPreparedStatements;
 
   // The input labels are AND-ed labels constraints
   // The returned labels are OR-ed allowed labels
@@ -157,7 +293,8 @@ private:
   [[nodiscard]]
   bool findValidProperties(const openCypher::Label& typeName, const std::vector<PropertyKeyName>& propNames, std::vector<bool>& valid) const;
   
-  void addElement(const openCypher::Label& typeName,
+  void addElement(const Element elem,
+                  const openCypher::Label& typeName,
                   const ID& id,
                   const std::vector<std::pair<PropertyKeyName, Value>>& propValues);
   
@@ -170,26 +307,95 @@ private:
     std::vector<const openCypher::Expression*> filters;
   };
 
+  // The name of the system table containing the elements of kind |elem|.
+  static const char* systemTableName(const Element elem);
+
+  // Creates the triggers updating the counts of elements in the namedTypes table.
+  void createCountElementsTriggers();
+
+  // Creates the nodeDegrees table, containing the out-degree and in-degree of nodes by relationship type,
+  // and the trigger updating it when a relationship is added.
+  void createNodeDegreesTable();
+
+  // Returns true if |property| is the id property or an inline property of elements of kind |elem|,
+  // or a computed property of nodes (see openCypher::isComputedNodeProperty).
+  bool isSystemProperty(const Element elem, const PropertyKeyName& property) const;
+
+  // When |property| is a computed property of nodes, returns the SQL expression computing it
+  // for the node whose id is in |nodeIDColumn|: a lookup in the nodeDegrees table for a degree
+  // (see openCypher::DegreeFunction), or correlated EXISTS subqueries for a pattern predicate.
+  std::optional<std::string> computedPropertySQLExpression(const PropertyKeyName& property, const std::string& nodeIDColumn) const;
+
+  std::string patternPredicateSQLExpression(const openCypher::PatternPredicate& predicate, const std::string& nodeIDColumn) const;
+
+  // Maps the computed properties of |var| used in |filters| to their SQL expressions in |info|,
+  // and returns these properties so that the caller can add them to the SQL fields.
+  std::set<PropertySchema> mapComputedProperties(const std::vector<const Expression*>& filters,
+                                                 const Variable& var,
+                                                 const std::string& nodeIDColumn,
+                                                 VarQueryInfo& info) const;
+
+  // Returns the count of properties in |varsUsages| that are not system properties.
+  size_t countNonSystemProperties(const openCypher::VarsUsages& varsUsages,
+                                  const std::map<Variable, Element>& varToElement) const;
+
   // @param idAndLabelFilters: contains AND-ed constraints that can be applied in the system relationships query.
   // @param postFilters: contains AND-ed constraints that can be applied in the typed property tables query.
+  // @param evaluatedFilters: contains AND-ed constraints that are evaluated by a sql::FilterProgram
+  //   once the property values have been gathered, because they use non-system properties of several variables
+  //   (or of a single variable, with SingleVariableFiltersEvaluation::Native).
   //
   // The function throws if it encounters a constraint that cannot be applied.
   void analyzeFilters(const ExpressionsByVarsUsages& allFilters,
                       const std::map<Variable, std::vector<ReturnClauseTerm>>& variablesInfo,
+                      const std::map<Variable, Element>& varToElement,
                       std::vector<const Expression*>& idAndLabelFilters,
                       std::map<Variable, VariablePostFilters>& postFilters,
+                      std::vector<const Expression*>& evaluatedFilters,
                       std::map<Variable, VariableInfo>& varInfo) const;
   
   // Whether the type (aka label) information of a node or relationship needs to be returned from the relationships system table query.
   bool varRequiresTypeInfo(const Variable& var,
+                           const Element elem,
                            const std::vector<ReturnClauseTerm>& returnedProperties,
                            const std::map<Variable, VariablePostFilters>& postFilters) const;
   
   std::optional<std::set<sql::ElementTypeIndex>> computeTypeFilter(const Element e,
-                                                                   openCypher::Labels const & labels);
+                                                                   openCypher::Labels const & labels) const;
     
   static std::string mkFilterTypesConstraint(const std::set<sql::ElementTypeIndex>& typesFilter, sql::QueryColumnName const& typeColumn);
 
+  // In IDAllocation::TypePartitioned mode, the type index of an element is stored in the bits
+  // of its id starting at this position.
+  // Type indices are limited to 15 bits so that ids are positive.
+  static constexpr int c_typeIndexShift{48};
+  static constexpr size_t c_maxPartitionedTypeIndex{(1ull << (63 - c_typeIndexShift)) - 1ull};
+
+  // The CHECK constraint of the system tables in IDAllocation::TypePartitioned mode.
+  // It is also used to infer the id allocation scheme of an existing DB.
+  static std::string mkTypePartitionedIDCheck(const std::string& typeColumn);
+
+  // Returns the [begin, end) range of ids of elements of type |typeIdx|, in IDAllocation::TypePartitioned mode.
+  static std::pair<int64_t, int64_t> partitionedIDRange(sql::ElementTypeIndex typeIdx);
+
+  // In IDAllocation::TypePartitioned mode, we don't need the system nodes table to filter on types,
+  // we use range predicates on the id column instead.
+  static std::string mkFilterTypesRangeConstraint(const std::set<sql::ElementTypeIndex>& typesFilter, sql::QueryColumnName const& idColumn);
+
+  // Returns the expression evaluating to the type index of the element whose id is in |idColumn|,
+  // in IDAllocation::TypePartitioned mode.
+  static sql::QueryColumnName mkTypeFromPartitionedID(sql::QueryColumnName const& idColumn);
+
+  // In IDAllocation::TypePartitioned mode, returns the next id for the element type |typeIdx|.
+  int64_t allocatePartitionedID(const Element, sql::ElementTypeIndex typeIdx);
+  // In IDAllocation::TypePartitioned mode, verifies that |id| is in the range of |typeIdx| and
+  // makes sure that this id will not be allocated by allocatePartitionedID.
+  void onExplicitPartitionedID(const Value& id, sql::ElementTypeIndex typeIdx);
+
+  // key : type index, value : the next id to allocate for this type.
+  // Entries are created lazily, from the ids stored in the DB.
+  std::unordered_map<size_t, int64_t> m_nextPartitionedIDs;
+
   // Note that there are 2 "modes" for this function:
   // - the function is called with an empty elementType and a non-empty varsQueryInfo
   //   when we build a sql filter for the system relationships query, or
@@ -202,11 +408,83 @@ private:
                              std::string& sqlFilter,
                              sql::QueryVars & vars) const;
 
+  // Returns true if |filters| contain a predicate that is selective enough to look up the elements of type |label|
+  // using an index on a property rather than using the primary key with |countCandidates| ids.
+  bool preferIndexedLookup(const openCypher::Label& label,
+                           const Element elem,
+                           const std::vector<const openCypher::Expression*>& filters,
+                           const size_t countCandidates) const;
+
+  // Returns true if |property| is the leading property of a non-partial index of |label|.
+  bool isIndexedProperty(const openCypher::Label& label, const PropertyKeyName& property) const;
+
+  // The maximum count of elements a variable can be anchored on, in forEachPath.
+  static constexpr size_t c_maxAnchorIDs{1000};
+
+  // The count of candidate rows processed at once when emitting the rows in forEachPath.
+  static constexpr size_t c_filterBatchSize{1024};
+
+  struct AnchorIDs
+  {
+    size_t count{};
+    std::shared_ptr<typename CorrespondingVectorType<ID>::type> ids;
+  };
+
+  // Expands the paths with self joins of the relationships system table, in a single query.
+  // The variables of |boundIDs| are constrained to be one of their ids.
+  // When a page of paths has filters that are not applied in this query, the candidate paths are queried
+  // by batches of |countPageCandidates| paths (0 for the first batch), until the page is full.
+  void forEachPathBySelfJoins(const std::vector<TraversalDirection>& traversalDirections,
+                              const std::map<Variable, std::vector<ReturnClauseTerm>>& variablesI,
+                              const std::vector<PathPatternElement>& pathPattern,
+                              const ExpressionsByVarsUsages& allFilters,
+                              const Distinct distinct,
+                              const std::optional<Limit>& limit,
+                              const FuncResults& f,
+                              PageKeys* page,
+                              std::map<Variable, AnchorIDs> boundIDs,
+                              size_t countPageCandidates = 0);
+
+  // When only properties of the last node of the path are returned, and the filters use either the first node
+  // or the last node of the path, expands the paths hop by hop: each hop is a query on a single relationship
+  // starting from the distinct nodes reached by the previous hop (the frontier), with the count of paths reaching each of them.
+  // The queries then grow with the count of reachable nodes rather than with the count of paths.
+  //
+  // Relationship uniqueness is not verified across hops, so the relationships of the hops must not be able to be the same relationship:
+  // their types, or the types of the nodes they would have in common, must be disjoint.
+  //
+  // Returns false (and returns no row) when the path pattern doesn't satisfy these conditions.
+  bool forEachPathByFrontiers(const std::vector<TraversalDirection>& traversalDirections,
+                              const std::map<Variable, std::vector<ReturnClauseTerm>>& variablesI,
+                              const std::vector<PathPatternElement>& pathPattern,
+                              const ExpressionsByVarsUsages& allFilters,
+                              const Distinct distinct,
+                              const std::optional<Limit>& limit,
+                              const FuncResults& f);
+
+  // Calls |f| with the node, the relationship and the neighbor for each relationship of |nodes| traversed in |direction|
+  // whose type is in |typeFilter| (when it has a value).
+  void forEachRelationshipOf(const std::vector<ID>& nodes,
+                             const TraversalDirection direction,
+                             const std::optional<std::set<sql::ElementTypeIndex>>& typeFilter,
+                             const std::function<void(const ID& node, const ID& relationship, const ID& neighbor)>& f) const;
+
+  // Returns the ids of the elements matching the filters of |var|, when these filters
+  // contain predicates on indexed properties matching at most c_maxAnchorIDs elements.
+  //
+  // The system relationships query can then start from these elements instead of enumerating all relationships.
+  std::optional<AnchorIDs> computeAnchorIDs(const Variable& var,
+                                            const Element elem,
+                                            const openCypher::Labels& labels,
+                                            const std::vector<const openCypher::Expression*>& filters) const;
+
+  // When |anchored| is true, the ids of |var| were looked up by computeAnchorIDs.
   void gatherPropertyValues(const Variable& var,
                             std::vector<std::unordered_set<ID>>&& elemsByType,
                             const Element elem,
                             const std::vector<PropertyKeyName>& propertyNames,
                             const std::map<Variable, VariablePostFilters>& postFilters,
+                            bool anchored,
                             std::unordered_map<ID, std::vector<Value>>& properties) const;
   
   // this method is timed
@@ -216,11 +494,35 @@ private:
                    const char **errmsg,
                    const sql::QueryVars& sqlVars = {}) const;
   
+  // Read-only statements run by sqlite3_exec, by query string: the queries differing only by their bound variables
+  // are prepared once.
+  mutable std::unordered_map<std::string, std::unique_ptr<SQLPreparedStatement>> m_cachedQueryStatements;
+  static constexpr size_t c_maxCachedQueryStatements{256};
+
   int sqlite3_exec_notime(const std::string& queryStr,
                           const sql::QueryVars& arrayVariables,
                           int (*callback)(void*, int, Value*, char**),
                           void *,
                           const char **errmsg) const;
+
+  // Runs the statement, without inserting the lists bound in temporary tables.
+  int runStatement(const std::string& queryStr,
+                   const sql::QueryVars& sqlVars,
+                   int (*callback)(void*, int, Value*, char**),
+                   void *,
+                   const char **errmsg) const;
+
+  // Returns the variables of a query, binding lists according to m_listBinding.
+  sql::QueryVars mkQueryVars() const;
+
+  void insertTempTableList(const sql::QueryVars::TempTableList& list) const;
+  void clearTempTableList(const sql::QueryVars::TempTableList& list) const;
+
+  // The count of queries using temporary tables that are running (the others are run by their callbacks).
+  mutable unsigned m_countRunningQueries{};
+  // The temporary tables created for lists.
+  mutable std::set<std::string> m_tempTableLists;
+  mutable std::string m_lastErrorMessage;
   
   std::unique_ptr<SQLPreparedStatement> sqlite3_prepare(const std::string& queryStr);
   int sqlite3_step(int (*callback)(void*, int, Value*, char**),
@@ -32,6 +32,32 @@ struct ReturnClauseTerm
 
   // TODO support more later.
   openCypher::PropertyKeyName propertyName;
+
+  // When set, the term is an aggregation of the property values (count(*) is represented as a count of the ids).
+  // The terms that are not aggregations are the grouping keys.
+  std::optional<openCypher::AggregationFunction> aggregation;
+};
+
+// A key of an ORDER BY clause that is evaluated in SQL.
+struct PropertySortKey
+{
+  openCypher::PropertyKeyName propertyName;
+  openCypher::SortOrder order;
+};
+
+// Keyset pagination: the rows of a page are returned in the order of a key identifying them,
+// and a page starts after the key of the last row of the previous page, so that the cost of a page
+// doesn't depend on the count of rows returned by the previous pages.
+//
+// The key of an element is its label and its id, the key of a path is the ids of its relationships
+// (and their orientations, for undirected relationships).
+struct PageKeys
+{
+  // The key of the last row of the previous page, empty for the first page.
+  std::vector<Value> after;
+
+  // The key of the last row of the page when the page is full, empty otherwise (there is no next page).
+  std::vector<Value> last;
 };
 
 struct PathPatternElement
@@ -49,6 +75,50 @@ struct PathPatternElement
 
 enum class Overwrite{Yes, No};
 
+// Whether duplicate rows are removed from the results of a query (RETURN DISTINCT).
+enum class Distinct{Yes, No};
+
+// Whether GraphDB::shortestPaths returns a single shortest path, or all the shortest paths.
+enum class ShortestPaths{One, All};
+
+// How the DB allocates the ids of nodes and relationships for which the caller didn't specify an id.
+enum class IDAllocation{
+  // Ids are allocated sequentially by SQLite.
+  Sequential,
+  // Only for integer ids: the type index of an element is stored in the high bits of its id,
+  // so that the type of an element can be derived from its id, without a lookup in the system tables.
+  TypePartitioned
+};
+
+enum class IndexKind{
+  BTree,
+  // The index also enforces that no two elements of the type have the same values for the indexed properties.
+  Unique
+};
+
+// A secondary index on properties of a node or relationship type.
+struct PropertyIndex
+{
+  // The indexed properties, the first one is the leading column of the index.
+  std::vector<openCypher::PropertyKeyName> properties;
+
+  IndexKind kind{IndexKind::BTree};
+
+  // When this has a value, this is a partial index: only the elements for which
+  // this SQL expression (using property names as column names) evaluates to true are indexed.
+  std::optional<std::string> where;
+};
+
+
+// Where forEachPath evaluates the filters using a single variable and some of its non-id, non-inline properties.
+enum class SingleVariableFiltersEvaluation{
+  // In the queries on the property tables. These filters can then use the secondary indices.
+  SQL,
+  // Natively, once the property values have been gathered (see sql::FilterProgram).
+  // Comparisons with numeric constants are then evaluated by SIMD kernels.
+  Native
+};
+
 
 // Contains information to order results in the same order as they were specified in the return clause.
 using ResultOrder = std::vector<std::pair<
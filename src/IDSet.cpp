@@ -0,0 +1,417 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "IDSet.h"
+
+#include "sqlite3.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iterator>
+#include <optional>
+
+namespace
+{
+constexpr uint64_t c_signBit{1ull << 63};
+
+// The sign bit is flipped so that negative ids are ordered before positive ids.
+uint64_t toUnsigned(const int64_t id) { return static_cast<uint64_t>(id) ^ c_signBit; }
+int64_t toSigned(const uint64_t u) { return static_cast<int64_t>(u ^ c_signBit); }
+
+uint64_t highBits(const int64_t id) { return toUnsigned(id) >> 16; }
+uint16_t lowBits(const int64_t id) { return static_cast<uint16_t>(toUnsigned(id) & 0xFFFF); }
+} // NS
+
+bool IDSet::Container::contains(const uint16_t low) const
+{
+  if(isBitmap())
+    return (bitmap[low / 64] >> (low % 64)) & 1;
+  return std::binary_search(array.begin(), array.end(), low);
+}
+
+void IDSet::Container::toBitmap()
+{
+  bitmap.assign(c_bitmapWords, 0);
+  for(const uint16_t low : array)
+    bitmap[low / 64] |= 1ull << (low % 64);
+  array.clear();
+  array.shrink_to_fit();
+}
+
+void IDSet::Container::toArray()
+{
+  std::vector<uint16_t> values;
+  values.reserve(cardinality);
+  for(size_t w{}; w < bitmap.size(); ++w)
+    for(uint64_t word = bitmap[w]; word; word &= word - 1)
+      values.push_back(static_cast<uint16_t>(w * 64 + std::countr_zero(word)));
+  array = std::move(values);
+  bitmap.clear();
+  bitmap.shrink_to_fit();
+}
+
+void IDSet::Container::optimize()
+{
+  if(isBitmap())
+  {
+    cardinality = 0;
+    for(const uint64_t word : bitmap)
+      cardinality += static_cast<uint32_t>(std::popcount(word));
+    if(cardinality <= c_maxArrayCardinality)
+      toArray();
+  }
+  else
+  {
+    cardinality = static_cast<uint32_t>(array.size());
+    if(cardinality > c_maxArrayCardinality)
+      toBitmap();
+  }
+}
+
+bool IDSet::insert(const int64_t id)
+{
+  const uint64_t key = highBits(id);
+  const uint16_t low = lowBits(id);
+  auto it = std::lower_bound(m_containers.begin(), m_containers.end(), key, [](const Container& c, const uint64_t k){ return c.key < k; });
+  if(it == m_containers.end() || it->key != key)
+  {
+    it = m_containers.insert(it, Container{});
+    it->key = key;
+  }
+  if(it->isBitmap())
+  {
+    uint64_t & word = it->bitmap[low / 64];
+    const uint64_t bit = 1ull << (low % 64);
+    if(word & bit)
+      return false;
+    word |= bit;
+    ++it->cardinality;
+    return true;
+  }
+  auto pos = std::lower_bound(it->array.begin(), it->array.end(), low);
+  if(pos != it->array.end() && *pos == low)
+    return false;
+  it->array.insert(pos, low);
+  ++it->cardinality;
+  if(it->cardinality > c_maxArrayCardinality)
+    it->toBitmap();
+  return true;
+}
+
+bool IDSet::contains(const int64_t id) const
+{
+  const uint64_t key = highBits(id);
+  const auto it = std::lower_bound(m_containers.begin(), m_containers.end(), key, [](const Container& c, const uint64_t k){ return c.key < k; });
+  return it != m_containers.end() && it->key == key && it->contains(lowBits(id));
+}
+
+size_t IDSet::size() const
+{
+  size_t count{};
+  for(const auto & c : m_containers)
+    count += c.cardinality;
+  return count;
+}
+
+IDSet& IDSet::operator |= (const IDSet& other)
+{
+  std::vector<Container> merged;
+  merged.reserve(m_containers.size() + other.m_containers.size());
+  auto it = m_containers.begin();
+  auto otherIt = other.m_containers.begin();
+  while(it != m_containers.end() || otherIt != other.m_containers.end())
+  {
+    if(otherIt == other.m_containers.end() || (it != m_containers.end() && it->key < otherIt->key))
+      merged.push_back(std::move(*it++));
+    else if(it == m_containers.end() || otherIt->key < it->key)
+      merged.push_back(*otherIt++);
+    else
+    {
+      Container & c = *it;
+      const Container & o = *otherIt;
+      if(!c.isBitmap() && !o.isBitmap())
+      {
+        std::vector<uint16_t> values;
+        values.reserve(c.array.size() + o.array.size());
+        std::set_union(c.array.begin(), c.array.end(), o.array.begin(), o.array.end(), std::back_inserter(values));
+        c.array = std::move(values);
+      }
+      else
+      {
+        if(!c.isBitmap())
+          c.toBitmap();
+        if(o.isBitmap())
+          for(size_t w{}; w < c_bitmapWords; ++w)
+            c.bitmap[w] |= o.bitmap[w];
+        else
+          for(const uint16_t low : o.array)
+            c.bitmap[low / 64] |= 1ull << (low % 64);
+      }
+      c.optimize();
+      merged.push_back(std::move(c));
+      ++it;
+      ++otherIt;
+    }
+  }
+  m_containers = std::move(merged);
+  return *this;
+}
+
+IDSet& IDSet::operator -= (const IDSet& other)
+{
+  auto otherIt = other.m_containers.begin();
+  for(auto & c : m_containers)
+  {
+    while(otherIt != other.m_containers.end() && otherIt->key < c.key)
+      ++otherIt;
+    if(otherIt == other.m_containers.end())
+      break;
+    if(otherIt->key != c.key)
+      continue;
+    const Container & o = *otherIt;
+    if(!c.isBitmap())
+      c.array.erase(std::remove_if(c.array.begin(), c.array.end(), [&](const uint16_t low){ return o.contains(low); }), c.array.end());
+    else if(o.isBitmap())
+      for(size_t w{}; w < c_bitmapWords; ++w)
+        c.bitmap[w] &= ~o.bitmap[w];
+    else
+      for(const uint16_t low : o.array)
+        c.bitmap[low / 64] &= ~(1ull << (low % 64));
+    c.optimize();
+  }
+  m_containers.erase(std::remove_if(m_containers.begin(), m_containers.end(), [](const Container& c){ return c.cardinality == 0; }), m_containers.end());
+  return *this;
+}
+
+// Containers use an array if and only if they have at most c_maxArrayCardinality ids,
+// so equal sets have the same representation.
+bool operator == (const IDSet& a, const IDSet& b)
+{
+  return std::equal(a.m_containers.begin(), a.m_containers.end(), b.m_containers.begin(), b.m_containers.end(),
+                    [](const IDSet::Container& c, const IDSet::Container& d){
+    return c.key == d.key && c.cardinality == d.cardinality && c.array == d.array && c.bitmap == d.bitmap;
+  });
+}
+
+size_t IDSet::sizeInBytes() const
+{
+  size_t count{m_containers.capacity() * sizeof(Container)};
+  for(const auto & c : m_containers)
+    count += c.array.capacity() * sizeof(uint16_t) + c.bitmap.capacity() * sizeof(uint64_t);
+  return count;
+}
+
+IDSet::const_iterator::const_iterator(const IDSet& set, const size_t container)
+: m_set(&set)
+, m_container(container)
+{
+  seek();
+}
+
+void IDSet::const_iterator::seek()
+{
+  const auto & containers = m_set->m_containers;
+  for(; m_container < containers.size(); ++m_container, m_pos = 0)
+  {
+    const Container & c = containers[m_container];
+    if(!c.isBitmap())
+    {
+      if(m_pos < c.array.size())
+        return;
+      continue;
+    }
+    for(size_t w = m_pos / 64; w < c_bitmapWords; ++w)
+    {
+      uint64_t word = c.bitmap[w];
+      if(w == m_pos / 64)
+        word &= ~0ull << (m_pos % 64);
+      if(word)
+      {
+        m_pos = static_cast<uint32_t>(w * 64 + std::countr_zero(word));
+        return;
+      }
+    }
+  }
+}
+
+int64_t IDSet::const_iterator::operator *() const
+{
+  const Container & c = m_set->m_containers[m_container];
+  const uint64_t low = c.isBitmap() ? m_pos : c.array[m_pos];
+  return toSigned((c.key << 16) | low);
+}
+
+IDSet::const_iterator& IDSet::const_iterator::operator ++()
+{
+  ++m_pos;
+  seek();
+  return *this;
+}
+
+namespace
+{
+// The 'idset' table-valued function, modeled after the carray extension:
+// 'SELECT value FROM idset(?1)' where ?1 is bound with sqlite3_bind_pointer(stmt, 1, &idSet, "idset", nullptr).
+constexpr const char* c_idsetPointerType{"idset"};
+
+enum IDSetColumn
+{
+  ColumnValue = 0,
+  ColumnPointer = 1
+};
+
+struct IDSetCursor : sqlite3_vtab_cursor
+{
+  std::optional<IDSet::const_iterator> it;
+  std::optional<IDSet::const_iterator> end;
+  sqlite3_int64 rowid{};
+};
+
+int idsetConnect(sqlite3 *db, void *, int, const char *const*, sqlite3_vtab **ppVtab, char **)
+{
+  const int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(value, pointer HIDDEN)");
+  if(rc != SQLITE_OK)
+    return rc;
+  *ppVtab = static_cast<sqlite3_vtab*>(sqlite3_malloc(sizeof(sqlite3_vtab)));
+  if(!*ppVtab)
+    return SQLITE_NOMEM;
+  memset(*ppVtab, 0, sizeof(sqlite3_vtab));
+  return SQLITE_OK;
+}
+
+int idsetDisconnect(sqlite3_vtab *pVtab)
+{
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+int idsetOpen(sqlite3_vtab *, sqlite3_vtab_cursor **ppCursor)
+{
+  *ppCursor = new IDSetCursor{};
+  return SQLITE_OK;
+}
+
+int idsetClose(sqlite3_vtab_cursor *cur)
+{
+  delete static_cast<IDSetCursor*>(cur);
+  return SQLITE_OK;
+}
+
+int idsetFilter(sqlite3_vtab_cursor *cur, int idxNum, const char *, int argc, sqlite3_value **argv)
+{
+  auto * cursor = static_cast<IDSetCursor*>(cur);
+  cursor->it.reset();
+  cursor->end.reset();
+  cursor->rowid = 0;
+  if(idxNum == 1 && argc == 1)
+  {
+    if(const auto * ids = static_cast<const IDSet*>(sqlite3_value_pointer(argv[0], c_idsetPointerType)))
+    {
+      cursor->it.emplace(ids->begin());
+      cursor->end.emplace(ids->end());
+    }
+  }
+  return SQLITE_OK;
+}
+
+int idsetNext(sqlite3_vtab_cursor *cur)
+{
+  auto * cursor = static_cast<IDSetCursor*>(cur);
+  ++*cursor->it;
+  ++cursor->rowid;
+  return SQLITE_OK;
+}
+
+int idsetEof(sqlite3_vtab_cursor *cur)
+{
+  const auto * cursor = static_cast<const IDSetCursor*>(cur);
+  return !cursor->it.has_value() || *cursor->it == *cursor->end;
+}
+
+int idsetColumn(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int i)
+{
+  const auto * cursor = static_cast<const IDSetCursor*>(cur);
+  if(i == IDSetColumn::ColumnValue)
+    sqlite3_result_int64(ctx, **cursor->it);
+  return SQLITE_OK;
+}
+
+int idsetRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid)
+{
+  *pRowid = static_cast<const IDSetCursor*>(cur)->rowid;
+  return SQLITE_OK;
+}
+
+int idsetBestIndex(sqlite3_vtab *, sqlite3_index_info *pIdxInfo)
+{
+  int ptrIdx = -1;
+  for(int i{}; i < pIdxInfo->nConstraint; ++i)
+  {
+    const auto & constraint = pIdxInfo->aConstraint[i];
+    if(constraint.usable && constraint.op == SQLITE_INDEX_CONSTRAINT_EQ && constraint.iColumn == IDSetColumn::ColumnPointer)
+      ptrIdx = i;
+  }
+  if(ptrIdx < 0)
+  {
+    pIdxInfo->estimatedCost = 2147483647.;
+    pIdxInfo->estimatedRows = 2147483647;
+    pIdxInfo->idxNum = 0;
+    return SQLITE_OK;
+  }
+  pIdxInfo->aConstraintUsage[ptrIdx].argvIndex = 1;
+  pIdxInfo->aConstraintUsage[ptrIdx].omit = 1;
+  pIdxInfo->estimatedCost = 1.;
+  pIdxInfo->estimatedRows = 100;
+  pIdxInfo->idxNum = 1;
+  // The ids are returned in increasing order.
+  if(pIdxInfo->nOrderBy == 1 && pIdxInfo->aOrderBy[0].iColumn == IDSetColumn::ColumnValue && !pIdxInfo->aOrderBy[0].desc)
+    pIdxInfo->orderByConsumed = 1;
+  return SQLITE_OK;
+}
+
+sqlite3_module idsetModule = {
+  0,                         /* iVersion */
+  0,                         /* xCreate */
+  idsetConnect,              /* xConnect */
+  idsetBestIndex,            /* xBestIndex */
+  idsetDisconnect,           /* xDisconnect */
+  0,                         /* xDestroy */
+  idsetOpen,                 /* xOpen - open a cursor */
+  idsetClose,                /* xClose - close a cursor */
+  idsetFilter,               /* xFilter - configure scan constraints */
+  idsetNext,                 /* xNext - advance a cursor */
+  idsetEof,                  /* xEof - check for end of scan */
+  idsetColumn,               /* xColumn - read data */
+  idsetRowid,                /* xRowid - read data */
+  0,                         /* xUpdate */
+  0,                         /* xBegin */
+  0,                         /* xSync */
+  0,                         /* xCommit */
+  0,                         /* xRollback */
+  0,                         /* xFindMethod */
+  0,                         /* xRename */
+  0,                         /* xSavepoint */
+  0,                         /* xRelease */
+  0,                         /* xRollbackTo */
+  0                          /* xShadowName */
+};
+} // NS
+
+int sqlite3_idset_init(sqlite3* db)
+{
+  return sqlite3_create_module(db, c_idsetPointerType, &idsetModule, nullptr);
+}
@@ -0,0 +1,119 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+struct sqlite3;
+
+// A compressed set of integer ids, like roaring bitmaps:
+// ids are grouped by their high 48 bits, and the low 16 bits of the ids of a group are stored
+// in a sorted array when the group has few ids, or in a bitmap of 2^16 bits otherwise.
+//
+// Dense sets of ids (like the ids allocated sequentially by the DB) then use about 1 bit per id,
+// and sparse sets 2 bytes per id.
+//
+// It can be passed as a list query parameter: it is bound to the SQL queries with the 'idset' virtual table,
+// without being converted to an array.
+class IDSet
+{
+public:
+  // Returns true if |id| was not in the set.
+  bool insert(int64_t id);
+
+  bool contains(int64_t id) const;
+
+  size_t size() const;
+  bool empty() const { return m_containers.empty(); }
+  void clear() { m_containers.clear(); }
+
+  // Union
+  IDSet& operator |= (const IDSet& other);
+  // Difference
+  IDSet& operator -= (const IDSet& other);
+
+  friend bool operator == (const IDSet& a, const IDSet& b);
+
+  // The count of bytes used by the ids.
+  size_t sizeInBytes() const;
+
+  // Iterates the ids in increasing order.
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = int64_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const int64_t*;
+    using reference = int64_t;
+
+    const_iterator() = default;
+
+    int64_t operator *() const;
+    const_iterator& operator ++();
+    const_iterator operator ++(int) { auto copy = *this; ++*this; return copy; }
+    friend bool operator == (const const_iterator& a, const const_iterator& b)
+    { return a.m_container == b.m_container && a.m_pos == b.m_pos; }
+
+  private:
+    friend class IDSet;
+    const_iterator(const IDSet& set, size_t container);
+
+    const IDSet* m_set{};
+    size_t m_container{};
+    // The index in the array, or the bit in the bitmap.
+    uint32_t m_pos{};
+
+    // Moves to the first id at or after the current position.
+    void seek();
+  };
+
+  const_iterator begin() const { return const_iterator{*this, 0}; }
+  const_iterator end() const { return const_iterator{*this, m_containers.size()}; }
+
+private:
+  // Containers having more ids use a bitmap.
+  static constexpr size_t c_maxArrayCardinality{4096};
+  static constexpr size_t c_bitmapWords{(1u << 16) / 64};
+
+  struct Container
+  {
+    // The high 48 bits of the ids.
+    uint64_t key{};
+    // The sorted low 16 bits of the ids, when bitmap is empty.
+    std::vector<uint16_t> array;
+    std::vector<uint64_t> bitmap;
+    uint32_t cardinality{};
+
+    bool isBitmap() const { return !bitmap.empty(); }
+    bool contains(uint16_t low) const;
+    void toBitmap();
+    void toArray();
+    // Uses the most compact representation for the cardinality.
+    void optimize();
+  };
+
+  // Sorted by key.
+  std::vector<Container> m_containers;
+};
+
+// Registers the 'idset' eponymous virtual table in |db|: 'SELECT value FROM idset(?1)' returns the ids
+// (in increasing order) of the IDSet bound to ?1 with sqlite3_bind_pointer(..., "idset", ...).
+int sqlite3_idset_init(sqlite3* db);
@@ -35,6 +35,59 @@ std::shared_ptr<Expression> tryStealAsExpressionPtr(std::any && res)
   else
     return {};
 }
+
+// Rewrites a pattern predicate as the comparison of a reserved property of its node variable with 1 (see PatternPredicate).
+// Returns an error message when the pattern is not supported.
+std::variant<ComparisonExpression, std::string> mkPatternPredicateExpression(const PatternElement& pe)
+{
+  const auto & chains = pe.patternElementChains;
+  if(chains.empty())
+    return "a pattern predicate expects relationships.";
+  for(size_t k{}; k+1 < chains.size(); ++k)
+    if(chains[k].nodePattern.mayVariable.has_value())
+      return "a pattern predicate expects a variable only on the first or last node.";
+  for(const auto & chain : chains)
+    if(chain.relPattern.mayVariable.has_value())
+      return "a pattern predicate expects no relationship variable.";
+  const bool firstIsVariable = pe.firstNodePattern.mayVariable.has_value();
+  const bool lastIsVariable = chains.back().nodePattern.mayVariable.has_value();
+  if(firstIsVariable == lastIsVariable)
+    return "a pattern predicate expects a variable on exactly one of the first and last nodes.";
+  const NodePattern& variableNode = firstIsVariable ? pe.firstNodePattern : chains.back().nodePattern;
+  if(!variableNode.labels.empty())
+    return "a pattern predicate expects no label on the node variable.";
+
+  PatternPredicate predicate;
+  if(firstIsVariable)
+    for(const auto & chain : chains)
+      predicate.steps.push_back({chain.relPattern.traversalDirection, chain.relPattern.labels, chain.nodePattern.labels});
+  else
+    // The steps start at the last node.
+    for(size_t k = chains.size(); k--;)
+    {
+      TraversalDirection direction = chains[k].relPattern.traversalDirection;
+      if(direction == TraversalDirection::Forward)
+        direction = TraversalDirection::Backward;
+      else if(direction == TraversalDirection::Backward)
+        direction = TraversalDirection::Forward;
+      const NodePattern& node = k ? chains[k-1].nodePattern : pe.firstNodePattern;
+      predicate.steps.push_back({direction, chains[k].relPattern.labels, node.labels});
+    }
+
+  ComparisonExpression res;
+  res.leftExp.atom = Atom{*variableNode.mayVariable};
+  try
+  {
+    res.leftExp.mayPropertyName = mkPatternPredicateProperty(predicate);
+  }
+  catch(const std::invalid_argument& e)
+  {
+    return e.what();
+  }
+  res.partial.comp = Comparison::EQ;
+  res.partial.rightExp.atom = Atom{Literal{std::make_shared<Value>(int64_t{1})}};
+  return res;
+}
 } // NS
 
 std::string trim(const char c, std::string && str)
@@ -152,8 +205,10 @@ std::any MyCypherVisitor::visitOC_SingleQuery(CypherParser::OC_SingleQueryContex
   auto res = context->children[0]->accept(this);
   if(res.type() == typeid(SinglePartQuery))
     sq.singlePartQuery = std::move(std::any_cast<SinglePartQuery>(res));
+  else if(res.type() == typeid(SingleQuery))
+    sq = std::move(std::any_cast<SingleQuery>(res));
   else
-    m_errors.push_back("OC_SingleQuery only supports SinglePartQuery for now.");
+    m_errors.push_back("OC_SingleQuery only supports SinglePartQuery and MultiPartQuery for now.");
   return sq;
 }
 
@@ -165,7 +220,9 @@ std::any MyCypherVisitor::visitOC_SinglePartQuery(CypherParser::OC_SinglePartQue
   {
     auto res = child->accept(this);
     if(res.type() == typeid(ReadingClause))
-      spq.mayReadingClause = std::move(std::any_cast<ReadingClause>(res));
+      addReadingClause("OC_SinglePartQuery", std::move(std::any_cast<ReadingClause>(res)), spq.mayReadingClause, spq.optionalMatches);
+    else if(res.type() == typeid(Unwind))
+      addUnwind("OC_SinglePartQuery", std::move(std::any_cast<Unwind>(res)), spq.mayUnwind, spq.mayReadingClause);
     else if(res.type() == typeid(Return))
     {
       ++countReturn;
@@ -177,9 +234,61 @@ std::any MyCypherVisitor::visitOC_SinglePartQuery(CypherParser::OC_SinglePartQue
   return spq;
 }
 
+void MyCypherVisitor::addReadingClause(const char* clauseName,
+                                       ReadingClause&& readingClause,
+                                       std::optional<ReadingClause>& mayReadingClause,
+                                       std::vector<Match>& optionalMatches) {
+  if(!mayReadingClause.has_value())
+  {
+    if(readingClause.match.optional)
+      m_errors.push_back(std::string{clauseName} + " does not support OPTIONAL MATCH as first reading clause.");
+    mayReadingClause = std::move(readingClause);
+  }
+  else if(readingClause.match.optional)
+    optionalMatches.push_back(std::move(readingClause.match));
+  else
+    m_errors.push_back(std::string{clauseName} + " only supports OPTIONAL MATCH after the first reading clause.");
+}
+
+void MyCypherVisitor::addUnwind(const char* clauseName,
+                                Unwind&& unwind,
+                                std::optional<Unwind>& mayUnwind,
+                                const std::optional<ReadingClause>& mayReadingClause) {
+  if(mayUnwind.has_value())
+    m_errors.push_back(std::string{clauseName} + " only supports a single UNWIND clause.");
+  else if(mayReadingClause.has_value())
+    m_errors.push_back(std::string{clauseName} + " only supports UNWIND before the first reading clause.");
+  else
+    mayUnwind = std::move(unwind);
+}
+
 std::any MyCypherVisitor::visitOC_MultiPartQuery(CypherParser::OC_MultiPartQueryContext *context) {
-  m_errors.push_back("OC_MultiPartQuery not supported");
-  return defaultVisit("MultiPartQuery", __LINE__, context);
+  auto _ = scope("MultiPartQuery");
+  SingleQuery sq;
+  QueryPart part;
+  size_t countSinglePartQuery{};
+  for(const auto & child : context->children)
+  {
+    auto res = child->accept(this);
+    if(res.type() == typeid(ReadingClause))
+      addReadingClause("OC_MultiPartQuery", std::move(std::any_cast<ReadingClause>(res)), part.mayReadingClause, part.optionalMatches);
+    else if(res.type() == typeid(Unwind))
+      addUnwind("OC_MultiPartQuery", std::move(std::any_cast<Unwind>(res)), part.mayUnwind, part.mayReadingClause);
+    else if(res.type() == typeid(With))
+    {
+      part.with = std::move(std::any_cast<With>(res));
+      sq.queryParts.push_back(std::move(part));
+      part = {};
+    }
+    else if(res.type() == typeid(SinglePartQuery))
+    {
+      ++countSinglePartQuery;
+      sq.singlePartQuery = std::move(std::any_cast<SinglePartQuery>(res));
+    }
+  }
+  if(countSinglePartQuery != 1)
+    m_errors.push_back("OC_MultiPartQuery expects single SinglePartQuery.");
+  return sq;
 }
 
 std::any MyCypherVisitor::visitOC_UpdatingClause(CypherParser::OC_UpdatingClauseContext *context) {
@@ -198,14 +307,17 @@ std::any MyCypherVisitor::visitOC_ReadingClause(CypherParser::OC_ReadingClauseCo
   auto res = context->children[0]->accept(this);
   if(res.type() == typeid(Match))
     r.match = std::move(std::any_cast<Match>(res));
+  else if(res.type() == typeid(Unwind))
+    return res;
   else
-    m_errors.push_back("OC_ReadingClause only supports MATCH for now.");
+    m_errors.push_back("OC_ReadingClause only supports MATCH and UNWIND for now.");
   return r;
 }
 
 std::any MyCypherVisitor::visitOC_Match(CypherParser::OC_MatchContext *context) {
   auto _ = scope("Match");
   Match m;
+  m.optional = context->OPTIONAL() != nullptr;
   for(const auto & child : context->children)
   {
     auto res = child->accept(this);
@@ -218,8 +330,29 @@ std::any MyCypherVisitor::visitOC_Match(CypherParser::OC_MatchContext *context)
 }
 
 std::any MyCypherVisitor::visitOC_Unwind(CypherParser::OC_UnwindContext *context) {
-  m_errors.push_back("OC_Unwind not supported");
-  return defaultVisit("Unwind", __LINE__, context);
+  auto _ = scope("Unwind");
+  Unwind u;
+  auto var = context->oC_Variable()->accept(this);
+  if(var.type() != typeid(Variable))
+  {
+    m_errors.push_back("OC_Unwind expects a variable.");
+    return {};
+  }
+  u.variable = std::move(std::any_cast<Variable>(var));
+  auto res = context->oC_Expression()->accept(this);
+  if(res.type() == typeid(NonArithmeticOperatorExpression))
+  {
+    auto & nao = std::any_cast<NonArithmeticOperatorExpression&>(res);
+    if(!nao.mayPropertyName.has_value() && nao.labels.empty() && !nao.mayAggregation.has_value())
+      if(auto * literal = std::get_if<Literal>(&nao.atom.var))
+        if(std::holds_alternative<HomogeneousNonNullableValues>(literal->variant))
+        {
+          u.list = std::move(*literal);
+          return u;
+        }
+  }
+  m_errors.push_back("OC_Unwind only supports list literals and list parameters.");
+  return {};
 }
 
 std::any MyCypherVisitor::visitOC_Merge(CypherParser::OC_MergeContext *context) { return defaultVisit("Merge", __LINE__, context); }
@@ -253,8 +386,23 @@ std::any MyCypherVisitor::visitOC_YieldItems(CypherParser::OC_YieldItemsContext
 std::any MyCypherVisitor::visitOC_YieldItem(CypherParser::OC_YieldItemContext *context) { return defaultVisit("YieldItem", __LINE__, context); }
 
 std::any MyCypherVisitor::visitOC_With(CypherParser::OC_WithContext *context) {
-  m_errors.push_back("OC_With not supported");
-  return defaultVisit("With", __LINE__, context);
+  auto _ = scope("With");
+  With w;
+  size_t countProjectionBody{};
+  for(const auto & child : context->children)
+  {
+    auto res = child->accept(this);
+    if(res.type() == typeid(ProjectionBody))
+    {
+      ++countProjectionBody;
+      w.projectionBody = std::move(std::any_cast<ProjectionBody>(res));
+    }
+    else if(res.type() == typeid(WhereClause))
+      w.where = std::move(std::any_cast<WhereClause>(res));
+  }
+  if(countProjectionBody != 1)
+    m_errors.push_back("OC_With expects single projection body.");
+  return w;
 }
 
 std::any MyCypherVisitor::visitOC_Return(CypherParser::OC_ReturnContext *context) {
@@ -272,11 +420,7 @@ std::any MyCypherVisitor::visitOC_Return(CypherParser::OC_ReturnContext *context
 std::any MyCypherVisitor::visitOC_ProjectionBody(CypherParser::OC_ProjectionBodyContext *context) {
   auto _ = scope("ProjectionBody");
   ProjectionBody body;
-  if(auto * projItems = context->DISTINCT())
-  {
-    m_errors.push_back("todo: support DISTINCT");
-    return {};
-  }
+  body.distinct = context->DISTINCT() != nullptr;
   if(auto * p = context->oC_Limit())
   {
     auto limit = p->accept(this);
@@ -290,10 +434,13 @@ std::any MyCypherVisitor::visitOC_ProjectionBody(CypherParser::OC_ProjectionBody
     m_errors.push_back("todo: support SKIP");
     return {};
   }
-  if(auto * projItems = context->oC_Order())
+  if(auto * p = context->oC_Order())
   {
-    m_errors.push_back("todo: support ORDER");
-    return {};
+    auto order = p->accept(this);
+    if(order.type() == typeid(Order))
+      body.order = std::move(std::any_cast<Order>(order));
+    else
+      m_errors.push_back("ProjectionBody: expected ORDER");
   }
   if(auto * projItems = context->oC_ProjectionItems())
   {
@@ -363,7 +510,22 @@ std::any MyCypherVisitor::visitOC_ProjectionItem(CypherParser::OC_ProjectionItem
   return {};
 }
 
-std::any MyCypherVisitor::visitOC_Order(CypherParser::OC_OrderContext *context) { return defaultVisit("Order", __LINE__, context); }
+std::any MyCypherVisitor::visitOC_Order(CypherParser::OC_OrderContext *context) {
+  auto _ = scope("Order");
+  Order order;
+  for(const auto & sortItem : context->oC_SortItem())
+  {
+    auto res = sortItem->accept(this);
+    if(res.type() == typeid(SortItem))
+      order.sortItems.push_back(std::move(std::any_cast<SortItem>(res)));
+    else
+    {
+      m_errors.push_back("OC_Order expects SortItem");
+      return {};
+    }
+  }
+  return order;
+}
 
 std::any MyCypherVisitor::visitOC_Skip(CypherParser::OC_SkipContext *context) { return defaultVisit("Skip", __LINE__, context); }
 
@@ -393,7 +555,25 @@ std::any MyCypherVisitor::visitOC_Limit(CypherParser::OC_LimitContext *context)
   return defaultVisit("Limit", __LINE__, context);
 }
 
-std::any MyCypherVisitor::visitOC_SortItem(CypherParser::OC_SortItemContext *context) { return defaultVisit("SortItem", __LINE__, context); }
+std::any MyCypherVisitor::visitOC_SortItem(CypherParser::OC_SortItemContext *context) {
+  auto _ = scope("SortItem");
+  if(auto * p = context->oC_Expression())
+  {
+    auto exp = p->accept(this);
+    if(exp.type() != typeid(NonArithmeticOperatorExpression))
+    {
+      m_errors.push_back("OC_SortItem expects NonArithmeticOperatorExpression");
+      return {};
+    }
+    return SortItem{
+      std::move(std::any_cast<NonArithmeticOperatorExpression>(exp)),
+      (context->DESCENDING() || context->DESC()) ? SortOrder::Descending : SortOrder::Ascending
+    };
+  }
+  else
+    m_errors.push_back("OC_SortItem expects oC_Expression");
+  return {};
+}
 
 std::any MyCypherVisitor::visitOC_Where(CypherParser::OC_WhereContext *context) {
   auto _ = scope("WhereContext");
@@ -458,7 +638,19 @@ std::any MyCypherVisitor::visitOC_PatternElement(CypherParser::OC_PatternElement
   return pe;
 }
 
-std::any MyCypherVisitor::visitOC_RelationshipsPattern(CypherParser::OC_RelationshipsPatternContext *context) { return defaultVisit("Relationships", __LINE__, context); }
+std::any MyCypherVisitor::visitOC_RelationshipsPattern(CypherParser::OC_RelationshipsPatternContext *context) {
+  auto _ = scope("RelationshipsPattern");
+  PatternElement pe;
+  for(const auto & child : context->children)
+  {
+    auto res = child->accept(this);
+    if(res.type() == typeid(NodePattern))
+      pe.firstNodePattern = std::move(std::any_cast<NodePattern>(res));
+    else if(res.type() == typeid(PatternElementChain))
+      pe.patternElementChains.push_back(std::move(std::any_cast<PatternElementChain>(res)));
+  }
+  return pe;
+}
 
 std::any MyCypherVisitor::visitOC_NodePattern(CypherParser::OC_NodePatternContext *context) {
   auto _ = scope("NodePattern");
@@ -929,6 +1121,14 @@ std::any MyCypherVisitor::visitOC_PropertyLookup(CypherParser::OC_PropertyLookup
 
 std::any MyCypherVisitor::visitOC_Atom(CypherParser::OC_AtomContext *context) {
   auto _ = scope("Atom");
+  if(context->COUNT())
+  {
+    // count(*)
+    NonArithmeticOperatorExpression res;
+    res.atom = Atom{Literal{std::make_shared<Value>()}};
+    res.mayAggregation = AggregationFunction::CountRows;
+    return res;
+  }
   if(context->children.size() != 1)
   {
     m_errors.push_back("OC_Atom Expected size of children 1");
@@ -948,6 +1148,7 @@ std::any MyCypherVisitor::visitOC_Atom(CypherParser::OC_AtomContext *context) {
     return Atom{std::move(std::any_cast<StringListNullPredicateExpression>(res)).StealAsPtr()};
   else if(res.type() == typeid(NonArithmeticOperatorExpression))
     // To support the id(...) function, we rewrite the function call into a property access.
+    // Aggregation function calls are also returned as NonArithmeticOperatorExpression.
     return res;
   else
     m_errors.push_back("unsupported alternative in OC_Atom");
@@ -979,8 +1180,20 @@ std::any MyCypherVisitor::visitOC_Quantifier(CypherParser::OC_QuantifierContext
 std::any MyCypherVisitor::visitOC_FilterExpression(CypherParser::OC_FilterExpressionContext *context) { return defaultVisit("FilterExpression", __LINE__, context); }
 
 std::any MyCypherVisitor::visitOC_PatternPredicate(CypherParser::OC_PatternPredicateContext *context) {
-  m_errors.push_back("OC_PatternPredicate not supported");
-  return defaultVisit("PatternPredicate", __LINE__, context);
+  auto _ = scope("PatternPredicate");
+  auto res = context->oC_RelationshipsPattern()->accept(this);
+  if(res.type() != typeid(PatternElement))
+  {
+    m_errors.push_back("OC_PatternPredicate expects a relationships pattern");
+    return {};
+  }
+  auto expr = detail::mkPatternPredicateExpression(std::any_cast<PatternElement>(res));
+  if(auto * error = std::get_if<std::string>(&expr))
+  {
+    m_errors.push_back("OC_PatternPredicate: " + *error);
+    return {};
+  }
+  return std::move(std::get<ComparisonExpression>(expr));
 }
 
 std::any MyCypherVisitor::visitOC_ParenthesizedExpression(CypherParser::OC_ParenthesizedExpressionContext *context) {
@@ -1004,9 +1217,9 @@ std::any MyCypherVisitor::visitOC_FunctionInvocation(CypherParser::OC_FunctionIn
   }
   // verify it is size 1 and matches a node (or relationships) variable.
   const auto expressions = context->oC_Expression();
-  if(expressions.size() != 1)
+  if(expressions.empty() || expressions.size() > 2)
   {
-    m_errors.push_back("OC_FunctionInvocation expects a single expression for now.");
+    m_errors.push_back("OC_FunctionInvocation expects a single expression for now (or a node and a relationship type for degree functions).");
     return {};
   }
   auto expr = expressions[0]->accept(this);
@@ -1015,22 +1228,72 @@ std::any MyCypherVisitor::visitOC_FunctionInvocation(CypherParser::OC_FunctionIn
     m_errors.push_back("OC_FunctionInvocation expression must be NonArithmeticOperatorExpression for now.");
     return {};
   }
-  const auto& naoExp = std::any_cast<NonArithmeticOperatorExpression>(expr);
-  if(naoExp.mayPropertyName.has_value())
+  auto& naoExp = std::any_cast<NonArithmeticOperatorExpression&>(expr);
+  if(!naoExp.labels.empty())
   {
-    m_errors.push_back("OC_FunctionInvocation expression must not have a property for now.");
+    m_errors.push_back("OC_FunctionInvocation expression must not have labels.");
     return {};
   }
-  if(!naoExp.labels.empty())
+  if(naoExp.mayAggregation.has_value())
   {
-    m_errors.push_back("OC_FunctionInvocation expression must not have labels.");
+    m_errors.push_back("OC_FunctionInvocation expression must not be an aggregation.");
     return {};
   }
 
   auto func = context->oC_FunctionName()->accept(this);
+  if(func.type() == typeid(DegreeDirection))
+  {
+    if(!std::holds_alternative<Variable>(naoExp.atom.var) || naoExp.mayPropertyName.has_value())
+    {
+      m_errors.push_back("OC_FunctionInvocation degree function expects a node variable.");
+      return {};
+    }
+    DegreeFunction degree{std::any_cast<DegreeDirection>(func), std::nullopt};
+    if(expressions.size() == 2)
+    {
+      // The relationship type is a string literal.
+      const std::string type = expressions[1]->getText();
+      if(type.size() < 3 || (type.front() != '\'' && type.front() != '"') || type.back() != type.front())
+      {
+        m_errors.push_back("OC_FunctionInvocation degree function expects a string literal relationship type.");
+        return {};
+      }
+      degree.relationshipType = Label{SymbolicName{type.substr(1, type.size() - 2)}};
+    }
+    NonArithmeticOperatorExpression res;
+    res.atom = std::move(naoExp.atom);
+    res.mayPropertyName = mkDegreeProperty(degree);
+    return res;
+  }
+  if(expressions.size() != 1)
+  {
+    m_errors.push_back("OC_FunctionInvocation expects a single expression for now.");
+    return {};
+  }
+  if(func.type() == typeid(AggregationFunction))
+  {
+    const auto aggregation = std::any_cast<AggregationFunction>(func);
+    if(!std::holds_alternative<Variable>(naoExp.atom.var))
+    {
+      m_errors.push_back("OC_FunctionInvocation aggregation function expects a variable or a property of a variable.");
+      return {};
+    }
+    if(!naoExp.mayPropertyName.has_value() && aggregation != AggregationFunction::Count)
+    {
+      m_errors.push_back("OC_FunctionInvocation aggregation function other than count expects a property.");
+      return {};
+    }
+    naoExp.mayAggregation = aggregation;
+    return std::move(naoExp);
+  }
   if(func.type() != typeid(IdentityFunction))
   {
-    m_errors.push_back("OC_FunctionInvocation function must be Identity for now.");
+    m_errors.push_back("OC_FunctionInvocation function must be Identity or an aggregation for now.");
+    return {};
+  }
+  if(naoExp.mayPropertyName.has_value())
+  {
+    m_errors.push_back("OC_FunctionInvocation expression must not have a property for now.");
     return {};
   }
   NonArithmeticOperatorExpression res;
@@ -1053,17 +1316,60 @@ std::any MyCypherVisitor::visitOC_FunctionName(CypherParser::OC_FunctionNameCont
   }
   const auto & sname = std::any_cast<SymbolicName>(name);
   const std::string lowerName = toLower(sname.str);
-  if(lowerName != "id")
-  {
-    m_errors.push_back("OC_FunctionInvocation with non-id function name is not supported yet");
+  if(lowerName == "id")
+    return IdentityFunction{};
+  if(lowerName == "degree")
+    return DegreeDirection::Both;
+  if(lowerName == "outdegree")
+    return DegreeDirection::Outgoing;
+  if(lowerName == "indegree")
+    return DegreeDirection::Incoming;
+  if(lowerName == "count")
+    return AggregationFunction::Count;
+  if(lowerName == "sum")
+    return AggregationFunction::Sum;
+  if(lowerName == "min")
+    return AggregationFunction::Min;
+  if(lowerName == "max")
+    return AggregationFunction::Max;
+  if(lowerName == "avg")
+    return AggregationFunction::Avg;
+  if(lowerName == "collect")
+  {
+    m_errors.push_back("OC_FunctionInvocation collect is not supported (lists are not supported as values)");
     return {};
   }
-  return IdentityFunction{};
+  m_errors.push_back("OC_FunctionInvocation with function name '" + sname.str + "' is not supported yet");
+  return {};
 }
 
 std::any MyCypherVisitor::visitOC_ExistentialSubquery(CypherParser::OC_ExistentialSubqueryContext *context) {
-  m_errors.push_back("OC_ExistentialSubquery not supported");
-  return defaultVisit("ExistentialSubquery", __LINE__, context);
+  auto _ = scope("ExistentialSubquery");
+  // EXISTS { pattern } is supported as a pattern predicate.
+  if(context->oC_RegularQuery() || context->oC_Where())
+  {
+    m_errors.push_back("OC_ExistentialSubquery only supports a pattern (without MATCH and WHERE)");
+    return {};
+  }
+  auto res = context->oC_Pattern()->accept(this);
+  if(res.type() != typeid(Pattern))
+  {
+    m_errors.push_back("OC_ExistentialSubquery expects a pattern");
+    return {};
+  }
+  auto & pattern = std::any_cast<Pattern&>(res);
+  if(pattern.patternParts.size() != 1 || pattern.patternParts[0].mayVariable.has_value())
+  {
+    m_errors.push_back("OC_ExistentialSubquery expects a single unnamed pattern part");
+    return {};
+  }
+  auto expr = detail::mkPatternPredicateExpression(pattern.patternParts[0].anonymousPatternPart);
+  if(auto * error = std::get_if<std::string>(&expr))
+  {
+    m_errors.push_back("OC_ExistentialSubquery: " + *error);
+    return {};
+  }
+  return std::move(std::get<ComparisonExpression>(expr));
 }
 
 std::any MyCypherVisitor::visitOC_ExplicitProcedureInvocation(CypherParser::OC_ExplicitProcedureInvocationContext *context) { return defaultVisit("ExplicitProcedureInvocation", __LINE__, context); }
@@ -1172,7 +1478,8 @@ std::any MyCypherVisitor::visitOC_ListLiteral(CypherParser::OC_ListLiteralContex
         m_errors.push_back("OC_ListLiteral : labels in NonArithmeticOperatorExpression is not supported");
         return {};
       }
-      append(std::move(*std::get<std::shared_ptr<Value>>(std::get<Literal>(std::move(nao.atom.var)).variant)), v);
+      // The value is copied: it may be the value of a parameter.
+      append(copy(*std::get<std::shared_ptr<Value>>(std::get<Literal>(nao.atom.var).variant)), v);
     }
     else
     {
@@ -1213,8 +1520,10 @@ std::any MyCypherVisitor::visitOC_Parameter(CypherParser::OC_ParameterContext *c
       const auto & sn = std::any_cast<SymbolicName>(paramName);
       auto it = m_queryParams.find(ParameterName{sn});
       if(it != m_queryParams.end())
-        // only list literals are supported for now.
+      {
+        ++m_countParameterUses[it->first];
         return Literal{it->second};
+      }
       else
         m_errors.push_back("OC_Parameter : param '" + sn.str + "' not found");
     }
@@ -1266,6 +1575,11 @@ std::any MyCypherVisitor::visitOC_SymbolicName(CypherParser::OC_SymbolicNameCont
   {
     return SymbolicName{hexLetter->getText()};
   }
+  else if(auto count = context->COUNT())
+  {
+    // The 'count' function name.
+    return SymbolicName{count->getText()};
+  }
   else
     m_errors.push_back("unhandled type of OC_SymbolicName");
   return {};
@@ -26,7 +26,7 @@ class MyCypherVisitor : public CypherVisitor
 {
 public:
   MyCypherVisitor(PropertySchema const& IDProperty,
-                  const std::map<ParameterName, HomogeneousNonNullableValues>& queryParams,
+                  const std::map<ParameterName, ParameterValue>& queryParams,
                   bool print = false)
   : m_print(print)
   , m_IDProperty(IDProperty)
@@ -35,6 +35,9 @@ public:
   
   const std::vector<std::string>& getErrors() const { return m_errors; }
   
+  // The count of uses of each parameter in the query.
+  const std::map<ParameterName, size_t>& getCountParameterUses() const { return m_countParameterUses; }
+  
 private:
   void print(const char* str) const;
   
@@ -256,13 +259,26 @@ private:
   std::any visitOC_Dash(CypherParser::OC_DashContext *context) override;
   
 private:
+  // Adds a reading clause of a query part: the first one is a MATCH, the next ones are OPTIONAL MATCH.
+  void addReadingClause(const char* clauseName,
+                        ReadingClause&& readingClause,
+                        std::optional<ReadingClause>& mayReadingClause,
+                        std::vector<Match>& optionalMatches);
+
+  // Sets the UNWIND clause of a query part, which must precede its first reading clause.
+  void addUnwind(const char* clauseName,
+                 Unwind&& unwind,
+                 std::optional<Unwind>& mayUnwind,
+                 const std::optional<ReadingClause>& mayReadingClause);
+
   std::any defaultVisit(const char* funcName, int line, antlr4::ParserRuleContext* context);
   
   template<typename U>
   std::any aggregate(const Aggregator a, const std::vector<U>& subExpressions);
   
   PropertySchema const& m_IDProperty;
-  std::map<ParameterName, HomogeneousNonNullableValues> m_queryParams;
+  std::map<ParameterName, ParameterValue> m_queryParams;
+  std::map<ParameterName, size_t> m_countParameterUses;
   bool m_print;
   std::vector<std::string> m_errors;
 };
@@ -2,8 +2,10 @@
 #include <chrono>
 #include <random>
 #include <filesystem>
+#include <algorithm>
 
 #include "GraphDBSqlite.h"
+#include "FilterKernels.h"
 #include "CypherQuery.h"
 #include "Logs.h"
 #include "TestUtils.h"
@@ -11,6 +13,146 @@
 namespace openCypher::test
 {
 
+// Creates the graph used by the Perfs2 tests, unless the DB already contains it.
+// Returns the id of the "root" node, from which the relationships were created.
+template<typename ID>
+ID createPerfs2Graph(GraphDB<ID>& db, const size_t countNodes, Timer& timer)
+{
+  std::mt19937 gen;
+  std::uniform_int_distribution<size_t> distrNodes(0, countNodes - 1ull);
+  // pick "root" node at random
+  const auto rootNodeIdx = distrNodes(gen);
+
+  // Here we assume that the id is 1 for the first node, 2 for the second, etc...
+  // This is how sqlite auto increment "integer primary key" column works.
+  // Note that if we use a different kind of id than integer, we could pick the first created node
+  // as root, and we would be able to find it later via its internal rowid which should be 1.
+  const ID expectedRootNodeId{static_cast<ID>(1ull + rootNodeIdx)};
+
+  if(!db.typesAndProperties().empty())
+    timer.endStep("Read existing DB file");
+  else
+  {
+    const auto p_age = mkProperty("age");
+    const auto p_since = mkProperty("since");
+    db.addType("Person", true, {p_age});
+    db.addType("Knows", false, {p_since});
+    db.addType("WorksWith", false, {p_since});
+    
+    timer.endStep("Non-system labeled entity/relationship property tables creation");
+
+    // TODO make a parametrized tests.
+    // See results in comment above the Perfs2 test.
+    std::vector<ID> nodeIds;
+    nodeIds.reserve(10000);
+    
+    const auto maxAge = 8000;
+    // 5 ms per iteration without a transaction
+    // 0.1 ms per iteration with a transaction
+    // Ideally we should have one transaction per ~10000 inserts.
+    for(int i=0;; ++i)
+    {
+      std::cout << i << "." << std::flush;
+      db.beginTransaction();
+      for(int64_t i=0; i<maxAge; ++i)
+      {
+        nodeIds.push_back(db.addNode("Person",
+                                     mkVec(std::pair{p_age, Value{i}})));
+        if(nodeIds.size() == countNodes)
+          break;
+      }
+      db.endTransaction();
+      if(nodeIds.size() == countNodes)
+        break;
+    }
+    std::cout << std::endl;
+    timer.endStep(std::to_string(nodeIds.size()) + " nodes creation");
+
+    EXPECT_EQ(expectedRootNodeId, nodeIds[rootNodeIdx]);
+
+    std::vector<std::pair<size_t, size_t>> rels;
+    rels.reserve(nodeIds.size());
+
+    std::vector<size_t> curNodeIDx;
+    std::vector<size_t> nextNodeIDx;
+    curNodeIDx.push_back(rootNodeIdx);
+    
+    // start with 2 neighbours per node and double at each iteration.
+    for(int countNeighbours = 1;; countNeighbours++)
+    {
+      const size_t countRelsToAdd = curNodeIDx.size() * countNeighbours;
+      if(countRelsToAdd > nodeIds.size())
+        break;
+      std::cout << "will specify " << countRelsToAdd << " rels" << std::endl;
+      for(const auto nodeIdx : curNodeIDx)
+      {
+        for(int i=0; i<countNeighbours; ++i)
+        {
+          // pick neighbours at random
+          const auto neighbourIdx = distrNodes(gen);
+          nextNodeIDx.push_back(neighbourIdx);
+          rels.emplace_back(nodeIdx, neighbourIdx);
+        }
+      }
+      curNodeIDx.clear();
+      nextNodeIDx.swap(curNodeIDx);
+    }
+    std::cout << "Will create " << rels.size() << " relationships." << std::endl;
+    
+    size_t relIdx{};
+    for(int i=0;; ++i)
+    {
+      std::cout << i << "." << std::flush;
+      db.beginTransaction();
+      for(int64_t i=0; i<4000; ++i)
+      {
+        if(relIdx == rels.size())
+          break;
+        db.addRelationship("Knows",
+                           nodeIds[rels[relIdx].first],
+                           nodeIds[rels[relIdx].second],
+                           mkVec(std::pair{p_since, Value(i)}));
+        ++relIdx;
+        if(relIdx == rels.size())
+          break;
+        db.addRelationship("WorksWith",
+                           nodeIds[rels[relIdx].first],
+                           nodeIds[rels[relIdx].second],
+                           mkVec(std::pair{p_since, Value(2 * i)}));
+        ++relIdx;
+      }
+      db.endTransaction();
+      if(relIdx == rels.size())
+        break;
+    }
+    std::cout << std::endl;
+    timer.endStep(std::to_string(relIdx) + " relationships creation");
+  }
+
+
+  return expectedRootNodeId;
+}
+
+// Runs |cypherQuery| |countRuns| times, and returns the duration of the fastest run, in microseconds.
+// |handler| then contains the rows of the query.
+template<typename ID>
+std::string fastestRunMicros(QueryResultsHandler<ID>& handler,
+                             const std::string& cypherQuery,
+                             const std::map<ParameterName, ParameterValue>& params,
+                             const int countRuns)
+{
+  std::optional<std::chrono::steady_clock::duration> minDuration;
+  for(int i=0; i<countRuns; ++i)
+  {
+    handler.run(cypherQuery, params);
+    if(!minDuration.has_value() || handler.m_cypherQueryDuration < *minDuration)
+      minDuration = handler.m_cypherQueryDuration;
+  }
+  std::ostringstream s;
+  s << std::chrono::duration_cast<std::chrono::microseconds>(*minDuration).count() << " us";
+  return s.str();
+}
+
 /*
  [Performance charts made using the test below this comment.]
  
@@ -489,117 +631,7 @@ TEST(Test, Perfs2)
   auto dbWrapper = std::make_unique<GraphWithStats<ID>>("test.Perf2." + std::to_string(countNodes) + ".sqlite3db");
   //dbWrapper->m_printSQLRequests = true;
 
-  std::mt19937 gen;
-  std::uniform_int_distribution<size_t> distrNodes(0, countNodes - 1ull);
-  // pick "root" node at random
-  const auto rootNodeIdx = distrNodes(gen);
-
-  // Here we assume that the id is 1 for the first node, 2 for the second, etc...
-  // This is how sqlite auto increment "integer primary key" column works.
-  // Note that if we use a different kind of id than integer, we could pick the first created node
-  // as root, and we would be able to find it later via its internal rowid which should be 1.
-  const ID expectedRootNodeId{static_cast<ID>(1ull + rootNodeIdx)};
-
-  auto & db = dbWrapper->getDB();
-  if(!db.typesAndProperties().empty())
-    timer.endStep("Read existing DB file");
-  else
-  {
-    const auto p_age = mkProperty("age");
-    const auto p_since = mkProperty("since");
-    db.addType("Person", true, {p_age});
-    db.addType("Knows", false, {p_since});
-    db.addType("WorksWith", false, {p_since});
-    
-    timer.endStep("Non-system labeled entity/relationship property tables creation");
-
-    // TODO make a parametrized tests.
-    // See results in comment above this test.
-    std::vector<ID> nodeIds;
-    nodeIds.reserve(10000);
-    
-    const auto maxAge = 8000;
-    // 5 ms per iteration without a transaction
-    // 0.1 ms per iteration with a transaction
-    // Ideally we should have one transaction per ~10000 inserts.
-    for(int i=0;; ++i)
-    {
-      std::cout << i << "." << std::flush;
-      db.beginTransaction();
-      for(int64_t i=0; i<maxAge; ++i)
-      {
-        nodeIds.push_back(db.addNode("Person",
-                                     mkVec(std::pair{p_age, Value{i}})));
-        if(nodeIds.size() == countNodes)
-          break;
-      }
-      db.endTransaction();
-      if(nodeIds.size() == countNodes)
-        break;
-    }
-    std::cout << std::endl;
-    timer.endStep(std::to_string(nodeIds.size()) + " nodes creation");
-
-    EXPECT_EQ(expectedRootNodeId, nodeIds[rootNodeIdx]);
-
-    std::vector<std::pair<size_t, size_t>> rels;
-    rels.reserve(nodeIds.size());
-
-    std::vector<size_t> curNodeIDx;
-    std::vector<size_t> nextNodeIDx;
-    curNodeIDx.push_back(rootNodeIdx);
-    
-    // start with 2 neighbours per node and double at each iteration.
-    for(int countNeighbours = 1;; countNeighbours++)
-    {
-      const size_t countRelsToAdd = curNodeIDx.size() * countNeighbours;
-      if(countRelsToAdd > nodeIds.size())
-        break;
-      std::cout << "will specify " << countRelsToAdd << " rels" << std::endl;
-      for(const auto nodeIdx : curNodeIDx)
-      {
-        for(int i=0; i<countNeighbours; ++i)
-        {
-          // pick neighbours at random
-          const auto neighbourIdx = distrNodes(gen);
-          nextNodeIDx.push_back(neighbourIdx);
-          rels.emplace_back(nodeIdx, neighbourIdx);
-        }
-      }
-      curNodeIDx.clear();
-      nextNodeIDx.swap(curNodeIDx);
-    }
-    std::cout << "Will create " << rels.size() << " relationships." << std::endl;
-    
-    size_t relIdx{};
-    for(int i=0;; ++i)
-    {
-      std::cout << i << "." << std::flush;
-      db.beginTransaction();
-      for(int64_t i=0; i<4000; ++i)
-      {
-        if(relIdx == rels.size())
-          break;
-        db.addRelationship("Knows",
-                           nodeIds[rels[relIdx].first],
-                           nodeIds[rels[relIdx].second],
-                           mkVec(std::pair{p_since, Value(i)}));
-        ++relIdx;
-        if(relIdx == rels.size())
-          break;
-        db.addRelationship("WorksWith",
-                           nodeIds[rels[relIdx].first],
-                           nodeIds[rels[relIdx].second],
-                           mkVec(std::pair{p_since, Value(2 * i)}));
-        ++relIdx;
-      }
-      db.endTransaction();
-      if(relIdx == rels.size())
-        break;
-    }
-    std::cout << std::endl;
-    timer.endStep(std::to_string(relIdx) + " relationships creation");
-  }
+  const ID expectedRootNodeId = createPerfs2Graph(dbWrapper->getDB(), countNodes, timer);
 
   QueryResultsHandler handler(*dbWrapper);
   
@@ -751,4 +783,600 @@ TEST(Test, Perfs2)
   printChart(std::cout, &columnNames, values);
 }
 
+// Compares the evaluation of the single-variable filters of the Perfs2 query in the queries on the property tables
+// with their native evaluation, for each instruction set of the filter kernels.
+TEST(Test, PerfsNativeFilters)
+{
+  Timer timer{std::cout};
+
+  LogIndentScope _{};
+
+  const size_t countNodes {64000};
+
+  using ID = int64_t;
+
+  auto dbWrapper = std::make_unique<GraphWithStats<ID>>("test.Perf2." + std::to_string(countNodes) + ".sqlite3db");
+
+  const ID expectedRootNodeId = createPerfs2Graph(dbWrapper->getDB(), countNodes, timer);
+
+  auto & db = dbWrapper->getDB();
+
+  QueryResultsHandler handler(*dbWrapper);
+
+  struct FiltersEvaluation{
+    std::string name;
+    SingleVariableFiltersEvaluation evaluation;
+    sql::kernels::InstructionSet instructionSet;
+  };
+  const std::vector<FiltersEvaluation> filtersEvaluations{
+    {"SQL", SingleVariableFiltersEvaluation::SQL, sql::kernels::InstructionSet::AVX2},
+    {"Native (scalar)", SingleVariableFiltersEvaluation::Native, sql::kernels::InstructionSet::Scalar},
+    {"Native (SSE4.2)", SingleVariableFiltersEvaluation::Native, sql::kernels::InstructionSet::SSE4_2},
+    {"Native (AVX2)", SingleVariableFiltersEvaluation::Native, sql::kernels::InstructionSet::AVX2}
+  };
+  // We keep the fastest of several runs of each query.
+  const int countRuns{5};
+
+  std::vector<std::string> columnNames{
+    "Expand",
+    "#Start nodes",
+    "#Rows found"
+  };
+  for(const auto & filtersEvaluation : filtersEvaluations)
+    columnNames.push_back(filtersEvaluation.name);
+
+  std::vector<std::vector<std::string>> values;
+
+  std::unordered_set<ID> nodeVisisted;
+  nodeVisisted.reserve(countNodes);
+
+  auto expandFronteer = std::make_shared<std::vector<ID>>();
+  expandFronteer->push_back(expectedRootNodeId);
+  for(size_t expand{1}; !expandFronteer->empty(); ++expand)
+  {
+    std::optional<size_t> countRows;
+    std::vector<std::string> durations;
+    for(const auto & filtersEvaluation : filtersEvaluations)
+    {
+      db.setSingleVariableFiltersEvaluation(filtersEvaluation.evaluation);
+      sql::kernels::setMaxInstructionSet(filtersEvaluation.instructionSet);
+
+      durations.push_back(fastestRunMicros(handler,
+                                           "MATCH (a)-[r]->(b)-[r2]->(c)-[r3]->(d) WHERE id(a) IN $list AND b.age < 6000 AND c.age > 2000 return id(b), d.age",
+                                           {{ParameterName{"list"}, expandFronteer}}, countRuns));
+
+      if(countRows.has_value())
+        EXPECT_EQ(*countRows, handler.countRows());
+      else
+        countRows = handler.countRows();
+    }
+
+    auto & v = values.emplace_back();
+    v.push_back(std::to_string(expand));
+    v.push_back(std::to_string(expandFronteer->size()));
+    v.push_back(std::to_string(*countRows));
+    v.insert(v.end(), durations.begin(), durations.end());
+
+    expandFronteer->clear();
+    for(const auto & row : handler.rows())
+      if(nodeVisisted.insert(std::get<ID>(row[0])).second)
+        expandFronteer->push_back(std::get<ID>(row[0]));
+  }
+
+  db.setSingleVariableFiltersEvaluation(SingleVariableFiltersEvaluation::SQL);
+  sql::kernels::setMaxInstructionSet(sql::kernels::InstructionSet::AVX2);
+
+  timer.endStep("Expand queries");
+
+  std::cout << "Supported instruction set: " << static_cast<int>(sql::kernels::instructionSet()) << std::endl;
+  std::cout << "For countNodes = " << countNodes << std::endl;
+  printChart(std::cout, &columnNames, values);
+}
+
+// Compares the ways lists are bound in the SQL queries (see sql::ListBinding), for several list sizes,
+// with IN filters on the ids of the Perfs2 dataset of |countNodes| nodes.
+template<typename ID>
+void perfsListBinding(const size_t countNodes)
+{
+  Timer timer{std::cout};
+
+  LogIndentScope _{};
+
+  auto dbWrapper = std::make_unique<GraphWithStats<ID>>("test.Perf2." + std::to_string(countNodes) + ".sqlite3db");
+
+  createPerfs2Graph(dbWrapper->getDB(), countNodes, timer);
+
+  auto & db = dbWrapper->getDB();
+
+  QueryResultsHandler handler(*dbWrapper);
+
+  const std::vector<std::pair<std::string, sql::ListBinding>> listBindings{
+    {"carray", sql::ListBinding::CArray},
+    {"sorted carray", sql::ListBinding::SortedCArray},
+    {"temp table", sql::ListBinding::TempTable},
+    {"adaptive", sql::ListBinding::Adaptive}
+  };
+  const std::vector<std::string> queries{
+    "MATCH (a)-[r]->(b) WHERE id(a) IN $list return id(b)",
+    "MATCH (a:Person) WHERE id(a) IN $list return a.age"
+  };
+  // We keep the fastest of several runs of each query.
+  const int countRuns{5};
+
+  std::vector<std::string> columnNames{
+    "Query",
+    "List size",
+    "#Rows found"
+  };
+  for(const auto & [name, _] : listBindings)
+    columnNames.push_back(name);
+  // The list passed as an IDSet, read by the idset virtual table.
+  columnNames.push_back("idset");
+
+  std::vector<std::vector<std::string>> values;
+
+  std::mt19937 gen;
+  // Ids are allocated from 1.
+  std::uniform_int_distribution<ID> distrIds(1, static_cast<ID>(countNodes));
+  for(const size_t listSize : {10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull})
+  {
+    auto list = std::make_shared<std::vector<ID>>();
+    list->reserve(listSize);
+    for(size_t i{}; i<listSize; ++i)
+      list->push_back(distrIds(gen));
+    auto idSet = std::make_shared<IDSet>();
+    for(const ID id : *list)
+      idSet->insert(id);
+
+    for(size_t q{}; q<queries.size(); ++q)
+    {
+      std::optional<size_t> countRows;
+      std::vector<std::string> durations;
+      auto runQuery = [&](const ParameterValue& param)
+      {
+        durations.push_back(fastestRunMicros(handler, queries[q], {{ParameterName{"list"}, param}}, countRuns));
+
+        if(countRows.has_value())
+          EXPECT_EQ(*countRows, handler.countRows());
+        else
+          countRows = handler.countRows();
+      };
+      for(const auto & [_, listBinding] : listBindings)
+      {
+        db.setListBinding(listBinding);
+        runQuery(list);
+      }
+      runQuery(idSet);
+
+      auto & v = values.emplace_back();
+      v.push_back(std::to_string(q + 1));
+      v.push_back(std::to_string(listSize));
+      v.push_back(std::to_string(*countRows));
+      v.insert(v.end(), durations.begin(), durations.end());
+    }
+  }
+
+  db.setListBinding(sql::ListBinding::Adaptive);
+
+  timer.endStep("List binding queries");
+
+  for(size_t q{}; q<queries.size(); ++q)
+    std::cout << q + 1 << ": " << queries[q] << std::endl;
+  std::cout << "For countNodes = " << countNodes << std::endl;
+  printChart(std::cout, &columnNames, values);
+}
+
+TEST(Test, PerfsListBinding)
+{
+  for(const size_t countNodes : {64000ull, 6400000ull})
+    perfsListBinding<int64_t>(countNodes);
+}
+
+// Compares the expansion of the relationships of paths with self joins of the relationships system table,
+// and with the neighbors virtual table reading the in-memory adjacency.
+TEST(Test, PerfsInMemoryAdjacency)
+{
+  Timer timer{std::cout};
+
+  LogIndentScope _{};
+
+  const size_t countNodes {64000};
+
+  using ID = int64_t;
+
+  auto dbWrapper = std::make_unique<GraphWithStats<ID>>("test.Perf2." + std::to_string(countNodes) + ".sqlite3db");
+
+  createPerfs2Graph(dbWrapper->getDB(), countNodes, timer);
+
+  auto & db = dbWrapper->getDB();
+
+  QueryResultsHandler handler(*dbWrapper);
+
+  const std::vector<std::string> queries{
+    "MATCH (a)-[r1]->(b)-[r2]->(c) WHERE id(a) IN $list return id(c)",
+    "MATCH (a)-[r1]->(b)-[r2]->(c)-[r3]->(d) WHERE id(a) IN $list return id(d)",
+    "MATCH (a)-[r1]->(b)-[r2]->(c)-[r3]->(d)-[r4]->(e) WHERE id(a) IN $list return id(e)",
+    "MATCH (a)-[r1]-(b)-[r2]-(c)-[r3]-(d) WHERE id(a) IN $list return id(d)"
+  };
+  // We keep the fastest of several runs of each query.
+  const int countRuns{5};
+
+  std::mt19937 gen;
+  // Ids are allocated from 1.
+  std::uniform_int_distribution<ID> distrIds(1, static_cast<ID>(countNodes));
+  auto list = std::make_shared<std::vector<ID>>();
+  for(size_t i{}; i<100; ++i)
+    list->push_back(distrIds(gen));
+
+  std::vector<std::string> columnNames{
+    "Query",
+    "#Rows found",
+    "relationships",
+    "neighbors"
+  };
+  std::vector<std::vector<std::string>> values(queries.size());
+  std::vector<std::optional<size_t>> countRows(queries.size());
+
+  for(const bool inMemoryAdjacency : {false, true})
+  {
+    db.setInMemoryAdjacency(inMemoryAdjacency);
+    timer.endStep(inMemoryAdjacency ? "Load in-memory adjacency" : "Queries with self joins");
+
+    for(size_t q{}; q<queries.size(); ++q)
+    {
+      const auto duration = fastestRunMicros(handler, queries[q], {{ParameterName{"list"}, list}}, countRuns);
+      if(countRows[q].has_value())
+        EXPECT_EQ(*countRows[q], handler.countRows());
+      else
+      {
+        countRows[q] = handler.countRows();
+        values[q].push_back(std::to_string(q + 1));
+        values[q].push_back(std::to_string(*countRows[q]));
+      }
+      values[q].push_back(duration);
+    }
+  }
+
+  db.setInMemoryAdjacency(false);
+
+  timer.endStep("Queries with the in-memory adjacency");
+
+  for(size_t q{}; q<queries.size(); ++q)
+    std::cout << q + 1 << ": " << queries[q] << std::endl;
+  std::cout << "For countNodes = " << countNodes << std::endl;
+  printChart(std::cout, &columnNames, values);
+}
+
+// Compares the expansion of paths returning only their last node with self joins of the relationships system table,
+// and hop by hop from the distinct nodes reached by the previous hop, on a dense graph where paths are much more numerous than nodes.
+TEST(Test, PerfsFrontierExpansion)
+{
+  Timer timer{std::cout};
+
+  LogIndentScope _{};
+
+  const size_t countNodes {5000};
+  // The average count of relationships of each type leaving a node.
+  const size_t fanOut {10};
+  const std::vector<std::string> relationshipTypes{"T0", "T1", "T2", "T3"};
+
+  using ID = int64_t;
+
+  auto dbWrapper = std::make_unique<GraphWithStats<ID>>("test.PerfsFrontierExpansion.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+
+  db.addType("Person", true, {});
+  for(const auto & type : relationshipTypes)
+    db.addType(type, false, {});
+
+  std::mt19937 gen;
+  std::uniform_int_distribution<size_t> distrNodes(0, countNodes - 1ull);
+  std::vector<ID> nodeIds;
+  nodeIds.reserve(countNodes);
+  db.beginTransaction();
+  for(size_t i{}; i<countNodes; ++i)
+    nodeIds.push_back(db.addNode("Person", {}));
+  for(const auto & type : relationshipTypes)
+    for(size_t i{}; i<countNodes * fanOut; ++i)
+      db.addRelationship(type, nodeIds[distrNodes(gen)], nodeIds[distrNodes(gen)], {});
+  db.endTransaction();
+  timer.endStep("Graph creation");
+
+  QueryResultsHandler handler(*dbWrapper);
+
+  auto list = std::make_shared<std::vector<ID>>();
+  for(size_t i{}; i<50; ++i)
+    list->push_back(nodeIds[distrNodes(gen)]);
+
+  const std::vector<std::string> queries{
+    "MATCH (a)-[:T0]->()-[:T1]->(c) WHERE id(a) IN $list RETURN id(c)",
+    "MATCH (a)-[:T0]->()-[:T1]->()-[:T2]->(d) WHERE id(a) IN $list RETURN id(d)",
+    "MATCH (a)-[:T0]->()-[:T1]->()-[:T2]->(d) WHERE id(a) IN $list RETURN DISTINCT id(d)",
+    "MATCH (a)-[:T0]->()-[:T1]->()-[:T2]->()-[:T3]->(e) WHERE id(a) IN $list RETURN id(e)",
+    "MATCH (a)-[:T0]->()-[:T1]->()-[:T2]->()-[:T3]->(e) WHERE id(a) IN $list RETURN DISTINCT id(e)"
+  };
+  // We keep the fastest of several runs of each query.
+  const int countRuns{3};
+
+  std::vector<std::string> columnNames{
+    "Query",
+    "#Rows found",
+    "self joins",
+    "frontiers"
+  };
+  std::vector<std::vector<std::string>> values(queries.size());
+  std::vector<std::optional<size_t>> countRows(queries.size());
+
+  for(const bool frontierExpansion : {false, true})
+  {
+    db.setFrontierExpansion(frontierExpansion);
+    for(size_t q{}; q<queries.size(); ++q)
+    {
+      const auto duration = fastestRunMicros(handler, queries[q], {{ParameterName{"list"}, list}}, countRuns);
+      if(countRows[q].has_value())
+        EXPECT_EQ(*countRows[q], handler.countRows());
+      else
+      {
+        countRows[q] = handler.countRows();
+        values[q].push_back(std::to_string(q + 1));
+        values[q].push_back(std::to_string(*countRows[q]));
+      }
+      values[q].push_back(duration);
+    }
+    timer.endStep(frontierExpansion ? "Queries by frontiers" : "Queries with self joins");
+  }
+
+  for(size_t q{}; q<queries.size(); ++q)
+    std::cout << q + 1 << ": " << queries[q] << std::endl;
+  std::cout << "For countNodes = " << countNodes << ", fanOut = " << fanOut << std::endl;
+  printChart(std::cout, &columnNames, values);
+}
+
+// Compares typed paths of 4 to 6 hops with and without the elimination of the relationship uniqueness constraints
+// between relationships that cannot be the same relationship (see GraphDB::setUniquenessConstraintsElimination).
+TEST(Test, PerfsRelationshipUniqueness)
+{
+  Timer timer{std::cout};
+
+  LogIndentScope _{};
+
+  const size_t countNodes {20000};
+  // The average count of relationships of each type leaving a node.
+  const size_t fanOut {3};
+  const std::vector<std::string> relationshipTypes{"T0", "T1", "T2"};
+
+  using ID = int64_t;
+
+  auto dbWrapper = std::make_unique<GraphWithStats<ID>>("test.PerfsRelationshipUniqueness.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+
+  db.addType("Person", true, {});
+  for(const auto & type : relationshipTypes)
+    db.addType(type, false, {});
+
+  std::mt19937 gen;
+  std::uniform_int_distribution<size_t> distrNodes(0, countNodes - 1ull);
+  std::vector<ID> nodeIds;
+  nodeIds.reserve(countNodes);
+  db.beginTransaction();
+  for(size_t i{}; i<countNodes; ++i)
+    nodeIds.push_back(db.addNode("Person", {}));
+  for(const auto & type : relationshipTypes)
+    for(size_t i{}; i<countNodes * fanOut; ++i)
+      db.addRelationship(type, nodeIds[distrNodes(gen)], nodeIds[distrNodes(gen)], {});
+  db.endTransaction();
+  timer.endStep("Graph creation");
+
+  QueryResultsHandler handler(*dbWrapper);
+
+  auto list = std::make_shared<std::vector<ID>>();
+  for(size_t i{}; i<200; ++i)
+    list->push_back(nodeIds[distrNodes(gen)]);
+
+  // The first node is returned, so that the paths are expanded with self joins (see GraphDB::setFrontierExpansion).
+  // Only the relationships of the same type are compared when the constraints are eliminated.
+  const std::vector<std::string> queries{
+    "MATCH (a)-[:T0]->()-[:T1]->()-[:T2]->()-[:T0]->(e) WHERE id(a) IN $list RETURN id(a), id(e)",
+    "MATCH (a)-[:T0]->()-[:T1]->()-[:T2]->()-[:T0]->()-[:T1]->(f) WHERE id(a) IN $list RETURN id(a), id(f)",
+    "MATCH (a)-[:T0]->()-[:T1]->()-[:T2]->()-[:T0]->()-[:T1]->()-[:T2]->(g) WHERE id(a) IN $list RETURN id(a), id(g)"
+  };
+  // We keep the fastest of several runs of each query.
+  const int countRuns{3};
+
+  std::vector<std::string> columnNames{
+    "Query",
+    "#Rows found",
+    "all constraints",
+    "eliminated constraints"
+  };
+  std::vector<std::vector<std::string>> values(queries.size());
+  std::vector<std::optional<size_t>> countRows(queries.size());
+
+  for(const bool elimination : {false, true})
+  {
+    db.setUniquenessConstraintsElimination(elimination);
+    for(size_t q{}; q<queries.size(); ++q)
+    {
+      const auto duration = fastestRunMicros(handler, queries[q], {{ParameterName{"list"}, list}}, countRuns);
+      if(countRows[q].has_value())
+        EXPECT_EQ(*countRows[q], handler.countRows());
+      else
+      {
+        countRows[q] = handler.countRows();
+        values[q].push_back(std::to_string(q + 1));
+        values[q].push_back(std::to_string(*countRows[q]));
+      }
+      values[q].push_back(duration);
+    }
+    timer.endStep(elimination ? "Queries with eliminated constraints" : "Queries with all constraints");
+  }
+
+  for(size_t q{}; q<queries.size(); ++q)
+    std::cout << q + 1 << ": " << queries[q] << std::endl;
+  std::cout << "For countNodes = " << countNodes << ", fanOut = " << fanOut << std::endl;
+  printChart(std::cout, &columnNames, values);
+}
+
+TEST(Test, PerfsShortestPaths)
+{
+  Timer timer{std::cout};
+
+  LogIndentScope _{};
+
+  const size_t countNodes {100000};
+  // The average count of relationships of each type leaving a node.
+  const size_t fanOut {5};
+  const size_t countSearches {50};
+
+  using ID = int64_t;
+
+  auto dbWrapper = std::make_unique<GraphWithStats<ID>>("test.PerfsShortestPaths.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+
+  db.addType("Person", true, {});
+  db.addType("Knows", false, {});
+  db.addType("Likes", false, {});
+
+  std::mt19937 gen;
+  std::uniform_int_distribution<size_t> distrNodes(0, countNodes - 1ull);
+  std::vector<ID> nodeIds;
+  nodeIds.reserve(countNodes);
+  db.beginTransaction();
+  for(size_t i{}; i<countNodes; ++i)
+    nodeIds.push_back(db.addNode("Person", {}));
+  for(const auto type : {"Knows", "Likes"})
+    for(size_t i{}; i<countNodes * fanOut; ++i)
+      db.addRelationship(type, nodeIds[distrNodes(gen)], nodeIds[distrNodes(gen)], {});
+  db.endTransaction();
+  timer.endStep("Graph creation");
+
+  std::vector<std::pair<ID, ID>> searches;
+  for(size_t i{}; i<countSearches; ++i)
+    searches.emplace_back(nodeIds[distrNodes(gen)], nodeIds[distrNodes(gen)]);
+
+  struct Search
+  {
+    std::string description;
+    TraversalDirection direction;
+    std::set<openCypher::Label> relationshipTypes;
+  };
+  const std::vector<Search> searchKinds{
+    {"(a)-[*]->(b)", TraversalDirection::Forward, {}},
+    {"(a)-[*]-(b)", TraversalDirection::Any, {}},
+    {"(a)-[:Knows*]->(b)", TraversalDirection::Forward, {openCypher::Label{openCypher::SymbolicName{"Knows"}}}},
+    {"(a)-[:Knows*]-(b)", TraversalDirection::Any, {openCypher::Label{openCypher::SymbolicName{"Knows"}}}}
+  };
+
+  std::vector<std::string> columnNames{
+    "Shortest paths",
+    "#Paths found",
+    "relationships table",
+    "in-memory adjacency"
+  };
+  std::vector<std::vector<std::string>> values(searchKinds.size());
+  std::vector<std::optional<size_t>> countPaths(searchKinds.size());
+
+  for(const bool inMemoryAdjacency : {false, true})
+  {
+    db.setInMemoryAdjacency(inMemoryAdjacency);
+    for(size_t k{}; k<searchKinds.size(); ++k)
+    {
+      const auto & search = searchKinds[k];
+      size_t count{};
+      std::vector<std::chrono::steady_clock::duration> durations;
+      durations.reserve(searches.size());
+      for(const auto & [from, to] : searches)
+      {
+        const auto start = std::chrono::steady_clock::now();
+        count += db.shortestPaths(from, to, search.direction, search.relationshipTypes, std::nullopt, ShortestPaths::All).size();
+        durations.push_back(std::chrono::steady_clock::now() - start);
+      }
+      // The median is not skewed by the few searches between nodes that are far apart, or not connected.
+      const auto median = durations.begin() + durations.size() / 2;
+      std::nth_element(durations.begin(), median, durations.end());
+      if(countPaths[k].has_value())
+        EXPECT_EQ(*countPaths[k], count);
+      else
+      {
+        countPaths[k] = count;
+        values[k].push_back(search.description);
+        values[k].push_back(std::to_string(count));
+      }
+      values[k].push_back(std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(*median).count()) + " us");
+    }
+    timer.endStep(inMemoryAdjacency ? "Searches with the in-memory adjacency" : "Searches with the relationships table");
+  }
+
+  std::cout << "Median duration of a search, for " << countSearches << " random pairs of nodes" << std::endl;
+  std::cout << "For countNodes = " << countNodes << ", fanOut = " << fanOut << std::endl;
+  printChart(std::cout, &columnNames, values);
+}
+
+// Compares the instruction sets of the filter kernels, on the 'age' values of the Perfs2 dataset.
+TEST(Test, PerfsFilterKernels)
+{
+  using sql::kernels::InstructionSet;
+
+  const size_t countValues {64000};
+  const int countRuns{1000};
+
+  std::vector<int64_t> ages(countValues);
+  for(size_t i{}; i<countValues; ++i)
+    ages[i] = static_cast<int64_t>(i % 8000);
+  const std::vector<double> realAges(ages.begin(), ages.end());
+  const std::vector<int64_t> set{10, 200, 1000, 2000, 3000, 4000, 5000, 6000};
+  std::vector<uint8_t> bytes(countValues);
+  std::vector<size_t> selection;
+  selection.reserve(countValues);
+
+  const std::vector<std::pair<std::string, std::function<void()>>> kernels{
+    {"age < 6000", [&]{ sql::kernels::compare(ages.data(), countValues, sql::Comparison::LT, 6000, bytes.data()); }},
+    {"age < 6000.", [&]{ sql::kernels::compare(realAges.data(), countValues, sql::Comparison::LT, 6000., bytes.data()); }},
+    {"age > 2000 AND age < 6000", [&]{ sql::kernels::inRange(ages.data(), countValues, 2000, false, 6000, false, bytes.data()); }},
+    {"age IN [8 values]", [&]{ sql::kernels::inSet(ages.data(), countValues, set, bytes.data()); }},
+    {"selection", [&]{ selection.clear(); sql::kernels::appendSelection(bytes.data(), countValues, 1, selection); }}
+  };
+  const std::vector<std::pair<std::string, InstructionSet>> instructionSets{
+    {"Scalar", InstructionSet::Scalar},
+    {"SSE4.2", InstructionSet::SSE4_2},
+    {"AVX2", InstructionSet::AVX2}
+  };
+
+  std::vector<std::string> columnNames{"Kernel"};
+  for(const auto & [name, _] : instructionSets)
+    columnNames.push_back(name);
+
+  std::vector<std::vector<std::string>> values;
+  for(const auto & [kernelName, kernel] : kernels)
+  {
+    auto & v = values.emplace_back();
+    v.push_back(kernelName);
+    std::optional<std::vector<uint8_t>> refBytes;
+    for(const auto & [_, instructionSet] : instructionSets)
+    {
+      sql::kernels::setMaxInstructionSet(instructionSet);
+      // The input of the "selection" kernel is the output of the previous kernel.
+      if(kernelName != "selection")
+        std::fill(bytes.begin(), bytes.end(), 0);
+      const auto start = std::chrono::steady_clock::now();
+      for(int i=0; i<countRuns; ++i)
+        kernel();
+      const auto duration = std::chrono::steady_clock::now() - start;
+      std::ostringstream s;
+      s << std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / countRuns << " ns";
+      v.push_back(s.str());
+
+      if(refBytes.has_value())
+        EXPECT_EQ(*refBytes, bytes);
+      else
+        refBytes = bytes;
+    }
+  }
+  sql::kernels::setMaxInstructionSet(InstructionSet::AVX2);
+
+  std::cout << "Supported instruction set: " << static_cast<int>(sql::kernels::instructionSet()) << std::endl;
+  std::cout << "For " << countValues << " values" << std::endl;
+  printChart(std::cout, &columnNames, values);
+}
+
 }
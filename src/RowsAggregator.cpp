@@ -0,0 +1,179 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "RowsAggregator.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace openCypher::detail
+{
+
+namespace
+{
+double numericAsDouble(const Value& v)
+{
+  if(storageClass(v) != 0)
+    throw std::logic_error("sum() and avg() expect numeric values.");
+  return asDouble(v);
+}
+
+// Like in SQLite, integers are summed as integers until a floating point value is summed.
+void addTo(Value& sum, const Value& v)
+{
+  if(std::holds_alternative<int64_t>(sum) && std::holds_alternative<int64_t>(v))
+  {
+    const int64_t a = std::get<int64_t>(sum);
+    const int64_t b = std::get<int64_t>(v);
+    if((b > 0 && a > std::numeric_limits<int64_t>::max() - b) ||
+       (b < 0 && a < std::numeric_limits<int64_t>::min() - b))
+      throw std::logic_error("integer overflow");
+    sum = a + b;
+  }
+  else
+    sum = numericAsDouble(sum) + numericAsDouble(v);
+}
+} // NS
+
+RowsAggregator::RowsAggregator(std::vector<std::optional<AggregationFunction>> aggregations)
+: m_aggregations(std::move(aggregations))
+{}
+
+auto RowsAggregator::findOrCreateGroup(const ResultOrder& resultOrder, const VecValues& values) -> Group&
+{
+  m_key.clear();
+  for(size_t p=0, sz=m_aggregations.size(); p<sz; ++p)
+  {
+    if(m_aggregations[p].has_value())
+      continue;
+    const auto & [i, j] = resultOrder[p];
+    appendEncoded((*values[i])[j], m_key);
+  }
+  const auto [it, inserted] = m_groupsIndices.try_emplace(m_key, m_groups.size());
+  if(!inserted)
+    return m_groups[it->second];
+
+  auto & group = m_groups.emplace_back();
+  group.values.resize(m_aggregations.size());
+  group.accumulators.resize(m_aggregations.size());
+  for(size_t p=0, sz=m_aggregations.size(); p<sz; ++p)
+  {
+    if(!m_aggregations[p].has_value())
+    {
+      const auto & [i, j] = resultOrder[p];
+      group.values[p] = copy((*values[i])[j]);
+    }
+    else if(*m_aggregations[p] == AggregationFunction::Sum)
+      group.accumulators[p].value = int64_t{0};
+  }
+  return group;
+}
+
+void RowsAggregator::onRow(const ResultOrder& resultOrder, const VecValues& values)
+{
+  Group& group = findOrCreateGroup(resultOrder, values);
+  for(size_t p=0, sz=m_aggregations.size(); p<sz; ++p)
+  {
+    if(!m_aggregations[p].has_value())
+      continue;
+    const auto & [i, j] = resultOrder[p];
+    const Value& value = (*values[i])[j];
+    if(std::holds_alternative<Nothing>(value))
+      continue;
+    Accumulator& acc = group.accumulators[p];
+    switch(*m_aggregations[p])
+    {
+      case AggregationFunction::CountRows:
+      case AggregationFunction::Count:
+        ++acc.count;
+        break;
+      case AggregationFunction::Sum:
+        addTo(acc.value, value);
+        break;
+      case AggregationFunction::Min:
+        if(std::holds_alternative<Nothing>(acc.value) || threeWayCompare(value, acc.value) < 0)
+          acc.value = copy(value);
+        break;
+      case AggregationFunction::Max:
+        if(std::holds_alternative<Nothing>(acc.value) || threeWayCompare(value, acc.value) > 0)
+          acc.value = copy(value);
+        break;
+      case AggregationFunction::Avg:
+        acc.floatSum += numericAsDouble(value);
+        ++acc.count;
+        break;
+    }
+  }
+}
+
+void RowsAggregator::emit(const std::optional<Limit>& limit, const FuncResults& f)
+{
+  const bool hasGroupingKeys = std::any_of(m_aggregations.begin(), m_aggregations.end(), [](const auto & aggregation)
+  {
+    return !aggregation.has_value();
+  });
+  if(m_groups.empty() && !hasGroupingKeys)
+  {
+    // The aggregations of an empty set.
+    auto & group = m_groups.emplace_back();
+    group.values.resize(m_aggregations.size());
+    group.accumulators.resize(m_aggregations.size());
+    for(size_t p=0, sz=m_aggregations.size(); p<sz; ++p)
+      if(*m_aggregations[p] == AggregationFunction::Sum)
+        group.accumulators[p].value = int64_t{0};
+  }
+
+  ResultOrder resultOrder;
+  resultOrder.reserve(m_aggregations.size());
+  for(size_t p=0, sz=m_aggregations.size(); p<sz; ++p)
+    resultOrder.emplace_back(0, p);
+  VecValues vecValues{nullptr};
+
+  const size_t countRows = limit.has_value() ? std::min(limit->maxCountRows, m_groups.size()) : m_groups.size();
+  for(size_t g=0; g<countRows; ++g)
+  {
+    Group& group = m_groups[g];
+    for(size_t p=0, sz=m_aggregations.size(); p<sz; ++p)
+    {
+      if(!m_aggregations[p].has_value())
+        continue;
+      Accumulator& acc = group.accumulators[p];
+      switch(*m_aggregations[p])
+      {
+        case AggregationFunction::CountRows:
+        case AggregationFunction::Count:
+          group.values[p] = acc.count;
+          break;
+        case AggregationFunction::Sum:
+        case AggregationFunction::Min:
+        case AggregationFunction::Max:
+          group.values[p] = std::move(acc.value);
+          break;
+        case AggregationFunction::Avg:
+          if(acc.count)
+            group.values[p] = acc.floatSum / static_cast<double>(acc.count);
+          break;
+      }
+    }
+    vecValues[0] = &group.values;
+    f(resultOrder, vecValues);
+  }
+  m_groups.clear();
+  m_groupsIndices.clear();
+}
+
+} // NS
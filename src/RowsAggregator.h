@@ -0,0 +1,72 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include "GraphDBSqliteTypes.h"
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace openCypher::detail
+{
+
+// Computes the aggregations of a return clause over rows that can't be aggregated in SQL (for example the paths
+// of a multi-hop pattern), using a hash table keyed by the encoded values of the grouping keys.
+//
+// Like in openCypher:
+// - the columns that are not aggregations are the grouping keys,
+// - nulls are ignored by the aggregation functions (count(*) is represented as a count of non-null ids),
+// - when there is no grouping key, a single row is emitted even if no row was passed to onRow.
+class RowsAggregator
+{
+public:
+  // @param aggregations: for each column of the rows, the aggregation function, or nullopt for a grouping key.
+  explicit RowsAggregator(std::vector<std::optional<AggregationFunction>> aggregations);
+
+  void onRow(const ResultOrder& resultOrder, const VecValues& values);
+
+  // Calls f with one row per group, in the order in which the groups were first seen.
+  void emit(const std::optional<Limit>& limit, const FuncResults& f);
+
+private:
+  struct Accumulator
+  {
+    int64_t count{};
+    // The sum, the min or the max.
+    Value value;
+    // The sum of floating point values, for avg.
+    double floatSum{};
+  };
+
+  struct Group
+  {
+    // The values of the grouping keys, and null values for the aggregations.
+    std::vector<Value> values;
+    std::vector<Accumulator> accumulators;
+  };
+
+  const std::vector<std::optional<AggregationFunction>> m_aggregations;
+  std::unordered_map<std::string, size_t> m_groupsIndices;
+  std::vector<Group> m_groups;
+  std::string m_key;
+
+  Group& findOrCreateGroup(const ResultOrder& resultOrder, const VecValues& values);
+};
+
+} // NS
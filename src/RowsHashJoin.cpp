@@ -0,0 +1,89 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "RowsHashJoin.h"
+
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace openCypher::detail
+{
+
+namespace
+{
+// Returns false if one of the keys is null.
+bool encodeKeys(const std::vector<Value>& row, const std::vector<size_t>& keys, std::string& encoded)
+{
+  encoded.clear();
+  for(const size_t key : keys)
+  {
+    if(std::holds_alternative<Nothing>(row[key]))
+      return false;
+    appendEncoded(row[key], encoded);
+  }
+  return true;
+}
+
+std::vector<Value> concatenate(const std::vector<Value>& a, const std::vector<Value>& b)
+{
+  std::vector<Value> row;
+  row.reserve(a.size() + b.size());
+  for(const auto & value : a)
+    row.push_back(copy(value));
+  for(const auto & value : b)
+    row.push_back(copy(value));
+  return row;
+}
+} // NS
+
+Rows hashJoin(const Rows& left,
+              const std::vector<size_t>& leftKeys,
+              const Rows& right,
+              const std::vector<size_t>& rightKeys)
+{
+  if(leftKeys.size() != rightKeys.size())
+    throw std::logic_error("The join keys are not parallel.");
+
+  const bool buildLeft = left.size() <= right.size();
+  const Rows& build = buildLeft ? left : right;
+  const Rows& probe = buildLeft ? right : left;
+  const auto & buildKeys = buildLeft ? leftKeys : rightKeys;
+  const auto & probeKeys = buildLeft ? rightKeys : leftKeys;
+
+  std::string key;
+  // The indices of the build rows, by encoded key.
+  std::unordered_map<std::string, std::vector<size_t>> buildRows;
+  buildRows.reserve(build.size());
+  for(size_t i{}, sz = build.size(); i<sz; ++i)
+    if(encodeKeys(build[i], buildKeys, key))
+      buildRows[key].push_back(i);
+
+  Rows joined;
+  for(const auto & probeRow : probe)
+  {
+    if(!encodeKeys(probeRow, probeKeys, key))
+      continue;
+    const auto it = buildRows.find(key);
+    if(it == buildRows.end())
+      continue;
+    for(const size_t i : it->second)
+      joined.push_back(buildLeft ? concatenate(build[i], probeRow) : concatenate(probeRow, build[i]));
+  }
+  return joined;
+}
+
+} // NS
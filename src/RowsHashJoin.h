@@ -0,0 +1,39 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include "Value.h"
+
+#include <vector>
+
+namespace openCypher::detail
+{
+
+using Rows = std::vector<std::vector<Value>>;
+
+// Joins the rows of |left| and |right| whose values in the key columns are equal
+// (|leftKeys| and |rightKeys| are parallel): a joined row contains the values of the |left| row
+// followed by the values of the |right| row. When there is no key column, this is the cartesian product.
+//
+// The hash table (keyed by the encoded values of the key columns) is built on the side having fewer rows,
+// and the rows of the other side probe it. Null keys never match.
+Rows hashJoin(const Rows& left,
+              const std::vector<size_t>& leftKeys,
+              const Rows& right,
+              const std::vector<size_t>& rightKeys);
+
+} // NS
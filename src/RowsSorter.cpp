@@ -0,0 +1,129 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "RowsSorter.h"
+
+#include <algorithm>
+
+namespace openCypher::detail
+{
+
+namespace
+{
+// Nulls are greater than the other values.
+int compare(const Value& a, const Value& b, const SortOrder order)
+{
+  const bool nullA = std::holds_alternative<Nothing>(a);
+  const bool nullB = std::holds_alternative<Nothing>(b);
+  int res;
+  if(nullA || nullB)
+    res = static_cast<int>(nullA) - static_cast<int>(nullB);
+  else
+    res = threeWayCompare(a, b);
+  return (order == SortOrder::Ascending) ? res : -res;
+}
+} // NS
+
+RowsSorter::RowsSorter(const size_t countColumns,
+                       std::vector<RowSortKey> sortKeys,
+                       const std::optional<Limit>& limit)
+: m_countColumns(countColumns)
+, m_sortKeys(std::move(sortKeys))
+, m_maxCountRows(limit.has_value() ? std::optional<size_t>{limit->maxCountRows} : std::nullopt)
+{
+  if(m_maxCountRows.has_value())
+    m_rows.reserve(*m_maxCountRows);
+}
+
+bool RowsSorter::before(const Row& a, const Row& b) const
+{
+  for(size_t k=0, sz=m_sortKeys.size(); k<sz; ++k)
+    if(const int res = compare(a.values[m_countColumns + k], b.values[m_countColumns + k], m_sortKeys[k].order))
+      return res < 0;
+  return a.sequence < b.sequence;
+}
+
+void RowsSorter::onRow(const ResultOrder& resultOrder, const VecValues& values)
+{
+  auto valueAt = [&](const size_t position) -> const Value&
+  {
+    const auto & [i, j] = resultOrder[position];
+    return (*values[i])[j];
+  };
+  auto before = [this](const Row& a, const Row& b) { return this->before(a, b); };
+
+  const size_t sequence = m_countRows++;
+  const bool full = m_maxCountRows.has_value() && (m_rows.size() == *m_maxCountRows);
+  if(full)
+  {
+    if(m_rows.empty())
+      // LIMIT 0
+      return;
+    // The row is kept only if it is before the last kept row, which is at the top of the heap.
+    // When the keys are equal, the last kept row is before because it was passed first.
+    const Row& lastKeptRow = m_rows.front();
+    int res{};
+    for(size_t k=0, sz=m_sortKeys.size(); k<sz && !res; ++k)
+      res = compare(valueAt(m_sortKeys[k].position), lastKeptRow.values[m_countColumns + k], m_sortKeys[k].order);
+    if(res >= 0)
+      return;
+  }
+
+  Row row;
+  row.sequence = sequence;
+  row.values.reserve(m_countColumns + m_sortKeys.size());
+  for(size_t p=0; p<m_countColumns; ++p)
+    row.values.push_back(copy(valueAt(p)));
+  for(const auto & sortKey : m_sortKeys)
+    row.values.push_back(copy(valueAt(sortKey.position)));
+
+  if(!m_maxCountRows.has_value())
+    m_rows.push_back(std::move(row));
+  else
+  {
+    if(full)
+    {
+      std::pop_heap(m_rows.begin(), m_rows.end(), before);
+      m_rows.back() = std::move(row);
+    }
+    else
+      m_rows.push_back(std::move(row));
+    std::push_heap(m_rows.begin(), m_rows.end(), before);
+  }
+}
+
+void RowsSorter::emit(const FuncResults& f)
+{
+  auto before = [this](const Row& a, const Row& b) { return this->before(a, b); };
+  if(m_maxCountRows.has_value())
+    std::sort_heap(m_rows.begin(), m_rows.end(), before);
+  else
+    std::sort(m_rows.begin(), m_rows.end(), before);
+
+  ResultOrder resultOrder;
+  resultOrder.reserve(m_countColumns);
+  for(size_t p=0; p<m_countColumns; ++p)
+    resultOrder.emplace_back(0, p);
+  VecValues vecValues{nullptr};
+  for(const auto & row : m_rows)
+  {
+    vecValues[0] = &row.values;
+    f(resultOrder, vecValues);
+  }
+  m_rows.clear();
+}
+
+} // NS
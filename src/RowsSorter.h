@@ -0,0 +1,75 @@
+/*
+ Copyright 2024-present Olivier Sohn
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include "GraphDBSqliteTypes.h"
+
+#include <optional>
+#include <vector>
+
+namespace openCypher::detail
+{
+
+struct RowSortKey
+{
+  // The position of the key in the rows passed to RowsSorter::onRow.
+  size_t position;
+  SortOrder order;
+};
+
+// Sorts the rows of a query according to an ORDER BY clause, and keeps only the first rows
+// when there is a LIMIT.
+//
+// With a LIMIT of k rows, the kept rows are in a bounded max-heap whose top is the last kept row:
+// memory is O(k) and a row that would not be kept is discarded before its values are copied.
+//
+// Like in openCypher, nulls are sorted after the other values in ascending order.
+// Rows with equal keys are kept in the order in which they were passed to onRow.
+class RowsSorter
+{
+public:
+  // @param countColumns: the count of columns of the rows passed to emit's callback.
+  //   The rows passed to onRow can have more columns: the sort keys that are not returned
+  //   are at positions >= countColumns.
+  RowsSorter(size_t countColumns,
+             std::vector<RowSortKey> sortKeys,
+             const std::optional<Limit>& limit);
+
+  void onRow(const ResultOrder& resultOrder, const VecValues& values);
+
+  // Calls f with the kept rows, in order.
+  void emit(const FuncResults& f);
+
+private:
+  struct Row
+  {
+    // The returned values, followed by the values of the sort keys.
+    std::vector<Value> values;
+    size_t sequence;
+  };
+
+  const size_t m_countColumns;
+  const std::vector<RowSortKey> m_sortKeys;
+  const std::optional<size_t> m_maxCountRows;
+  std::vector<Row> m_rows;
+  size_t m_countRows{};
+
+  // Returns true if |a| is before |b|.
+  bool before(const Row& a, const Row& b) const;
+};
+
+} // NS
@@ -92,8 +92,16 @@ void SQLPreparedStatement::bindVariable(int sqliteIndex, Value const& value) con
 
 void SQLPreparedStatement::bindVariables(const sql::QueryVars& sqlVars) const
 {
-  for(const auto & [i, v] : sqlVars.vars())
+  for(const auto & [i, var] : sqlVars.vars())
   {
+    if(const auto * value = std::get_if<Value>(&var))
+    {
+      bindVariable(i, *value);
+      continue;
+    }
+    if(std::holds_alternative<sql::QueryVars::TempTableList>(var))
+      // The list is in a temporary table, not bound.
+      continue;
     std::visit([&, i=i](auto && arg) {
       using T = std::decay_t<decltype(arg)>;
       if constexpr (std::is_same_v<T, std::monostate>)
@@ -124,9 +132,15 @@ void SQLPreparedStatement::bindVariables(const sql::QueryVars& sqlVars) const
         if(sqlite3_carray_bind(m_stmt, i, const_cast<iovec*>(arg->iovecs.data()), static_cast<int>(arg->iovecs.size()), CARRAY_BLOB, SQLITE_STATIC))
           throw std::logic_error("Bind: " + std::string{sqlite3_errmsg(m_db)});
       }
+      else if constexpr (std::is_same_v<T, std::shared_ptr<IDSet>>)
+      {
+        // read via the idset virtual table
+        if(sqlite3_bind_pointer(m_stmt, i, arg.get(), "idset", nullptr))
+          throw std::logic_error("Bind: " + std::string{sqlite3_errmsg(m_db)});
+      }
       else
         static_assert(c_false<T>, "non-exhaustive visitor!");
-    }, v);
+    }, std::get<HomogeneousNonNullableValues>(var));
   }
 }
 
@@ -175,6 +189,11 @@ nextRow:
   return res;
 }
 
+bool SQLPreparedStatement::isReadOnly() const
+{
+  return m_stmt && sqlite3_stmt_readonly(m_stmt);
+}
+
 void SQLPreparedStatement::reset() {
   if(sqlite3_reset(m_stmt))
     throw std::logic_error("Reset: " + std::string{sqlite3_errmsg(m_db)});
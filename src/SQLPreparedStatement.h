@@ -53,6 +53,8 @@ struct SQLPreparedStatement{
   void bindVariable(int sqliteIndex, const StringPtr&) const;
   void bindVariable(int sqliteIndex, const ByteArrayPtr&) const;
   void bindVariables(const sql::QueryVars& sqlVars) const;
+  // Whether the statement doesn't write to the DB.
+  bool isReadOnly() const;
   void reset();
 
   // if propertyTypes is not null, it contains the type of each column.
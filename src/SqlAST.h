@@ -60,31 +60,111 @@ private:
 };
 
 
+// How QueryVars binds a list.
+enum class ListBinding
+{
+  // Depending on the count of values of the list, CArray for small lists and SortedCArray for larger lists.
+  Adaptive,
+  // The list is bound as is with carray.
+  CArray,
+  // A sorted copy of the list without duplicates is bound with carray:
+  // SQLite then looks up its values in the indices in index order.
+  SortedCArray,
+  // The list is inserted in a temporary table whose primary key is the value, before running the query:
+  // SQLite then uses this table directly as the index of the IN operator.
+  // Adaptive doesn't use it: it is slower than SortedCArray for all the list sizes measured by PerfsListBinding.
+  TempTable
+};
+
 struct QueryVars
 {
+  // A list inserted in the temporary table |tableName| before running the query (see ListBinding::TempTable).
+  struct TempTableList
+  {
+    std::string tableName;
+    HomogeneousNonNullableValues values;
+  };
+
+  // A variable is either a list, bound with carray, a list inserted in a temporary table, or a single value.
+  using Variable = std::variant<HomogeneousNonNullableValues, TempTableList, Value>;
+
+  // The count of values from which a list is sorted, with ListBinding::Adaptive.
+  static constexpr size_t c_minSortedListSize{1000};
+
+  QueryVars() = default;
+
+  // |tempTablesPrefix| is the prefix of the names of the temporary tables of the lists bound with ListBinding::TempTable:
+  // queries that run at the same time must use different prefixes.
+  QueryVars(const ListBinding listBinding, const std::string& tempTablesPrefix)
+  : m_listBinding(listBinding)
+  , m_tempTablesPrefix(tempTablesPrefix)
+  {}
+
   // There is a convention in sqlite to identify bound variables by their position in the query.
   // So the order of calls to this method must match the query string order.
   std::string addVar(HomogeneousNonNullableValues const & value)
   {
-    m_variables[m_nextKey] = value;
+    // An IDSet is read by the idset virtual table, whatever its size.
+    if(std::holds_alternative<std::shared_ptr<IDSet>>(value))
+    {
+      m_variables.emplace(m_nextKey, value);
+      return "idset(" + nextName() + ")";
+    }
+    switch(listBinding(value))
+    {
+      case ListBinding::Adaptive:
+      case ListBinding::CArray:
+        m_variables.emplace(m_nextKey, value);
+        return "carray(" + nextName() + ")";
+      case ListBinding::SortedCArray:
+        m_variables.emplace(m_nextKey, sortedDistinctValues(value));
+        return "carray(" + nextName() + ")";
+      case ListBinding::TempTable:
+      {
+        // The variable has no placeholder in the query string.
+        std::string tableName = m_tempTablesPrefix + std::to_string(m_nextKey);
+        m_variables.emplace(m_nextKey, TempTableList{tableName, value});
+        ++m_nextKey;
+        return "temp." + tableName;
+      }
+    }
+    throw std::logic_error("[Unexpected] ListBinding");
+  }
+
+  // Binding values rather than inlining them in the query string lets queries differing only by their constants
+  // have the same query string, and share the same prepared statement.
+  std::string addVar(Value const & value)
+  {
+    m_variables.emplace(m_nextKey, copy(value));
     return nextName();
   }
   
-  const std::map<int, HomogeneousNonNullableValues> & vars() const { return m_variables; }
+  const std::map<int, Variable> & vars() const { return m_variables; }
   
 private:
   // key starts at 1 because of https://www.sqlite.org/c3ref/bind_blob.html:
   // The NNN value must be between 1 and the sqlite3_limit() parameter SQLITE_LIMIT_VARIABLE_NUMBER (default value: 32766).
-  std::map<int, HomogeneousNonNullableValues> m_variables;
+  std::map<int, Variable> m_variables;
   int m_nextKey {1};
+  ListBinding m_listBinding{ListBinding::CArray};
+  std::string m_tempTablesPrefix;
   
   std::string nextName()
   {
     std::ostringstream s;
-    s << "carray(?" << m_nextKey << ")";
+    s << "?" << m_nextKey;
     ++m_nextKey;
     return s.str();
   }
+
+  ListBinding listBinding(HomogeneousNonNullableValues const & value) const
+  {
+    if(m_listBinding != ListBinding::Adaptive)
+      return m_listBinding;
+    if(countValues(value) >= c_minSortedListSize)
+      return ListBinding::SortedCArray;
+    return ListBinding::CArray;
+  }
 };
 
 enum class Comparison
@@ -152,6 +232,9 @@ inline Evaluation negated(Evaluation e)
   return Evaluation::Unknown;
 }
 
+class FilterProgram;
+struct FilterOperand;
+
 struct Expression
 {
   virtual ~Expression() = default;
@@ -159,6 +242,15 @@ struct Expression
   virtual std::optional<Evaluation> tryEvaluate(const CountLabelsPerElement countLabelsPerElement) const = 0;
   
   virtual void toString(std::ostream& os, QueryVars& vars) const = 0;
+
+  // Appends the instructions evaluating this expression to |program|,
+  // and returns the register that will contain the evaluations.
+  // Throws if the expression is not a predicate.
+  virtual unsigned compile(FilterProgram& program) const;
+
+  // Returns the operand representing the value of this expression in |program|.
+  // Throws if the expression is not a value.
+  virtual FilterOperand compileOperand(FilterProgram& program) const;
 };
 
 struct Literal : public Expression
@@ -173,7 +265,16 @@ struct Literal : public Expression
     std::visit([&](auto && arg) {
       using T = std::decay_t<decltype(arg)>;
       if constexpr (std::is_same_v<T, std::shared_ptr<Value>>)
-        os << *arg;
+      {
+        if(std::holds_alternative<Nothing>(*arg))
+          os << *arg;
+        else
+        {
+          if(!m_varName.has_value())
+            m_varName = vars.addVar(*arg);
+          os << *m_varName;
+        }
+      }
       else if constexpr (std::is_same_v<T, HomogeneousNonNullableValues>)
       {
         if(!m_varName.has_value())
@@ -185,6 +286,8 @@ struct Literal : public Expression
     }, m_variant);
   }
 
+  FilterOperand compileOperand(FilterProgram& program) const override;
+
   auto& getVariant() const { return m_variant; }
 
 private:
@@ -217,6 +320,7 @@ struct QueryColumn : public Expression
   {
     os << m_name;
   }
+  FilterOperand compileOperand(FilterProgram& program) const override;
 
 private:
   QueryColumnName m_name;
@@ -227,6 +331,8 @@ struct Null : public Expression
 {
   std::optional<Evaluation> tryEvaluate(const CountLabelsPerElement countLabelsPerElement) const override { return Evaluation::Unknown; }
   void toString(std::ostream& os, QueryVars& vars) const override { os << "NULL"; }
+  unsigned compile(FilterProgram& program) const override;
+  FilterOperand compileOperand(FilterProgram& program) const override;
 };
 
 // Represents a TRUE value.
@@ -234,6 +340,7 @@ struct True : public Expression
 {
   std::optional<Evaluation> tryEvaluate(const CountLabelsPerElement countLabelsPerElement) const override { return Evaluation::True; }
   void toString(std::ostream& os, QueryVars& vars) const override { os << "TRUE"; }
+  unsigned compile(FilterProgram& program) const override;
 };
 
 // Represents a FALSE value.
@@ -241,6 +348,7 @@ struct False : public Expression
 {
   std::optional<Evaluation> tryEvaluate(const CountLabelsPerElement countLabelsPerElement) const override { return Evaluation::False; }
   void toString(std::ostream& os, QueryVars& vars) const override { os << "FALSE"; }
+  unsigned compile(FilterProgram& program) const override;
 };
 
 // Represents a negation.
@@ -264,6 +372,8 @@ struct Not : public Expression
     os << " ) ";
   }
 
+  unsigned compile(FilterProgram& program) const override;
+
 private:
   std::unique_ptr<Expression> m_expr;
 };
@@ -303,6 +413,8 @@ struct ElementLabelsConstraints : public Expression
     os << " ) ";
   }
 
+  unsigned compile(FilterProgram& program) const override;
+
 private:
   std::set<ElementTypeIndex> m_typeConstraintsANDed;
   QueryColumnName m_typeIndexQueryColumn;
@@ -353,6 +465,8 @@ struct ComparisonExpression : public Expression {
     os << " ) ";
   }
 
+  unsigned compile(FilterProgram& program) const override;
+
 private:
   std::unique_ptr<Expression> m_left;
   Comparison m_comp;
@@ -398,6 +512,8 @@ struct StringListNullPredicateExpression : public Expression {
     os << " IN ";
     m_right->toString(os, vars);
   }
+
+  unsigned compile(FilterProgram& program) const override;
   
 private:
   std::unique_ptr<Expression> m_left;
@@ -515,6 +631,8 @@ struct AggregateExpression : public Expression
     }
   }
 
+  unsigned compile(FilterProgram& program) const override;
+
 private:
   Aggregator m_aggregator;
   std::vector<std::unique_ptr<Expression>> m_subExprs;
@@ -167,7 +167,9 @@ struct SQLQueryStat{
 template<typename ID = int64_t>
 struct GraphWithStats
 {
-  GraphWithStats(const std::optional<std::filesystem::path>& dbPath = std::nullopt, std::optional<Overwrite> overwrite = std::nullopt);
+  GraphWithStats(const std::optional<std::filesystem::path>& dbPath = std::nullopt,
+                 std::optional<Overwrite> overwrite = std::nullopt,
+                 std::optional<IDAllocation> idAllocation = std::nullopt);
   
   GraphDB<ID>& getDB() { return *m_graph; }
 
@@ -189,7 +191,17 @@ struct QueryResultsHandler
   
   // Runs the openCypher query |cypherQuery| with optional parameters |Params|.
   void run(const std::string &cypherQuery,
-           const std::map<ParameterName, HomogeneousNonNullableValues>& Params = {});
+           const std::map<ParameterName, ParameterValue>& Params = {});
+
+  // Runs the openCypher query |cypherQuery| to get the page of results following |continuationToken|
+  // (see openCypher::runCypherPage), and returns the continuation token of the next page.
+  std::string runPage(const std::string &cypherQuery,
+                      const std::string &continuationToken,
+                      const std::map<ParameterName, ParameterValue>& Params = {});
+
+  // Runs the openCypher query |cypherQuery| for each parameter set of |batchParams| (see openCypher::runCypherBatch).
+  void runBatch(const std::string &cypherQuery,
+                const std::vector<std::map<ParameterName, ParameterValue>>& batchParams);
 
   bool printCypherAST() const { return m_printCypherAST; }
     
@@ -197,12 +209,17 @@ struct QueryResultsHandler
 
   void onColumns(const std::vector<std::string>& columns);
   void onRow(const ResultOrder& resultOrder, const VecValues& values);
+  void onBatch(size_t batchIndex);
   
   void onCypherQueryEnds();
   
   size_t countRows() const { return m_rows.size(); }
   const auto& rows() const { return m_rows; }
 
+  size_t countBatches() const { return m_batchesBegin.size(); }
+  // The rows of the parameter set of index |batchIndex| of a batch.
+  std::vector<std::vector<Value>> batchRows(size_t batchIndex) const;
+
   size_t countColumns() const { return m_columnNames.size(); }
 
   const std::vector<std::string>& columns() const
@@ -232,6 +249,9 @@ struct QueryResultsHandler
   std::chrono::steady_clock::duration m_sqlPropCbDuration{};
 
 private:
+  template<typename F>
+  void measure(const F& runQuery);
+
   std::chrono::steady_clock::time_point m_tCallRunCypher{};
 
   std::unique_ptr<LogIndentScope> m_logIndentScope;
@@ -241,6 +261,8 @@ private:
   
   GraphWithStats<ID>& m_db;
   std::vector<std::vector<Value>> m_rows;
+  // For each parameter set of a batch, the index of its first row in m_rows.
+  std::vector<size_t> m_batchesBegin;
 };
 
 }
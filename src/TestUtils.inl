@@ -3,7 +3,8 @@ namespace openCypher::test
 {
 template<typename ID>
 GraphWithStats<ID>::GraphWithStats(const std::optional<std::filesystem::path>& dbPath,
-                               std::optional<Overwrite> overwrite)
+                               std::optional<Overwrite> overwrite,
+                               std::optional<IDAllocation> idAllocation)
 {
   auto onSQLQuery = [&](const std::string& req)
   {
@@ -48,18 +49,67 @@ GraphWithStats<ID>::GraphWithStats(const std::optional<std::filesystem::path>& d
     return 0;
   };
 
-  m_graph = std::make_unique<GraphDB<ID>>(onSQLQuery, onSQLQueryDuration, onDBDiagnosticContent, dbPath, overwrite);
+  m_graph = std::make_unique<GraphDB<ID>>(onSQLQuery, onSQLQueryDuration, onDBDiagnosticContent, dbPath, overwrite, idAllocation);
 }
 
 template<typename ID>
 void QueryResultsHandler<ID>::run(const std::string &cypherQuery,
-                              const std::map<ParameterName, HomogeneousNonNullableValues>& Params)
+                              const std::map<ParameterName, ParameterValue>& Params)
+{
+  measure([&]()
+  {
+    openCypher::runCypher(cypherQuery, Params, m_db.getDB(), *this);
+  });
+}
+
+template<typename ID>
+std::string QueryResultsHandler<ID>::runPage(const std::string &cypherQuery,
+                                             const std::string &continuationToken,
+                                             const std::map<ParameterName, ParameterValue>& Params)
+{
+  std::string nextContinuationToken;
+  measure([&]()
+  {
+    nextContinuationToken = openCypher::runCypherPage(cypherQuery, Params, m_db.getDB(), *this, continuationToken);
+  });
+  return nextContinuationToken;
+}
+
+template<typename ID>
+void QueryResultsHandler<ID>::runBatch(const std::string &cypherQuery,
+                                   const std::vector<std::map<ParameterName, ParameterValue>>& batchParams)
+{
+  measure([&]()
+  {
+    openCypher::runCypherBatch(cypherQuery, batchParams, m_db.getDB(), *this);
+  });
+}
+
+template<typename ID>
+std::vector<std::vector<Value>> QueryResultsHandler<ID>::batchRows(size_t batchIndex) const
+{
+  const size_t begin = m_batchesBegin.at(batchIndex);
+  const size_t end = (batchIndex + 1 < m_batchesBegin.size()) ? m_batchesBegin[batchIndex + 1] : m_rows.size();
+  std::vector<std::vector<Value>> res;
+  for(size_t i=begin; i<end; ++i)
+  {
+    auto & row = res.emplace_back();
+    for(const auto & value : m_rows[i])
+      row.push_back(copy(value));
+  }
+  return res;
+}
+
+template<typename ID>
+template<typename F>
+void QueryResultsHandler<ID>::measure(const F& runQuery)
 {
   m_db.m_queryStats.clear();
   m_resultOrder.clear();
   m_variables.clear();
   m_columnNames.clear();
   m_rows.clear();
+  m_batchesBegin.clear();
 
   auto sqlDuration1 = m_db.getDB().m_totalSQLQueryExecutionDuration;
   auto relCbDuration1 = m_db.getDB().m_totalSystemRelationshipCbDuration;
@@ -67,7 +117,7 @@ void QueryResultsHandler<ID>::run(const std::string &cypherQuery,
   
   m_tCallRunCypher = std::chrono::steady_clock::now();
   
-  openCypher::runCypher(cypherQuery, Params, m_db.getDB(), *this);
+  runQuery();
   
   m_cypherQueryDuration = (std::chrono::steady_clock::now() - m_tCallRunCypher) - m_cypherToASTDuration;
   
@@ -115,6 +165,14 @@ void QueryResultsHandler<ID>::onRow(const ResultOrder& resultOrder, const VecVal
     row.push_back(copy((*values[i])[j]));
 }
 
+template<typename ID>
+void QueryResultsHandler<ID>::onBatch(size_t batchIndex)
+{
+  if(batchIndex != m_batchesBegin.size())
+    throw std::logic_error("Batches are expected in order");
+  m_batchesBegin.push_back(m_rows.size());
+}
+
 template<typename ID>
 void QueryResultsHandler<ID>::onCypherQueryEnds()
 {
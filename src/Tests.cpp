@@ -4,6 +4,7 @@
 #include <filesystem>
 
 #include "GraphDBSqlite.h"
+#include "FilterKernels.h"
 #include "CypherQuery.h"
 #include "Logs.h"
 #include "TestUtils.h"
@@ -1307,8 +1308,30 @@ TEST(Test, WhereClauses)
   // 4 because we need different queries on node and dualNode.
   
   
-  // not supported yet: "A non-equi-var expression is using non-id properties"
-  EXPECT_THROW(handler.run("MATCH (b)<-[r]-(a) WHERE r.since > 12345 OR a.age < 107 return a.age, b.age, r.since"), std::logic_error);
+  // Non-equi-var expression using non-id properties.
+  handler.run("MATCH (b)<-[r]-(a) WHERE r.since > 12345 OR a.age < 107 return a.age, b.age, r.since");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {
+        5, 10, 1234
+      }, {
+        105, 110, 123456
+      },
+    });
+    const std::set<std::vector<Value>> actualRes = toSet(handler.rows());
+    EXPECT_EQ(expectedRes, actualRes);
+  }
+  
+  handler.run("MATCH (b)<-[r]-(a) WHERE r.since > 12345 AND a.age < 107 return a.age, b.age, r.since");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {
+        105, 110, 123456
+      },
+    });
+    const std::set<std::vector<Value>> actualRes = toSet(handler.rows());
+    EXPECT_EQ(expectedRes, actualRes);
+  }
 }
 
 TEST(Test, WhereClausesOptimized)
@@ -1645,20 +1668,19 @@ TEST(Test, LongerPathPattern)
     EXPECT_EQ(expectedRes, actualRes);
   }
   
-  // Non-equi-var expression in WHERE clause is not supported yet.
-  EXPECT_THROW(handler.run("MATCH (a)-[]->(b)-[]->(c) WHERE a.age < b.age AND b.age < c.age return a.age, b.age, c.age"), std::exception);
-  /*
-   {
-   const std::set<std::vector<std::optional<std::string>>> expectedRes{
-   {
-   {Value(1)}, {Value(2)}, {Value(3)}
-   }, {
-   {Value(2)}, {Value(3)}, {Value(4)}
-   },
-   };
-   const std::set<std::vector<std::optional<std::string>>> actualRes = toSet(handler.rows());
-   EXPECT_EQ(expectedRes, actualRes);
-   }*/
+  // Non-equi-var expression in WHERE clause.
+  handler.run("MATCH (a)-[]->(b)-[]->(c) WHERE a.age < b.age AND b.age < c.age return a.age, b.age, c.age");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {
+        1, 2, 3
+      }, {
+        2, 3, 4
+      },
+    });
+    const std::set<std::vector<Value>> actualRes = toSet(handler.rows());
+    EXPECT_EQ(expectedRes, actualRes);
+  }
   
   handler.run("MATCH (a)-[]->(b)-[]->(a) return a.age, b.age, a.age");
   {
@@ -2058,12 +2080,69 @@ TEST(Test, LabelConstraints)
   EXPECT_EQ(0, handler.rows().size());
   
   
-  // Non-equi var expression using non-id properties is not supported yet.
-  // To support this we should apply the filter at the end before returning the results.
-  EXPECT_THROW(handler.run("MATCH (a)-[r]->(b) WHERE r:Rel2 OR a.age > 2.5 return id(r)"), std::exception);
-  EXPECT_THROW(handler.run("MATCH (a)-[r]->(b) WHERE a:E1 OR b.age = 2 return id(r)"), std::exception);
-  EXPECT_THROW(handler.run("MATCH (a)-[r]->(b) WHERE a:E1 AND (NOT r:Rel1 OR a.age > 2.5) AND (NOT r:Rel2 AND r.since < 0.5) return id(r)"), std::exception);
-  EXPECT_THROW(handler.run("MATCH (a)-[r]->(b) WHERE (a:E1 AND (NOT r:Rel1 AND r.since > 2.5)) OR (NOT r:Rel2 AND r.since < 0.5) return id(r)"), std::exception);
+  // Non-equi var expressions using non-id properties are applied once the property values have been gathered.
+  
+  handler.run("MATCH (a)-[r]->(b) WHERE r:Rel2 OR a.age > 2.5 return id(r)");
+  // returns all Rel2 and Rel1 whose origin has an age > 2.5
+  {
+    std::set<std::vector<int64_t>> expected;
+    for(int i=0; i < 4; ++i)
+      for(int j=0; j < 4; ++j)
+      {
+        expected.insert({rel2Id[i][j]});
+        if(i > 0)
+          expected.insert({rel1Id[i][j]});
+      }
+    const auto expectedRes = toValues(std::move(expected));
+    const std::set<std::vector<Value>> actualRes = toSet(handler.rows());
+    EXPECT_EQ(expectedRes, actualRes);
+  }
+  
+  handler.run("MATCH (a)-[r]->(b) WHERE a:E1 OR b.age = 2 return id(r)");
+  // returns all Rel1 (no node has an age of 2)
+  {
+    std::set<std::vector<int64_t>> expected;
+    for(int i=0; i < 4; ++i)
+      for(int j=0; j < 4; ++j)
+        expected.insert({rel1Id[i][j]});
+    const auto expectedRes = toValues(std::move(expected));
+    const std::set<std::vector<Value>> actualRes = toSet(handler.rows());
+    EXPECT_EQ(expectedRes, actualRes);
+  }
+  
+  handler.run("MATCH (a)-[r]->(b) WHERE a:E1 AND (NOT r:Rel1 OR a.age > 2.5) AND (NOT r:Rel2 AND r.since < 0.5) return id(r)");
+  // returns Rel1 where since = 0 and whose origin has an age > 2.5
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {
+        rel1Id[1][0]
+      }, {
+        rel1Id[2][0]
+      }, {
+        rel1Id[3][0]
+      }
+    });
+    const std::set<std::vector<Value>> actualRes = toSet(handler.rows());
+    EXPECT_EQ(expectedRes, actualRes);
+  }
+  
+  handler.run("MATCH (a)-[r]->(b) WHERE (a:E1 AND (NOT r:Rel1 AND r.since > 2.5)) OR (NOT r:Rel2 AND r.since < 0.5) return id(r)");
+  // returns Rel1 where since = 0
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {
+        rel1Id[0][0]
+      }, {
+        rel1Id[1][0]
+      }, {
+        rel1Id[2][0]
+      }, {
+        rel1Id[3][0]
+      }
+    });
+    const std::set<std::vector<Value>> actualRes = toSet(handler.rows());
+    EXPECT_EQ(expectedRes, actualRes);
+  }
   
   // Test 2 hops pattern
   handler.run("MATCH (a)-[r]->(b:E2)-[r2]->(a) WHERE a:E1 AND ((NOT r:Rel1 AND r.since > 2.5) OR (NOT r:Rel2 AND r.since < 0.5)) return id(r), id(r2)");
@@ -2192,4 +2271,2152 @@ TEST(Test, UnionAll)
   }
 }
 
+TEST(Test, TypePartitionedIDs)
+{
+  LogIndentScope _{};
+  
+  const std::filesystem::path dbFile{"Test.TypePartitionedIDs.sqlite3db"};
+  
+  using ID = int64_t;
+  
+  const auto p_age = mkProperty("age");
+  const auto p_since = mkProperty("since");
+  
+  ID p1, p2, c1, r1, r2;
+  {
+    auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>(dbFile, Overwrite::Yes, IDAllocation::TypePartitioned);
+    
+    auto & db = dbWrapper->getDB();
+    EXPECT_EQ(IDAllocation::TypePartitioned, db.idAllocation());
+    db.addType("Person", true, {p_age});
+    db.addType("Company", true, {p_age});
+    db.addType("Knows", false, {p_since});
+    db.addType("WorksAt", false, {p_since});
+    
+    p1 = db.addNode("Person", mkVec(std::pair{p_age, Value(5)}));
+    p2 = db.addNode("Person", mkVec(std::pair{p_age, Value(10)}));
+    c1 = db.addNode("Company", mkVec(std::pair{p_age, Value(100)}));
+    r1 = db.addRelationship("Knows", p1, p2, mkVec(std::pair{p_since, Value(1234)}));
+    r2 = db.addRelationship("WorksAt", p1, c1, mkVec(std::pair{p_since, Value(2345)}));
+    
+    // The type of an element is stored in the high bits of its id.
+    EXPECT_EQ(p1 >> 48, p2 >> 48);
+    EXPECT_NE(p1 >> 48, c1 >> 48);
+    EXPECT_NE(r1 >> 48, r2 >> 48);
+    EXPECT_NE(p1 >> 48, r1 >> 48);
+    EXPECT_EQ(p1 + 1, p2);
+    
+    // An explicit id must be in the id range of the type.
+    EXPECT_THROW(db.addNode("Company", mkVec(std::pair{mkProperty("SYS__ID"), Value(p1 + 10)})), std::logic_error);
+    
+    QueryResultsHandler handler(*dbWrapper);
+    
+    // Type constraints are range predicates on ids: the nodes system table is not used.
+    handler.run("MATCH (a:Person)-[r]->(b:Company) RETURN id(a), id(b), id(r)");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {p1, c1, r2}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_EQ(1, handler.countSQLQueries());
+    EXPECT_EQ(std::string::npos, dbWrapper->m_queryStats[0].query.find("nodes"));
+    
+    handler.run("MATCH (a)-[r]->(b) WHERE b:Person OR b:Company RETURN id(b)");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {p2}, {c1}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_EQ(1, handler.countSQLQueries());
+    EXPECT_EQ(std::string::npos, dbWrapper->m_queryStats[0].query.find("nodes"));
+    
+    handler.run("MATCH (a)-[r:Knows]->(b) RETURN a.age, b.age, r.since");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {5, 10, 1234}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_EQ(std::string::npos, dbWrapper->m_queryStats[0].query.find("nodes"));
+  }
+  
+  // The id allocation scheme is inferred from the DB.
+  EXPECT_THROW(std::make_unique<GraphWithStats<int64_t>>(dbFile, Overwrite::No, IDAllocation::Sequential), std::invalid_argument);
+  {
+    auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>(dbFile, Overwrite::No);
+    
+    auto & db = dbWrapper->getDB();
+    EXPECT_EQ(IDAllocation::TypePartitioned, db.idAllocation());
+    
+    // The allocation continues after the largest id of the type.
+    const ID p3 = db.addNode("Person", mkVec(std::pair{p_age, Value(15)}));
+    EXPECT_EQ(p2 + 1, p3);
+    
+    QueryResultsHandler handler(*dbWrapper);
+    handler.run("MATCH (a:Person) RETURN id(a)");
+    EXPECT_EQ(3, handler.countRows());
+  }
+  
+  // Type partitioned ids are only supported for integer ids.
+  EXPECT_THROW(std::make_unique<GraphWithStats<StringPtr>>(std::nullopt, std::nullopt, IDAllocation::TypePartitioned), std::invalid_argument);
+}
+
+TEST(Test, PropertyIndices)
+{
+  LogIndentScope _{};
+  
+  const std::filesystem::path dbFile{"Test.PropertyIndices.sqlite3db"};
+  
+  using ID = int64_t;
+  
+  const auto p_age = mkProperty("age");
+  const auto p_weight = mkProperty("weight");
+  
+  const Label personLabel{SymbolicName{"Person"}};
+  {
+    auto dbWrapper = std::make_unique<GraphWithStats<ID>>(dbFile, Overwrite::Yes);
+    
+    auto & db = dbWrapper->getDB();
+    db.addType("Person", true, {p_age, p_weight}, {
+      PropertyIndex{{p_age}},
+      PropertyIndex{{p_weight}, IndexKind::Unique},
+      PropertyIndex{{p_age}, IndexKind::BTree, "age > 100"}
+    });
+    db.addType("Knows", false, {});
+    
+    EXPECT_THROW(db.addIndex("Person", PropertyIndex{{mkProperty("unknown")}}), std::logic_error);
+    EXPECT_THROW(db.addIndex("Unknown", PropertyIndex{{p_age}}), std::logic_error);
+    
+    const size_t countPersons{1000};
+    std::vector<ID> ids;
+    db.beginTransaction();
+    for(size_t i{}; i<countPersons; ++i)
+      ids.push_back(db.addNode("Person", mkVec(std::pair{p_age, Value(static_cast<int64_t>(i))},
+                                               std::pair{p_weight, Value(static_cast<int64_t>(3*i))})));
+    for(size_t i{1}; i<countPersons; ++i)
+      db.addRelationship("Knows", ids[i-1], ids[i], {});
+    db.endTransaction();
+    
+    // Unique indices are enforced.
+    EXPECT_THROW(db.addNode("Person", mkVec(std::pair{p_weight, Value(3)})), std::logic_error);
+    db.addNode("Person", mkVec(std::pair{p_age, Value(5)}, std::pair{p_weight, Value(-1)}));
+    EXPECT_THROW(db.addIndex("Person", PropertyIndex{{p_age}, IndexKind::Unique}), std::logic_error);
+    
+    QueryResultsHandler handler(*dbWrapper);
+    
+    // A selective range predicate on an indexed property: the index is used instead of the primary key.
+    handler.run("MATCH (a)-[r]->(b:Person) WHERE b.age < 10 RETURN b.age");
+    EXPECT_EQ(9, handler.countRows());
+    EXPECT_NE(std::string::npos, dbWrapper->m_queryStats.back().query.find("+SYS__ID"));
+    
+    // A non-selective range predicate: the primary key is used.
+    handler.run("MATCH (a)-[r]->(b:Person) WHERE b.age > 10 RETURN b.age");
+    EXPECT_EQ(989, handler.countRows());
+    EXPECT_EQ(std::string::npos, dbWrapper->m_queryStats.back().query.find("+SYS__ID"));
+    
+    // An equality predicate on a property with a unique index.
+    handler.run("MATCH (a)-[r]->(b:Person) WHERE b.weight = 30 RETURN b.age");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {10}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_NE(std::string::npos, dbWrapper->m_queryStats.back().query.find("+SYS__ID"));
+    
+    // Label scans use the indices directly.
+    handler.run("MATCH (b:Person) WHERE b.age = 42 RETURN b.weight");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {126}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+  }
+  
+  // The indices are inferred from the DB.
+  {
+    auto dbWrapper = std::make_unique<GraphWithStats<ID>>(dbFile, Overwrite::No);
+    
+    const auto & indices = dbWrapper->getDB().typesAndIndices().at(personLabel);
+    EXPECT_EQ(3, indices.size());
+    size_t countUnique{};
+    size_t countPartial{};
+    for(const auto & namedIndex : indices)
+    {
+      EXPECT_EQ(1, namedIndex.index.properties.size());
+      if(namedIndex.index.kind == IndexKind::Unique)
+      {
+        ++countUnique;
+        EXPECT_EQ(p_weight, namedIndex.index.properties[0]);
+      }
+      if(namedIndex.index.where.has_value())
+      {
+        ++countPartial;
+        EXPECT_EQ("age > 100", *namedIndex.index.where);
+      }
+    }
+    EXPECT_EQ(1, countUnique);
+    EXPECT_EQ(1, countPartial);
+  }
+}
+
+TEST(Test, PropertyFirstPlans)
+{
+  LogIndentScope _{};
+  
+  using ID = int64_t;
+  
+  const auto p_key = mkProperty("key");
+  const auto p_age = mkProperty("age");
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<ID>>();
+  
+  auto & db = dbWrapper->getDB();
+  db.addType("Person", true, {p_key, p_age}, {
+    PropertyIndex{{p_key}, IndexKind::Unique},
+    PropertyIndex{{p_age}}
+  });
+  db.addType("Knows", false, {});
+  
+  const size_t countPersons{2000};
+  std::vector<ID> ids;
+  db.beginTransaction();
+  for(size_t i{}; i<countPersons; ++i)
+    ids.push_back(db.addNode("Person", mkVec(std::pair{p_key, Value(static_cast<int64_t>(i))},
+                                             std::pair{p_age, Value(static_cast<int64_t>(i % 50))})));
+  for(size_t i{1}; i<countPersons; ++i)
+    db.addRelationship("Knows", ids[i-1], ids[i], {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  // The ids of the matching 'a' nodes are looked up first, and the system relationships query starts from them.
+  handler.run("MATCH (a:Person)-[r]->(b) WHERE a.key = 42 RETURN b.key");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {43}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  EXPECT_EQ(0, dbWrapper->m_queryStats[0].query.find("SELECT SYS__ID FROM Person"));
+  EXPECT_NE(std::string::npos, dbWrapper->m_queryStats[2].query.find("R0.OriginID IN carray("));
+  
+  handler.run("MATCH (a)-[r]-(b:Person) WHERE b.key IN [10, 20] RETURN a.key");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {9}, {11}, {19}, {21}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  EXPECT_NE(std::string::npos, dbWrapper->m_queryStats[2].query.find("R0.DestinationID IN carray("));
+  // The properties of the anchored variable are looked up by id.
+  EXPECT_NE(std::string::npos, dbWrapper->m_queryStats.back().query.find("+SYS__ID"));
+  
+  // 800 nodes match, which is not selective enough to anchor the system relationships query.
+  handler.run("MATCH (a:Person)-[r]->(b) WHERE a.age < 20 RETURN b.key");
+  EXPECT_EQ(800, handler.countRows());
+  EXPECT_EQ(std::string::npos, dbWrapper->m_queryStats[2].query.find("IN carray("));
+  
+  // No node matches, so the system relationships query is not run.
+  handler.run("MATCH (a:Person)-[r]->(b) WHERE a.key = -5 RETURN b.key");
+  EXPECT_EQ(0, handler.countRows());
+  EXPECT_EQ(1, handler.countSQLQueries());
+  
+  // Too many nodes match, so the system relationships query enumerates all relationships.
+  handler.run("MATCH (a:Person)-[r]->(b) WHERE a.age >= 0 RETURN b.key");
+  EXPECT_EQ(countPersons - 1, handler.countRows());
+  EXPECT_EQ(std::string::npos, dbWrapper->m_queryStats[1].query.find("IN carray("));
+}
+
+TEST(Test, InlineProperties)
+{
+  LogIndentScope _{};
+  
+  const std::filesystem::path dbFile{"Test.InlineProperties.sqlite3db"};
+  
+  using ID = int64_t;
+  
+  const auto p_age = mkProperty("age");
+  const auto p_weight = mkProperty("weight");
+  const auto p_since = mkProperty("since");
+  
+  ID p1, p2, p3, c1;
+  {
+    auto dbWrapper = std::make_unique<GraphWithStats<ID>>(dbFile, Overwrite::Yes);
+    
+    auto & db = dbWrapper->getDB();
+    db.addType("Person", true, {p_age, p_weight});
+    db.addType("Company", true, {PropertySchema{p_age, ValueType::Integer, IsNullable::Yes, std::make_shared<Value>(77)}});
+    db.addType("Knows", false, {p_since});
+    
+    p1 = db.addNode("Person", mkVec(std::pair{p_age, Value(5)}, std::pair{p_weight, Value(50)}));
+    p2 = db.addNode("Person", mkVec(std::pair{p_age, Value(10)}));
+    
+    // The values of existing elements are copied in the system tables.
+    db.addInlineProperty(Element::Node, PropertySchema{p_age, ValueType::Integer});
+    db.addInlineProperty(Element::Relationship, PropertySchema{p_since, ValueType::Integer});
+    
+    EXPECT_THROW(db.addInlineProperty(Element::Node, PropertySchema{p_weight, ValueType::String}), std::logic_error);
+    EXPECT_THROW(db.addInlineProperty(Element::Node, PropertySchema{mkProperty("NodeType"), ValueType::Integer}), std::logic_error);
+    EXPECT_THROW(db.addType("Other", true, {PropertySchema{p_age, ValueType::String}}), std::logic_error);
+    
+    p3 = db.addNode("Person", mkVec(std::pair{p_age, Value(15)}));
+    // The default value is used.
+    c1 = db.addNode("Company", {});
+    db.addRelationship("Knows", p1, p2, mkVec(std::pair{p_since, Value(2000)}));
+    db.addRelationship("Knows", p2, p3, mkVec(std::pair{p_since, Value(2010)}));
+    db.addRelationship("Knows", p3, c1, {});
+    
+    QueryResultsHandler handler(*dbWrapper);
+    
+    // Filters and projections on inline properties are evaluated in the system relationships query.
+    handler.run("MATCH (a)-[r]->(b) WHERE b.age >= 10 AND r.since >= 2000 RETURN a.age, b.age, r.since");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {5, 10, 2000},
+        {10, 15, 2010}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_EQ(1, handler.countSQLQueries());
+    
+    handler.run("MATCH (a)-[r]->(b:Company) RETURN b.age, r.since");
+    EXPECT_EQ(1, handler.countRows());
+    EXPECT_EQ(Value(77), handler.rows()[0][0]);
+    EXPECT_EQ(Nothing{}, handler.rows()[0][1]);
+    EXPECT_EQ(1, handler.countSQLQueries());
+    
+    // Non-equi-var expressions can use inline properties.
+    handler.run("MATCH (a)-[r]->(b) WHERE a.age = 5 OR r.since = 2010 RETURN id(a)");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {p1}, {p2}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_EQ(1, handler.countSQLQueries());
+    
+    // Non-inline properties are still looked up in the property tables.
+    handler.run("MATCH (a)-[r]-(b) WHERE r.since = 2000 RETURN a.weight, b.age");
+    EXPECT_EQ(2, handler.countRows());
+    for(const auto & row : handler.rows())
+    {
+      if(row[0] == Nothing{})
+        // a = p2, b = p1
+        EXPECT_EQ(Value(5), row[1]);
+      else
+      {
+        // a = p1, b = p2
+        EXPECT_EQ(Value(50), row[0]);
+        EXPECT_EQ(Value(10), row[1]);
+      }
+    }
+    EXPECT_EQ(2, handler.countSQLQueries());
+  }
+  
+  // The inline properties are inferred from the DB.
+  {
+    auto dbWrapper = std::make_unique<GraphWithStats<ID>>(dbFile, Overwrite::No);
+    
+    auto & db = dbWrapper->getDB();
+    EXPECT_EQ(1, db.inlineProperties(Element::Node).size());
+    EXPECT_EQ(1, db.inlineProperties(Element::Relationship).size());
+    
+    const ID p4 = db.addNode("Person", mkVec(std::pair{p_age, Value(20)}));
+    db.addRelationship("Knows", p4, p1, {});
+    
+    QueryResultsHandler handler(*dbWrapper);
+    handler.run("MATCH (a)-[r]->(b) WHERE a.age = 20 RETURN b.age");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {5}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_EQ(1, handler.countSQLQueries());
+  }
+}
+
+TEST(Test, EvaluatedFilters)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>();
+  using ID = int64_t;
+  
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  const auto p_employees = mkProperty("employees");
+  const auto p_since = mkProperty("since");
+  db.addType("Person", true, {p_age});
+  db.addType("Company", true, {p_employees});
+  db.addType("Knows", false, {p_since});
+  db.addType("WorksAt", false, {});
+  
+  // The count of rows spans several batches of evaluated rows.
+  const int64_t countPersons = 2500;
+  std::vector<ID> persons;
+  for(int64_t i=0; i<countPersons; ++i)
+    persons.push_back(db.addNode("Person", mkVec(std::pair{p_age, Value(i)})));
+  // p[i] -- knows (since i) --> p[i+1]
+  // p[i+1] -- knows (since i) --> p[i]
+  for(int64_t i=0; i+1<countPersons; ++i)
+  {
+    db.addRelationship("Knows", persons[i], persons[i+1], mkVec(std::pair{p_since, Value(i)}));
+    db.addRelationship("Knows", persons[i+1], persons[i], mkVec(std::pair{p_since, Value(i)}));
+  }
+  const ID company = db.addNode("Company", mkVec(std::pair{p_employees, Value(10)}));
+  db.addRelationship("WorksAt", persons[0], company, {});
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  handler.run("MATCH (a)-[r:Knows]->(b) WHERE a.age < b.age RETURN a.age, b.age");
+  EXPECT_EQ(countPersons - 1, handler.countRows());
+  for(const auto & row : handler.rows())
+    EXPECT_EQ(std::get<int64_t>(row[0]) + 1, std::get<int64_t>(row[1]));
+  
+  handler.run("MATCH (a)-[r:Knows]->(b) WHERE a.age < b.age RETURN a.age, b.age LIMIT 1500");
+  EXPECT_EQ(1500, handler.countRows());
+  for(const auto & row : handler.rows())
+    EXPECT_EQ(std::get<int64_t>(row[0]) + 1, std::get<int64_t>(row[1]));
+  
+  // Company has no 'age' property and Person has no 'employees' property,
+  // so these comparisons evaluate to NULL for some rows.
+  handler.run("MATCH (a)-[r]->(b) WHERE a.age > b.age OR b.employees > 5 RETURN id(b)");
+  EXPECT_EQ(countPersons, handler.countRows());
+  
+  // NOT NULL is NULL so no row is returned.
+  handler.run("MATCH (a)-[r]->(b) WHERE NOT (a.age > b.age OR b.employees > 5) RETURN id(b)");
+  EXPECT_EQ(0, handler.countRows());
+  
+  // A filter evaluated after gathering the property values is mixed with a filter applied in the property tables query.
+  handler.run("MATCH (a)-[r]->(b) WHERE r.since = b.age AND a.age IN [3, 4] RETURN a.age, b.age");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {
+        4, 3
+      }, {
+        3, 2
+      }
+    });
+    const std::set<std::vector<Value>> actualRes = toSet(handler.rows());
+    EXPECT_EQ(expectedRes, actualRes);
+  }
+  
+  // Label constraints are evaluated with the property values.
+  handler.run("MATCH (a)-[r]->(b) WHERE b:Company OR (a.age > b.age AND r.since = 0) RETURN id(b)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {
+        company
+      }, {
+        persons[0]
+      }
+    });
+    const std::set<std::vector<Value>> actualRes = toSet(handler.rows());
+    EXPECT_EQ(expectedRes, actualRes);
+  }
+}
+
+TEST(Test, FilterKernels)
+{
+  using sql::Comparison;
+  using sql::kernels::InstructionSet;
+
+  // The counts of values are not all multiples of the SIMD widths, so that the scalar loops are also tested.
+  for(const size_t countValues : {0, 1, 3, 17, 100})
+  {
+    std::vector<int64_t> integers;
+    for(size_t i{}; i<countValues; ++i)
+      integers.push_back(static_cast<int64_t>(i % 7) - 3);
+    if(countValues)
+    {
+      integers.front() = std::numeric_limits<int64_t>::min();
+      integers.back() = std::numeric_limits<int64_t>::max();
+    }
+    std::vector<double> reals;
+    for(const auto i : integers)
+      reals.push_back(0.5 * static_cast<double>(i));
+
+    const auto satisfies = [](const auto a, const Comparison comp, const auto b)
+    {
+      switch(comp)
+      {
+        case Comparison::EQ: return a == b;
+        case Comparison::NE: return a != b;
+        case Comparison::LT: return a < b;
+        case Comparison::LE: return a <= b;
+        case Comparison::GT: return a > b;
+        case Comparison::GE: return a >= b;
+      }
+      return false;
+    };
+
+    for(const auto instructionSet : {InstructionSet::Scalar, InstructionSet::SSE4_2, InstructionSet::AVX2})
+    {
+      sql::kernels::setMaxInstructionSet(instructionSet);
+      std::vector<uint8_t> dst(countValues);
+
+      for(const auto comp : {Comparison::EQ, Comparison::NE, Comparison::LT, Comparison::LE, Comparison::GT, Comparison::GE})
+      {
+        sql::kernels::compare(integers.data(), countValues, comp, 1, dst.data());
+        for(size_t i{}; i<countValues; ++i)
+          EXPECT_EQ(satisfies(integers[i], comp, int64_t{1}), dst[i] == 1);
+
+        sql::kernels::compare(reals.data(), countValues, comp, 0.5, dst.data());
+        for(size_t i{}; i<countValues; ++i)
+          EXPECT_EQ(satisfies(reals[i], comp, 0.5), dst[i] == 1);
+      }
+
+      for(const bool lowInclusive : {false, true})
+      {
+        for(const bool highInclusive : {false, true})
+        {
+          sql::kernels::inRange(integers.data(), countValues, -2, lowInclusive, 2, highInclusive, dst.data());
+          for(size_t i{}; i<countValues; ++i)
+            EXPECT_EQ((lowInclusive ? integers[i] >= -2 : integers[i] > -2) &&
+                      (highInclusive ? integers[i] <= 2 : integers[i] < 2), dst[i] == 1);
+
+          sql::kernels::inRange(reals.data(), countValues, -1., lowInclusive, 1., highInclusive, dst.data());
+          for(size_t i{}; i<countValues; ++i)
+            EXPECT_EQ((lowInclusive ? reals[i] >= -1. : reals[i] > -1.) &&
+                      (highInclusive ? reals[i] <= 1. : reals[i] < 1.), dst[i] == 1);
+        }
+      }
+
+      // A small set and a set that is too big to be evaluated with SIMD comparisons.
+      std::vector<int64_t> bigSet;
+      for(int64_t i=-100; i<100; i+=2)
+        bigSet.push_back(i);
+      for(const auto & set : {std::vector<int64_t>{-3, 0, 2}, bigSet})
+      {
+        sql::kernels::inSet(integers.data(), countValues, set, dst.data());
+        for(size_t i{}; i<countValues; ++i)
+          EXPECT_EQ(std::find(set.begin(), set.end(), integers[i]) != set.end(), dst[i] == 1);
+      }
+      sql::kernels::inSet(reals.data(), countValues, std::vector<double>{-1.5, 0., 1.}, dst.data());
+      for(size_t i{}; i<countValues; ++i)
+        EXPECT_EQ(reals[i] == -1.5 || reals[i] == 0. || reals[i] == 1., dst[i] == 1);
+
+      std::vector<size_t> selection;
+      sql::kernels::appendSelection(dst.data(), countValues, 1, selection);
+      std::vector<size_t> expectedSelection;
+      for(size_t i{}; i<countValues; ++i)
+        if(dst[i] == 1)
+          expectedSelection.push_back(i);
+      EXPECT_EQ(expectedSelection, selection);
+    }
+  }
+  sql::kernels::setMaxInstructionSet(InstructionSet::AVX2);
+}
+
+TEST(Test, NativeSingleVariableFilters)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>();
+  using ID = int64_t;
+  
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  const auto p_score = mkProperty("score");
+  const auto p_name = mkProperty("name");
+  const auto p_since = mkProperty("since");
+  db.addType("Person", true, {
+    PropertySchema{p_age, ValueType::Integer, IsNullable::Yes},
+    PropertySchema{p_score, ValueType::Float, IsNullable::Yes},
+    PropertySchema{p_name, ValueType::String, IsNullable::Yes}
+  });
+  db.addType("Company", true, {PropertySchema{p_name, ValueType::String, IsNullable::Yes}});
+  db.addType("Knows", false, {p_since});
+  
+  // The count of rows spans several batches of evaluated rows, and some property values are NULL.
+  const int64_t countPersons = 2500;
+  std::vector<ID> persons;
+  for(int64_t i=0; i<countPersons; ++i)
+  {
+    std::vector<std::pair<PropertyKeyName, Value>> propValues;
+    if(i % 11)
+      propValues.emplace_back(p_age, Value(i % 100));
+    if(i % 7)
+      propValues.emplace_back(p_score, Value(static_cast<double>(i % 50) / 50.));
+    propValues.emplace_back(p_name, Value(StringPtr::fromCStr(("p" + std::to_string(i)).c_str())));
+    persons.push_back(db.addNode("Person", propValues));
+  }
+  for(int64_t i=0; i+1<countPersons; ++i)
+    db.addRelationship("Knows", persons[i], persons[i+1], mkVec(std::pair{p_since, Value(i)}));
+  const ID company = db.addNode("Company", mkVec(std::pair{p_name, Value(StringPtr::fromCStr("c"))}));
+  db.addRelationship("Knows", persons[0], company, mkVec(std::pair{p_since, Value(-1)}));
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  // The results are the same whether the filters are evaluated natively or in SQL
+  // (the rows contain the ids of both nodes so they are distinct).
+  for(const auto * filter : {
+    "b.age >= 10 AND b.age < 60",
+    "b.age > 2.5",
+    "30 > b.age",
+    "b.score > 0.5",
+    "b.score <= 0",
+    "b.age IN [1, 2, 3, 50]",
+    "NOT b.age IN [1, 2, 3, 50]",
+    "NOT (b.age >= 10 AND b.age < 60)",
+    "b.age = 5 OR b.score < 0.1",
+    "a.age < 6 AND b.age <> 3",
+    "b.name < 'p5'"
+  })
+  {
+    const std::string query = std::string{"MATCH (a)-[r]->(b) WHERE "} + filter + " RETURN id(a), id(b), b.age";
+    
+    db.setSingleVariableFiltersEvaluation(SingleVariableFiltersEvaluation::SQL);
+    handler.run(query);
+    const std::set<std::vector<Value>> expectedRes = toSet(handler.rows());
+    
+    db.setSingleVariableFiltersEvaluation(SingleVariableFiltersEvaluation::Native);
+    handler.run(query);
+    const std::set<std::vector<Value>> actualRes = toSet(handler.rows());
+    
+    EXPECT_EQ(expectedRes, actualRes) << filter;
+  }
+  db.setSingleVariableFiltersEvaluation(SingleVariableFiltersEvaluation::SQL);
+}
+
+TEST(Test, OrderBy)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>();
+  using ID = int64_t;
+  
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  const auto p_name = mkProperty("name");
+  db.addType("Person", true, {p_age, PropertySchema{p_name, ValueType::String, IsNullable::Yes}}, {PropertyIndex{{p_age}}});
+  db.addType("Robot", true, {p_age});
+  db.addType("Knows", false, {});
+  
+  auto mkPerson = [&](std::optional<int64_t> age, const char* name)
+  {
+    std::vector<std::pair<PropertyKeyName, Value>> props;
+    if(age.has_value())
+      props.emplace_back(p_age, Value(*age));
+    props.emplace_back(p_name, Value(StringPtr::fromCStr(name)));
+    return db.addNode("Person", props);
+  };
+  ID p1 = mkPerson(5, "e");
+  ID p2 = mkPerson(3, "c");
+  ID p3 = mkPerson(std::nullopt, "a");
+  ID p4 = mkPerson(3, "b");
+  ID p5 = mkPerson(8, "d");
+  ID r1 = db.addNode("Robot", mkVec(std::pair{p_age, Value(1)}));
+  db.addRelationship("Knows", p1, p2, {});
+  db.addRelationship("Knows", p2, p3, {});
+  db.addRelationship("Knows", p3, p4, {});
+  db.addRelationship("Knows", p4, p5, {});
+  db.addRelationship("Knows", p5, r1, {});
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  auto column = [&](const size_t j)
+  {
+    std::vector<Value> res;
+    for(const auto & row : handler.rows())
+      res.push_back(copy(row[j]));
+    return res;
+  };
+  auto strings = [](std::initializer_list<const char*> strs)
+  {
+    std::vector<Value> res;
+    for(const auto * str : strs)
+      res.emplace_back(StringPtr::fromCStr(str));
+    return res;
+  };
+  auto integers = [](std::initializer_list<std::optional<int64_t>> ints)
+  {
+    std::vector<Value> res;
+    for(const auto & i : ints)
+      res.push_back(i.has_value() ? Value(*i) : Value(Nothing{}));
+    return res;
+  };
+  auto lastQuerySortsInSQL = [&]()
+  {
+    return std::string::npos != dbWrapper->m_queryStats.back().query.find("ORDER BY");
+  };
+  
+  // The leading sort key is indexed: the rows are sorted in SQL.
+  handler.run("MATCH (n:Person) RETURN n.name ORDER BY n.age, n.name LIMIT 3");
+  EXPECT_EQ(strings({"b", "c", "e"}), column(0));
+  EXPECT_TRUE(lastQuerySortsInSQL());
+  
+  // Nulls are sorted last in ascending order, first in descending order.
+  handler.run("MATCH (n:Person) RETURN n.name ORDER BY n.age DESC, n.name");
+  EXPECT_EQ(strings({"a", "d", "e", "b", "c"}), column(0));
+  EXPECT_TRUE(lastQuerySortsInSQL());
+  handler.run("MATCH (n:Person) RETURN n.age ORDER BY n.age ASCENDING");
+  EXPECT_EQ(integers({3, 3, 5, 8, std::nullopt}), column(0));
+  
+  // The leading sort key is not indexed, and is not returned: the rows are sorted in the engine.
+  handler.run("MATCH (n:Person) RETURN n.age AS a ORDER BY n.name DESC LIMIT 2");
+  EXPECT_EQ(integers({5, 8}), column(0));
+  EXPECT_FALSE(lastQuerySortsInSQL());
+  
+  // Sorting by an alias of the return clause.
+  handler.run("MATCH (n:Person) RETURN n.name AS name ORDER BY name LIMIT 2");
+  EXPECT_EQ(strings({"a", "b"}), column(0));
+  
+  // Elements of several labels are sorted in the engine.
+  handler.run("MATCH (n) RETURN id(n) ORDER BY n.age, id(n)");
+  EXPECT_EQ(integers({r1, p2, p4, p1, p5, p3}), column(0));
+  EXPECT_FALSE(lastQuerySortsInSQL());
+  handler.run("MATCH (n) RETURN id(n) ORDER BY n.age, id(n) LIMIT 4");
+  EXPECT_EQ(integers({r1, p2, p4, p1}), column(0));
+  handler.run("MATCH (n) RETURN id(n) ORDER BY n.age LIMIT 0");
+  EXPECT_EQ(0, handler.countRows());
+  
+  // Paths are sorted in the engine.
+  handler.run("MATCH (a)-[]->(b) RETURN a.name, b.age ORDER BY b.age DESC, a.name LIMIT 3");
+  EXPECT_EQ(strings({"c", "b", "a"}), column(0));
+  EXPECT_EQ(integers({std::nullopt, 8, 3}), column(1));
+  handler.run("MATCH (a)-[]->(b) RETURN a.name ORDER BY b.age, a.name LIMIT 2");
+  EXPECT_EQ(strings({"d", "a"}), column(0));
+  EXPECT_EQ(1, handler.countColumns());
+  
+  EXPECT_THROW(handler.run("MATCH (n:Person) RETURN n.name ORDER BY m.age"), std::logic_error);
+}
+
+TEST(Test, Distinct)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>();
+  using ID = int64_t;
+  
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("Robot", true, {p_age});
+  db.addType("Knows", false, {});
+  
+  /*
+   p1 -> p2 -> p4
+    |     ^
+    v     |
+   p3 ----
+   */
+  ID p1 = db.addNode("Person", mkVec(std::pair{p_age, Value(10)}));
+  ID p2 = db.addNode("Person", mkVec(std::pair{p_age, Value(20)}));
+  ID p3 = db.addNode("Person", mkVec(std::pair{p_age, Value(20)}));
+  ID p4 = db.addNode("Person", {});
+  db.addNode("Robot", mkVec(std::pair{p_age, Value(10)}));
+  db.addRelationship("Knows", p1, p2, {});
+  db.addRelationship("Knows", p1, p3, {});
+  db.addRelationship("Knows", p3, p2, {});
+  db.addRelationship("Knows", p2, p4, {});
+  db.addRelationship("Knows", p3, p4, {});
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  auto duplicatesAreRemovedInSQL = [&]()
+  {
+    return std::string::npos != dbWrapper->m_queryStats.front().query.find("DISTINCT");
+  };
+  
+  handler.run("MATCH (a)-[]->(b)-[]->(c) RETURN id(c)");
+  EXPECT_EQ(4, handler.countRows());
+  
+  // Only ids are returned: duplicate rows are removed in SQL.
+  handler.run("MATCH (a)-[]->(b)-[]->(c) RETURN DISTINCT id(c)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {p2}, {p4}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    EXPECT_EQ(2, handler.countRows());
+  }
+  EXPECT_TRUE(duplicatesAreRemovedInSQL());
+  handler.run("MATCH (a)-[]->(b)-[]->(c) RETURN DISTINCT id(a), id(c)");
+  EXPECT_EQ(3, handler.countRows());
+  handler.run("MATCH (a)-[]->(b)-[]->(c) RETURN DISTINCT id(c) LIMIT 1");
+  EXPECT_EQ(1, handler.countRows());
+  
+  // Non-system properties are returned: duplicate rows are removed in the engine.
+  const Value age10{10};
+  const Value age20{20};
+  const Value noAge{Nothing{}};
+  handler.run("MATCH (a)-[]->(b) RETURN DISTINCT b.age");
+  ASSERT_EQ(2, handler.countRows());
+  EXPECT_EQ(mkSet({age20, noAge}), mkSet({handler.rows()[0][0], handler.rows()[1][0]}));
+  EXPECT_FALSE(duplicatesAreRemovedInSQL());
+  handler.run("MATCH (a)-[]->(b) RETURN DISTINCT b.age LIMIT 2");
+  EXPECT_EQ(2, handler.countRows());
+  handler.run("MATCH (a)-[]->(b) WHERE b.age = 20 RETURN DISTINCT id(b)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {p2}, {p3}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    EXPECT_EQ(2, handler.countRows());
+  }
+  
+  // Duplicates are removed across labels.
+  handler.run("MATCH (n) RETURN DISTINCT n.age");
+  ASSERT_EQ(3, handler.countRows());
+  EXPECT_EQ(mkSet({age10, age20, noAge}), mkSet({handler.rows()[0][0], handler.rows()[1][0], handler.rows()[2][0]}));
+  EXPECT_TRUE(duplicatesAreRemovedInSQL());
+  
+  handler.run("MATCH (n) RETURN DISTINCT n.age ORDER BY n.age DESC LIMIT 2");
+  ASSERT_EQ(2, handler.countRows());
+  EXPECT_EQ(noAge, handler.rows()[0][0]);
+  EXPECT_EQ(age20, handler.rows()[1][0]);
+  
+  EXPECT_THROW(handler.run("MATCH (n) RETURN DISTINCT n.age ORDER BY id(n)"), std::logic_error);
+}
+
+TEST(Test, Aggregation)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>();
+  using ID = int64_t;
+  
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("Robot", true, {p_age});
+  db.addType("Knows", false, {});
+  
+  /*
+   p1 -> p2 -> p4
+    |     ^
+    v     |
+   p3 ----
+   */
+  ID p1 = db.addNode("Person", mkVec(std::pair{p_age, Value(10)}));
+  ID p2 = db.addNode("Person", mkVec(std::pair{p_age, Value(20)}));
+  ID p3 = db.addNode("Person", mkVec(std::pair{p_age, Value(20)}));
+  ID p4 = db.addNode("Person", {});
+  db.addNode("Robot", mkVec(std::pair{p_age, Value(10)}));
+  db.addRelationship("Knows", p1, p2, {});
+  db.addRelationship("Knows", p1, p3, {});
+  db.addRelationship("Knows", p3, p2, {});
+  db.addRelationship("Knows", p2, p4, {});
+  db.addRelationship("Knows", p3, p4, {});
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  auto aggregatedInSQL = [&]()
+  {
+    return std::string::npos != dbWrapper->m_queryStats.front().query.find("COUNT(");
+  };
+  
+  const Value age10{10};
+  const Value age20{20};
+  const Value noAge{Nothing{}};
+  
+  // The aggregations of a single node or relationship variable are computed in SQL.
+  handler.run("MATCH (n:Person) RETURN count(*)");
+  {
+    const std::vector<std::string> expectedColumns{ "count(*)" };
+    EXPECT_EQ(expectedColumns, handler.columns());
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {4}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  handler.run("MATCH (n:Person) RETURN count(n.age)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {3}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  EXPECT_TRUE(aggregatedInSQL());
+  handler.run("MATCH ()-[r]->() RETURN count(r)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {5}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  handler.run("MATCH (n) RETURN count(n.age), sum(n.age), min(n.age), max(n.age), avg(n.age)");
+  {
+    const std::vector<std::string> expectedColumns{ "count(n.age)", "sum(n.age)", "min(n.age)", "max(n.age)", "avg(n.age)" };
+    EXPECT_EQ(expectedColumns, handler.columns());
+    ASSERT_EQ(1, handler.countRows());
+    const auto & row = handler.rows()[0];
+    EXPECT_EQ(Value(4), row[0]);
+    EXPECT_EQ(Value(60), row[1]);
+    EXPECT_EQ(age10, row[2]);
+    EXPECT_EQ(age20, row[3]);
+    EXPECT_EQ(Value(15.), row[4]);
+  }
+  
+  // The returned terms that are not aggregations are the grouping keys.
+  handler.run("MATCH (n) RETURN n.age, count(*) ORDER BY n.age");
+  {
+    ASSERT_EQ(3, handler.countRows());
+    const auto & rows = handler.rows();
+    EXPECT_EQ(age10, rows[0][0]);
+    EXPECT_EQ(Value(2), rows[0][1]);
+    EXPECT_EQ(age20, rows[1][0]);
+    EXPECT_EQ(Value(2), rows[1][1]);
+    EXPECT_EQ(noAge, rows[2][0]);
+    EXPECT_EQ(Value(1), rows[2][1]);
+  }
+  EXPECT_TRUE(aggregatedInSQL());
+  
+  // Without grouping keys, a row is returned even when nothing matches.
+  handler.run("MATCH (n:Nope) RETURN count(*), sum(n.age), max(n.age)");
+  {
+    ASSERT_EQ(1, handler.countRows());
+    const auto & row = handler.rows()[0];
+    EXPECT_EQ(Value(0), row[0]);
+    EXPECT_EQ(Value(0), row[1]);
+    EXPECT_EQ(noAge, row[2]);
+  }
+  
+  // The aggregations of paths are computed in the engine.
+  handler.run("MATCH (a)-[]->(b) RETURN b.age, count(*) ORDER BY b.age");
+  {
+    ASSERT_EQ(2, handler.countRows());
+    const auto & rows = handler.rows();
+    EXPECT_EQ(age20, rows[0][0]);
+    EXPECT_EQ(Value(3), rows[0][1]);
+    EXPECT_EQ(noAge, rows[1][0]);
+    EXPECT_EQ(Value(2), rows[1][1]);
+  }
+  EXPECT_FALSE(aggregatedInSQL());
+  handler.run("MATCH (a)-[]->(b) RETURN id(a), count(b.age) AS c ORDER BY c DESC LIMIT 1");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {p1, 2}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  handler.run("MATCH (a)-[]->(b)-[]->(c) RETURN count(*), avg(a.age), min(id(c))");
+  {
+    ASSERT_EQ(1, handler.countRows());
+    const auto & row = handler.rows()[0];
+    EXPECT_EQ(Value(4), row[0]);
+    EXPECT_EQ(Value(12.5), row[1]);
+    EXPECT_EQ(Value(std::min(p2, p4)), row[2]);
+  }
+  handler.run("MATCH (a)-[]->(b) WHERE a.age > 100 RETURN count(*)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {0}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  EXPECT_THROW(handler.run("MATCH (n) RETURN count(*) ORDER BY n.age"), std::logic_error);
+  EXPECT_THROW(handler.run("MATCH (n) WHERE count(n.age) > 1 RETURN id(n)"), std::logic_error);
+  EXPECT_THROW(handler.run("MATCH (n) RETURN collect(n.age)"), std::logic_error);
+}
+
+TEST(Test, CountElements)
+{
+  LogIndentScope _{};
+  
+  const std::filesystem::path dbFile{"Test.CountElements.sqlite3db"};
+  const auto p_age = mkProperty("age");
+  
+  auto countsAreRead = [](GraphWithStats<int64_t>& dbWrapper)
+  {
+    return (dbWrapper.m_queryStats.size() == 1) &&
+    (std::string::npos != dbWrapper.m_queryStats.front().query.find("FROM namedTypes"));
+  };
+  
+  {
+    auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>(dbFile, Overwrite::Yes);
+    auto & db = dbWrapper->getDB();
+    db.addType("Person", true, {p_age});
+    db.addType("Robot", true, {});
+    db.addType("Knows", false, {});
+    db.addType("Likes", false, {});
+    
+    std::vector<int64_t> ids;
+    db.beginTransaction();
+    for(int i=0; i<10; ++i)
+      ids.push_back(db.addNode((i % 5) ? "Person" : "Robot", mkVec(std::pair{p_age, Value(i)})));
+    for(int i=0; i<9; ++i)
+      db.addRelationship((i % 3) ? "Knows" : "Likes", ids[i], ids[i+1], {});
+    db.endTransaction();
+    
+    EXPECT_EQ(8, db.countElements(Element::Node, Labels{{"Person"_L}}));
+    EXPECT_EQ(10, db.countElements(Element::Node, Labels{}));
+    EXPECT_EQ(0, db.countElements(Element::Node, Labels{{"Nope"_L}}));
+    
+    QueryResultsHandler handler(*dbWrapper);
+    
+    // The counts are read from the namedTypes table.
+    handler.run("MATCH (n:Person) RETURN count(n)");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {8}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_TRUE(countsAreRead(*dbWrapper));
+    handler.run("MATCH (n) RETURN count(*)");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {10}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_TRUE(countsAreRead(*dbWrapper));
+    handler.run("MATCH ()-[r:Knows]->() RETURN count(r)");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {6}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_TRUE(countsAreRead(*dbWrapper));
+    
+    // With a filter, the elements are counted.
+    handler.run("MATCH (n:Person) WHERE n.age > 5 RETURN count(n)");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {4}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_FALSE(countsAreRead(*dbWrapper));
+  }
+  
+  // The counts are persisted, and updated when elements are added.
+  {
+    auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>(dbFile, Overwrite::No);
+    auto & db = dbWrapper->getDB();
+    EXPECT_EQ(8, db.countElements(Element::Node, Labels{{"Person"_L}}));
+    db.addNode("Person", {});
+    EXPECT_EQ(9, db.countElements(Element::Node, Labels{{"Person"_L}}));
+    EXPECT_EQ(3, db.countElements(Element::Relationship, Labels{{"Likes"_L}}));
+  }
+}
+
+TEST(Test, Degree)
+{
+  LogIndentScope _{};
+  
+  const std::filesystem::path dbFile{"Test.Degree.sqlite3db"};
+  
+  std::vector<int64_t> ids;
+  {
+    auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>(dbFile, Overwrite::Yes);
+    auto & db = dbWrapper->getDB();
+    db.addType("Person", true, {});
+    db.addType("Knows", false, {});
+    db.addType("Likes", false, {});
+    
+    db.beginTransaction();
+    for(int i=0; i<6; ++i)
+      ids.push_back(db.addNode("Person", {}));
+    // ids[0] is a hub.
+    for(int i=1; i<6; ++i)
+      db.addRelationship("Knows", ids[0], ids[i], {});
+    for(int i=1; i<5; ++i)
+      db.addRelationship("Likes", ids[i], ids[i+1], {});
+    db.endTransaction();
+    
+    QueryResultsHandler handler(*dbWrapper);
+    
+    handler.run("MATCH (n:Person) WHERE outDegree(n, 'Knows') > 2 RETURN id(n)");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {ids[0]}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    handler.run("MATCH (n:Person) WHERE id(n) IN [" + std::to_string(ids[0]) + ", " + std::to_string(ids[2]) + "] RETURN id(n), degree(n), outDegree(n), inDegree(n, 'Likes'), degree(n, 'Nope')");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {ids[0], 5, 5, 0, 0},
+        {ids[2], 3, 1, 1, 0}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    
+    // The degree predicate is evaluated in the system relationships query.
+    handler.run("MATCH (a)-[r:Likes]->(b) WHERE degree(b) < 3 RETURN id(a), id(b)");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {ids[4], ids[5]}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+    EXPECT_EQ(1, dbWrapper->m_queryStats.size());
+    EXPECT_NE(std::string::npos, dbWrapper->m_queryStats.front().query.find("FROM nodeDegrees"));
+    
+    handler.run("MATCH (a)-[r:Knows]->(b) WHERE outDegree(a) < 3 RETURN id(b)");
+    EXPECT_EQ(0, handler.rows().size());
+  }
+  
+  // The degrees are persisted, and updated when relationships are added.
+  {
+    auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>(dbFile, Overwrite::No);
+    auto & db = dbWrapper->getDB();
+    db.addRelationship("Likes", ids[5], ids[5], {});
+    
+    QueryResultsHandler handler(*dbWrapper);
+    handler.run("MATCH (n) WHERE id(n) = " + std::to_string(ids[5]) + " RETURN degree(n), outDegree(n, 'Likes'), inDegree(n, 'Likes')");
+    {
+      const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+        {4, 1, 2}
+      });
+      EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    }
+  }
+}
+
+TEST(Test, Pagination)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.Pagination.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("Robot", true, {p_age});
+  db.addType("Knows", false, {});
+  
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<10; ++i)
+    ids.push_back(db.addNode((i % 2) ? "Robot" : "Person", mkVec(std::pair{p_age, Value(static_cast<int64_t>(i))})));
+  for(int i=0; i<9; ++i)
+    db.addRelationship("Knows", ids[i], ids[i+1], {});
+  // A loop is returned twice by an undirected pattern.
+  db.addRelationship("Knows", ids[3], ids[3], {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  // Concatenates the pages of results.
+  auto runPages = [&](const std::string& cypherQuery)
+  {
+    std::vector<std::vector<Value>> rows;
+    std::string continuationToken;
+    size_t countPages{};
+    do
+    {
+      continuationToken = handler.runPage(cypherQuery, continuationToken);
+      for(const auto & row : handler.rows())
+      {
+        auto & rowCopy = rows.emplace_back();
+        for(const auto & value : row)
+          rowCopy.push_back(copy(value));
+      }
+      ++countPages;
+    }
+    while(!continuationToken.empty());
+    return std::pair{std::move(rows), countPages};
+  };
+  
+  {
+    const auto [rows, countPages] = runPages("MATCH (n) WHERE n.age >= 2 RETURN n.age LIMIT 3");
+    EXPECT_EQ(3, countPages);
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {2}, {3}, {4}, {5}, {6}, {7}, {8}, {9}
+    });
+    EXPECT_EQ(expectedRes, toSet(rows));
+    EXPECT_EQ(8, rows.size());
+  }
+  // The next page starts after the id of the last element of the previous page.
+  EXPECT_NE(std::string::npos, dbWrapper->m_queryStats.front().query.find("SYS__ID > "));
+  
+  // The page predicate applies to all the terms of a disjunction.
+  {
+    const auto [rows, countPages] = runPages("MATCH (n) WHERE n.age < 2 OR n.age > 5 RETURN n.age LIMIT 2");
+    EXPECT_LE(3, countPages);
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {0}, {1}, {6}, {7}, {8}, {9}
+    });
+    EXPECT_EQ(expectedRes, toSet(rows));
+    EXPECT_EQ(6, rows.size());
+  }
+  
+  {
+    const auto [rows, countPages] = runPages("MATCH (a)-[r:Knows]->(b) RETURN id(a), id(b) LIMIT 4");
+    EXPECT_EQ(3, countPages);
+    EXPECT_EQ(10, rows.size());
+  }
+  // The filter on 'b' is applied after the paths query, which returns the candidate paths by batches.
+  {
+    const auto [rows, countPages] = runPages("MATCH (a)-[r:Knows]->(b) WHERE b.age > 2 RETURN id(a), b.age LIMIT 4");
+    EXPECT_EQ(3, countPages);
+    EXPECT_EQ(8, rows.size());
+  }
+  EXPECT_NE(std::string::npos, dbWrapper->m_queryStats.front().query.find(" LIMIT "));
+  {
+    const auto [rows, countPages] = runPages("MATCH (a)-[r:Knows]-(b) RETURN id(a), id(b) LIMIT 6");
+    EXPECT_EQ(4, countPages);
+    EXPECT_EQ(20, rows.size());
+    handler.run("MATCH (a)-[r:Knows]-(b) RETURN id(a), id(b)");
+    EXPECT_EQ(toSet(handler.rows()), toSet(rows));
+  }
+  
+  EXPECT_THROW(handler.runPage("MATCH (n) RETURN n.age", {}), std::invalid_argument);
+  EXPECT_THROW(handler.runPage("MATCH (n) RETURN n.age ORDER BY n.age LIMIT 2", {}), std::logic_error);
+  EXPECT_THROW(handler.runPage("MATCH (n) RETURN n.age LIMIT 2", "not a token"), std::invalid_argument);
+}
+
+TEST(Test, MultiplePatternParts)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.MultiplePatternParts.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("Knows", false, {});
+  
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<5; ++i)
+    ids.push_back(db.addNode("Person", mkVec(std::pair{p_age, Value(static_cast<int64_t>(10 * i))})));
+  // 0 -> 1 -> 2 -> 3
+  //      4 -^
+  const auto r01 = db.addRelationship("Knows", ids[0], ids[1], {});
+  db.addRelationship("Knows", ids[1], ids[2], {});
+  db.addRelationship("Knows", ids[2], ids[3], {});
+  db.addRelationship("Knows", ids[4], ids[2], {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  // The pattern parts share an end node: they are joined in the system relationships query.
+  handler.run("MATCH (a)-[r]->(b), (c)-[s]->(b) RETURN id(a), id(c)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[1], ids[4]},
+      {ids[4], ids[1]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  EXPECT_EQ(1, handler.countSQLQueries());
+  
+  // The pattern parts share a node that is not at the end of a pattern part: they are joined in the engine.
+  handler.run("MATCH (a)-[]->(b)-[]->(c), (d)-[]->(b) WHERE d.age < a.age RETURN id(a), id(b), id(c), id(d)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[4], ids[2], ids[3], ids[1]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  // A relationship is not traversed by two pattern parts.
+  handler.run("MATCH ()-[r]->(), (a)-[s]->() WHERE id(a) = " + std::to_string(ids[0]) + " RETURN id(r)");
+  EXPECT_EQ(3, handler.countRows());
+  handler.run("MATCH ()-[r]->(), (a)-[s]->() WHERE id(r) = " + std::to_string(r01) + " AND id(a) = " + std::to_string(ids[0]) + " RETURN id(s)");
+  EXPECT_EQ(0, handler.countRows());
+  
+  handler.run("MATCH (a), (b) WHERE a.age < b.age RETURN count(*)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {10}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+}
+
+TEST(Test, OptionalMatch)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.OptionalMatch.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("ManagedBy", false, {});
+  
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<4; ++i)
+    ids.push_back(db.addNode("Person", mkVec(std::pair{p_age, Value(static_cast<int64_t>(10 * i))})));
+  // 1 and 2 are managed by 0, 3 is managed by 1.
+  db.addRelationship("ManagedBy", ids[1], ids[0], {});
+  db.addRelationship("ManagedBy", ids[2], ids[0], {});
+  db.addRelationship("ManagedBy", ids[3], ids[1], {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  auto managerById = [&]()
+  {
+    std::map<int64_t, Value> res;
+    for(const auto & row : handler.rows())
+      res.emplace(std::get<int64_t>(row[0]), copy(row[1]));
+    return res;
+  };
+  
+  handler.run("MATCH (n:Person) OPTIONAL MATCH (n)-[:ManagedBy]->(m) RETURN id(n), id(m)");
+  {
+    EXPECT_EQ(4, handler.countRows());
+    const auto managers = managerById();
+    EXPECT_EQ(Nothing{}, managers.at(ids[0]));
+    EXPECT_EQ(Value(ids[0]), managers.at(ids[1]));
+    EXPECT_EQ(Value(ids[0]), managers.at(ids[2]));
+    EXPECT_EQ(Value(ids[1]), managers.at(ids[3]));
+  }
+  
+  // The WHERE clause of an OPTIONAL MATCH filters the matches, not the rows.
+  handler.run("MATCH (n:Person) OPTIONAL MATCH (n)-[:ManagedBy]->(m) WHERE m.age > 5 RETURN id(n), m.age");
+  {
+    EXPECT_EQ(4, handler.countRows());
+    const auto managers = managerById();
+    EXPECT_EQ(Nothing{}, managers.at(ids[0]));
+    EXPECT_EQ(Nothing{}, managers.at(ids[1]));
+    EXPECT_EQ(Nothing{}, managers.at(ids[2]));
+    EXPECT_EQ(Value(int64_t{10}), managers.at(ids[3]));
+  }
+  
+  // A filter using variables of the MATCH clause and of the OPTIONAL MATCH clause.
+  handler.run("MATCH (n:Person) WHERE n.age >= 20 OPTIONAL MATCH (m:Person) WHERE m.age > n.age RETURN id(n), id(m)");
+  {
+    EXPECT_EQ(2, handler.countRows());
+    const auto managers = managerById();
+    EXPECT_EQ(Value(ids[3]), managers.at(ids[2]));
+    EXPECT_EQ(Nothing{}, managers.at(ids[3]));
+  }
+  
+  // count(*) counts the rows, count(m) counts the matches.
+  handler.run("MATCH (n:Person) OPTIONAL MATCH (m)-[:ManagedBy]->(n) RETURN id(n), count(*), count(m)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[0], 2, 2},
+      {ids[1], 1, 1},
+      {ids[2], 1, 0},
+      {ids[3], 1, 0}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  EXPECT_EQ(2, handler.countSQLQueries());
+  
+  // The OPTIONAL MATCH clause is queried only for the ids of 'n' in the rows of the MATCH clause.
+  handler.run("MATCH (n:Person) WHERE n.age >= 20 OPTIONAL MATCH (n)-[:ManagedBy]->(m) RETURN id(n), id(m)");
+  {
+    EXPECT_EQ(2, handler.countRows());
+    const auto managers = managerById();
+    EXPECT_EQ(Value(ids[0]), managers.at(ids[2]));
+    EXPECT_EQ(Value(ids[1]), managers.at(ids[3]));
+  }
+  ASSERT_EQ(2, handler.countSQLQueries());
+  EXPECT_NE(std::string::npos, dbWrapper->m_queryStats[1].query.find("R0.OriginID IN carray("));
+}
+
+TEST(Test, PatternPredicates)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.PatternPredicates.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  db.addType("User", true, {});
+  db.addType("Bot", true, {});
+  db.addType("Blocks", false, {});
+  db.addType("Knows", false, {});
+  
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<6; ++i)
+    ids.push_back(db.addNode("User", {}));
+  const auto bot = db.addNode("Bot", {});
+  // 0 blocks 1, 2 blocks the bot, 3 knows 4, 4 blocks 5.
+  db.addRelationship("Blocks", ids[0], ids[1], {});
+  db.addRelationship("Blocks", ids[2], bot, {});
+  db.addRelationship("Knows", ids[3], ids[4], {});
+  db.addRelationship("Blocks", ids[4], ids[5], {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  handler.run("MATCH (a:User) WHERE (a)-[:Blocks]->(:User) RETURN id(a)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[0]},
+      {ids[4]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  EXPECT_EQ(1, handler.countSQLQueries());
+  
+  handler.run("MATCH (a:User) WHERE NOT (a)-[:Blocks]->() RETURN id(a)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[1]},
+      {ids[3]},
+      {ids[5]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  // The variable can be the last node of the pattern.
+  handler.run("MATCH (a) WHERE (:User)-[:Blocks]->(a) RETURN id(a)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[1]},
+      {ids[5]},
+      {bot}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  handler.run("MATCH (a:User) WHERE EXISTS { (a)-[:Knows]->()-[:Blocks]->(:User) } RETURN id(a)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[3]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  // In a path pattern, the predicate is evaluated in the system relationships query.
+  handler.run("MATCH (a)-[:Knows]->(b) WHERE (b)-[:Blocks]-() RETURN id(a)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[3]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  EXPECT_EQ(1, handler.countSQLQueries());
+}
+
+TEST(Test, MultiPartQuery)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.MultiPartQuery.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("Knows", false, {});
+  
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<4; ++i)
+    ids.push_back(db.addNode("Person", mkVec(std::pair{p_age, Value(static_cast<int64_t>(10 * i))})));
+  db.addRelationship("Knows", ids[0], ids[1], {});
+  db.addRelationship("Knows", ids[1], ids[2], {});
+  db.addRelationship("Knows", ids[2], ids[3], {});
+  db.addRelationship("Knows", ids[3], ids[0], {});
+  db.addRelationship("Knows", ids[3], ids[1], {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  // The ids of the 2 oldest persons are bound to 'a' in the second part.
+  handler.run("MATCH (a:Person) WITH a ORDER BY a.age DESC LIMIT 2 MATCH (a)-[:Knows]->(b) RETURN id(a), id(b)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[2], ids[3]},
+      {ids[3], ids[0]},
+      {ids[3], ids[1]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  // The WHERE clause of the WITH clause and of the next MATCH clause.
+  handler.run("MATCH (a:Person) WITH a WHERE a.age > 10 MATCH (a)-[:Knows]->(b) WHERE b.age < 20 RETURN id(a), id(b)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[3], ids[0]},
+      {ids[3], ids[1]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  handler.run("MATCH (a)-[:Knows]->(b) WITH DISTINCT b MATCH (b)-[:Knows]->(c) RETURN count(*)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {5}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  // 'b' is projected twice for ids[1], so its rows in the second part are repeated.
+  handler.run("MATCH (a)-[:Knows]->(b) WITH b MATCH (b)-[:Knows]->(c) RETURN id(b), id(c)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[0], ids[1]},
+      {ids[1], ids[2]},
+      {ids[2], ids[3]},
+      {ids[3], ids[0]},
+      {ids[3], ids[1]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+    EXPECT_EQ(6, handler.countRows());
+  }
+  handler.run("MATCH (a)-[:Knows]->(b) WITH b MATCH (b)-[:Knows]->(c) RETURN count(*)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {6}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  handler.run("MATCH (a)-[:Knows]->(b) WITH b MATCH (b) RETURN count(*)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {5}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  // No id is bound.
+  handler.run("MATCH (a:Person) WITH a WHERE a.age > 100 MATCH (a)-[:Knows]->(b) RETURN id(b)");
+  EXPECT_EQ(0, handler.countRows());
+  
+  EXPECT_THROW(handler.run("MATCH (a) WITH a.age AS age MATCH (b) RETURN id(b)"), std::logic_error);
+  EXPECT_THROW(handler.run("MATCH (a) WITH a MATCH (b) RETURN id(b)"), std::logic_error);
+}
+
+TEST(Test, Unwind)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.Unwind.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("Knows", false, {});
+  
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<4; ++i)
+    ids.push_back(db.addNode("Person", mkVec(std::pair{p_age, Value(static_cast<int64_t>(10 * i))})));
+  db.addRelationship("Knows", ids[0], ids[1], {});
+  db.addRelationship("Knows", ids[0], ids[2], {});
+  db.addRelationship("Knows", ids[1], ids[2], {});
+  db.addRelationship("Knows", ids[2], ids[3], {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  const std::map<ParameterName, ParameterValue> params{
+    {ParameterName{"ids"}, std::make_shared<std::vector<int64_t>>(std::vector<int64_t>{ids[0], ids[2], ids[3]})}
+  };
+  
+  // The whole list is matched by a single SQL query.
+  handler.run("UNWIND $ids AS x MATCH (a)-[:Knows]->(b) WHERE id(a) = x RETURN x, id(b)", params);
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[0], ids[1]},
+      {ids[0], ids[2]},
+      {ids[2], ids[3]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  EXPECT_EQ(1, handler.countSQLQueries());
+  
+  handler.run("UNWIND $ids AS x MATCH (a)-[:Knows]->(b) WHERE id(a) = x AND id(b) <> x RETURN x, count(*)", params);
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[0], 2},
+      {ids[2], 1}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  handler.run("UNWIND [0, 20, 50] AS age MATCH (n:Person) WHERE n.age = age RETURN age, id(n)");
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {0, ids[0]},
+      {20, ids[2]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.rows()));
+  }
+  
+  // The rows of the duplicate values would have to be repeated.
+  EXPECT_THROW(handler.run("UNWIND [0, 0] AS age MATCH (n:Person) WHERE n.age = age RETURN id(n)"), std::logic_error);
+  EXPECT_THROW(handler.run("UNWIND $ids AS x MATCH (a) RETURN id(a)", params), std::logic_error);
+  EXPECT_THROW(handler.run("MATCH (a) UNWIND $ids AS x RETURN id(a)", params), std::logic_error);
+}
+
+TEST(Test, BatchQuery)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.BatchQuery.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("Knows", false, {});
+  
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<4; ++i)
+    ids.push_back(db.addNode("Person", mkVec(std::pair{p_age, Value(static_cast<int64_t>(10 * i))})));
+  db.addRelationship("Knows", ids[0], ids[1], {});
+  db.addRelationship("Knows", ids[0], ids[2], {});
+  db.addRelationship("Knows", ids[1], ids[2], {});
+  db.addRelationship("Knows", ids[2], ids[3], {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  auto mkParams = [](std::vector<int64_t> values)
+  {
+    return std::map<ParameterName, ParameterValue>{
+      {ParameterName{"ids"}, std::make_shared<std::vector<int64_t>>(std::move(values))}
+    };
+  };
+  const std::vector<std::map<ParameterName, ParameterValue>> batchParams{
+    mkParams({ids[0]}),
+    mkParams({ids[3]}),
+    mkParams({ids[1], ids[0]})
+  };
+  
+  // The parameter sets are run by a single query.
+  handler.runBatch("MATCH (a)-[:Knows]->(b) WHERE id(a) IN $ids RETURN id(a), id(b)", batchParams);
+  EXPECT_EQ(1, handler.countSQLQueries());
+  EXPECT_EQ(2, handler.countColumns());
+  ASSERT_EQ(3, handler.countBatches());
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[0], ids[1]},
+      {ids[0], ids[2]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.batchRows(0)));
+  }
+  EXPECT_EQ(0, handler.batchRows(1).size());
+  {
+    const auto expectedRes = toValues(std::set<std::vector<int64_t>>{
+      {ids[0], ids[1]},
+      {ids[0], ids[2]},
+      {ids[1], ids[2]}
+    });
+    EXPECT_EQ(expectedRes, toSet(handler.batchRows(2)));
+  }
+  
+  // DISTINCT and LIMIT apply to the rows of each parameter set.
+  handler.runBatch("MATCH (a)-[:Knows]->(b) WHERE id(a) IN $ids RETURN DISTINCT id(b) LIMIT 5", batchParams);
+  ASSERT_EQ(3, handler.countBatches());
+  EXPECT_EQ(2, handler.batchRows(0).size());
+  EXPECT_EQ(0, handler.batchRows(1).size());
+  EXPECT_EQ(2, handler.batchRows(2).size());
+  
+  // With aggregations, the query is run for each parameter set.
+  handler.runBatch("MATCH (a)-[:Knows]->(b) WHERE id(a) IN $ids RETURN count(*)", batchParams);
+  ASSERT_EQ(3, handler.countBatches());
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{2}}), toSet(handler.batchRows(0)));
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{0}}), toSet(handler.batchRows(1)));
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{3}}), toSet(handler.batchRows(2)));
+  
+  // When the parameter is used several times, the query is run for each parameter set:
+  // the other uses would filter with the union of the lists.
+  handler.runBatch("MATCH (a)-[:Knows]->(b) WHERE id(a) IN $ids AND id(b) IN $ids RETURN id(a), id(b)", batchParams);
+  ASSERT_EQ(3, handler.countBatches());
+  EXPECT_EQ(0, handler.batchRows(0).size());
+  EXPECT_EQ(0, handler.batchRows(1).size());
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{ids[0], ids[1]}}), toSet(handler.batchRows(2)));
+  
+  // The columns are passed once, before the first parameter set, whether the parameter sets are run by a single query or not.
+  struct CallsRecorder
+  {
+    std::vector<std::string> calls;
+    bool printCypherAST() const { return false; }
+    void onCypherQueryStarts(const std::string&) {}
+    void onCypherQueryEnds() {}
+    void onColumns(const std::vector<std::string>&) { calls.push_back("columns"); }
+    void onBatch(size_t batchIndex) { calls.push_back("batch " + std::to_string(batchIndex)); }
+    void onRow(const ResultOrder&, const VecValues&) { calls.push_back("row"); }
+  };
+  for(const auto * query : {"MATCH (a)-[:Knows]->(b) WHERE id(a) IN $ids RETURN id(b)",
+                            "MATCH (a)-[:Knows]->(b) WHERE id(a) IN $ids RETURN count(*)"})
+  {
+    CallsRecorder recorder;
+    runCypherBatch(query, batchParams, db, recorder);
+    ASSERT_LE(2, recorder.calls.size());
+    EXPECT_EQ("columns", recorder.calls[0]);
+    EXPECT_EQ("batch 0", recorder.calls[1]);
+    EXPECT_EQ(1, std::count(recorder.calls.begin(), recorder.calls.end(), "columns"));
+  }
+}
+
+TEST(Test, ScalarParameters)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.ScalarParameters.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("Knows", false, {});
+  
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<4; ++i)
+    ids.push_back(db.addNode("Person", mkVec(std::pair{p_age, Value(static_cast<int64_t>(10 * i))})));
+  db.addRelationship("Knows", ids[0], ids[1], {});
+  db.addRelationship("Knows", ids[1], ids[2], {});
+  db.addRelationship("Knows", ids[2], ids[3], {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  auto mkParams = [](int64_t age)
+  {
+    return std::map<ParameterName, ParameterValue>{
+      {ParameterName{"age"}, std::make_shared<Value>(age)}
+    };
+  };
+  
+  handler.run("MATCH (a:Person) WHERE a.age > $age RETURN a.age", mkParams(15));
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{20}, {30}}), toSet(handler.rows()));
+  const auto sqlQuery = dbWrapper->m_queryStats.back().query;
+  
+  // Queries differing only by their constants have the same SQL queries, the constants are bound.
+  handler.run("MATCH (a:Person) WHERE a.age > $age RETURN a.age", mkParams(25));
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{30}}), toSet(handler.rows()));
+  EXPECT_EQ(sqlQuery, dbWrapper->m_queryStats.back().query);
+  
+  handler.run("MATCH (a:Person) WHERE a.age > 5 RETURN a.age");
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{10}, {20}, {30}}), toSet(handler.rows()));
+  EXPECT_EQ(sqlQuery, dbWrapper->m_queryStats.back().query);
+  
+  handler.run("MATCH (a)-[:Knows]->(b) WHERE a.age >= $age RETURN a.age, b.age", mkParams(10));
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{10, 20}, {20, 30}}), toSet(handler.rows()));
+}
+
+TEST(Test, ListBinding)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.ListBinding.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("Knows", false, {});
+  
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<4; ++i)
+    ids.push_back(db.addNode("Person", mkVec(std::pair{p_age, Value(static_cast<int64_t>(10 * i))})));
+  db.addRelationship("Knows", ids[0], ids[1], {});
+  db.addRelationship("Knows", ids[1], ids[2], {});
+  db.addRelationship("Knows", ids[2], ids[3], {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  // An unsorted list, with duplicates.
+  const std::map<ParameterName, ParameterValue> params{
+    {ParameterName{"ids"}, std::make_shared<std::vector<int64_t>>(std::vector<int64_t>{ids[2], ids[0], ids[2]})}
+  };
+  const auto expectedPaths = toValues(std::set<std::vector<int64_t>>{
+    {ids[0], ids[1]},
+    {ids[2], ids[3]}
+  });
+  const auto expectedAges = toValues(std::set<std::vector<int64_t>>{{0}, {20}});
+  
+  for(const auto listBinding : {sql::ListBinding::CArray, sql::ListBinding::SortedCArray, sql::ListBinding::TempTable, sql::ListBinding::Adaptive})
+  {
+    db.setListBinding(listBinding);
+    
+    handler.run("MATCH (a)-[:Knows]->(b) WHERE id(a) IN $ids RETURN id(a), id(b)", params);
+    EXPECT_EQ(expectedPaths, toSet(handler.rows()));
+    EXPECT_EQ(listBinding == sql::ListBinding::TempTable,
+              std::any_of(dbWrapper->m_queryStats.begin(), dbWrapper->m_queryStats.end(), [](const SQLQueryStat& stat) {
+      return std::string::npos != stat.query.find("IN temp.SYS__IN_LIST_");
+    }));
+    
+    handler.run("MATCH (a:Person) WHERE id(a) IN $ids RETURN a.age", params);
+    EXPECT_EQ(expectedAges, toSet(handler.rows()));
+    
+    // The temporary tables are emptied after each query.
+    handler.run("MATCH (a:Person) WHERE id(a) IN $ids RETURN a.age", {{ParameterName{"ids"}, std::make_shared<std::vector<int64_t>>(std::vector<int64_t>{ids[3]})}});
+    EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{30}}), toSet(handler.rows()));
+  }
+}
+
+TEST(Test, IDSet)
+{
+  IDSet ids;
+  EXPECT_TRUE(ids.empty());
+  EXPECT_TRUE(ids.begin() == ids.end());
+  
+  // Negative ids, ids in different containers, and a container converted to a bitmap.
+  std::set<int64_t> expected{-(1ll << 40), -3, 0, 1, (1ll << 16) + 5, std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min()};
+  for(int64_t i=100; i<10100; i += 2)
+    expected.insert(i);
+  for(const int64_t id : expected)
+    EXPECT_TRUE(ids.insert(id));
+  EXPECT_FALSE(ids.insert(0));
+  EXPECT_FALSE(ids.insert(102));
+  EXPECT_EQ(expected.size(), ids.size());
+  EXPECT_TRUE(ids.contains(-3));
+  EXPECT_TRUE(ids.contains(10098));
+  EXPECT_FALSE(ids.contains(101));
+  EXPECT_FALSE(ids.contains(-2));
+  // Iteration is in increasing order.
+  EXPECT_EQ(std::vector<int64_t>(expected.begin(), expected.end()), std::vector<int64_t>(ids.begin(), ids.end()));
+  
+  IDSet odd;
+  for(int64_t i=101; i<10101; i += 2)
+    odd.insert(i);
+  odd.insert(-3);
+  
+  IDSet all = ids;
+  all |= odd;
+  EXPECT_EQ(expected.size() + 5000, all.size());
+  for(int64_t i=100; i<10100; ++i)
+    EXPECT_TRUE(all.contains(i));
+  
+  all -= odd;
+  EXPECT_EQ(ids.size() - 1, all.size());
+  all.insert(-3);
+  EXPECT_EQ(ids, all);
+  all -= ids;
+  EXPECT_TRUE(all.empty());
+  
+  // A difference converting a bitmap back to an array.
+  IDSet even = ids;
+  for(int64_t i=1000; i<10100; i += 2)
+    all.insert(i);
+  even -= all;
+  EXPECT_EQ(expected.size() - 4550, even.size());
+  EXPECT_TRUE(even.contains(998));
+  EXPECT_FALSE(even.contains(1000));
+  EXPECT_LT(even.sizeInBytes(), ids.sizeInBytes());
+}
+
+TEST(Test, IDSetParameter)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.IDSetParameter.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  db.addType("Person", true, {});
+  db.addType("Knows", false, {});
+  
+  // A chain of persons, where each person knows the next two persons.
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<20; ++i)
+    ids.push_back(db.addNode("Person", {}));
+  for(size_t i=0; i<ids.size(); ++i)
+    for(size_t j=i+1; j<std::min(i+3, ids.size()); ++j)
+      db.addRelationship("Knows", ids[i], ids[j], {});
+  db.endTransaction();
+  
+  // Breadth-first traversal, where each level is the result of a query having the previous level as parameter.
+  auto visited = std::make_shared<IDSet>();
+  visited->insert(ids[0]);
+  auto frontier = std::make_shared<IDSet>(*visited);
+  size_t countLevels{};
+  while(!frontier->empty())
+  {
+    IDSet next;
+    IDSetResultsHandler handler(next);
+    runCypher("MATCH (a)-[:Knows]->(b) WHERE id(a) IN $frontier RETURN id(b)", {{ParameterName{"frontier"}, frontier}}, db, handler);
+    next -= *visited;
+    *visited |= next;
+    *frontier = std::move(next);
+    ++countLevels;
+  }
+  EXPECT_EQ(ids.size(), visited->size());
+  EXPECT_EQ(11, countLevels);
+  
+  // The set is read by the idset virtual table.
+  QueryResultsHandler handler(*dbWrapper);
+  auto someIds = std::make_shared<IDSet>();
+  someIds->insert(ids[18]);
+  someIds->insert(ids[3]);
+  someIds->insert(ids[3] + 1000);
+  const std::map<ParameterName, ParameterValue> params{{ParameterName{"ids"}, someIds}};
+  handler.run("MATCH (a)-[:Knows]->(b) WHERE id(a) IN $ids RETURN id(a), id(b)", params);
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{ids[3], ids[4]}, {ids[3], ids[5]}, {ids[18], ids[19]}}), toSet(handler.rows()));
+  EXPECT_TRUE(std::any_of(dbWrapper->m_queryStats.begin(), dbWrapper->m_queryStats.end(), [](const SQLQueryStat& stat) {
+    return std::string::npos != stat.query.find("IN idset(?");
+  }));
+  
+  // Filters evaluated natively.
+  db.setSingleVariableFiltersEvaluation(SingleVariableFiltersEvaluation::Native);
+  handler.run("MATCH (a)-[:Knows]->(b) WHERE id(b) IN $ids RETURN id(a)", params);
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{ids[1]}, {ids[2]}, {ids[16]}, {ids[17]}}), toSet(handler.rows()));
+}
+
+TEST(Test, InMemoryAdjacency)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.InMemoryAdjacency.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("Knows", false, {});
+  db.addType("Likes", false, {});
+  
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<6; ++i)
+    ids.push_back(db.addNode("Person", mkVec(std::pair{p_age, Value(static_cast<int64_t>(10 * i))})));
+  db.addRelationship("Knows", ids[0], ids[1], {});
+  db.addRelationship("Knows", ids[1], ids[2], {});
+  db.addRelationship("Likes", ids[1], ids[3], {});
+  db.addRelationship("Knows", ids[4], ids[1], {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  const std::vector<std::string> queries{
+    "MATCH (a)-[:Knows]->(b)-[:Knows]->(c) RETURN id(a), id(c)",
+    "MATCH (a)-[]->(b)-[r]->(c) WHERE id(a) = " + std::to_string(ids[0]) + " RETURN id(r), c.age",
+    "MATCH (a)-[]->(b)<-[]-(c) RETURN id(a), id(c)",
+    "MATCH (a)-[]-(b)-[:Likes]-(c) WHERE c.age > 10 RETURN id(a), id(c)"
+  };
+  auto runAll = [&]()
+  {
+    std::vector<std::set<std::vector<Value>>> results;
+    for(const auto & query : queries)
+    {
+      handler.run(query);
+      results.push_back(toSet(handler.rows()));
+    }
+    return results;
+  };
+  auto usesNeighbors = [&]()
+  {
+    return std::any_of(dbWrapper->m_queryStats.begin(), dbWrapper->m_queryStats.end(), [](const SQLQueryStat& stat) {
+      return std::string::npos != stat.query.find("neighbors(");
+    });
+  };
+  
+  const auto expected = runAll();
+  EXPECT_FALSE(usesNeighbors());
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{ids[0], ids[2]}, {ids[4], ids[2]}}), expected[0]);
+  
+  db.setInMemoryAdjacency(true);
+  EXPECT_EQ(expected, runAll());
+  EXPECT_TRUE(usesNeighbors());
+  
+  // The relationships added later are also in memory.
+  db.addRelationship("Knows", ids[2], ids[5], {});
+  const auto withAdjacency = runAll();
+  db.setInMemoryAdjacency(false);
+  EXPECT_EQ(runAll(), withAdjacency);
+  EXPECT_NE(expected, withAdjacency);
+}
+
+TEST(Test, FrontierExpansion)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.FrontierExpansion.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  const auto p_age = mkProperty("age");
+  db.addType("Person", true, {p_age});
+  db.addType("City", true, {});
+  db.addType("Knows", false, {});
+  db.addType("Likes", false, {});
+  db.addType("LivesIn", false, {});
+  
+  std::vector<int64_t> ids;
+  db.beginTransaction();
+  for(int i=0; i<6; ++i)
+    ids.push_back(db.addNode("Person", mkVec(std::pair{p_age, Value(static_cast<int64_t>(10 * i))})));
+  const auto city = db.addNode("City", {});
+  db.addRelationship("Knows", ids[0], ids[1], {});
+  db.addRelationship("Knows", ids[0], ids[2], {});
+  db.addRelationship("Knows", ids[1], ids[3], {});
+  db.addRelationship("Likes", ids[1], ids[4], {});
+  db.addRelationship("Likes", ids[2], ids[4], {});
+  db.addRelationship("Likes", ids[2], ids[5], {});
+  db.addRelationship("Likes", ids[3], ids[0], {});
+  db.addRelationship("LivesIn", ids[4], city, {});
+  db.addRelationship("LivesIn", ids[5], city, {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  const std::map<ParameterName, ParameterValue> params{
+    {ParameterName{"ids"}, std::make_shared<std::vector<int64_t>>(std::vector<int64_t>{ids[0], ids[1]})}
+  };
+  const std::vector<std::string> queries{
+    "MATCH (a)-[:Knows]->()-[:Likes]->(c) WHERE id(a) = " + std::to_string(ids[0]) + " RETURN id(c)",
+    "MATCH (a)-[:Knows]->()-[:Likes]->(c) WHERE id(a) = " + std::to_string(ids[0]) + " RETURN DISTINCT id(c)",
+    "MATCH (a)-[:Knows]->(b:Person)-[:Likes]-(c)-[:LivesIn]->(d:City) WHERE a.age < 20 RETURN id(d), count(*)",
+    "MATCH (a)-[:Knows]->()<-[:Likes]-(c) WHERE id(a) IN $ids AND c.age > 10 RETURN c.age",
+    "MATCH (a)-[:Knows]->()-[:Likes]->(c) RETURN id(c) LIMIT 2"
+  };
+  // The rows, with their multiplicity.
+  auto runAll = [&]()
+  {
+    std::vector<std::multiset<std::vector<Value>>> results;
+    for(const auto & query : queries)
+    {
+      handler.run(query, params);
+      std::multiset<std::vector<Value>> rows;
+      for(const auto & row : handler.rows())
+      {
+        std::vector<Value> r;
+        for(const auto & v : row)
+          r.push_back(copy(v));
+        rows.insert(std::move(r));
+      }
+      results.push_back(std::move(rows));
+    }
+    return results;
+  };
+  auto row = [](auto... values)
+  {
+    std::vector<Value> r;
+    (r.push_back(Value(values)), ...);
+    return r;
+  };
+  
+  db.setFrontierExpansion(false);
+  const auto expected = runAll();
+  EXPECT_EQ(3, expected[0].size());
+  EXPECT_EQ(2, expected[0].count(row(ids[4])));
+  EXPECT_EQ(1, expected[0].count(row(ids[5])));
+  EXPECT_EQ(2, expected[1].size());
+  EXPECT_EQ(1, expected[2].size());
+  EXPECT_EQ(1, expected[2].count(row(city, int64_t{3})));
+  
+  db.setFrontierExpansion(true);
+  const auto results = runAll();
+  for(size_t i{}; i<queries.size() - 1; ++i)
+    EXPECT_EQ(expected[i], results[i]);
+  EXPECT_EQ(2, results.back().size());
+  
+  // Each hop is a query on a single relationship.
+  handler.run(queries[2], params);
+  for(const auto & stat : dbWrapper->m_queryStats)
+    EXPECT_EQ(std::string::npos, stat.query.find("R1."));
+  
+  // Relationship types that are not disjoint need relationship uniqueness: the paths are expanded with self joins.
+  handler.run("MATCH (a)-[:Knows]->()-[:Knows]->(c) RETURN id(c)");
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{ids[3]}}), toSet(handler.rows()));
+  EXPECT_TRUE(std::any_of(dbWrapper->m_queryStats.begin(), dbWrapper->m_queryStats.end(), [](const SQLQueryStat& stat) {
+    return std::string::npos != stat.query.find("R1.");
+  }));
+}
+
+TEST(Test, RelationshipUniqueness)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.RelationshipUniqueness.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  db.addType("Person", true, {});
+  db.addType("City", true, {});
+  db.addType("Knows", false, {});
+  db.addType("Likes", false, {});
+  db.addType("LivesIn", false, {});
+  
+  db.beginTransaction();
+  const auto a = db.addNode("Person", {});
+  const auto b = db.addNode("Person", {});
+  const auto c = db.addNode("Person", {});
+  const auto city = db.addNode("City", {});
+  db.addRelationship("Knows", a, b, {});
+  db.addRelationship("Knows", b, a, {});
+  db.addRelationship("Likes", b, c, {});
+  db.addRelationship("LivesIn", a, city, {});
+  db.addRelationship("LivesIn", b, city, {});
+  db.endTransaction();
+  
+  QueryResultsHandler handler(*dbWrapper);
+  
+  auto comparesRelationshipIDs = [&]()
+  {
+    return std::any_of(dbWrapper->m_queryStats.begin(), dbWrapper->m_queryStats.end(), [](const SQLQueryStat& stat) {
+      return std::string::npos != stat.query.find("NOT IN");
+    });
+  };
+  
+  // Relationships of disjoint types cannot be the same relationship.
+  handler.run("MATCH (x)-[:Knows]->(y)-[:Likes]->(z) RETURN id(x), id(y), id(z)");
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{a, b, c}}), toSet(handler.rows()));
+  EXPECT_FALSE(comparesRelationshipIDs());
+  
+  // Unless the elimination of these comparisons is disabled.
+  db.setUniquenessConstraintsElimination(false);
+  handler.run("MATCH (x)-[:Knows]->(y)-[:Likes]->(z) RETURN id(x), id(y), id(z)");
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{a, b, c}}), toSet(handler.rows()));
+  EXPECT_TRUE(comparesRelationshipIDs());
+  db.setUniquenessConstraintsElimination(true);
+  
+  // Relationships whose destinations have disjoint types cannot be the same relationship.
+  handler.run("MATCH (x:Person)-[]->(y:Person)-[]->(z:City) RETURN id(x), id(y), id(z)");
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{a, b, city}, {b, a, city}}), toSet(handler.rows()));
+  EXPECT_FALSE(comparesRelationshipIDs());
+  
+  // Relationships that can be the same relationship are compared.
+  handler.run("MATCH (x)-[:Knows]->(y)-[:Knows]->(z) RETURN id(x), id(y), id(z)");
+  EXPECT_EQ(toValues(std::set<std::vector<int64_t>>{{a, b, a}, {b, a, b}}), toSet(handler.rows()));
+  EXPECT_TRUE(comparesRelationshipIDs());
+  
+  handler.run("MATCH (x)-[r1]-(y)-[r2]-(z) RETURN id(r1), id(r2)");
+  EXPECT_LT(0, handler.rows().size());
+  for(const auto & row : handler.rows())
+    EXPECT_FALSE(row[0] == row[1]);
+  EXPECT_TRUE(comparesRelationshipIDs());
+}
+
+TEST(Test, ShortestPaths)
+{
+  LogIndentScope _{};
+  
+  auto dbWrapper = std::make_unique<GraphWithStats<int64_t>>("Test.ShortestPaths.sqlite3db", Overwrite::Yes);
+  auto & db = dbWrapper->getDB();
+  db.addType("Person", true, {});
+  db.addType("Knows", false, {});
+  db.addType("Likes", false, {});
+  
+  db.beginTransaction();
+  const auto a = db.addNode("Person", {});
+  const auto b = db.addNode("Person", {});
+  const auto c = db.addNode("Person", {});
+  const auto d = db.addNode("Person", {});
+  const auto e = db.addNode("Person", {});
+  const auto ab = db.addRelationship("Knows", a, b, {});
+  const auto bd = db.addRelationship("Knows", b, d, {});
+  const auto ac = db.addRelationship("Knows", a, c, {});
+  const auto cd = db.addRelationship("Likes", c, d, {});
+  const auto de = db.addRelationship("Knows", d, e, {});
+  db.endTransaction();
+  
+  using Paths = std::set<std::vector<int64_t>>;
+  const std::set<openCypher::Label> anyType;
+  const std::set<openCypher::Label> knows{openCypher::Label{openCypher::SymbolicName{"Knows"}}};
+  auto allShortestPaths = [&](const int64_t from, const int64_t to, const TraversalDirection direction,
+                              const std::set<openCypher::Label>& types, const std::optional<size_t> maxDepth = std::nullopt)
+  {
+    const auto paths = db.shortestPaths(from, to, direction, types, maxDepth, ShortestPaths::All);
+    return Paths(paths.begin(), paths.end());
+  };
+  
+  for(const bool inMemoryAdjacency : {false, true})
+  {
+    db.setInMemoryAdjacency(inMemoryAdjacency);
+    
+    EXPECT_EQ(Paths({{a, ab, b, bd, d}, {a, ac, c, cd, d}}), allShortestPaths(a, d, TraversalDirection::Forward, anyType));
+    EXPECT_EQ(Paths({{a, ab, b, bd, d, de, e}, {a, ac, c, cd, d, de, e}}), allShortestPaths(a, e, TraversalDirection::Forward, anyType));
+    EXPECT_EQ(Paths({{a, ab, b, bd, d}}), allShortestPaths(a, d, TraversalDirection::Forward, knows));
+    
+    // Directions.
+    EXPECT_EQ(Paths{}, allShortestPaths(d, a, TraversalDirection::Forward, anyType));
+    EXPECT_EQ(Paths({{d, bd, b, ab, a}, {d, cd, c, ac, a}}), allShortestPaths(d, a, TraversalDirection::Backward, anyType));
+    EXPECT_EQ(Paths({{d, bd, b, ab, a}, {d, cd, c, ac, a}}), allShortestPaths(d, a, TraversalDirection::Any, anyType));
+    EXPECT_EQ(Paths({{b, ab, a, ac, c}, {b, bd, d, cd, c}}), allShortestPaths(b, c, TraversalDirection::Any, anyType));
+    
+    // Maximum depth.
+    EXPECT_EQ(Paths{}, allShortestPaths(a, d, TraversalDirection::Forward, anyType, 1));
+    EXPECT_EQ(2, allShortestPaths(a, d, TraversalDirection::Forward, anyType, 2).size());
+    
+    EXPECT_EQ(Paths({{a}}), allShortestPaths(a, a, TraversalDirection::Forward, anyType));
+    
+    // A single shortest path.
+    const auto paths = db.shortestPaths(a, e, TraversalDirection::Forward, anyType, std::nullopt, ShortestPaths::One);
+    ASSERT_EQ(1, paths.size());
+    EXPECT_EQ(1, allShortestPaths(a, e, TraversalDirection::Forward, anyType).count(paths[0]));
+  }
+}
+
 }  // NS
@@ -16,7 +16,9 @@
 
 #include "Value.h"
 
+#include <algorithm>
 #include <sstream>
+#include <unordered_set>
 
 template < typename > constexpr bool c_false = false;
 
@@ -59,6 +61,125 @@ Value copy(Value const & v)
   }, v);
 }
 
+int storageClass(const Value& v)
+{
+  if(std::holds_alternative<int64_t>(v) || std::holds_alternative<double>(v))
+    return 0;
+  if(std::holds_alternative<StringPtr>(v))
+    return 1;
+  return 2;
+}
+
+double asDouble(const Value& v)
+{
+  if(const auto * i = std::get_if<int64_t>(&v))
+    return static_cast<double>(*i);
+  return std::get<double>(v);
+}
+
+int compareBytes(const unsigned char* a, size_t szA, const unsigned char* b, size_t szB)
+{
+  if(const int res = std::memcmp(a, b, std::min(szA, szB)))
+    return res;
+  return compareScalars(szA, szB);
+}
+
+int threeWayCompare(const Value& a, const Value& b)
+{
+  const int classA = storageClass(a);
+  const int classB = storageClass(b);
+  if(classA != classB)
+    return compareScalars(classA, classB);
+  switch(classA)
+  {
+    case 0:
+      if(std::holds_alternative<int64_t>(a) && std::holds_alternative<int64_t>(b))
+        return compareScalars(std::get<int64_t>(a), std::get<int64_t>(b));
+      return compareScalars(asDouble(a), asDouble(b));
+    case 1:
+      return std::strcmp(std::get<StringPtr>(a).string.get(), std::get<StringPtr>(b).string.get());
+    default:
+    {
+      const auto & bytesA = std::get<ByteArrayPtr>(a);
+      const auto & bytesB = std::get<ByteArrayPtr>(b);
+      return compareBytes(bytesA.bytes.get(), bytesA.m_bufSz, bytesB.bytes.get(), bytesB.m_bufSz);
+    }
+  }
+}
+
+void appendEncoded(const Value & value, std::string& key)
+{
+  key.push_back(static_cast<char>(value.index()));
+  std::visit([&](auto && arg) {
+    using T = std::decay_t<decltype(arg)>;
+    if constexpr (std::is_same_v<T, int64_t> || std::is_same_v<T, double>)
+      key.append(reinterpret_cast<const char*>(&arg), sizeof(T));
+    else if constexpr (std::is_same_v<T, StringPtr>)
+      // The string has no null character.
+      key.append(arg.string.get()).push_back('\0');
+    else if constexpr (std::is_same_v<T, ByteArrayPtr>)
+    {
+      key.append(reinterpret_cast<const char*>(&arg.m_bufSz), sizeof(arg.m_bufSz));
+      key.append(reinterpret_cast<const char*>(arg.bytes.get()), arg.m_bufSz);
+    }
+    else if constexpr (std::is_same_v<T, Nothing>)
+    {}
+    else
+      static_assert(c_false<T>, "non-exhaustive visitor!");
+  }, value);
+}
+
+Value decodeValue(const std::string& key, size_t& pos)
+{
+  if(pos >= key.size())
+    throw std::invalid_argument("No encoded value");
+  const size_t index = static_cast<unsigned char>(key[pos++]);
+  auto readBytes = [&](void* dst, const size_t sz)
+  {
+    if(key.size() - pos < sz)
+      throw std::invalid_argument("Truncated encoded value");
+    memcpy(dst, key.data() + pos, sz);
+    pos += sz;
+  };
+  switch(index)
+  {
+    case 0:
+      return Nothing{};
+    case 1:
+    {
+      double d;
+      readBytes(&d, sizeof(d));
+      return d;
+    }
+    case 2:
+    {
+      int64_t i;
+      readBytes(&i, sizeof(i));
+      return i;
+    }
+    case 3:
+    {
+      const auto end = key.find('\0', pos);
+      if(end == std::string::npos)
+        throw std::invalid_argument("Truncated encoded value");
+      auto str = StringPtr::fromCStr(key.c_str() + pos);
+      pos = end + 1;
+      return str;
+    }
+    case 4:
+    {
+      size_t sz;
+      readBytes(&sz, sizeof(sz));
+      if(key.size() - pos < sz)
+        throw std::invalid_argument("Truncated encoded value");
+      auto bytes = ByteArrayPtr::fromByteArray(key.data() + pos, sz);
+      pos += sz;
+      return bytes;
+    }
+  }
+  throw std::invalid_argument("Invalid encoded value type");
+}
+
 void append(Value && val, HomogeneousNonNullableValues & v)
 {
   std::visit([&](auto && arg) {
@@ -94,6 +215,105 @@ void append(Value && val, HomogeneousNonNullableValues & v)
   }, val);
 }
 
+bool hasDuplicates(const HomogeneousNonNullableValues & values)
+{
+  auto hasDuplicateKeys = [](const auto & keys)
+  {
+    using Key = typename std::decay_t<decltype(keys)>::value_type;
+    std::unordered_set<Key> distinctKeys;
+    distinctKeys.reserve(keys.size());
+    for(const auto & key : keys)
+      if(!distinctKeys.insert(key).second)
+        return true;
+    return false;
+  };
+  return std::visit([&](auto && arg) {
+    using T = std::decay_t<decltype(arg)>;
+    if constexpr (std::is_same_v<T, std::monostate>)
+      return false;
+    else if constexpr (std::is_same_v<T, std::shared_ptr<Strings>>)
+    {
+      std::vector<std::string_view> keys;
+      keys.reserve(arg->stringsArray.size());
+      for(const char * str : arg->stringsArray)
+        keys.emplace_back(str);
+      return hasDuplicateKeys(keys);
+    }
+    else if constexpr (std::is_same_v<T, std::shared_ptr<ByteArrays>>)
+    {
+      std::vector<std::string_view> keys;
+      keys.reserve(arg->iovecs.size());
+      for(const auto & iov : arg->iovecs)
+        keys.emplace_back(static_cast<const char*>(iov.iov_base), iov.iov_len);
+      return hasDuplicateKeys(keys);
+    }
+    else if constexpr (std::is_same_v<T, std::shared_ptr<IDSet>>)
+      return false;
+    else
+      return hasDuplicateKeys(*arg);
+  }, values);
+}
+
+void forEachValue(const HomogeneousNonNullableValues & values, const std::function<void(Value &&)>& f)
+{
+  std::visit([&](auto && arg) {
+    using T = std::decay_t<decltype(arg)>;
+    if constexpr (std::is_same_v<T, std::monostate>)
+      return;
+    else if constexpr (std::is_same_v<T, std::shared_ptr<Strings>>)
+    {
+      for(const char * str : arg->stringsArray)
+        f(StringPtr::fromCStr(str));
+    }
+    else if constexpr (std::is_same_v<T, std::shared_ptr<ByteArrays>>)
+    {
+      for(const auto & iov : arg->iovecs)
+        f(ByteArrayPtr::fromByteArray(iov.iov_base, iov.iov_len));
+    }
+    else if constexpr (std::is_same_v<T, std::shared_ptr<IDSet>>)
+    {
+      for(const int64_t id : *arg)
+        f(id);
+    }
+    else
+    {
+      for(const auto value : *arg)
+        f(value);
+    }
+  }, values);
+}
+
+size_t countValues(const HomogeneousNonNullableValues & values)
+{
+  return std::visit([&](auto && arg) -> size_t {
+    using T = std::decay_t<decltype(arg)>;
+    if constexpr (std::is_same_v<T, std::monostate>)
+      return 0;
+    else if constexpr (std::is_same_v<T, std::shared_ptr<Strings>>)
+      return arg->stringsArray.size();
+    else if constexpr (std::is_same_v<T, std::shared_ptr<ByteArrays>>)
+      return arg->iovecs.size();
+    else
+      return arg->size();
+  }, values);
+}
+
+HomogeneousNonNullableValues sortedDistinctValues(const HomogeneousNonNullableValues & values)
+{
+  return std::visit([&](auto && arg) -> HomogeneousNonNullableValues {
+    using T = std::decay_t<decltype(arg)>;
+    if constexpr (std::is_same_v<T, std::shared_ptr<std::vector<int64_t>>> || std::is_same_v<T, std::shared_ptr<std::vector<double>>>)
+    {
+      auto sorted = std::make_shared<typename T::element_type>(*arg);
+      std::sort(sorted->begin(), sorted->end());
+      sorted->erase(std::unique(sorted->begin(), sorted->end()), sorted->end());
+      return sorted;
+    }
+    else
+      return values;
+  }, values);
+}
+
 ByteArrayPtr ByteArrayPtr::clone() const
 {
   if(bytes)
@@ -16,11 +16,15 @@
 
 #pragma once
 
+#include "IDSet.h"
+
 #include <variant>
 #include <memory>
 #include <cstring>
 #include <exception>
+#include <functional>
 #include <ostream>
+#include <string>
 
 #ifdef _WIN32
 struct iovec {
@@ -131,6 +135,34 @@ using Value = std::variant<Nothing, double, int64_t, StringPtr, ByteArrayPtr>;
 
 Value copy(Value const & v);
 
+// Values of different storage classes are ordered like in SQLite:
+// numeric values (0) < text (1) < blob (2).
+int storageClass(const Value& v);
+
+// |v| is an integer or a real.
+double asDouble(const Value& v);
+
+template<typename T>
+int compareScalars(const T& a, const T& b)
+{
+  return (a < b) ? -1 : ((b < a) ? 1 : 0);
+}
+
+// Orders byte arrays like SQLite orders blobs: a byte array is smaller than the longer byte arrays it is a prefix of.
+int compareBytes(const unsigned char* a, size_t szA, const unsigned char* b, size_t szB);
+
+// Orders non-null values like SQLite does (numeric values < text < blob):
+// returns a negative value if a < b, 0 if a == b and a positive value if a > b.
+int threeWayCompare(const Value& a, const Value& b);
+
+// Appends to |key| an encoding of |value| such that two values have the same encoding iff they are equal.
+// Values of different types have different encodings, and nulls have the same encoding.
+void appendEncoded(const Value & value, std::string& key);
+
+// Decodes the value encoded by appendEncoded at position |pos| of |key|, and moves |pos| after the encoded value.
+// Throws std::invalid_argument if |key| doesn't contain an encoded value at |pos|.
+Value decodeValue(const std::string& key, size_t& pos);
+
 std::ostream & operator <<(std::ostream& os, const Value & v);
 
 struct ByteArrays
@@ -170,7 +202,8 @@ std::monostate, // empty list
 std::shared_ptr<std::vector<double>>,
 std::shared_ptr<std::vector<int64_t>>,
 std::shared_ptr<Strings>, // this format is OK for binding via the carray sqlite extention.
-std::shared_ptr<ByteArrays>
+std::shared_ptr<ByteArrays>,
+std::shared_ptr<IDSet> // integers, bound via the idset virtual table.
 >;
 
 template<typename Value_T>
@@ -201,6 +234,19 @@ struct CorrespondingVectorType<ByteArrayPtr>
 // Will throw if v has a value and val is incompatible with this value.
 void append(Value && val, HomogeneousNonNullableValues & v);
 
+// Whether |values| contains some value more than once.
+bool hasDuplicates(const HomogeneousNonNullableValues & values);
+
+// Calls |f| with each value of |values|.
+void forEachValue(const HomogeneousNonNullableValues & values, const std::function<void(Value &&)>& f);
+
+// Returns the count of values of |values|.
+size_t countValues(const HomogeneousNonNullableValues & values);
+
+// Returns a sorted copy of |values| without duplicates, for lists of numbers.
+// Lists of strings and byte arrays, and IDSets, are returned as is.
+HomogeneousNonNullableValues sortedDistinctValues(const HomogeneousNonNullableValues & values);
+
 
 template<typename T>
 struct Traits;